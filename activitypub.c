@@ -154,6 +154,40 @@ int actor_request(snac *user, const char *actor, xs_dict **data)
 }
 
 
+int actor_summary_request(snac *user, const char *actor, xs_dict **data)
+/* request an actor, returning only its summary */
+{
+    int status;
+
+    if (data)
+        *data = NULL;
+
+    /* get from disk first */
+    status = actor_summary_get_refresh(user, actor, data);
+
+    if (valid_status(status)) {
+        /* collect the (presumed) shared inbox in this actor */
+        if (xs_type(xs_dict_get(srv_config, "disable_inbox_collection")) != XSTYPE_TRUE) {
+            if (data && *data)
+                inbox_add_by_actor(*data);
+        }
+    }
+    else {
+        xs *actor_o = NULL;
+
+        /* get from the net (the summary is built when stored) */
+        if (valid_status(status = actor_request(user, actor, &actor_o))) {
+            if (!valid_status(actor_summary_get(actor, data)) && data) {
+                *data   = actor_o;
+                actor_o = NULL;
+            }
+        }
+    }
+
+    return status;
+}
+
+
 const char *get_atto(const xs_dict *msg)
 /* gets the attributedTo field (an actor) */
 {
@@ -395,13 +429,28 @@ int send_to_inbox_raw(const char *keyid, const char *seckey,
                   const xs_str *inbox, const xs_dict *msg,
                   xs_val **payload, int *p_size, int timeout)
 /* sends a message to an Inbox */
+{
+    xs *j_msg = xs_json_dumps((xs_dict *)msg, 4);
+
+    return send_to_inbox_body(keyid, seckey, inbox, j_msg, NULL, payload, p_size, timeout);
+}
+
+
+int send_to_inbox_body(const char *keyid, const char *seckey,
+                  const xs_str *inbox, const char *body, const char *digest,
+                  xs_val **payload, int *p_size, int timeout)
+/* sends an already serialized message to an Inbox */
 {
     int status;
     xs_dict *response;
-    xs *j_msg = xs_json_dumps((xs_dict *)msg, 4);
+    xs *hdrs = xs_dict_new();
+
+    /* if the digest is already computed, pass it as a header */
+    if (digest != NULL)
+        hdrs = xs_dict_append(hdrs, "digest", digest);
 
     response = http_signed_request_raw(keyid, seckey, "POST", inbox,
-        NULL, j_msg, strlen(j_msg), &status, payload, p_size, timeout);
+        hdrs, body, strlen(body), &status, payload, p_size, timeout);
 
     xs_free(response);
 
@@ -425,7 +474,7 @@ xs_str *get_actor_inbox(const char *actor)
     xs *data = NULL;
     const char *v = NULL;
 
-    if (valid_status(actor_request(NULL, actor, &data))) {
+    if (valid_status(actor_summary_request(NULL, actor, &data))) {
         /* try first endpoints/sharedInbox */
         if ((v = xs_dict_get(data, "endpoints")))
             v = xs_dict_get(v, "sharedInbox");
@@ -686,6 +735,123 @@ int is_msg_for_me(snac *snac, const xs_dict *c_msg)
 }
 
 
+static void _add_local_user(xs_set *users, const char *url)
+/* adds the user of a local actor (or of something under it) */
+{
+    int l = strlen(srv_baseurl);
+
+    if (xs_type(url) == XSTYPE_STRING && strncmp(url, srv_baseurl, l) == 0 && url[l] == '/') {
+        xs *uid = xs_dup(url + l + 1);
+        char *p = strchr(uid, '/');
+
+        if (p != NULL)
+            *p = '\0';
+
+        if (*uid)
+            xs_set_add(users, uid);
+    }
+}
+
+
+static int _add_relation_users(xs_set *users, const char *actor, const char *cachedir)
+/* adds the users having a relation with an actor
+   (returns 0 if the relations index is not available) */
+{
+    if (xs_type(actor) != XSTYPE_STRING)
+        return 1;
+
+    xs *list = relation_users(actor, cachedir);
+    xs_list *p = list;
+    const char *v;
+
+    if (list == NULL)
+        return 0;
+
+    while (xs_list_iter(&p, &v))
+        xs_set_add(users, v);
+
+    return 1;
+}
+
+
+xs_list *msg_candidate_users(const xs_dict *c_msg)
+/* returns the users that may accept a message from the shared inbox,
+   to be confirmed by is_msg_for_me(), or NULL if any of them may */
+{
+    const char *type  = xs_dict_get(c_msg, "type");
+    const char *actor = xs_dict_get(c_msg, "actor");
+    xs_set users;
+    int ok = 1;
+
+    /* these are accepted by everybody */
+    if (xs_type(type) != XSTYPE_STRING ||
+        !xs_match(type, "Like|Announce|Undo|Accept|Follow|Ping|Create|Update"))
+        return NULL;
+
+    xs_set_init(&users);
+
+    if (xs_match(type, "Like|Announce")) {
+        const char *object = xs_dict_get(c_msg, "object");
+
+        if (xs_type(object) == XSTYPE_DICT)
+            object = xs_dict_get(object, "id");
+
+        _add_local_user(&users, object);
+        ok &= _add_relation_users(&users, actor, "following");
+    }
+    else
+    if (xs_match(type, "Undo")) {
+        ok &= _add_relation_users(&users, actor, "followers");
+        ok &= _add_relation_users(&users, actor, "following");
+    }
+    else
+    if (xs_match(type, "Accept"))
+        ok &= _add_relation_users(&users, actor, "following");
+    else
+    if (xs_match(type, "Follow"))
+        _add_local_user(&users, xs_dict_get(c_msg, "object"));
+    else
+    if (xs_match(type, "Ping"))
+        _add_local_user(&users, xs_dict_get(c_msg, "to"));
+    else {
+        /* Create or Update: the same tests as is_msg_for_me() */
+        const xs_dict *msg = xs_dict_get(c_msg, "object");
+        int pub_msg = is_msg_public(c_msg);
+
+        ok &= _add_relation_users(&users, actor, "following");
+
+        xs *rcpts = recipient_list(NULL, msg, 0);
+        xs_list *p = rcpts;
+        const char *v;
+
+        while (xs_list_iter(&p, &v)) {
+            _add_local_user(&users, v);
+
+            if (pub_msg)
+                ok &= _add_relation_users(&users, v, "following");
+        }
+
+        if (pub_msg) {
+            ok &= _add_relation_users(&users, get_atto(msg), "following");
+
+            const char *irt = xs_dict_get(msg, "inReplyTo");
+            xs *r_msg = NULL;
+
+            if (!xs_is_null(irt) && valid_status(object_get(irt, &r_msg)))
+                ok &= _add_relation_users(&users, get_atto(r_msg), "following");
+        }
+    }
+
+    /* no relations index? */
+    if (!ok) {
+        xs_set_free(&users);
+        return NULL;
+    }
+
+    return xs_set_result(&users);
+}
+
+
 xs_str *process_tags(snac *snac, const char *content, xs_list **tag)
 /* parses mentions and tags from content */
 {
@@ -2194,6 +2360,10 @@ void process_user_queue_item(snac *snac, xs_dict *q_item)
 
         xs_set_init(&inboxes);
 
+        /* the body and its digest are the same for all deliveries */
+        xs *body   = xs_json_dumps(msg, 4);
+        xs *digest = http_digest(body, strlen(body));
+
         /* iterate the recipients */
         p = rcpts;
         while (xs_list_iter(&p, &actor)) {
@@ -2202,7 +2372,7 @@ void process_user_queue_item(snac *snac, xs_dict *q_item)
             if (inbox != NULL) {
                 /* add to the set and, if it's not there, send message */
                 if (xs_set_add(&inboxes, inbox) == 1)
-                    enqueue_output(snac, msg, inbox, 0, 0);
+                    enqueue_output_wave(snac, msg, body, digest, inbox);
             }
             else
                 snac_log(snac, xs_fmt("cannot find inbox for %s", actor));
@@ -2217,7 +2387,7 @@ void process_user_queue_item(snac *snac, xs_dict *q_item)
                 p = shibx;
                 while (xs_list_iter(&p, &inbox)) {
                     if (xs_set_add(&inboxes, inbox) == 1)
-                        enqueue_output(snac, msg, inbox, 0, 0);
+                        enqueue_output_wave(snac, msg, body, digest, inbox);
                 }
             }
         }
@@ -2234,7 +2404,20 @@ void process_user_queue_item(snac *snac, xs_dict *q_item)
         if (xs_is_null(msg))
             return;
 
-        if (!process_input_message(snac, msg, req)) {
+        const char *id = xs_dict_get(msg, "id");
+
+        /* already got from another inbox? */
+        if (activity_seen(snac->uid, id)) {
+            snac_debug(snac, 1, xs_fmt("input already seen %s", id));
+            return;
+        }
+
+        int r = process_input_message(snac, msg, req);
+
+        if (r == 1)
+            activity_seen_add(snac->uid, id);
+        else
+        if (r == 0) {
             srv_archive_error("input", "process_input_message", req, msg);
 
             if (retries > queue_retry_max)
@@ -2348,6 +2531,27 @@ void process_queue_item(xs_dict *q_item)
             return;
         }
 
+        int wait = 0;
+
+        if (!job_host_check(inbox, &wait)) {
+            /* the host is failing: park the message in the disk queue until
+               its circuit half-opens; it's not a retry, as it was not tried,
+               but give up after as long as all the retries would have taken */
+            int qrt = xs_number_get(xs_dict_get(srv_config, "queue_retry_minutes"));
+            int max_secs = qrt * 60 * queue_retry_max * (queue_retry_max + 1) / 2;
+            const xs_number *parked = xs_dict_get(q_item, "parked");
+
+            if (xs_type(parked) == XSTYPE_NUMBER &&
+                time(NULL) - xs_number_get(parked) > max_secs)
+                srv_log(xs_fmt("output message: giving up %s (circuit open)", inbox));
+            else {
+                enqueue_output_park(q_item, wait);
+                srv_debug(1, xs_fmt("output message: parked %s for %d secs", inbox, wait));
+            }
+
+            return;
+        }
+
         /* deliver (if previous error status was a timeout, try now longer) */
         if (p_status == 599)
             timeout = xs_number_get(xs_dict_get_def(srv_config, "queue_timeout_2", "8"));
@@ -2357,7 +2561,15 @@ void process_queue_item(xs_dict *q_item)
         if (timeout == 0)
             timeout = 6;
 
-        status = send_to_inbox_raw(keyid, seckey, inbox, msg, &payload, &p_size, timeout);
+        const char *body   = xs_dict_get(q_item, "body");
+        const char *digest = xs_dict_get(q_item, "digest");
+
+        if (xs_type(body) == XSTYPE_STRING && xs_type(digest) == XSTYPE_STRING)
+            status = send_to_inbox_body(keyid, seckey, inbox, body, digest, &payload, &p_size, timeout);
+        else
+            status = send_to_inbox_raw(keyid, seckey, inbox, msg, &payload, &p_size, timeout);
+
+        job_host_result(inbox, status);
 
         if (payload) {
             if (p_size > 64) {
@@ -2505,18 +2717,31 @@ void process_queue_item(xs_dict *q_item)
             FILE *f;
 
             if ((f = fopen(tmpfn, "w")) != NULL) {
-                xs_json_dump(q_item, 4, f);
+                xs_json_dump(q_item, json_indent(), f);
                 fclose(f);
             }
 
-            xs *users = user_list();
-            xs_list *p = users;
+            /* only the users related to the message need to be checked */
+            xs *users = msg_candidate_users(msg);
+            const char *id = xs_dict_get(msg, "id");
             const char *v;
             int cnt = 0;
 
+            if (users == NULL)
+                users = user_list();
+
+            xs_list *p = users;
+
             while (xs_list_iter(&p, &v)) {
                 snac user;
 
+                /* already got from another inbox? */
+                if (activity_seen(v, id)) {
+                    srv_debug(1, xs_fmt("already seen by %s %s", v, id));
+                    cnt++;
+                    continue;
+                }
+
                 if (user_open(&user, v)) {
                     if (is_msg_for_me(&user, msg)) {
                         xs *fn = xs_fmt("%s/queue/%s.json", user.basedir, ntid);
@@ -2526,6 +2751,8 @@ void process_queue_item(xs_dict *q_item)
 
                         if (link(tmpfn, fn) < 0)
                             srv_log(xs_fmt("link(%s, %s) error", tmpfn, fn));
+                        else
+                            queue_sched_add(fn);
 
                         cnt++;
                     }
@@ -2557,6 +2784,10 @@ int process_queue(void)
     const xs_str *fn;
 
     while (xs_list_iter(&p, &fn)) {
+        /* no more room? leave the rest on disk for the next round */
+        if (job_queue_full())
+            break;
+
         xs *q_item = dequeue(fn);
 
         if (q_item != NULL) {
@@ -2569,6 +2800,60 @@ int process_queue(void)
 }
 
 
+int process_queues(time_t *next)
+/* processes the due items from the user and global queues, as told
+   by the in-memory schedule; next is set to the next retry time */
+{
+    int cnt = 0;
+    xs *list = queue_sched_due(next);
+    xs_list *p = list;
+    const xs_list *e;
+    snac user = {0};
+
+    while (xs_list_iter(&p, &e)) {
+        const char *uid = xs_list_get(e, 0);
+        const char *fn  = xs_list_get(e, 1);
+
+        if (xs_is_null(uid)) {
+            /* no more room? back to the schedule for the next round */
+            if (job_queue_full()) {
+                queue_sched_add(fn);
+                continue;
+            }
+
+            xs *q_item = dequeue(fn);
+
+            if (q_item != NULL) {
+                job_post(q_item, 0);
+                cnt++;
+            }
+        }
+        else {
+            /* reuse the user if it's the same as the previous item's */
+            if (user.uid == NULL || strcmp(user.uid, uid) != 0) {
+                user_free(&user);
+
+                if (!user_open(&user, uid)) {
+                    user = (snac){0};
+                    continue;
+                }
+            }
+
+            xs *q_item = dequeue(fn);
+
+            if (q_item != NULL) {
+                process_user_queue_item(&user, q_item);
+                cnt++;
+            }
+        }
+    }
+
+    user_free(&user);
+
+    return cnt;
+}
+
+
 /** HTTP handlers */
 
 int activitypub_get_handler(const xs_dict *req, const char *q_path,
@@ -2768,7 +3053,12 @@ int activitypub_post_handler(const xs_dict *req, const char *q_path,
     }
 
     if (valid_status(status)) {
-        enqueue_input(&snac, msg, req, 0);
+        /* already got from the shared inbox? */
+        if (activity_seen(snac.uid, xs_dict_get(msg, "id")))
+            snac_debug(&snac, 1, xs_fmt("input already seen %s", xs_dict_get(msg, "id")));
+        else
+            enqueue_input(&snac, msg, req, 0);
+
         *ctype = "application/activity+json";
     }
 
@@ -11,6 +11,7 @@
 #include "xs_time.h"
 #include "xs_regex.h"
 #include "xs_match.h"
+#include "xs_unicode.h"
 
 #include "snac.h"
 
@@ -20,15 +21,31 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <stdint.h>
 
 double disk_layout = 2.7;
 
-/* storage serializer */
-pthread_mutex_t data_mutex = {0};
+/* storage serializers; one of them is chosen by hashing the file name,
+   so operations on unrelated files don't wait for each other */
+#ifndef DATA_MUTEXES
+#define DATA_MUTEXES 64
+#endif
+
+static pthread_mutex_t data_mutex[DATA_MUTEXES];
+
+#define data_lock(fn) pthread_mutex_lock(_data_mutex(fn))
+#define data_unlock(fn) pthread_mutex_unlock(_data_mutex(fn))
 
 int snac_upgrade(xs_str **error);
 
 
+static pthread_mutex_t *_data_mutex(const char *fn)
+/* returns the serializer for a file */
+{
+    return &data_mutex[xs_hash_func(fn, strlen(fn)) % DATA_MUTEXES];
+}
+
+
 int srv_open(const char *basedir, int auto_upgrade)
 /* opens a server */
 {
@@ -37,7 +54,8 @@ int srv_open(const char *basedir, int auto_upgrade)
     FILE *f;
     xs_str *error = NULL;
 
-    pthread_mutex_init(&data_mutex, NULL);
+    for (int n = 0; n < DATA_MUTEXES; n++)
+        pthread_mutex_init(&data_mutex[n], NULL);
 
     srv_basedir = xs_str_new(basedir);
 
@@ -106,6 +124,9 @@ int srv_open(const char *basedir, int auto_upgrade)
     xs *tmpdir = xs_fmt("%s/tmp", srv_basedir);
     mkdirx(tmpdir);
 
+    xs *acdir = xs_fmt("%s/actor", srv_basedir);
+    mkdirx(acdir);
+
 #ifdef __APPLE__
 /* Apple uses st_atimespec instead of st_atim etc */
 #define st_atim st_atimespec
@@ -157,7 +178,15 @@ void srv_free(void)
     xs_free(srv_config);
     xs_free(srv_baseurl);
 
-    pthread_mutex_destroy(&data_mutex);
+    for (int n = 0; n < DATA_MUTEXES; n++)
+        pthread_mutex_destroy(&data_mutex[n]);
+}
+
+
+int json_indent(void)
+/* returns the indentation of the JSON files in the storage */
+{
+    return xs_type(xs_dict_get(srv_config, "compact_json")) == XSTYPE_TRUE ? 0 : 4;
 }
 
 
@@ -175,8 +204,167 @@ void user_free(snac *snac)
 }
 
 
-int user_open(snac *user, const char *uid)
-/* opens a user */
+/** user registry **/
+
+/* The parsed files of the users are kept in memory, so user_open()
+   only has to stat() them and copy the data if they haven't changed.
+   The list of users is also kept until the user/ directory changes. */
+
+#define USER_REG_FILES 4
+
+static const char *user_reg_files[USER_REG_FILES] = {
+    "user.json", "key.json", "user_o.json", "links.json"
+};
+
+typedef struct user_reg_ent {
+    struct user_reg_ent *next;
+    snac user;                          /* the parsed data */
+    uint64_t v[USER_REG_FILES][3];      /* validators of the files */
+} user_reg_ent;
+
+static struct {
+    pthread_mutex_t mutex;
+    user_reg_ent *users;
+    xs_list *list;                      /* the user ids */
+    uint64_t v[3];                      /* validator of the user/ directory */
+} user_reg = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+static void _user_reg_stamp(const char *fn, uint64_t v[3])
+/* fills the validator of a file (all zeros if it does not exist) */
+{
+    struct stat st;
+
+    if (stat(fn, &st) != -1) {
+        v[0] = st.st_ino;
+        v[1] = st.st_size;
+        v[2] = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    else
+        v[0] = v[1] = v[2] = 0;
+}
+
+
+static void _user_reg_stamps(const char *basedir, uint64_t v[USER_REG_FILES][3])
+/* fills the validators of all the files of a user */
+{
+    int n;
+
+    for (n = 0; n < USER_REG_FILES; n++) {
+        xs *fn = xs_fmt("%s/%s", basedir, user_reg_files[n]);
+        _user_reg_stamp(fn, v[n]);
+    }
+}
+
+
+static void _user_dup(snac *dst, const snac *src)
+/* copies a user snac */
+{
+    dst->uid      = xs_dup(src->uid);
+    dst->basedir  = xs_dup(src->basedir);
+    dst->config   = xs_dup(src->config);
+    dst->config_o = xs_dup(src->config_o);
+    dst->key      = xs_dup(src->key);
+    dst->links    = xs_dup(src->links);
+    dst->actor    = xs_dup(src->actor);
+    dst->md5      = xs_dup(src->md5);
+}
+
+
+static user_reg_ent **_user_reg_find(const char *uid, int icase)
+/* returns a pointer to the link to an entry (or to the NULL link at the end) */
+{
+    user_reg_ent **pe = &user_reg.users;
+
+    while (*pe != NULL &&
+        (icase ? strcasecmp((*pe)->user.uid, uid) : strcmp((*pe)->user.uid, uid)) != 0)
+        pe = &(*pe)->next;
+
+    return pe;
+}
+
+
+static int _user_reg_get(snac *user, const char *uid)
+/* gets a user from the registry, if its files didn't change */
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&user_reg.mutex);
+
+    user_reg_ent **pe = _user_reg_find(uid, 0);
+
+    /* not there? try with a different case, but only if there is
+       no user with this exact uid (that is just not loaded yet) */
+    if (*pe == NULL) {
+        xs *t = xs_fmt("%s/user/%s", srv_basedir, uid);
+
+        if (mtime(t) == 0.0)
+            pe = _user_reg_find(uid, 1);
+    }
+
+    if (*pe != NULL) {
+        uint64_t v[USER_REG_FILES][3];
+
+        _user_reg_stamps((*pe)->user.basedir, v);
+
+        if (memcmp(v, (*pe)->v, sizeof(v)) == 0) {
+            _user_dup(user, &(*pe)->user);
+            ret = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&user_reg.mutex);
+
+    return ret;
+}
+
+
+static void _user_reg_put(const snac *user, uint64_t v[USER_REG_FILES][3])
+/* stores a user into the registry */
+{
+    int paused = xs_arena_pause();
+
+    pthread_mutex_lock(&user_reg.mutex);
+
+    user_reg_ent **pe = _user_reg_find(user->uid, 0);
+
+    if (*pe == NULL) {
+        *pe = xs_realloc(NULL, sizeof(user_reg_ent));
+        **pe = (user_reg_ent){0};
+    }
+    else
+        user_free(&(*pe)->user);
+
+    _user_dup(&(*pe)->user, user);
+    memcpy((*pe)->v, v, sizeof((*pe)->v));
+
+    pthread_mutex_unlock(&user_reg.mutex);
+
+    xs_arena_resume(paused);
+}
+
+
+static void _user_reg_del(const char *uid)
+/* deletes a user from the registry */
+{
+    pthread_mutex_lock(&user_reg.mutex);
+
+    user_reg_ent **pe = _user_reg_find(uid, 0);
+
+    if (*pe != NULL) {
+        user_reg_ent *e = *pe;
+        *pe = e->next;
+
+        user_free(&e->user);
+        xs_free(e);
+    }
+
+    pthread_mutex_unlock(&user_reg.mutex);
+}
+
+
+static int _user_load(snac *user, const char *uid)
+/* opens a user, reading its files */
 {
     int ret = 0;
 
@@ -276,11 +464,64 @@ int user_open(snac *user, const char *uid)
 }
 
 
+int user_open(snac *user, const char *uid)
+/* opens a user */
+{
+    if (!validate_uid(uid)) {
+        *user = (snac){0};
+        srv_debug(1, xs_fmt("invalid user '%s'", uid));
+        return 0;
+    }
+
+    if (_user_reg_get(user, uid))
+        return 1;
+
+    /* not in the registry or changed; take the file stamps
+       before reading, so that later changes are detected */
+    xs *basedir = xs_fmt("%s/user/%s", srv_basedir, uid);
+    uint64_t v[USER_REG_FILES][3];
+
+    _user_reg_stamps(basedir, v);
+
+    if (!_user_load(user, uid)) {
+        _user_reg_del(uid);
+        return 0;
+    }
+
+    /* opened with a different case? the stamps are not valid */
+    if (strcmp(user->uid, uid) == 0)
+        _user_reg_put(user, v);
+
+    return 1;
+}
+
+
 xs_list *user_list(void)
 /* returns the list of user ids */
 {
-    xs *spec = xs_fmt("%s/user/" "*", srv_basedir);
-    return xs_glob(spec, 1, 0);
+    xs *dir = xs_fmt("%s/user", srv_basedir);
+    uint64_t v[3];
+    xs_list *list;
+
+    _user_reg_stamp(dir, v);
+
+    pthread_mutex_lock(&user_reg.mutex);
+
+    if (user_reg.list == NULL || memcmp(v, user_reg.v, sizeof(v)) != 0) {
+        xs *spec = xs_fmt("%s/user/" "*", srv_basedir);
+        int paused = xs_arena_pause();
+
+        xs_free(user_reg.list);
+        user_reg.list = xs_glob(spec, 1, 0);
+        xs_arena_resume(paused);
+        memcpy(user_reg.v, v, sizeof(v));
+    }
+
+    list = xs_dup(user_reg.list);
+
+    pthread_mutex_unlock(&user_reg.mutex);
+
+    return list;
 }
 
 
@@ -351,2261 +592,5855 @@ int is_md5_hex(const char *md5)
 
 /** indexes **/
 
+/* Indexes can be stored in two formats: the classic one (one 32-byte
+   hex md5 per line, deleted entries overwritten with a '-') and a
+   binary one, selected by the "binary_indexes" server setting. The binary
+   format has a small header with the number of slots and live entries,
+   followed by blocks of BIDX_SLOTS raw md5s, each block preceded by its
+   tombstone bitmap. This way, any slot can be reached by direct offset
+   and the number of live entries is known without reading the index.
+   Existing indexes keep their format until they are garbage-collected. */
 
-int index_add_md5(const char *fn, const char *md5)
-/* adds an md5 to an index */
-{
-    int status = 201; /* Created */
-    FILE *f;
+#define BIDX_MAGIC    "\0SIX"
+#define BIDX_VERSION  1
+#define BIDX_SLOTS    256
+#define BIDX_MD5_SIZE 16
+#define BIDX_BM_SIZE  (BIDX_SLOTS / 8)
 
-    if (!is_md5_hex(md5)) {
-        srv_log(xs_fmt("index_add_md5: bad md5 %s %s", fn, md5));
-        return 400;
-    }
+typedef struct {
+    char magic[4];          /* BIDX_MAGIC */
+    uint32_t version;       /* BIDX_VERSION */
+    uint32_t total;         /* number of slots (including deleted ones) */
+    uint32_t live;          /* number of live entries */
+} bidx_hdr;
 
-    pthread_mutex_lock(&data_mutex);
+typedef struct {
+    unsigned char bm[BIDX_BM_SIZE];                 /* tombstone bitmap */
+    unsigned char md5[BIDX_SLOTS][BIDX_MD5_SIZE];   /* raw md5s */
+} bidx_blk;
 
-    if ((f = fopen(fn, "a")) != NULL) {
-        flock(fileno(f), LOCK_EX);
+#define _bidx_blk_off(b) ((long)sizeof(bidx_hdr) + (long)(b) * (long)sizeof(bidx_blk))
+#define _bidx_dead(blk, i) ((blk)->bm[(i) / 8] & (1 << ((i) % 8)))
 
-        /* ensure the position is at the end after getting the lock */
-        fseek(f, 0, SEEK_END);
 
-        fprintf(f, "%s\n", md5);
-        fclose(f);
-    }
+static int _bidx_enabled(void)
+/* returns true if new indexes are to be created in binary format */
+{
+    return xs_type(xs_dict_get(srv_config, "binary_indexes")) == XSTYPE_TRUE;
+}
+
+
+static int _bidx_hdr(FILE *f, bidx_hdr *h)
+/* reads the header of a binary index; if it's not one, rewinds */
+{
+    int ret = 0;
+
+    fseek(f, 0, SEEK_SET);
+
+    if (fread(h, sizeof(*h), 1, f) == 1 && memcmp(h->magic, BIDX_MAGIC, 4) == 0)
+        ret = 1;
     else
-        status = 500;
+        fseek(f, 0, SEEK_SET);
 
-    pthread_mutex_unlock(&data_mutex);
+    return ret;
+}
 
-    return status;
+
+static void _bidx_hdr_init(bidx_hdr *h)
+/* initializes the header of an empty binary index */
+{
+    memset(h, '\0', sizeof(*h));
+    memcpy(h->magic, BIDX_MAGIC, 4);
+    h->version = BIDX_VERSION;
 }
 
 
-int index_add(const char *fn, const char *id)
-/* adds an id to an index */
+static void _bidx_hdr_write(FILE *f, const bidx_hdr *h)
+/* writes the header of a binary index */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return index_add_md5(fn, md5);
+    fseek(f, 0, SEEK_SET);
+    fwrite(h, sizeof(*h), 1, f);
 }
 
 
-int index_del_md5(const char *fn, const char *md5)
-/* deletes an md5 from an index */
+static int _bidx_blk_read(FILE *f, const bidx_hdr *h, int b, bidx_blk *blk)
+/* reads block #b, returning the number of used slots in it */
 {
-    int status = 404;
-    FILE *f;
+    int n = (int)h->total - b * BIDX_SLOTS;
 
-    pthread_mutex_lock(&data_mutex);
+    if (n <= 0)
+        return 0;
 
-    if ((f = fopen(fn, "r+")) != NULL) {
-        char line[256];
+    if (n > BIDX_SLOTS)
+        n = BIDX_SLOTS;
 
-        while (fgets(line, sizeof(line), f) != NULL) {
-            line[32] = '\0';
+    if (fseek(f, _bidx_blk_off(b), SEEK_SET) == -1 ||
+        fread(blk, BIDX_BM_SIZE + n * BIDX_MD5_SIZE, 1, f) != 1)
+        return 0;
 
-            if (strcmp(line, md5) == 0) {
-                /* found! just rewind, overwrite it with garbage
-                   and an eventual call to index_gc() will clean it
-                   [yes: this breaks index_len()] */
-                fseek(f, -33, SEEK_CUR);
-                fwrite("-", 1, 1, f);
-                status = 200;
+    return n;
+}
 
-                break;
-            }
-        }
 
-        fclose(f);
-    }
-    else
-        status = 410;
+static int _bidx_md5_raw(const char *md5, unsigned char *raw)
+/* converts an hex md5 to raw */
+{
+    return is_md5_hex(md5) && _xs_hex_dec((char *)raw, md5, 32) != NULL;
+}
 
-    pthread_mutex_unlock(&data_mutex);
 
-    return status;
+static void _bidx_md5_hex(const unsigned char *raw, char *md5)
+/* converts a raw md5 to hex */
+{
+    *_xs_hex_enc(md5, (const char *)raw, BIDX_MD5_SIZE) = '\0';
 }
 
 
-int index_del(const char *fn, const char *id)
-/* deletes an id from an index */
+static int _bidx_find(FILE *f, const bidx_hdr *h, const unsigned char *raw)
+/* returns the slot of a live md5, or -1 */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return index_del_md5(fn, md5);
+    bidx_blk blk;
+    int b, i, n;
+
+    for (b = 0; (n = _bidx_blk_read(f, h, b, &blk)) > 0; b++) {
+        for (i = 0; i < n; i++) {
+            if (!_bidx_dead(&blk, i) && memcmp(blk.md5[i], raw, BIDX_MD5_SIZE) == 0)
+                return b * BIDX_SLOTS + i;
+        }
+    }
+
+    return -1;
 }
 
 
-int index_gc(const char *fn)
-/* garbage-collects an index, deleting objects that are not here */
+static void _bidx_add(FILE *f, bidx_hdr *h, const unsigned char *raw)
+/* appends a raw md5 to a binary index */
 {
-    FILE *i, *o;
-    int gc = -1;
+    int s = h->total;
+    long off = _bidx_blk_off(s / BIDX_SLOTS);
 
-    pthread_mutex_lock(&data_mutex);
+    if (s % BIDX_SLOTS == 0) {
+        /* first slot of a new block: write its empty bitmap */
+        unsigned char bm[BIDX_BM_SIZE] = {0};
 
-    if ((i = fopen(fn, "r")) != NULL) {
-        xs *nfn = xs_fmt("%s.new", fn);
-        char line[256];
+        fseek(f, off, SEEK_SET);
+        fwrite(bm, sizeof(bm), 1, f);
+    }
 
-        if ((o = fopen(nfn, "w")) != NULL) {
-            gc = 0;
+    fseek(f, off + BIDX_BM_SIZE + (long)(s % BIDX_SLOTS) * BIDX_MD5_SIZE, SEEK_SET);
+    fwrite(raw, BIDX_MD5_SIZE, 1, f);
 
-            while (fgets(line, sizeof(line), i) != NULL) {
-                line[32] = '\0';
+    h->total++;
+    h->live++;
 
-                if (line[0] != '-' && object_here_by_md5(line))
-                    fprintf(o, "%s\n", line);
-                else
-                    gc++;
-            }
+    _bidx_hdr_write(f, h);
+}
 
-            fclose(o);
 
-            xs *ofn = xs_fmt("%s.bak", fn);
+typedef struct {
+    FILE *f;
+    bidx_hdr h;
+    bidx_blk blk;
+} bidx_writer;
 
-            unlink(ofn);
-            link(fn, ofn);
-            rename(nfn, fn);
-        }
 
-        fclose(i);
-    }
+static void _bidx_writer_open(bidx_writer *w, FILE *f)
+/* starts writing a new binary index sequentially */
+{
+    memset(w, '\0', sizeof(*w));
+    w->f = f;
+    _bidx_hdr_init(&w->h);
+
+    _bidx_hdr_write(f, &w->h);
+}
 
-    pthread_mutex_unlock(&data_mutex);
 
-    return gc;
+static void _bidx_writer_add(bidx_writer *w, const unsigned char *raw)
+/* adds a raw md5 to a sequentially written binary index */
+{
+    int i = w->h.total % BIDX_SLOTS;
+
+    memcpy(w->blk.md5[i], raw, BIDX_MD5_SIZE);
+
+    w->h.total++;
+    w->h.live++;
+
+    if (i == BIDX_SLOTS - 1)
+        fwrite(&w->blk, sizeof(w->blk), 1, w->f);
 }
 
 
-int index_in_md5(const char *fn, const char *md5)
-/* checks if the md5 is already in the index */
+static void _bidx_writer_close(bidx_writer *w)
+/* flushes the last block and the header */
 {
-    FILE *f;
-    int ret = 0;
+    int n = w->h.total % BIDX_SLOTS;
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        flock(fileno(f), LOCK_SH);
+    if (n)
+        fwrite(&w->blk, BIDX_BM_SIZE + n * BIDX_MD5_SIZE, 1, w->f);
 
-        char line[256];
+    _bidx_hdr_write(w->f, &w->h);
+}
 
-        while (!ret && fgets(line, sizeof(line), f) != NULL) {
-            line[32] = '\0';
 
-            if (strcmp(line, md5) == 0)
-                ret = 1;
-        }
+/** index membership cache **/
 
-        fclose(f);
-    }
+/* The md5s of the most recently checked indexes are kept in memory
+   in open-addressing hash tables, so index_in_md5() is just a stat()
+   and a lookup. Each table is validated against the index file's
+   inode, size and mtime, so changes made by other processes are
+   detected; additions made by this one are applied to the table.
+   The tables use up to the "index_cache_size" server setting (in
+   megabytes); indexes too big to fit a quarter of it are not cached
+   and are searched in the file as before. */
 
-    return ret;
+#define IDX_CACHE_FILES 64
+
+typedef struct {
+    xs_str *fn;             /* index file name */
+    ino_t ino;              /* stat data of the file when loaded */
+    off_t size;
+    struct timespec mtim;
+    unsigned int tick;      /* last usage */
+    int n_slots;            /* size of the table (power of 2) */
+    int n_keys;             /* number of used slots */
+    unsigned char (*keys)[BIDX_MD5_SIZE];
+} idx_cache_ent;
+
+static idx_cache_ent idx_cache[IDX_CACHE_FILES];
+static unsigned int idx_cache_tick = 0;
+static long idx_cache_used = 0;
+static pthread_mutex_t idx_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const unsigned char idx_cache_empty[BIDX_MD5_SIZE] = {0};
+
+
+static long _idx_cache_max(void)
+/* returns the maximum memory to be used by the index cache */
+{
+    const xs_number *v = xs_dict_get(srv_config, "index_cache_size");
+
+    return (xs_type(v) == XSTYPE_NUMBER ? xs_number_get(v) : 16) * 1024 * 1024;
 }
 
 
-int index_in(const char *fn, const char *id)
-/* checks if the object id is already in the index */
+static int _idx_cache_same(const idx_cache_ent *e, const struct stat *st)
+/* checks if the cached table still matches the file */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return index_in_md5(fn, md5);
+    return e->ino == st->st_ino && e->size == st->st_size &&
+        e->mtim.tv_sec == st->st_mtim.tv_sec && e->mtim.tv_nsec == st->st_mtim.tv_nsec;
 }
 
 
-int index_first(const char *fn, char *line, int size)
-/* reads the first entry of an index */
+static void _idx_cache_stat(idx_cache_ent *e, const struct stat *st)
+/* stores the stat data of the file */
 {
-    FILE *f;
-    int ret = 0;
+    e->ino  = st->st_ino;
+    e->size = st->st_size;
+    e->mtim = st->st_mtim;
+}
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        flock(fileno(f), LOCK_SH);
 
-        if (fgets(line, size, f) != NULL) {
-            line[32] = '\0';
-            ret = 1;
-        }
+static idx_cache_ent *_idx_cache_find(const char *fn)
+/* finds the cache entry of an index */
+{
+    int n;
 
-        fclose(f);
+    for (n = 0; n < IDX_CACHE_FILES; n++) {
+        if (idx_cache[n].fn && strcmp(idx_cache[n].fn, fn) == 0)
+            return &idx_cache[n];
     }
 
-    return ret;
+    return NULL;
 }
 
 
-int index_len(const char *fn)
-/* returns the number of elements in an index */
+static void _idx_cache_drop(idx_cache_ent *e)
+/* empties a cache entry */
 {
-    struct stat st;
-    int len = 0;
-
-    if (stat(fn, &st) != -1)
-        len = st.st_size / 33;
+    if (e != NULL) {
+        idx_cache_used -= (long)e->n_slots * BIDX_MD5_SIZE;
 
-    return len;
+        xs_free(e->fn);
+        xs_free(e->keys);
+        *e = (idx_cache_ent){0};
+    }
 }
 
 
-xs_list *index_list(const char *fn, int max)
-/* returns an index as a list */
+static int _idx_cache_slot(const idx_cache_ent *e, const unsigned char *raw)
+/* returns the slot where raw is or should be */
 {
-    xs_list *list = xs_list_new();
-    FILE *f;
-    int n = 0;
+    unsigned int i;
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        flock(fileno(f), LOCK_SH);
+    /* md5s are already well distributed */
+    memcpy(&i, raw, sizeof(i));
 
-        char line[256];
+    for (;;) {
+        i &= e->n_slots - 1;
 
-        while (n < max && fgets(line, sizeof(line), f) != NULL) {
-            if (line[0] != '-') {
-                line[32] = '\0';
-                list = xs_list_append(list, line);
-                n++;
-            }
-        }
+        if (memcmp(e->keys[i], raw, BIDX_MD5_SIZE) == 0 ||
+            memcmp(e->keys[i], idx_cache_empty, BIDX_MD5_SIZE) == 0)
+            break;
 
-        fclose(f);
+        i++;
     }
 
-    return list;
+    return i;
 }
 
 
-xs_list *index_list_desc(const char *fn, int skip, int show)
-/* returns an index as a list, in reverse order */
+static void _idx_cache_put(idx_cache_ent *e, const unsigned char *raw)
+/* adds a raw md5 to the table, growing it if needed */
 {
-    xs_list *list = xs_list_new();
-    FILE *f;
-    int n = 0;
-
-    if ((f = fopen(fn, "r")) != NULL) {
-        flock(fileno(f), LOCK_SH);
+    if ((e->n_keys + 1) * 2 > e->n_slots) {
+        idx_cache_ent o = *e;
+        int paused = xs_arena_pause();
+        int n;
 
-        char line[256];
+        e->n_slots = o.n_slots ? o.n_slots * 2 : 64;
+        e->n_keys  = 0;
+        e->keys    = xs_realloc(NULL, e->n_slots * BIDX_MD5_SIZE);
+        xs_arena_resume(paused);
 
-        /* move to the end minus one entry (or more, if skipping entries) */
-        if (!fseek(f, 0, SEEK_END) && !fseek(f, (skip + 1) * -33, SEEK_CUR)) {
-            while (n < show && fgets(line, sizeof(line), f) != NULL) {
-                if (line[0] != '-') {
-                    line[32] = '\0';
-                    list = xs_list_append(list, line);
-                    n++;
-                }
+        idx_cache_used += (long)(e->n_slots - o.n_slots) * BIDX_MD5_SIZE;
+        memset(e->keys, '\0', e->n_slots * BIDX_MD5_SIZE);
 
-                /* move backwards 2 entries */
-                if (fseek(f, -66, SEEK_CUR) == -1)
-                    break;
-            }
+        for (n = 0; n < o.n_slots; n++) {
+            if (memcmp(o.keys[n], idx_cache_empty, BIDX_MD5_SIZE) != 0)
+                _idx_cache_put(e, o.keys[n]);
         }
 
-        fclose(f);
+        xs_free(o.keys);
     }
 
-    return list;
-}
+    int i = _idx_cache_slot(e, raw);
 
+    if (memcmp(e->keys[i], raw, BIDX_MD5_SIZE) != 0) {
+        memcpy(e->keys[i], raw, BIDX_MD5_SIZE);
+        e->n_keys++;
+    }
+}
 
-/** objects **/
 
-static xs_str *_object_fn_by_md5(const char *md5, const char *func)
+static idx_cache_ent *_idx_cache_load(const char *fn, FILE *f, const struct stat *st)
+/* loads the md5s of an index into a cache entry */
 {
-    xs *bfn = xs_fmt("%s/object/%c%c", srv_basedir, md5[0], md5[1]);
-    xs_str *ret;
-    int ok = 1;
+    idx_cache_ent *e = _idx_cache_find(fn);
+    int n;
 
-    /* an object deleted from an index; fail but don't bark */
-    if (md5[0] == '-')
-        ok = 0;
-    else
-    if (!is_md5_hex(md5)) {
-        srv_log(xs_fmt("_object_fn_by_md5() [from %s()]: bad md5 '%s'", func, md5));
-        ok = 0;
+    if (e == NULL) {
+        /* take a free one or the least recently used */
+        e = &idx_cache[0];
+
+        for (n = 0; n < IDX_CACHE_FILES && e->fn != NULL; n++) {
+            if (idx_cache[n].fn == NULL || idx_cache[n].tick < e->tick)
+                e = &idx_cache[n];
+        }
     }
 
-    if (ok) {
-        mkdirx(bfn);
-        ret = xs_fmt("%s/%s.json", bfn, md5);
+    _idx_cache_drop(e);
+
+    int paused = xs_arena_pause();
+
+    e->fn = xs_str_new(fn);
+    _idx_cache_stat(e, st);
+
+    unsigned char raw[BIDX_MD5_SIZE];
+    char line[256];
+    bidx_hdr h;
+
+    if (_bidx_hdr(f, &h)) {
+        bidx_blk blk;
+        int b, bn, s;
+
+        for (b = 0; (bn = _bidx_blk_read(f, &h, b, &blk)) > 0; b++) {
+            for (s = 0; s < bn; s++) {
+                if (!_bidx_dead(&blk, s))
+                    _idx_cache_put(e, blk.md5[s]);
+            }
+        }
     }
     else
-        ret = xs_fmt("%s/object/invalid/invalid.json", srv_basedir);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[32] = '\0';
 
-    return ret;
-}
+        if (line[0] != '-' && _bidx_md5_raw(line, raw))
+            _idx_cache_put(e, raw);
+    }
 
+    /* ensure there is a table, even if the index is empty */
+    if (e->n_slots == 0) {
+        e->n_slots = 64;
+        e->keys    = xs_realloc(NULL, e->n_slots * BIDX_MD5_SIZE);
+        memset(e->keys, '\0', e->n_slots * BIDX_MD5_SIZE);
 
-static xs_str *_object_fn(const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return _object_fn_by_md5(md5, "_object_fn");
+        idx_cache_used += (long)e->n_slots * BIDX_MD5_SIZE;
+    }
+
+    xs_arena_resume(paused);
+
+    return e;
 }
 
 
-int object_here_by_md5(const char *id)
-/* checks if an object is already downloaded */
+static void _idx_cache_trim(const idx_cache_ent *keep)
+/* drops the least recently used tables until the cache fits its size */
 {
-    xs *fn = _object_fn_by_md5(id, "object_here_by_md5");
-    return mtime(fn) > 0.0;
+    long max = _idx_cache_max();
+
+    while (idx_cache_used > max) {
+        idx_cache_ent *o = NULL;
+        int n;
+
+        for (n = 0; n < IDX_CACHE_FILES; n++) {
+            idx_cache_ent *e = &idx_cache[n];
+
+            if (e->fn != NULL && e != keep && (o == NULL || e->tick < o->tick))
+                o = e;
+        }
+
+        if (o == NULL)
+            break;
+
+        _idx_cache_drop(o);
+    }
 }
 
 
-int object_here(const char *id)
-/* checks if an object is already downloaded */
+static int _idx_cache_in(const char *fn, const unsigned char *raw)
+/* checks if a raw md5 is in an index using the cache (-1: cannot tell) */
 {
-    xs *fn = _object_fn(id);
-    return mtime(fn) > 0.0;
+    struct stat st;
+    idx_cache_ent *e;
+    int ret = -1;
+
+    if (stat(fn, &st) == -1)
+        return 0;
+
+    /* disabled, or too big to be cached? (a table takes up
+       to four times the size of the index it holds) */
+    long max = _idx_cache_max();
+
+    if (max <= 0 || (long)st.st_size * 4 > max / 4)
+        return -1;
+
+    pthread_mutex_lock(&idx_cache_mutex);
+
+    if ((e = _idx_cache_find(fn)) == NULL || !_idx_cache_same(e, &st)) {
+        FILE *f;
+
+        e = NULL;
+
+        if ((f = fopen(fn, "r")) != NULL) {
+            flock(fileno(f), LOCK_SH);
+
+            /* stat again, now that no one is writing */
+            if (fstat(fileno(f), &st) != -1) {
+                e = _idx_cache_load(fn, f, &st);
+                _idx_cache_trim(e);
+            }
+
+            fclose(f);
+        }
+    }
+
+    if (e != NULL) {
+        e->tick = ++idx_cache_tick;
+        ret = memcmp(e->keys[_idx_cache_slot(e, raw)], raw, BIDX_MD5_SIZE) == 0;
+    }
+
+    pthread_mutex_unlock(&idx_cache_mutex);
+
+    return ret;
 }
 
 
-int object_get_by_md5(const char *md5, xs_dict **obj)
-/* returns a stored object, optionally of the requested type */
+static void _idx_cache_added(const char *fn, const struct stat *o_st,
+                             const struct stat *n_st, const unsigned char *raw)
+/* updates the cache after adding an md5 to an index */
 {
-    int status = 404;
-    xs *fn     = _object_fn_by_md5(md5, "object_get_by_md5");
-    FILE *f;
+    idx_cache_ent *e;
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        *obj = xs_json_load(f);
-        fclose(f);
+    pthread_mutex_lock(&idx_cache_mutex);
 
-        if (*obj)
-            status = 200;
+    if ((e = _idx_cache_find(fn)) != NULL) {
+        if (_idx_cache_same(e, o_st)) {
+            /* it was up to date: keep it that way */
+            _idx_cache_put(e, raw);
+            _idx_cache_stat(e, n_st);
+
+            if ((long)e->n_slots * BIDX_MD5_SIZE > _idx_cache_max() / 4)
+                _idx_cache_drop(e);
+            else
+                _idx_cache_trim(e);
+        }
+        else
+            _idx_cache_drop(e);
     }
-    else
-        *obj = NULL;
 
-    return status;
+    pthread_mutex_unlock(&idx_cache_mutex);
 }
 
 
-int object_get(const char *id, xs_dict **obj)
-/* returns a stored object, optionally of the requested type */
+static void _idx_cache_forget(const char *fn)
+/* drops an index from the cache */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return object_get_by_md5(md5, obj);
+    pthread_mutex_lock(&idx_cache_mutex);
+    _idx_cache_drop(_idx_cache_find(fn));
+    pthread_mutex_unlock(&idx_cache_mutex);
 }
 
 
-int _object_add(const char *id, const xs_dict *obj, int ow)
-/* stores an object */
+int index_add_md5(const char *fn, const char *md5)
+/* adds an md5 to an index */
 {
     int status = 201; /* Created */
-    xs *fn     = _object_fn(id);
-    FILE *f;
+    FILE *f = NULL;
+    int fd;
 
-    if (mtime(fn) > 0.0) {
-        if (!ow) {
-            /* object already here */
-            srv_debug(1, xs_fmt("object_add object already here %s", id));
-            return 204; /* No content */
-        }
-        else
-            status = 200;
+    if (!is_md5_hex(md5)) {
+        srv_log(xs_fmt("index_add_md5: bad md5 %s %s", fn, md5));
+        return 400;
     }
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        flock(fileno(f), LOCK_EX);
+    data_lock(fn);
 
-        xs_json_dump(obj, 4, f);
-        fclose(f);
+    if ((fd = open(fn, O_RDWR | O_CREAT, 0666)) != -1 && (f = fdopen(fd, "r+")) != NULL) {
+        unsigned char raw[BIDX_MD5_SIZE];
+        struct stat o_st, n_st;
+        bidx_hdr h;
 
-        /* does this object has a parent? */
-        const char *in_reply_to = xs_dict_get(obj, "inReplyTo");
+        flock(fileno(f), LOCK_EX);
 
-        if (!xs_is_null(in_reply_to) && *in_reply_to) {
-            /* update the children index of the parent */
-            xs *c_idx = _object_fn(in_reply_to);
+        fstat(fd, &o_st);
+        _bidx_md5_raw(md5, raw);
 
-            c_idx = xs_replace_i(c_idx, ".json", "_c.idx");
+        if (_bidx_hdr(f, &h))
+            _bidx_add(f, &h, raw);
+        else {
+            /* ensure the position is at the end after getting the lock */
+            fseek(f, 0, SEEK_END);
 
-            if (!index_in(c_idx, id)) {
-                index_add(c_idx, id);
-                srv_debug(1, xs_fmt("object_add added child %s to %s", id, c_idx));
+            if (ftell(f) == 0 && _bidx_enabled()) {
+                /* new index: create it in binary format */
+                _bidx_hdr_init(&h);
+                _bidx_add(f, &h, raw);
             }
             else
-                srv_debug(1, xs_fmt("object_add %s child already in %s", id, c_idx));
+                fprintf(f, "%s\n", md5);
+        }
 
-            /* create a one-element index with the parent */
-            xs *p_idx = xs_replace(fn, ".json", "_p.idx");
+        fflush(f);
+        fstat(fd, &n_st);
+        _idx_cache_added(fn, &o_st, &n_st, raw);
 
-            if (mtime(p_idx) == 0.0) {
-                index_add(p_idx, in_reply_to);
-                srv_debug(1, xs_fmt("object_add added parent %s to %s", in_reply_to, p_idx));
-            }
-        }
+        fclose(f);
     }
     else {
-        srv_log(xs_fmt("object_add error writing %s (errno: %d)", fn, errno));
+        if (fd != -1)
+            close(fd);
+
         status = 500;
     }
 
-    srv_debug(1, xs_fmt("object_add %s %s %d", id, fn, status));
+    data_unlock(fn);
 
     return status;
 }
 
 
-int object_add(const char *id, const xs_dict *obj)
-/* stores an object */
+int index_add(const char *fn, const char *id)
+/* adds an id to an index */
 {
-    return _object_add(id, obj, 0);
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return index_add_md5(fn, md5);
 }
 
 
-int object_add_ow(const char *id, const xs_dict *obj)
-/* stores an object (overwriting allowed) */
+int index_del_md5(const char *fn, const char *md5)
+/* deletes an md5 from an index */
 {
-    return _object_add(id, obj, 1);
-}
+    int status = 404;
+    FILE *f;
 
+    data_lock(fn);
 
-int object_del_by_md5(const char *md5)
-/* deletes an object by its md5 */
-{
-    int status = 404;
-    xs *fn     = _object_fn_by_md5(md5, "object_del_by_md5");
+    if ((f = fopen(fn, "r+")) != NULL) {
+        char line[256];
+        bidx_hdr h;
 
-    if (unlink(fn) != -1) {
-        status = 200;
+        flock(fileno(f), LOCK_EX);
 
-        /* also delete associated indexes */
-        xs *spec  = xs_dup(fn);
-        spec      = xs_replace_i(spec, ".json", "*.idx");
-        xs *files = xs_glob(spec, 0, 0);
-        char *p;
-        const char *v;
+        if (_bidx_hdr(f, &h)) {
+            unsigned char raw[BIDX_MD5_SIZE];
+            int s;
 
-        p = files;
-        while (xs_list_iter(&p, &v)) {
-            srv_debug(1, xs_fmt("object_del index %s", v));
-            unlink(v);
+            if (_bidx_md5_raw(md5, raw) && (s = _bidx_find(f, &h, raw)) != -1) {
+                /* found: mark it in the tombstone bitmap */
+                long off = _bidx_blk_off(s / BIDX_SLOTS) + (s % BIDX_SLOTS) / 8;
+                unsigned char c;
+
+                fseek(f, off, SEEK_SET);
+
+                if (fread(&c, 1, 1, f) == 1) {
+                    c |= 1 << (s % 8);
+
+                    fseek(f, off, SEEK_SET);
+                    fwrite(&c, 1, 1, f);
+
+                    h.live--;
+                    _bidx_hdr_write(f, &h);
+
+                    status = 200;
+                }
+            }
+        }
+        else
+        while (fgets(line, sizeof(line), f) != NULL) {
+            line[32] = '\0';
+
+            if (strcmp(line, md5) == 0) {
+                /* found! just rewind, overwrite it with garbage
+                   and an eventual call to index_gc() will clean it
+                   [yes: this breaks index_len()] */
+                fseek(f, -33, SEEK_CUR);
+                fwrite("-", 1, 1, f);
+                status = 200;
+
+                break;
+            }
         }
+
+        fclose(f);
+
+        if (status == 200)
+            _idx_cache_forget(fn);
     }
+    else
+        status = 410;
 
-    srv_debug(1, xs_fmt("object_del %s %d", fn, status));
+    data_unlock(fn);
 
     return status;
 }
 
 
-int object_del(const char *id)
-/* deletes an object */
+int index_del(const char *fn, const char *id)
+/* deletes an id from an index */
 {
     xs *md5 = xs_md5_hex(id, strlen(id));
-    return object_del_by_md5(md5);
+    return index_del_md5(fn, md5);
 }
 
 
-int object_del_if_unref(const char *id)
-/* deletes an object if its n_links < 2 */
+int index_gc(const char *fn)
+/* garbage-collects an index, deleting objects that are not here */
 {
-    xs *fn = _object_fn(id);
-    int n_links;
-    int ret = 0;
+    FILE *i, *o;
+    int gc = -1;
 
-    if (mtime_nl(fn, &n_links) > 0.0 && n_links < 2)
-        ret = object_del(id);
+    data_lock(fn);
 
-    return ret;
-}
-
-
-double object_ctime_by_md5(const char *md5)
-{
-    xs *fn = _object_fn_by_md5(md5, "object_ctime_by_md5");
-    return f_ctime(fn);
-}
-
-
-double object_ctime(const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return object_ctime_by_md5(md5);
-}
+    if ((i = fopen(fn, "r")) != NULL) {
+        xs *nfn = xs_fmt("%s.new", fn);
+        char line[256];
+        bidx_hdr h;
+        int bin = _bidx_hdr(i, &h);
 
+        if ((o = fopen(nfn, "w")) != NULL) {
+            gc = 0;
 
-double object_mtime_by_md5(const char *md5)
-{
-    xs *fn = _object_fn_by_md5(md5, "object_mtime_by_md5");
-    return mtime(fn);
-}
+            if (bin || _bidx_enabled()) {
+                /* (ascii indexes are converted on the fly) */
+                bidx_writer w;
 
+                _bidx_writer_open(&w, o);
 
-double object_mtime(const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return object_mtime_by_md5(md5);
-}
+                if (bin) {
+                    bidx_blk blk;
+                    int b, n, s;
 
+                    for (b = 0; (n = _bidx_blk_read(i, &h, b, &blk)) > 0; b++) {
+                        for (s = 0; s < n; s++) {
+                            _bidx_md5_hex(blk.md5[s], line);
 
-void object_touch(const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    xs *fn = _object_fn_by_md5(md5, "object_touch");
+                            if (!_bidx_dead(&blk, s) && object_here_by_md5(line))
+                                _bidx_writer_add(&w, blk.md5[s]);
+                            else
+                                gc++;
+                        }
+                    }
+                }
+                else {
+                    while (fgets(line, sizeof(line), i) != NULL) {
+                        unsigned char raw[BIDX_MD5_SIZE];
 
-    if (mtime(fn))
-        utimes(fn, NULL);
-}
+                        line[32] = '\0';
 
+                        if (line[0] != '-' && _bidx_md5_raw(line, raw) && object_here_by_md5(line))
+                            _bidx_writer_add(&w, raw);
+                        else
+                            gc++;
+                    }
+                }
 
-xs_str *_object_index_fn(const char *id, const char *idxsfx)
-/* returns the filename of an object's index */
-{
-    xs_str *fn = _object_fn(id);
-    return xs_replace_i(fn, ".json", idxsfx);
-}
+                _bidx_writer_close(&w);
+            }
+            else {
+                while (fgets(line, sizeof(line), i) != NULL) {
+                    line[32] = '\0';
 
+                    if (line[0] != '-' && object_here_by_md5(line))
+                        fprintf(o, "%s\n", line);
+                    else
+                        gc++;
+                }
+            }
 
-int object_likes_len(const char *id)
-/* returns the number of likes (without reading the index) */
-{
-    xs *fn = _object_index_fn(id, "_l.idx");
-    return index_len(fn);
-}
+            fclose(o);
 
+            xs *ofn = xs_fmt("%s.bak", fn);
 
-int object_announces_len(const char *id)
-/* returns the number of announces (without reading the index) */
-{
-    xs *fn = _object_index_fn(id, "_a.idx");
-    return index_len(fn);
-}
+            unlink(ofn);
+            link(fn, ofn);
+            rename(nfn, fn);
 
+            _idx_cache_forget(fn);
+        }
 
-xs_list *object_children(const char *id)
-/* returns the list of an object's children */
-{
-    xs *fn = _object_index_fn(id, "_c.idx");
-    return index_list(fn, XS_ALL);
-}
+        fclose(i);
+    }
 
+    data_unlock(fn);
 
-xs_list *object_likes(const char *id)
-{
-    xs *fn = _object_index_fn(id, "_l.idx");
-    return index_list(fn, XS_ALL);
+    return gc;
 }
 
 
-xs_list *object_announces(const char *id)
+int index_in_md5(const char *fn, const char *md5)
+/* checks if the md5 is already in the index */
 {
-    xs *fn = _object_index_fn(id, "_a.idx");
-    return index_list(fn, XS_ALL);
-}
-
+    FILE *f;
+    int ret = 0;
+    unsigned char raw[BIDX_MD5_SIZE];
 
-int object_parent(const char *md5, char *buf, int size)
-/* returns the object parent, if any */
-{
-    xs *fn = _object_fn_by_md5(md5, "object_parent");
+    if (_bidx_md5_raw(md5, raw) && (ret = _idx_cache_in(fn, raw)) != -1)
+        return ret;
 
-    fn = xs_replace_i(fn, ".json", "_p.idx");
-    return index_first(fn, buf, size);
-}
+    ret = 0;
 
+    if ((f = fopen(fn, "r")) != NULL) {
+        flock(fileno(f), LOCK_SH);
 
-int object_admire(const char *id, const char *actor, int like)
-/* actor likes or announces this object */
-{
-    int status = 200;
-    xs *fn     = _object_fn(id);
+        char line[256];
+        bidx_hdr h;
 
-    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+        if (_bidx_hdr(f, &h))
+            ret = _bidx_md5_raw(md5, raw) && _bidx_find(f, &h, raw) != -1;
+        else
+        while (!ret && fgets(line, sizeof(line), f) != NULL) {
+            line[32] = '\0';
 
-    if (!index_in(fn, actor)) {
-        status = index_add(fn, actor);
+            if (strcmp(line, md5) == 0)
+                ret = 1;
+        }
 
-        srv_debug(1, xs_fmt("object_admire (%s) %s %s", like ? "Like" : "Announce", actor, fn));
+        fclose(f);
     }
 
-    return status;
+    return ret;
 }
 
 
-int object_unadmire(const char *id, const char *actor, int like)
-/* actor no longer likes or announces this object */
+int index_in(const char *fn, const char *id)
+/* checks if the object id is already in the index */
 {
-    int status;
-    xs *fn = _object_fn(id);
-
-    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return index_in_md5(fn, md5);
+}
 
-    status = index_del(fn, actor);
 
-    if (valid_status(status))
-        index_gc(fn);
+int index_first(const char *fn, char *line, int size)
+/* reads the first entry of an index */
+{
+    FILE *f;
+    int ret = 0;
 
-    srv_debug(0,
-        xs_fmt("object_unadmire (%s) %s %s %d", like ? "Like" : "Announce", actor, fn, status));
+    if ((f = fopen(fn, "r")) != NULL) {
+        flock(fileno(f), LOCK_SH);
 
-    return status;
-}
+        bidx_hdr h;
 
+        if (_bidx_hdr(f, &h)) {
+            bidx_blk blk;
+            int b, n, s;
 
-int _object_user_cache(snac *snac, const char *id, const char *cachedir, int del)
-/* adds or deletes from a user cache */
-{
-    xs *ofn = _object_fn(id);
-    xs *l   = xs_split(ofn, "/");
-    xs *cfn = xs_fmt("%s/%s/%s", snac->basedir, cachedir, xs_list_get(l, -1));
-    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
-    int ret;
+            for (b = 0; !ret && size > 32 && (n = _bidx_blk_read(f, &h, b, &blk)) > 0; b++) {
+                for (s = 0; s < n; s++) {
+                    if (!_bidx_dead(&blk, s)) {
+                        _bidx_md5_hex(blk.md5[s], line);
+                        ret = 1;
+                        break;
+                    }
+                }
+            }
+        }
+        else
+        if (fgets(line, size, f) != NULL) {
+            line[32] = '\0';
+            ret = 1;
+        }
 
-    if (del) {
-        ret = unlink(cfn);
-        index_del(idx, id);
-    }
-    else {
-        if ((ret = link(ofn, cfn)) != -1)
-            index_add(idx, id);
+        fclose(f);
     }
 
     return ret;
 }
 
 
-int object_user_cache_add(snac *snac, const char *id, const char *cachedir)
-/* caches an object into a user cache */
+int index_len(const char *fn)
+/* returns the number of elements in an index */
 {
-    return _object_user_cache(snac, id, cachedir, 0);
-}
-
+    struct stat st;
+    int len = 0;
 
-int object_user_cache_del(snac *snac, const char *id, const char *cachedir)
-/* deletes an object from a user cache */
-{
-    return _object_user_cache(snac, id, cachedir, 1);
-}
+    if (stat(fn, &st) != -1) {
+        FILE *f;
+        bidx_hdr h;
 
+        /* binary indexes know their number of live entries */
+        if (st.st_size >= (off_t)sizeof(h) && (f = fopen(fn, "r")) != NULL) {
+            if (_bidx_hdr(f, &h))
+                len = h.live;
+            else
+                len = st.st_size / 33;
 
-int object_user_cache_in(snac *snac, const char *id, const char *cachedir)
-/* checks if an object is stored in a cache */
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    xs *cfn = xs_fmt("%s/%s/%s.json", snac->basedir, cachedir, md5);
+            fclose(f);
+        }
+        else
+            len = st.st_size / 33;
+    }
 
-    return !!(mtime(cfn) != 0.0);
+    return len;
 }
 
 
-xs_list *object_user_cache_list(snac *snac, const char *cachedir, int max, int inv)
-/* returns the objects in a cache as a list */
+xs_list *index_list(const char *fn, int max)
+/* returns an index as a list */
 {
-    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
-    return inv ? index_list_desc(idx, 0, max) : index_list(idx, max);
-}
-
-
-/** specialized functions **/
+    xs_list *list = xs_list_new();
+    FILE *f;
+    int n = 0;
 
-/** followers **/
+    if ((f = fopen(fn, "r")) != NULL) {
+        flock(fileno(f), LOCK_SH);
 
-int follower_add(snac *snac, const char *actor)
-/* adds a follower */
-{
-    int ret = object_user_cache_add(snac, actor, "followers");
+        char line[256];
+        bidx_hdr h;
+
+        if (_bidx_hdr(f, &h)) {
+            bidx_blk blk;
+            int b, bn, s;
+
+            for (b = 0; n < max && (bn = _bidx_blk_read(f, &h, b, &blk)) > 0; b++) {
+                for (s = 0; n < max && s < bn; s++) {
+                    if (!_bidx_dead(&blk, s)) {
+                        _bidx_md5_hex(blk.md5[s], line);
+                        list = xs_list_append(list, line);
+                        n++;
+                    }
+                }
+            }
+        }
+        else
+        while (n < max && fgets(line, sizeof(line), f) != NULL) {
+            if (line[0] != '-') {
+                line[32] = '\0';
+                list = xs_list_append(list, line);
+                n++;
+            }
+        }
 
-    snac_debug(snac, 2, xs_fmt("follower_add %s", actor));
+        fclose(f);
+    }
 
-    return ret == -1 ? 500 : 200;
+    return list;
 }
 
 
-int follower_del(snac *snac, const char *actor)
-/* deletes a follower */
+xs_list *index_list_desc(const char *fn, int skip, int show)
+/* returns an index as a list, in reverse order */
 {
-    int ret = object_user_cache_del(snac, actor, "followers");
+    xs_list *list = xs_list_new();
+    FILE *f;
+    int n = 0;
 
-    snac_debug(snac, 2, xs_fmt("follower_del %s", actor));
+    if ((f = fopen(fn, "r")) != NULL) {
+        flock(fileno(f), LOCK_SH);
 
-    return ret == -1 ? 404 : 200;
-}
+        char line[256];
+        bidx_hdr h;
 
+        if (_bidx_hdr(f, &h)) {
+            /* go directly to the first slot to be shown */
+            int s = (int)h.total - 1 - skip;
 
-int follower_check(snac *snac, const char *actor)
-/* checks if someone is a follower */
-{
-    return object_user_cache_in(snac, actor, "followers");
-}
-
-
-xs_list *follower_list(snac *snac)
-/* returns the list of followers */
-{
-    xs *list       = object_user_cache_list(snac, "followers", XS_ALL, 0);
-    xs_list *fwers = xs_list_new();
-    char *p;
-    const char *v;
+            while (n < show && s >= 0) {
+                bidx_blk blk;
+                int b = s / BIDX_SLOTS;
 
-    /* resolve the list of md5 to be a list of actors */
-    p = list;
-    while (xs_list_iter(&p, &v)) {
-        xs *a_obj = NULL;
+                if (_bidx_blk_read(f, &h, b, &blk) == 0)
+                    break;
 
-        if (valid_status(object_get_by_md5(v, &a_obj))) {
-            const char *actor = xs_dict_get(a_obj, "id");
+                for (; n < show && s >= b * BIDX_SLOTS; s--) {
+                    int i = s % BIDX_SLOTS;
 
-            if (!xs_is_null(actor)) {
-                /* check if the actor is still cached */
-                xs *fn = xs_fmt("%s/followers/%s.json", snac->basedir, v);
+                    if (!_bidx_dead(&blk, i)) {
+                        _bidx_md5_hex(blk.md5[i], line);
+                        list = xs_list_append(list, line);
+                        n++;
+                    }
+                }
+            }
+        }
+        else
+        /* move to the end minus one entry (or more, if skipping entries) */
+        if (!fseek(f, 0, SEEK_END) && !fseek(f, (skip + 1) * -33, SEEK_CUR)) {
+            while (n < show && fgets(line, sizeof(line), f) != NULL) {
+                if (line[0] != '-') {
+                    line[32] = '\0';
+                    list = xs_list_append(list, line);
+                    n++;
+                }
 
-                if (mtime(fn) > 0.0)
-                    fwers = xs_list_append(fwers, actor);
+                /* move backwards 2 entries */
+                if (fseek(f, -66, SEEK_CUR) == -1)
+                    break;
             }
         }
+
+        fclose(f);
     }
 
-    return fwers;
+    return list;
 }
 
 
-/** timeline **/
+/** packed object store **/
 
-double timeline_mtime(snac *snac)
+/* If the "packed_objects" server setting is set, new objects are not
+   stored in their own files, but appended to segment files inside
+   object/pack/. An append-only log (object/pack/index) maps each md5
+   to its segment, offset and length; it's replayed into memory and
+   read incrementally when other processes add to it.
+   User caches use the number of hard links to an object file as its
+   reference count, so packed objects are extracted to their own file
+   before being linked; this way, packed objects are always unreferenced.
+   The space of deleted objects is reclaimed by _pack_compact(). */
+
+#define PACK_SEG_MAX (64 * 1024 * 1024)
+
+typedef struct {
+    unsigned char md5[BIDX_MD5_SIZE];
+    uint32_t seg;           /* segment number */
+    uint32_t off;           /* offset inside the segment */
+    uint32_t len;           /* data length (0: deleted) */
+    uint32_t ctime;         /* creation time */
+    uint32_t mtime;         /* modification time */
+} pack_rec;
+
+static pthread_mutex_t pack_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ino_t pack_ino = 0;          /* inode of the loaded log */
+static off_t pack_size = 0;         /* bytes of the log already replayed */
+static uint32_t pack_last_seg = 0;  /* highest segment number seen */
+static int pack_slots = 0;          /* size of the table (power of 2) */
+static int pack_keys = 0;           /* number of used slots */
+static pack_rec *pack_recs = NULL;  /* table of records */
+
+
+static int _pack_enabled(void)
+/* returns true if new objects are to be packed */
 {
-    xs *fn = xs_fmt("%s/private.idx", snac->basedir);
-    return mtime(fn);
+    return xs_type(xs_dict_get(srv_config, "packed_objects")) == XSTYPE_TRUE;
 }
 
 
-int timeline_touch(snac *snac)
-/* changes the date of the timeline index */
+static xs_str *_pack_fn(uint32_t seg)
+/* returns the file name of a segment, or of the log if seg is 0 */
 {
-    xs *fn = xs_fmt("%s/private.idx", snac->basedir);
-    return utimes(fn, NULL);
+    if (seg == 0)
+        return xs_fmt("%s/object/pack/index", srv_basedir);
+    else
+        return xs_fmt("%s/object/pack/%08x.seg", srv_basedir, seg);
 }
 
 
-xs_str *timeline_fn_by_md5(snac *snac, const char *md5)
-/* get the filename of an entry by md5 from any timeline */
+static int _pack_slot(const unsigned char *raw)
+/* returns the slot where raw is or should be */
 {
-    xs_str *fn = NULL;
+    unsigned int i;
 
-    if (xs_is_hex(md5) && strlen(md5) == 32) {
-        fn = xs_fmt("%s/private/%s.json", snac->basedir, md5);
+    memcpy(&i, raw, sizeof(i));
 
-        if (mtime(fn) == 0.0) {
-            fn = xs_free(fn);
-            fn = xs_fmt("%s/public/%s.json", snac->basedir, md5);
+    for (;;) {
+        i &= pack_slots - 1;
 
-            if (mtime(fn) == 0.0)
-                fn = xs_free(fn);
-        }
+        if (memcmp(pack_recs[i].md5, raw, BIDX_MD5_SIZE) == 0 ||
+            memcmp(pack_recs[i].md5, idx_cache_empty, BIDX_MD5_SIZE) == 0)
+            break;
+
+        i++;
     }
 
-    return fn;
+    return i;
 }
 
 
-int timeline_here(snac *snac, const char *md5)
-/* checks if an object is in the user cache */
+static void _pack_put(const pack_rec *r)
+/* stores a record in the table, replacing the previous one */
 {
-    xs *fn = timeline_fn_by_md5(snac, md5);
+    if ((pack_keys + 1) * 2 > pack_slots) {
+        pack_rec *o = pack_recs;
+        int o_slots = pack_slots;
+        int n;
 
-    return !(fn == NULL);
-}
+        int paused = xs_arena_pause();
 
+        pack_slots = o_slots ? o_slots * 2 : 1024;
+        pack_keys  = 0;
+        pack_recs  = xs_realloc(NULL, pack_slots * sizeof(pack_rec));
+        xs_arena_resume(paused);
+        memset(pack_recs, '\0', pack_slots * sizeof(pack_rec));
 
-int timeline_get_by_md5(snac *snac, const char *md5, xs_dict **msg)
-/* gets a message from the timeline */
-{
-    int status = 404;
-    FILE *f    = NULL;
+        for (n = 0; n < o_slots; n++) {
+            if (memcmp(o[n].md5, idx_cache_empty, BIDX_MD5_SIZE) != 0)
+                _pack_put(&o[n]);
+        }
 
-    xs *fn = timeline_fn_by_md5(snac, md5);
+        xs_free(o);
+    }
 
-    if (fn != NULL && (f = fopen(fn, "r")) != NULL) {
-        *msg = xs_json_load(f);
-        fclose(f);
+    int i = _pack_slot(r->md5);
 
-        if (*msg != NULL)
-            status = 200;
-    }
+    if (memcmp(pack_recs[i].md5, idx_cache_empty, BIDX_MD5_SIZE) == 0)
+        pack_keys++;
 
-    return status;
+    pack_recs[i] = *r;
+
+    if (r->seg > pack_last_seg)
+        pack_last_seg = r->seg;
 }
 
 
-int timeline_del(snac *snac, const char *id)
-/* deletes a message from the timeline */
+static void _pack_sync(void)
+/* replays the records added to the log since the last time (mutex held) */
 {
-    /* delete from the user's caches */
-    object_user_cache_del(snac, id, "public");
-    object_user_cache_del(snac, id, "private");
+    xs *fn = _pack_fn(0);
+    struct stat st;
 
-    /* try to delete the object if it's not used elsewhere */
-    return object_del_if_unref(id);
-}
+    if (stat(fn, &st) == -1) {
+        /* no log (yet, or anymore) */
+        st.st_ino  = 0;
+        st.st_size = 0;
+    }
 
+    if (st.st_ino != pack_ino) {
+        /* new or compacted log: start again */
+        pack_recs     = xs_free(pack_recs);
+        pack_slots    = 0;
+        pack_keys     = 0;
+        pack_size     = 0;
+        pack_last_seg = 0;
+        pack_ino      = st.st_ino;
+    }
 
-void timeline_update_indexes(snac *snac, const char *id)
-/* updates the indexes */
-{
-    object_user_cache_add(snac, id, "private");
+    if (st.st_size >= pack_size + (off_t)sizeof(pack_rec)) {
+        FILE *f;
 
-    if (xs_startswith(id, snac->actor)) {
-        xs *msg = NULL;
+        if ((f = fopen(fn, "r")) != NULL) {
+            pack_rec r;
 
-        if (valid_status(object_get(id, &msg))) {
-            /* if its ours and is public, also store in public */
-            if (is_msg_public(msg)) {
-                object_user_cache_add(snac, id, "public");
+            fseek(f, pack_size, SEEK_SET);
 
-                /* also add it to the instance public timeline */
-                xs *ipt = xs_fmt("%s/public.idx", srv_basedir);
-                index_add(ipt, id);
+            /* only full records are read */
+            while (fread(&r, sizeof(r), 1, f) == 1) {
+                _pack_put(&r);
+                pack_size += sizeof(r);
             }
+
+            fclose(f);
         }
     }
 }
 
 
-int timeline_add(snac *snac, const char *id, const xs_dict *o_msg)
-/* adds a message to the timeline */
+static int _pack_get(const char *md5, pack_rec *r)
+/* gets the record of a live packed object */
 {
-    int ret = object_add(id, o_msg);
-    timeline_update_indexes(snac, id);
+    unsigned char raw[BIDX_MD5_SIZE];
+    int ret = 0;
 
-    tag_index(id, o_msg);
+    if (!_bidx_md5_raw(md5, raw))
+        return 0;
 
-    list_distribute(snac, NULL, o_msg);
+    pthread_mutex_lock(&pack_mutex);
 
-    snac_debug(snac, 1, xs_fmt("timeline_add %s", id));
+    _pack_sync();
+
+    if (pack_slots) {
+        const pack_rec *p = &pack_recs[_pack_slot(raw)];
+
+        if (p->len && memcmp(p->md5, raw, BIDX_MD5_SIZE) == 0) {
+            *r = *p;
+            ret = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&pack_mutex);
 
     return ret;
 }
 
 
-int timeline_admire(snac *snac, const char *id, const char *admirer, int like)
-/* updates a timeline entry with a new admiration */
+static int _pack_log(pack_rec *r, const char *data)
+/* appends data (if any) to the last segment and the record to the log */
 {
-    /* if we are admiring this, add to both timelines */
-    if (!like && strcmp(admirer, snac->actor) == 0) {
-        object_user_cache_add(snac, id, "public");
-        object_user_cache_add(snac, id, "private");
-    }
+    int ret = 0;
+    xs *dir = xs_fmt("%s/object/pack", srv_basedir);
+    xs *lfn = _pack_fn(0);
+    FILE *lf;
 
-    int ret = object_admire(id, admirer, like);
+    mkdirx(dir);
 
-    snac_debug(snac, 1, xs_fmt("timeline_admire (%s) %s %s",
-            like ? "Like" : "Announce", id, admirer));
+    pthread_mutex_lock(&pack_mutex);
 
-    return ret;
-}
+    for (;;) {
+        struct stat st1, st2;
 
+        if ((lf = fopen(lfn, "a")) == NULL)
+            break;
 
-xs_list *timeline_top_level(snac *snac, const xs_list *list)
-/* returns the top level md5 entries from this index */
-{
-    xs_set seen;
-    const xs_str *v;
+        flock(fileno(lf), LOCK_EX);
 
-    xs_set_init(&seen);
+        /* if the log was compacted while waiting for the lock, open the new one */
+        if (fstat(fileno(lf), &st1) != -1 && stat(lfn, &st2) != -1 && st1.st_ino == st2.st_ino)
+            break;
 
-    int c = 0;
-    while (xs_list_next(list, &v, &c)) {
-        char line[256] = "";
+        fclose(lf);
+    }
 
-        strncpy(line, v, sizeof(line));
+    if (lf != NULL) {
+        /* catch up with other writers */
+        _pack_sync();
 
-        for (;;) {
-            char line2[256];
+        if (data != NULL) {
+            uint32_t seg = pack_last_seg ? pack_last_seg : 1;
+            xs *sfn = _pack_fn(seg);
+            FILE *sf;
 
-            /* if it doesn't have a parent, use this */
-            if (!object_parent(line, line2, sizeof(line2)))
-                break;
+            struct stat st;
 
-            /* well, there is a parent... but is it here? */
-            if (!timeline_here(snac, line2))
-                break;
+            /* start a new segment if this one is full */
+            if (stat(sfn, &st) != -1 && st.st_size + r->len > PACK_SEG_MAX) {
+                seg++;
+                sfn = xs_free(sfn);
+                sfn = _pack_fn(seg);
+            }
 
-            /* it's here! try again with its own parent */
-            strncpy(line, line2, sizeof(line));
+            if ((sf = fopen(sfn, "a")) != NULL) {
+                fseek(sf, 0, SEEK_END);
+
+                r->seg = seg;
+                r->off = ftell(sf);
+
+                if (fwrite(data, r->len, 1, sf) == 1)
+                    ret = 1;
+
+                /* the data must be in the segment before the record is in the log */
+                if (fclose(sf) != 0)
+                    ret = 0;
+            }
+        }
+        else
+            ret = 1;
+
+        if (ret) {
+            fwrite(r, sizeof(*r), 1, lf);
+
+            if (fflush(lf) == 0) {
+                _pack_put(r);
+                pack_size += sizeof(*r);
+            }
+            else
+                ret = 0;
         }
 
-        xs_set_add(&seen, line);
+        fclose(lf);
     }
 
-    return xs_set_result(&seen);
+    pthread_mutex_unlock(&pack_mutex);
+
+    return ret;
 }
 
 
-xs_list *timeline_simple_list(snac *snac, const char *idx_name, int skip, int show)
-/* returns a timeline (with all entries) */
+static int _pack_write(const char *md5, const xs_dict *obj)
+/* packs an object */
 {
-    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, idx_name);
+    pack_rec r = {0};
+    pack_rec o;
+    xs *j = xs_json_dumps(obj, 0);
 
-    return index_list_desc(idx, skip, show);
+    if (j == NULL || !_bidx_md5_raw(md5, r.md5))
+        return 0;
+
+    r.len   = strlen(j);
+    r.mtime = time(NULL);
+    r.ctime = _pack_get(md5, &o) ? o.ctime : r.mtime;
+
+    return _pack_log(&r, j);
 }
 
 
-xs_list *timeline_list(snac *snac, const char *idx_name, int skip, int show)
-/* returns a timeline (only top level entries) */
+static int _pack_del(const char *md5)
+/* deletes a packed object */
 {
-    int c_max;
-
-    /* maximum number of items in the timeline */
-    c_max = xs_number_get(xs_dict_get(srv_config, "max_timeline_entries"));
+    pack_rec r;
 
-    /* never more timeline entries than the configured maximum */
-    if (show > c_max)
-        show = c_max;
+    if (!_pack_get(md5, &r))
+        return 0;
 
-    xs *list = timeline_simple_list(snac, idx_name, skip, show);
+    r.len = 0;
 
-    return timeline_top_level(snac, list);
+    return _pack_log(&r, NULL);
 }
 
 
-xs_list *timeline_instance_list(int skip, int show)
-/* returns the timeline for the full instance */
+static int _pack_touch(const char *md5)
+/* updates the modification time of a packed object */
 {
-    xs *idx = xs_fmt("%s/public.idx", srv_basedir);
+    pack_rec r;
 
-    return index_list_desc(idx, skip, show);
-}
+    if (!_pack_get(md5, &r))
+        return 0;
 
+    r.mtime = time(NULL);
 
-/** following **/
+    return _pack_log(&r, NULL);
+}
 
-/* this needs special treatment and cannot use the object db as is,
-   with a link to a cached author, because we need the Follow object
-   in case we need to unfollow (Undo + original Follow) */
 
-xs_str *_following_fn(snac *snac, const char *actor)
+static xs_str *_pack_read(const char *md5, pack_rec *r)
+/* reads the data of a packed object */
 {
-    xs *md5 = xs_md5_hex(actor, strlen(actor));
-    return xs_fmt("%s/following/%s.json", snac->basedir, md5);
-}
+    xs_str *data = NULL;
+    int n;
 
+    for (n = 0; data == NULL && n < 2; n++) {
+        FILE *f;
 
-int following_add(snac *snac, const char *actor, const xs_dict *msg)
-/* adds to the following list */
-{
-    int ret = 201; /* created */
-    xs *fn = _following_fn(snac, actor);
-    FILE *f;
-    xs *p_object = NULL;
+        if (!_pack_get(md5, r))
+            break;
 
-    if (valid_status(following_get(snac, actor, &p_object))) {
-        /* object already exists; if it's of type Accept,
-           the actor is already being followed and confirmed,
-           so do nothing */
-        const char *type = xs_dict_get(p_object, "type");
+        xs *fn = _pack_fn(r->seg);
 
-        if (!xs_is_null(type) && strcmp(type, "Accept") == 0) {
-            snac_debug(snac, 1, xs_fmt("following_add actor already confirmed %s", actor));
-            return 200;
-        }
-    }
+        if ((f = fopen(fn, "r")) != NULL) {
+            int size = r->len;
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        xs_json_dump(msg, 4, f);
-        fclose(f);
+            if (fseek(f, r->off, SEEK_SET) != -1) {
+                data = xs_read(f, &size);
 
-        /* get the filename of the actor object */
-        xs *actor_fn = _object_fn(actor);
+                if (size != (int)r->len)
+                    data = xs_free(data);
+            }
 
-        /* increase its reference count */
-        fn = xs_replace_i(fn, ".json", "_a.json");
-        link(actor_fn, fn);
-    }
-    else
-        ret = 500;
+            fclose(f);
+        }
 
-    snac_debug(snac, 2, xs_fmt("following_add %s %s", actor, fn));
+        if (data == NULL) {
+            /* maybe the log was compacted in the meantime: force a reload */
+            pthread_mutex_lock(&pack_mutex);
+            pack_ino = 0;
+            pthread_mutex_unlock(&pack_mutex);
+        }
+    }
 
-    return ret;
+    return data;
 }
 
 
-int following_del(snac *snac, const char *actor)
-/* we're not following this actor any longer */
+static xs_list *_pack_list(time_t mt)
+/* returns the md5s of the packed objects older than mt */
 {
-    xs *fn = _following_fn(snac, actor);
+    xs_list *list = xs_list_new();
+    int n;
 
-    snac_debug(snac, 2, xs_fmt("following_del %s %s", actor, fn));
+    pthread_mutex_lock(&pack_mutex);
 
-    unlink(fn);
+    _pack_sync();
 
-    /* also delete the reference to the author */
-    fn = xs_replace_i(fn, ".json", "_a.json");
-    unlink(fn);
+    for (n = 0; n < pack_slots; n++) {
+        const pack_rec *r = &pack_recs[n];
 
-    return 200;
-}
+        if (r->len && r->mtime < mt) {
+            char md5[33];
 
+            _bidx_md5_hex(r->md5, md5);
+            list = xs_list_append(list, md5);
+        }
+    }
 
-int following_check(snac *snac, const char *actor)
-/* checks if we are following this actor */
-{
-    xs *fn = _following_fn(snac, actor);
+    pthread_mutex_unlock(&pack_mutex);
 
-    return !!(mtime(fn) != 0.0);
+    return list;
 }
 
 
-int following_get(snac *snac, const char *actor, xs_dict **data)
-/* returns the 'Follow' object */
+static int _pack_extract(const char *md5, const char *fn)
+/* moves a packed object to its own file */
 {
-    xs *fn = _following_fn(snac, actor);
+    int ret = 0;
+    pack_rec r;
+    xs *data = _pack_read(md5, &r);
     FILE *f;
-    int status = 200;
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        *data = xs_json_load(f);
+    if (data != NULL && (f = fopen(fn, "w")) != NULL) {
+        flock(fileno(f), LOCK_EX);
+
+        /* store as any other object file */
+        xs *obj = xs_json_loads(data);
+
+        if (obj != NULL)
+            xs_json_dump(obj, json_indent(), f);
+        else
+            fwrite(data, r.len, 1, f);
+
         fclose(f);
+
+        /* keep the original modification time */
+        struct timeval tv[2] = { { r.mtime, 0 }, { r.mtime, 0 } };
+        utimes(fn, tv);
+
+        _pack_del(md5);
+
+        ret = 1;
     }
-    else
-        status = 404;
 
-    return status;
+    return ret;
 }
 
 
-xs_list *following_list(snac *snac)
-/* returns the list of people being followed */
+static int _pack_compact(void)
+/* rewrites the live packed objects into new segments, dropping deleted ones */
 {
-    xs *spec = xs_fmt("%s/following/" "*.json", snac->basedir);
-    xs *glist = xs_glob(spec, 0, 0);
-    xs_list *p;
-    const xs_str *v;
-    xs_list *list = xs_list_new();
+    xs *lfn  = _pack_fn(0);
+    xs *nlfn = xs_fmt("%s.new", lfn);
+    FILE *lf, *nlf;
+    int cnt = -1;
 
-    /* iterate the list of files */
-    p = glist;
-    while (xs_list_iter(&p, &v)) {
-        FILE *f;
+    if (mtime(lfn) == 0.0)
+        return cnt;
 
-        /* load the follower data */
-        if ((f = fopen(v, "r")) != NULL) {
-            xs *o = xs_json_load(f);
-            fclose(f);
+    pthread_mutex_lock(&pack_mutex);
 
-            if (o != NULL) {
-                const char *type = xs_dict_get(o, "type");
+    if ((lf = fopen(lfn, "r")) != NULL) {
+        flock(fileno(lf), LOCK_EX);
 
-                if (!xs_is_null(type) && strcmp(type, "Accept") == 0) {
-                    const char *actor = xs_dict_get(o, "actor");
+        _pack_sync();
 
-                    if (!xs_is_null(actor)) {
-                        list = xs_list_append(list, actor);
+        /* check if it's worth the effort */
+        double t_size = 0.0;
+        double l_size = 0.0;
+        uint32_t seg;
+        int n;
 
-                        /* check if there is a link to the actor object */
-                        xs *v2 = xs_replace(v, ".json", "_a.json");
+        for (seg = 1; seg <= pack_last_seg; seg++) {
+            xs *sfn = _pack_fn(seg);
+            struct stat st;
 
-                        if (mtime(v2) == 0.0) {
-                            /* no; add a link to it */
-                            xs *actor_fn = _object_fn(actor);
-                            link(actor_fn, v2);
-                        }
-                    }
-                }
-            }
+            if (stat(sfn, &st) != -1)
+                t_size += st.st_size;
         }
-    }
-
-    return list;
-}
 
+        for (n = 0; n < pack_slots; n++)
+            l_size += pack_recs[n].len;
 
-xs_str *_muted_fn(snac *snac, const char *actor)
-{
-    xs *md5 = xs_md5_hex(actor, strlen(actor));
-    return xs_fmt("%s/muted/%s", snac->basedir, md5);
-}
+        if (t_size > 0.0 && l_size / t_size < 0.75 && (nlf = fopen(nlfn, "w")) != NULL) {
+            uint32_t o_last_seg = pack_last_seg;
+            uint32_t n_seg = o_last_seg;
+            FILE *nsf = NULL;
+            long n_off = PACK_SEG_MAX;
+            int err = 0;
 
+            cnt = 0;
 
-void mute(snac *snac, const char *actor)
-/* mutes a moron */
-{
-    xs *fn = _muted_fn(snac, actor);
-    FILE *f;
+            for (n = 0; !err && n < pack_slots; n++) {
+                pack_rec r = pack_recs[n];
+                xs *data = NULL;
+                int size = r.len;
+                FILE *sf;
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%s\n", actor);
-        fclose(f);
+                if (r.len == 0) {
+                    if (memcmp(r.md5, idx_cache_empty, BIDX_MD5_SIZE) != 0)
+                        cnt++;
 
-        snac_debug(snac, 2, xs_fmt("muted %s %s", actor, fn));
-    }
-}
+                    continue;
+                }
 
+                xs *sfn = _pack_fn(r.seg);
 
-void unmute(snac *snac, const char *actor)
-/* actor is no longer a moron */
-{
-    xs *fn = _muted_fn(snac, actor);
+                if ((sf = fopen(sfn, "r")) != NULL) {
+                    if (fseek(sf, r.off, SEEK_SET) != -1)
+                        data = xs_read(sf, &size);
 
-    unlink(fn);
+                    fclose(sf);
+                }
 
-    snac_debug(snac, 2, xs_fmt("unmuted %s %s", actor, fn));
-}
+                if (data == NULL || size != (int)r.len) {
+                    /* unreadable: drop it */
+                    cnt++;
+                    continue;
+                }
 
+                if (n_off + r.len > PACK_SEG_MAX) {
+                    /* open a new segment */
+                    if (nsf != NULL && fclose(nsf) != 0)
+                        err = 1;
 
-int is_muted(snac *snac, const char *actor)
-/* check if someone is muted */
-{
-    xs *fn = _muted_fn(snac, actor);
+                    xs *nsfn = _pack_fn(++n_seg);
 
-    return !!(mtime(fn) != 0.0);
-}
+                    if ((nsf = fopen(nsfn, "w")) == NULL)
+                        err = 1;
 
+                    n_off = 0;
 
-/** pinning **/
+                    if (err)
+                        break;
+                }
 
-xs_str *_pinned_fn(snac *user, const char *id)
-{
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return xs_fmt("%s/pinned/%s.json", user->basedir, md5);
-}
+                r.seg = n_seg;
+                r.off = n_off;
+                n_off += r.len;
 
+                if (fwrite(data, r.len, 1, nsf) != 1 || fwrite(&r, sizeof(r), 1, nlf) != 1)
+                    err = 1;
+            }
 
-int is_pinned(snac *user, const char *id)
-/* returns true if this note is pinned */
-{
-    xs *fn = _pinned_fn(user, id);
-    return !!(mtime(fn) != 0.0);
-}
+            if (nsf != NULL && fclose(nsf) != 0)
+                err = 1;
 
+            if (fclose(nlf) != 0)
+                err = 1;
 
-int is_pinned_by_md5(snac *user, const char *md5)
-{
-    xs *fn = xs_fmt("%s/pinned/%s.json", user->basedir, md5);
-    return !!(mtime(fn) != 0.0);
-}
+            if (!err) {
+                rename(nlfn, lfn);
 
+                /* the old segments are no longer needed */
+                for (seg = 1; seg <= o_last_seg; seg++) {
+                    xs *sfn = _pack_fn(seg);
+                    unlink(sfn);
+                }
+            }
+            else {
+                srv_log(xs_fmt("_pack_compact: error writing %s", nlfn));
+                unlink(nlfn);
 
-int pin(snac *user, const char *id)
-/* pins a message */
-{
-    int ret = -2;
+                /* delete the partially written segments */
+                for (seg = o_last_seg + 1; seg <= n_seg; seg++) {
+                    xs *sfn = _pack_fn(seg);
+                    unlink(sfn);
+                }
 
-    if (xs_startswith(id, user->actor)) {
-        if (is_pinned(user, id))
-            ret = -3;
-        else {
-            /* create the subfolder, if it does not exist */
-            xs *fn = xs_fmt("%s/pinned/", user->basedir);
-            mkdirx(fn);
+                cnt = -1;
+            }
 
-            ret = object_user_cache_add(user, id, "pinned");
+            /* force a reload */
+            pack_ino = 0;
         }
+
+        fclose(lf);
     }
 
-    return ret;
+    pthread_mutex_unlock(&pack_mutex);
+
+    return cnt;
 }
 
 
-int unpin(snac *user, const char *id)
-/* unpin a message */
-{
-    int ret = object_user_cache_del(user, id, "pinned");
+/** parsed object cache **/
 
-    if (ret != -1) {
-        /* delete from the index */
-        xs *idx = xs_fmt("%s/pinned.idx", user->basedir);
-        index_del(idx, id);
-    }
+/* Recently read objects are kept parsed in memory, up to the
+   "object_cache_size" server setting (in megabytes). A cached
+   object is only returned if its file (or its packed record)
+   hasn't changed since it was read. */
 
-    return ret;
-}
+#define OBJ_CACHE_BUCKETS 4096
 
+typedef struct obj_cache_ent {
+    unsigned char md5[BIDX_MD5_SIZE];
+    uint64_t v[3];                  /* validator (inode, size and mtime, or pack position) */
+    long size;                      /* memory used */
+    xs_dict *obj;                   /* the parsed object */
+    struct obj_cache_ent *prev;     /* LRU list (more recent) */
+    struct obj_cache_ent *next;     /* LRU list (less recent) */
+    struct obj_cache_ent *h_next;   /* hash chain */
+} obj_cache_ent;
 
-xs_list *pinned_list(snac *user)
-/* return the lists of pinned posts */
-{
-    return object_user_cache_list(user, "pinned", XS_ALL, 1);
-}
+typedef struct {
+    pthread_mutex_t mutex;
+    obj_cache_ent *h[OBJ_CACHE_BUCKETS];
+    obj_cache_ent *mru;
+    obj_cache_ent *lru;
+    long used;
+} obj_cache;
 
+static obj_cache object_cache = { .mutex = PTHREAD_MUTEX_INITIALIZER };
 
-xs_str *_hidden_fn(snac *snac, const char *id)
+
+static long _obj_cache_max(void)
+/* returns the maximum memory to be used by the object cache */
 {
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    return xs_fmt("%s/hidden/%s", snac->basedir, md5);
+    const xs_number *v = xs_dict_get(srv_config, "object_cache_size");
+
+    return (xs_type(v) == XSTYPE_NUMBER ? xs_number_get(v) : 16) * 1024 * 1024;
 }
 
 
-void hide(snac *snac, const char *id)
-/* hides a message tree */
+static obj_cache_ent **_obj_cache_ptr(obj_cache *c, const unsigned char *raw)
+/* returns the pointer to the entry for raw, or where it should be (mutex held) */
 {
-    xs *fn = _hidden_fn(snac, id);
-    FILE *f;
-
-    if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%s\n", id);
-        fclose(f);
+    unsigned int i;
 
-        snac_debug(snac, 2, xs_fmt("hidden %s %s", id, fn));
+    memcpy(&i, raw, sizeof(i));
 
-        /* hide all the children */
-        xs *chld = object_children(id);
-        char *p;
-        const char *v;
+    obj_cache_ent **e = &c->h[i % OBJ_CACHE_BUCKETS];
 
-        p = chld;
-        while (xs_list_iter(&p, &v)) {
-            xs *co = NULL;
+    while (*e != NULL && memcmp((*e)->md5, raw, BIDX_MD5_SIZE) != 0)
+        e = &(*e)->h_next;
 
-            /* resolve to get the id */
-            if (valid_status(object_get_by_md5(v, &co))) {
-                const char *id = xs_dict_get(co, "id");
-                if (id != NULL)
-                    hide(snac, id);
-            }
-        }
-    }
+    return e;
 }
 
 
-int is_hidden(snac *snac, const char *id)
-/* check is id is hidden */
+static void _obj_cache_lru_unlink(obj_cache *c, obj_cache_ent *e)
+/* takes an entry out of the LRU list (mutex held) */
 {
-    xs *fn = _hidden_fn(snac, id);
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        c->mru = e->next;
 
-    return !!(mtime(fn) != 0.0);
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        c->lru = e->prev;
+
+    e->prev = e->next = NULL;
 }
 
 
-int actor_add(const char *actor, const xs_dict *msg)
-/* adds an actor */
+static void _obj_cache_lru_push(obj_cache *c, obj_cache_ent *e)
+/* puts an entry as the most recently used (mutex held) */
 {
-    return object_add_ow(actor, msg);
+    e->prev = NULL;
+    e->next = c->mru;
+
+    if (c->mru)
+        c->mru->prev = e;
+    else
+        c->lru = e;
+
+    c->mru = e;
 }
 
 
-int actor_get(const char *actor, xs_dict **data)
-/* returns an already downloaded actor */
+static void _obj_cache_remove(obj_cache *c, obj_cache_ent **pe)
+/* removes an entry from the cache (mutex held) */
 {
-    int status = 200;
-    xs_dict *d = NULL;
+    obj_cache_ent *e = *pe;
 
-    if (xs_startswith(actor, srv_baseurl)) {
-        /* it's a (possible) local user */
-        xs *l = xs_split(actor, "/");
-        const char *uid = xs_list_get(l, -1);
-        snac user;
+    *pe = e->h_next;
+    _obj_cache_lru_unlink(c, e);
 
-        if (!xs_is_null(uid) && user_open(&user, uid)) {
-            if (data)
-                *data = msg_actor(&user);
+    c->used -= e->size;
 
-            user_free(&user);
-            return 200;
-        }
-        else
-            return 404;
-    }
+    xs_free(e->obj);
+    xs_free(e);
+}
 
-    /* read the object */
-    if (!valid_status(status = object_get(actor, &d))) {
-        d = xs_free(d);
-        return status;
-    }
 
-    /* if the object is corrupted, discard it */
-    if (xs_is_null(xs_dict_get(d, "id")) || xs_is_null(xs_dict_get(d, "type"))) {
-        srv_debug(1, xs_fmt("corrupted actor object %s", actor));
-        d = xs_free(d);
-        return 404;
-    }
+static int _obj_cache_get(obj_cache *c, const char *md5, const uint64_t v[3],
+                          xs_dict **obj, const char *keys[])
+/* gets a copy of a cached object (or only of some of its keys), if it's still valid */
+{
+    unsigned char raw[BIDX_MD5_SIZE];
+    int ret = 0;
 
-    if (data)
-        *data = d;
-    else
-        d = xs_free(d);
+    if (!_bidx_md5_raw(md5, raw))
+        return 0;
 
-    xs *fn = _object_fn(actor);
-    double max_time;
+    pthread_mutex_lock(&c->mutex);
 
-    /* maximum time for the actor data to be considered stale */
-    max_time = 3600.0 * 36.0;
+    obj_cache_ent **pe = _obj_cache_ptr(c, raw);
 
-    if (mtime(fn) + max_time < (double) time(NULL)) {
-        /* actor data exists but also stinks */
-        status = 205; /* "205: Reset Content" "110: Response Is Stale" */
+    if (*pe != NULL) {
+        if (memcmp((*pe)->v, v, sizeof((*pe)->v)) == 0) {
+            if (keys == NULL)
+                *obj = xs_dup((*pe)->obj);
+            else {
+                *obj = xs_dict_new();
+
+                for (int n = 0; keys[n]; n++) {
+                    const xs_val *kv = xs_dict_get((*pe)->obj, keys[n]);
+
+                    if (kv != NULL)
+                        *obj = xs_dict_append(*obj, keys[n], kv);
+                }
+            }
+
+            /* move to the head of the LRU list */
+            _obj_cache_lru_unlink(c, *pe);
+            _obj_cache_lru_push(c, *pe);
+
+            ret = 1;
+        }
+        else
+            _obj_cache_remove(c, pe);
     }
 
-    return status;
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
 }
 
 
-int actor_get_refresh(snac *user, const char *actor, xs_dict **data)
-/* gets an actor and requests a refresh if it's stale */
+static void _obj_cache_put(obj_cache *c, const char *md5, const uint64_t v[3],
+                           const xs_dict *obj, long max)
+/* stores a copy of an object in the cache, using up to max bytes */
 {
-    int status = actor_get(actor, data);
+    unsigned char raw[BIDX_MD5_SIZE];
+    long size = xs_size(obj) + sizeof(obj_cache_ent);
 
-    if (status == 205 && user && !xs_startswith(actor, srv_baseurl))
-        enqueue_actor_refresh(user, actor, 0);
+    if (size > max || !_bidx_md5_raw(md5, raw))
+        return;
 
-    return status;
-}
+    /* the cache outlives any arena */
+    int paused = xs_arena_pause();
+    obj_cache_ent *e = xs_realloc(NULL, sizeof(*e));
 
+    memcpy(e->md5, raw, BIDX_MD5_SIZE);
+    memcpy(e->v, v, sizeof(e->v));
+    e->size   = size;
+    e->obj    = xs_dup(obj);
+    e->h_next = NULL;
 
-/** user limiting (announce blocks) **/
+    xs_arena_resume(paused);
 
-int limited(snac *user, const char *id, int cmd)
-/* announce messages from a followed (0: check, 1: limit; 2: unlimit) */
+    pthread_mutex_lock(&c->mutex);
+
+    obj_cache_ent **pe = _obj_cache_ptr(c, raw);
+
+    if (*pe != NULL)
+        _obj_cache_remove(c, pe);
+
+    *pe = e;
+    _obj_cache_lru_push(c, e);
+    c->used += size;
+
+    /* evict the least recently used objects */
+    while (c->used > max)
+        _obj_cache_remove(c, _obj_cache_ptr(c, c->lru->md5));
+
+    pthread_mutex_unlock(&c->mutex);
+}
+
+
+static void _obj_cache_drop(obj_cache *c, const char *md5)
+/* drops an object from the cache */
 {
-    int ret = 0;
-    xs *dir = xs_fmt("%s/limited", user->basedir);
-    xs *md5 = xs_md5_hex(id, strlen(id));
-    xs *fn  = xs_fmt("%s/%s", dir, md5);
+    unsigned char raw[BIDX_MD5_SIZE];
 
-    switch (cmd) {
-    case 0: /** check **/
-        ret = !!(mtime(fn) > 0.0);
-        break;
+    if (!_bidx_md5_raw(md5, raw))
+        return;
 
-    case 1: /** limit **/
-        mkdirx(dir);
+    pthread_mutex_lock(&c->mutex);
 
-        if (mtime(fn) > 0.0)
-            ret = -1;
-        else {
-            FILE *f;
+    obj_cache_ent **pe = _obj_cache_ptr(c, raw);
 
-            if ((f = fopen(fn, "w")) != NULL) {
-                fprintf(f, "%s\n", id);
-                fclose(f);
-            }
-            else
-                ret = -2;
-        }
-        break;
+    if (*pe != NULL)
+        _obj_cache_remove(c, pe);
 
-    case 2: /** unlimit **/
-        if (mtime(fn) > 0.0)
-            ret = unlink(fn);
-        else
-            ret = -1;
-        break;
+    pthread_mutex_unlock(&c->mutex);
+}
+
+
+/** objects **/
+
+static xs_str *_object_fn_by_md5(const char *md5, const char *func)
+{
+    xs *bfn = xs_fmt("%s/object/%c%c", srv_basedir, md5[0], md5[1]);
+    xs_str *ret;
+    int ok = 1;
+
+    /* an object deleted from an index; fail but don't bark */
+    if (md5[0] == '-')
+        ok = 0;
+    else
+    if (!is_md5_hex(md5)) {
+        srv_log(xs_fmt("_object_fn_by_md5() [from %s()]: bad md5 '%s'", func, md5));
+        ok = 0;
+    }
+
+    if (ok) {
+        mkdirx(bfn);
+        ret = xs_fmt("%s/%s.json", bfn, md5);
     }
+    else
+        ret = xs_fmt("%s/object/invalid/invalid.json", srv_basedir);
 
     return ret;
 }
 
 
-/** tag indexing **/
+static xs_str *_object_fn(const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return _object_fn_by_md5(md5, "_object_fn");
+}
 
-void tag_index(const char *id, const xs_dict *obj)
-/* update the tag indexes for this object */
+
+int object_here_by_md5(const char *id)
+/* checks if an object is already downloaded */
 {
-    const xs_list *tags = xs_dict_get(obj, "tag");
+    xs *fn = _object_fn_by_md5(id, "object_here_by_md5");
+    pack_rec r;
 
-    if (is_msg_public(obj) && xs_type(tags) == XSTYPE_LIST && xs_list_len(tags) > 0) {
-        xs *g_tag_dir = xs_fmt("%s/tag", srv_basedir);
+    return mtime(fn) > 0.0 || _pack_get(id, &r);
+}
 
-        mkdirx(g_tag_dir);
 
-        const xs_dict *v;
-        int ct = 0;
-        while (xs_list_next(tags, &v, &ct)) {
-            const char *type = xs_dict_get(v, "type");
-            const char *name = xs_dict_get(v, "name");
+int object_here(const char *id)
+/* checks if an object is already downloaded */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return object_here_by_md5(md5);
+}
 
-            if (!xs_is_null(type) && !xs_is_null(name) && strcmp(type, "Hashtag") == 0) {
-                while (*name == '#' || *name == '@')
-                    name++;
 
-                if (*name == '\0')
-                    continue;
+static int _object_stamp(const char *md5, const char *fn, uint64_t v[3], double *mt)
+/* fills the validator of a stored object (1: own file, 2: packed, 0: not here) */
+{
+    struct stat st;
+    pack_rec r;
 
-                name = xs_tolower_i((xs_str *)name);
+    if (stat(fn, &st) != -1) {
+        v[0] = st.st_ino;
+        v[1] = st.st_size;
+        v[2] = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
 
-                xs *md5_tag   = xs_md5_hex(name, strlen(name));
-                xs *tag_dir   = xs_fmt("%s/%c%c", g_tag_dir, md5_tag[0], md5_tag[1]);
-                mkdirx(tag_dir);
+        if (mt)
+            *mt = (double) st.st_mtim.tv_sec;
 
-                xs *g_tag_idx = xs_fmt("%s/%s.idx", tag_dir, md5_tag);
-                index_add(g_tag_idx, id);
+        return 1;
+    }
 
-                FILE *f;
-                xs *g_tag_name = xs_replace(g_tag_idx, ".idx", ".tag");
-                if ((f = fopen(g_tag_name, "w")) != NULL) {
-                    fprintf(f, "%s\n", name);
-                    fclose(f);
-                }
+    if (_pack_get(md5, &r)) {
+        v[0] = 0;
+        v[1] = (uint64_t)r.seg << 32 | r.off;
+        v[2] = r.len;
 
-                srv_debug(0, xs_fmt("tagged %s #%s (#%s)", id, name, md5_tag));
-            }
-        }
+        if (mt)
+            *mt = (double) r.mtime;
+
+        return 2;
     }
+
+    return 0;
 }
 
 
-xs_list *tag_search(const char *tag, int skip, int show)
-/* returns the list of posts tagged with tag */
+int object_get_by_md5(const char *md5, xs_dict **obj)
+/* returns a stored object, optionally of the requested type */
 {
-    if (*tag == '#')
-        tag++;
+    int status = 404;
+    xs *fn     = _object_fn_by_md5(md5, "object_get_by_md5");
+    long max   = _obj_cache_max();
+    uint64_t v[3];
+    int where;
+    FILE *f;
 
-    xs *lw_tag = xs_tolower_i(xs_dup(tag));
-    xs *md5    = xs_md5_hex(lw_tag, strlen(lw_tag));
-    xs *idx    = xs_fmt("%s/tag/%c%c/%s.idx", srv_basedir, md5[0], md5[1], md5);
+    *obj = NULL;
 
-    return index_list_desc(idx, skip, show);
-}
+    if ((where = _object_stamp(md5, fn, v, NULL)) == 0)
+        return status;
 
+    if (max > 0) {
+        int hit = _obj_cache_get(&object_cache, md5, v, obj, NULL);
 
-/** lists **/
+        if (p_state != NULL) {
+            if (hit)
+                p_state->obj_cache_hits++;
+            else
+                p_state->obj_cache_misses++;
+        }
 
-xs_val *list_maint(snac *user, const char *list, int op)
-/* list maintenance */
+        if (hit)
+            return 200;
+    }
+
+    if (where == 1) {
+        if ((f = fopen(fn, "r")) != NULL) {
+            *obj = xs_json_load(f);
+            fclose(f);
+        }
+    }
+    else {
+        pack_rec r;
+        xs *data = _pack_read(md5, &r);
+
+        if (data != NULL)
+            *obj = xs_json_loads(data);
+    }
+
+    if (*obj) {
+        status = 200;
+
+        if (max > 0)
+            _obj_cache_put(&object_cache, md5, v, *obj, max);
+    }
+
+    return status;
+}
+
+
+int object_get(const char *id, xs_dict **obj)
+/* returns a stored object, optionally of the requested type */
 {
-    xs_val *l = NULL;
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return object_get_by_md5(md5, obj);
+}
 
-    switch (op) {
-    case 0: /** list of lists **/
-        {
-            FILE *f;
-            xs *spec = xs_fmt("%s/list/" "*.id", user->basedir);
-            xs *ls   = xs_glob(spec, 0, 0);
-            int c = 0;
-            const char *v;
 
-            l = xs_list_new();
+int _object_peek_by_md5(const char *md5, xs_dict **obj, const char *keys[])
+/* returns only some of the top level keys of a stored object,
+   without converting the full object if it's not in the cache */
+{
+    int status = 404;
+    xs *fn     = _object_fn_by_md5(md5, "object_peek_by_md5");
+    uint64_t v[3];
+    int where;
+    FILE *f;
 
-            while (xs_list_next(ls, &v, &c)) {
-                if ((f = fopen(v, "r")) != NULL) {
-                    xs *title = xs_readline(f);
-                    fclose(f);
+    *obj = NULL;
 
-                    title = xs_strip_i(title);
+    if ((where = _object_stamp(md5, fn, v, NULL)) == 0)
+        return status;
 
-                    xs *v2 = xs_replace(v, ".id", "");
-                    xs *l2 = xs_split(v2, "/");
+    if (_obj_cache_max() > 0 && _obj_cache_get(&object_cache, md5, v, obj, keys))
+        return 200;
 
-                    /* return [ list_id, list_title ] */
-                    l = xs_list_append(l, xs_list_append(xs_list_new(), xs_list_get(l2, -1), title));
-                }
-            }
+    if (where == 1) {
+        if ((f = fopen(fn, "r")) != NULL) {
+            *obj = _xs_json_peek(f, keys);
+            fclose(f);
         }
+    }
+    else {
+        pack_rec r;
+        xs *data = _pack_read(md5, &r);
 
-        break;
+        if (data != NULL)
+            *obj = _xs_json_peek_m(data, r.len, keys);
+    }
 
-    case 1: /** create new list (list is the name) **/
-        {
-            xs *lol = list_maint(user, NULL, 0);
-            int c = 0;
-            const xs_list *v;
-            int add = 1;
+    if (*obj)
+        status = 200;
 
-            /* check if this list name already exists */
-            while (xs_list_next(lol, &v, &c)) {
-                if (strcmp(xs_list_get(v, 1), list) == 0) {
-                    add = 0;
-                    break;
-                }
-            }
+    return status;
+}
 
-            if (add) {
-                FILE *f;
-                xs *dir = xs_fmt("%s/list/", user->basedir);
-                xs *id  = xs_fmt("%010x", time(NULL));
 
-                mkdirx(dir);
+int _object_add(const char *id, const xs_dict *obj, int ow)
+/* stores an object */
+{
+    int status = 201; /* Created */
+    xs *md5    = xs_md5_hex(id, strlen(id));
+    xs *fn     = _object_fn_by_md5(md5, "_object_add");
+    int here   = mtime(fn) > 0.0;
+    pack_rec r;
+    FILE *f    = NULL;
 
-                xs *fn = xs_fmt("%s%s.id", dir, id);
+    if (here || _pack_get(md5, &r)) {
+        if (!ow) {
+            /* object already here */
+            srv_debug(1, xs_fmt("object_add object already here %s", id));
+            return 204; /* No content */
+        }
+        else
+            status = 200;
+    }
 
-                if ((f = fopen(fn, "w")) != NULL) {
-                    fprintf(f, "%s\n", list);
-                    fclose(f);
-                }
+    _obj_cache_drop(&object_cache, md5);
 
-                l = xs_stock(XSTYPE_TRUE);
-            }
-            else
-                l = xs_stock(XSTYPE_FALSE);
+    /* objects that have their own file are rewritten in place,
+       so that the hard links to it keep pointing to the new content */
+    if ((!here && _pack_enabled() && _pack_write(md5, obj)) ||
+        (f = fopen(fn, "w")) != NULL) {
+        if (f != NULL) {
+            flock(fileno(f), LOCK_EX);
+
+            xs_json_dump(obj, json_indent(), f);
+            fclose(f);
+
+            /* if it was packed, it's now stale */
+            _pack_del(md5);
         }
 
-        break;
+        search_index(id, obj);
+
+        /* does this object has a parent? */
+        const char *in_reply_to = xs_dict_get(obj, "inReplyTo");
+
+        if (!xs_is_null(in_reply_to) && *in_reply_to) {
+            /* update the children index of the parent */
+            xs *c_idx = _object_fn(in_reply_to);
+
+            c_idx = xs_replace_i(c_idx, ".json", "_c.idx");
+
+            if (!index_in(c_idx, id)) {
+                index_add(c_idx, id);
+                srv_debug(1, xs_fmt("object_add added child %s to %s", id, c_idx));
+            }
+            else
+                srv_debug(1, xs_fmt("object_add %s child already in %s", id, c_idx));
+
+            /* create a one-element index with the parent */
+            xs *p_idx = xs_replace(fn, ".json", "_p.idx");
+
+            if (mtime(p_idx) == 0.0) {
+                index_add(p_idx, in_reply_to);
+                srv_debug(1, xs_fmt("object_add added parent %s to %s", in_reply_to, p_idx));
+            }
+        }
+    }
+    else {
+        srv_log(xs_fmt("object_add error writing %s (errno: %d)", fn, errno));
+        status = 500;
+    }
+
+    srv_debug(1, xs_fmt("object_add %s %s %d", id, fn, status));
+
+    return status;
+}
+
+
+int object_add(const char *id, const xs_dict *obj)
+/* stores an object */
+{
+    return _object_add(id, obj, 0);
+}
+
+
+int object_add_ow(const char *id, const xs_dict *obj)
+/* stores an object (overwriting allowed) */
+{
+    return _object_add(id, obj, 1);
+}
+
+
+int object_del_by_md5(const char *md5)
+/* deletes an object by its md5 */
+{
+    int status = 404;
+    xs *fn     = _object_fn_by_md5(md5, "object_del_by_md5");
+
+    _obj_cache_drop(&object_cache, md5);
+
+    if (_pack_del(md5))
+        status = 200;
+
+    if (unlink(fn) != -1)
+        status = 200;
+
+    if (status == 200) {
+
+        /* also delete associated indexes */
+        xs *spec  = xs_dup(fn);
+        spec      = xs_replace_i(spec, ".json", "*.idx");
+        xs *files = xs_glob(spec, 0, 0);
+        char *p;
+        const char *v;
+
+        p = files;
+        while (xs_list_iter(&p, &v)) {
+            srv_debug(1, xs_fmt("object_del index %s", v));
+            unlink(v);
+        }
+    }
+
+    srv_debug(1, xs_fmt("object_del %s %d", fn, status));
+
+    return status;
+}
+
+
+int object_del(const char *id)
+/* deletes an object */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return object_del_by_md5(md5);
+}
+
+
+int object_del_if_unref(const char *id)
+/* deletes an object if its n_links < 2 */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *fn  = _object_fn_by_md5(md5, "object_del_if_unref");
+    int n_links;
+    int ret = 0;
+    pack_rec r;
+
+    /* packed objects are never linked from anywhere */
+    if ((mtime_nl(fn, &n_links) > 0.0 && n_links < 2) || _pack_get(md5, &r))
+        ret = object_del(id);
+
+    return ret;
+}
+
+
+double object_ctime_by_md5(const char *md5)
+{
+    xs *fn = _object_fn_by_md5(md5, "object_ctime_by_md5");
+    double t = f_ctime(fn);
+    pack_rec r;
+
+    if (t == 0.0 && _pack_get(md5, &r))
+        t = r.ctime;
+
+    return t;
+}
+
+
+double object_ctime(const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return object_ctime_by_md5(md5);
+}
+
+
+double object_mtime_by_md5(const char *md5)
+{
+    xs *fn = _object_fn_by_md5(md5, "object_mtime_by_md5");
+    double t = mtime(fn);
+    pack_rec r;
+
+    if (t == 0.0 && _pack_get(md5, &r))
+        t = r.mtime;
+
+    return t;
+}
+
+
+double object_mtime(const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return object_mtime_by_md5(md5);
+}
+
+
+void object_touch(const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *fn = _object_fn_by_md5(md5, "object_touch");
+
+    _obj_cache_drop(&object_cache, md5);
+
+    if (mtime(fn))
+        utimes(fn, NULL);
+    else
+        _pack_touch(md5);
+}
+
+
+static void _object_unpack(const char *id)
+/* moves a packed object to its own file, as it's going to be hard-linked */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *fn  = _object_fn_by_md5(md5, "_object_unpack");
+
+    if (mtime(fn) == 0.0)
+        _pack_extract(md5, fn);
+}
+
+
+xs_str *_object_index_fn(const char *id, const char *idxsfx)
+/* returns the filename of an object's index */
+{
+    xs_str *fn = _object_fn(id);
+    return xs_replace_i(fn, ".json", idxsfx);
+}
+
+
+int object_likes_len(const char *id)
+/* returns the number of likes (without reading the index) */
+{
+    xs *fn = _object_index_fn(id, "_l.idx");
+    return index_len(fn);
+}
+
+
+int object_announces_len(const char *id)
+/* returns the number of announces (without reading the index) */
+{
+    xs *fn = _object_index_fn(id, "_a.idx");
+    return index_len(fn);
+}
+
+
+xs_list *object_children(const char *id)
+/* returns the list of an object's children */
+{
+    xs *fn = _object_index_fn(id, "_c.idx");
+    return index_list(fn, XS_ALL);
+}
+
+
+xs_list *object_likes(const char *id)
+{
+    xs *fn = _object_index_fn(id, "_l.idx");
+    return index_list(fn, XS_ALL);
+}
+
+
+xs_list *object_announces(const char *id)
+{
+    xs *fn = _object_index_fn(id, "_a.idx");
+    return index_list(fn, XS_ALL);
+}
+
+
+int object_parent(const char *md5, char *buf, int size)
+/* returns the object parent, if any */
+{
+    xs *fn = _object_fn_by_md5(md5, "object_parent");
+
+    fn = xs_replace_i(fn, ".json", "_p.idx");
+    return index_first(fn, buf, size);
+}
+
+
+int object_admire(const char *id, const char *actor, int like)
+/* actor likes or announces this object */
+{
+    int status = 200;
+    xs *fn     = _object_fn(id);
+
+    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+
+    if (!index_in(fn, actor)) {
+        status = index_add(fn, actor);
+
+        srv_debug(1, xs_fmt("object_admire (%s) %s %s", like ? "Like" : "Announce", actor, fn));
+    }
+
+    return status;
+}
+
+
+int object_unadmire(const char *id, const char *actor, int like)
+/* actor no longer likes or announces this object */
+{
+    int status;
+    xs *fn = _object_fn(id);
+
+    fn = xs_replace_i(fn, ".json", like ? "_l.idx" : "_a.idx");
+
+    status = index_del(fn, actor);
+
+    if (valid_status(status))
+        index_gc(fn);
+
+    srv_debug(0,
+        xs_fmt("object_unadmire (%s) %s %s %d", like ? "Like" : "Announce", actor, fn, status));
+
+    return status;
+}
+
+
+int _object_user_cache(snac *snac, const char *id, const char *cachedir, int del)
+/* adds or deletes from a user cache */
+{
+    xs *ofn = _object_fn(id);
+    xs *l   = xs_split(ofn, "/");
+    xs *cfn = xs_fmt("%s/%s/%s", snac->basedir, cachedir, xs_list_get(l, -1));
+    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
+    int ret;
+
+    if (del) {
+        ret = unlink(cfn);
+        index_del(idx, id);
+    }
+    else {
+        _object_unpack(id);
+
+        if ((ret = link(ofn, cfn)) != -1)
+            index_add(idx, id);
+    }
+
+    return ret;
+}
+
+
+int object_user_cache_add(snac *snac, const char *id, const char *cachedir)
+/* caches an object into a user cache */
+{
+    return _object_user_cache(snac, id, cachedir, 0);
+}
+
+
+int object_user_cache_del(snac *snac, const char *id, const char *cachedir)
+/* deletes an object from a user cache */
+{
+    return _object_user_cache(snac, id, cachedir, 1);
+}
+
+
+int object_user_cache_in(snac *snac, const char *id, const char *cachedir)
+/* checks if an object is stored in a cache */
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *cfn = xs_fmt("%s/%s/%s.json", snac->basedir, cachedir, md5);
+
+    return !!(mtime(cfn) != 0.0);
+}
+
+
+xs_list *object_user_cache_list(snac *snac, const char *cachedir, int max, int inv)
+/* returns the objects in a cache as a list */
+{
+    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, cachedir);
+    return inv ? index_list_desc(idx, 0, max) : index_list(idx, max);
+}
+
+
+/** specialized functions **/
+
+/** relations index **/
+
+/* The server keeps in memory, for every actor, the local users that
+   follow it or are followed by it, so the recipients of a message
+   received in the shared inbox can be found without opening all the
+   users. Other processes (like the command line) touch the
+   user/.relations file after changing a relation, and the background
+   thread rebuilds the index when it sees it changed (or every while);
+   the new index is built without holding the mutex, and the changes
+   made by this process meanwhile are applied to it before using it. */
+
+#define REL_FOLLOWER  1     /* the actor is in the user's followers */
+#define REL_FOLLOWING 2     /* the actor is in the user's following */
+
+typedef struct rel_entry {
+    struct rel_entry *next;
+    unsigned char md5[BIDX_MD5_SIZE];   /* raw md5 of the actor */
+    xs_str *uid;
+    int rel;                /* REL_* bits */
+} rel_entry;
+
+#define REL_BUCKETS 16384
+#define REL_RELOAD (10 * 60)
+
+typedef struct {
+    rel_entry *b[REL_BUCKETS];
+    int n;                  /* number of entries */
+} rel_table;
+
+static struct {
+    pthread_mutex_t mutex;
+    int on;                 /* the index is being used */
+    rel_table *t;           /* the index */
+    xs_list *pending;       /* changes made while rebuilding it (NULL: not rebuilding) */
+    double stamp;           /* mtime of user/.relations when loaded */
+    time_t loaded;          /* time of the last load */
+} relations = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+static double _rel_stamp(void)
+/* returns the mtime of the relations change stamp file */
+{
+    xs *fn = xs_fmt("%s/user/.relations", srv_basedir);
+    struct stat st;
+
+    if (stat(fn, &st) == -1)
+        return 0.0;
+
+    return (double) st.st_mtim.tv_sec + (double) st.st_mtim.tv_nsec / 1000000000.0;
+}
+
+
+static rel_entry **_rel_bucket(rel_table *t, const unsigned char *raw)
+/* returns the bucket of an actor md5 */
+{
+    unsigned int i;
+
+    memcpy(&i, raw, sizeof(i));
+
+    return &t->b[i % REL_BUCKETS];
+}
+
+
+static void _rel_set(rel_table *t, const char *md5, const char *uid, int rel, int on)
+/* sets or clears a relation between an actor md5 and a user */
+{
+    unsigned char raw[BIDX_MD5_SIZE];
+
+    if (!_bidx_md5_raw(md5, raw))
+        return;
+
+    rel_entry **pe = _rel_bucket(t, raw);
+
+    while (*pe != NULL && (memcmp((*pe)->md5, raw, BIDX_MD5_SIZE) != 0 || strcmp((*pe)->uid, uid) != 0))
+        pe = &(*pe)->next;
+
+    if (on) {
+        if (*pe == NULL) {
+            int paused = xs_arena_pause();
+
+            *pe = xs_realloc(NULL, sizeof(rel_entry));
+            **pe = (rel_entry){ .uid = xs_dup(uid) };
+            memcpy((*pe)->md5, raw, BIDX_MD5_SIZE);
+            t->n++;
+
+            xs_arena_resume(paused);
+        }
+
+        (*pe)->rel |= rel;
+    }
+    else
+    if (*pe != NULL) {
+        (*pe)->rel &= ~rel;
+
+        if ((*pe)->rel == 0) {
+            rel_entry *e = *pe;
+            *pe = e->next;
+
+            xs_free(e->uid);
+            xs_free(e);
+            t->n--;
+        }
+    }
+}
+
+
+static void _rel_free(rel_table *t)
+/* frees a relations table */
+{
+    int n;
+
+    if (t == NULL)
+        return;
+
+    for (n = 0; n < REL_BUCKETS; n++) {
+        while (t->b[n] != NULL) {
+            rel_entry *e = t->b[n];
+            t->b[n] = e->next;
+
+            xs_free(e->uid);
+            xs_free(e);
+        }
+    }
+
+    xs_free(t);
+}
+
+
+static rel_table *_rel_build(void)
+/* builds a relations table from disk */
+{
+    int paused = xs_arena_pause();
+    rel_table *t = xs_realloc(NULL, sizeof(rel_table));
+    xs_arena_resume(paused);
+
+    memset(t, '\0', sizeof(rel_table));
+
+    xs *users = user_list();
+    xs_list *p = users;
+    const char *uid;
+
+    while (xs_list_iter(&p, &uid)) {
+        xs *s1 = xs_fmt("%s/user/%s/followers/" "*.json", srv_basedir, uid);
+        xs *l1 = xs_glob(s1, 1, 0);
+        xs_list *q = l1;
+        const char *v;
+
+        while (xs_list_iter(&q, &v)) {
+            xs *md5 = xs_replace(v, ".json", "");
+            _rel_set(t, md5, uid, REL_FOLLOWER, 1);
+        }
+
+        xs *s2 = xs_fmt("%s/user/%s/following/" "*.json", srv_basedir, uid);
+        xs *l2 = xs_glob(s2, 1, 0);
+
+        /* the _a.json files are links to the actors; they are skipped
+           because their names are not a valid md5 */
+        q = l2;
+        while (xs_list_iter(&q, &v)) {
+            xs *md5 = xs_replace(v, ".json", "");
+            _rel_set(t, md5, uid, REL_FOLLOWING, 1);
+        }
+    }
+
+    return t;
+}
+
+
+static void _rel_reload(void)
+/* rebuilds the relations index from disk and starts using it */
+{
+    time_t t = time(NULL);
+    double stamp = _rel_stamp();
+
+    pthread_mutex_lock(&relations.mutex);
+
+    int paused = xs_arena_pause();
+    relations.pending = xs_list_new();
+    xs_arena_resume(paused);
+
+    pthread_mutex_unlock(&relations.mutex);
+
+    rel_table *nt = _rel_build();
+    rel_table *ot;
+
+    pthread_mutex_lock(&relations.mutex);
+
+    /* apply the changes made while building it */
+    const xs_list *c;
+    int ct = 0;
+
+    while (xs_list_next(relations.pending, &c, &ct)) {
+        _rel_set(nt, xs_list_get(c, 0), xs_list_get(c, 1),
+            xs_number_get(xs_list_get(c, 2)), xs_number_get(xs_list_get(c, 3)));
+    }
+
+    relations.pending = xs_free(relations.pending);
+
+    ot = relations.t;
+    relations.t      = nt;
+    relations.on     = 1;
+    relations.stamp  = stamp;
+    relations.loaded = t;
+
+    pthread_mutex_unlock(&relations.mutex);
+
+    _rel_free(ot);
+
+    srv_debug(1, xs_fmt("relations index loaded (%d entries)", nt->n));
+}
+
+
+void relations_start(void)
+/* starts using the in-memory relations index (server only) */
+{
+    _rel_reload();
+}
+
+
+void relations_check(void)
+/* rebuilds the relations index if it was changed from outside,
+   or it's time to (called from the background thread) */
+{
+    double stamp = _rel_stamp();
+    int due;
+
+    pthread_mutex_lock(&relations.mutex);
+
+    due = relations.on &&
+        (time(NULL) - relations.loaded >= REL_RELOAD || stamp != relations.stamp);
+
+    pthread_mutex_unlock(&relations.mutex);
+
+    if (due)
+        _rel_reload();
+}
+
+
+static void _rel_changed(snac *snac, const char *actor, int rel, int on)
+/* notifies that a relation has changed */
+{
+    pthread_mutex_lock(&relations.mutex);
+
+    if (relations.on) {
+        xs *md5 = xs_md5_hex(actor, strlen(actor));
+        _rel_set(relations.t, md5, snac->uid, rel, on);
+
+        if (relations.pending != NULL) {
+            /* being rebuilt: also keep it to be applied to the new one */
+            int paused = xs_arena_pause();
+            xs *n1 = xs_number_new(rel);
+            xs *n2 = xs_number_new(on);
+            xs *c  = xs_list_new();
+
+            c = xs_list_append(c, md5, snac->uid, n1, n2);
+            relations.pending = xs_list_append(relations.pending, c);
+
+            xs_arena_resume(paused);
+        }
+    }
+    else {
+        /* tell the server */
+        xs *sfn = xs_fmt("%s/user/.relations", srv_basedir);
+        FILE *f;
+
+        if ((f = fopen(sfn, "w")) != NULL)
+            fclose(f);
+    }
+
+    pthread_mutex_unlock(&relations.mutex);
+}
+
+
+xs_list *relation_users(const char *actor, const char *cachedir)
+/* returns the list of users that have actor in their "followers"
+   or "following" cachedir, or NULL if the index is not available */
+{
+    int rel = strcmp(cachedir, "followers") == 0 ? REL_FOLLOWER : REL_FOLLOWING;
+    xs *md5 = xs_md5_hex(actor, strlen(actor));
+    unsigned char raw[BIDX_MD5_SIZE];
+    xs_list *list = NULL;
+    rel_entry *e;
+
+    _bidx_md5_raw(md5, raw);
+
+    pthread_mutex_lock(&relations.mutex);
+
+    if (relations.on) {
+        list = xs_list_new();
+
+        for (e = *_rel_bucket(relations.t, raw); e != NULL; e = e->next) {
+            if ((e->rel & rel) && memcmp(e->md5, raw, BIDX_MD5_SIZE) == 0)
+                list = xs_list_append(list, e->uid);
+        }
+    }
+
+    pthread_mutex_unlock(&relations.mutex);
+
+    return list;
+}
+
+
+/** recently seen activities **/
+
+/* The ids of the activities recently processed by each user are
+   kept in memory for a while, so the copies of the same activity
+   received by different inboxes (like the shared one and the
+   user's) are only processed once. */
+
+#define SEEN_SLOTS 65536
+#define SEEN_BUCKETS 16384
+#define SEEN_TTL (10 * 60)
+
+typedef struct {
+    unsigned char md5[BIDX_MD5_SIZE];   /* raw md5 of uid + activity id */
+    time_t t;               /* when it was seen */
+    int next;               /* next in the bucket chain (slot + 1, 0 for none) */
+} seen_entry;
+
+static struct {
+    pthread_mutex_t mutex;
+    seen_entry *e;          /* ring of SEEN_SLOTS entries */
+    int head;               /* next slot to be reused */
+    int b[SEEN_BUCKETS];    /* bucket chains (slot + 1, 0 for none) */
+} seen = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+static void _seen_key(const char *uid, const char *id, unsigned char *raw)
+/* computes the key of an activity for a user */
+{
+    xs *s   = xs_fmt("%s %s", uid, id);
+    xs *md5 = xs_md5_hex(s, strlen(s));
+
+    _bidx_md5_raw(md5, raw);
+}
+
+
+static int *_seen_bucket(const unsigned char *raw)
+/* returns the bucket of a key */
+{
+    unsigned int i;
+
+    memcpy(&i, raw, sizeof(i));
+
+    return &seen.b[i % SEEN_BUCKETS];
+}
+
+
+int activity_seen(const char *uid, const char *id)
+/* checks if an activity has been recently processed by a user */
+{
+    unsigned char raw[BIDX_MD5_SIZE];
+    time_t t = time(NULL);
+    int ret = 0;
+    int s;
+
+    if (xs_type(id) != XSTYPE_STRING)
+        return 0;
+
+    _seen_key(uid, id, raw);
+
+    pthread_mutex_lock(&seen.mutex);
+
+    if (seen.e != NULL) {
+        for (s = *_seen_bucket(raw); s != 0; s = seen.e[s - 1].next) {
+            if (memcmp(seen.e[s - 1].md5, raw, BIDX_MD5_SIZE) == 0) {
+                ret = t - seen.e[s - 1].t < SEEN_TTL;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&seen.mutex);
+
+    return ret;
+}
+
+
+void activity_seen_add(const char *uid, const char *id)
+/* marks an activity as processed by a user */
+{
+    unsigned char raw[BIDX_MD5_SIZE];
+
+    if (xs_type(id) != XSTYPE_STRING)
+        return;
+
+    _seen_key(uid, id, raw);
+
+    pthread_mutex_lock(&seen.mutex);
+
+    if (seen.e == NULL) {
+        int paused = xs_arena_pause();
+
+        seen.e = xs_realloc(NULL, SEEN_SLOTS * sizeof(seen_entry));
+        memset(seen.e, '\0', SEEN_SLOTS * sizeof(seen_entry));
+
+        xs_arena_resume(paused);
+    }
+    else {
+        /* unlink the oldest entry from its chain, if it's in use */
+        seen_entry *o = &seen.e[seen.head];
+
+        if (o->t != 0) {
+            int *ps = _seen_bucket(o->md5);
+
+            while (*ps != seen.head + 1)
+                ps = &seen.e[*ps - 1].next;
+
+            *ps = o->next;
+        }
+    }
+
+    seen_entry *e = &seen.e[seen.head];
+    int *pb = _seen_bucket(raw);
+
+    memcpy(e->md5, raw, BIDX_MD5_SIZE);
+    e->t    = time(NULL);
+    e->next = *pb;
+    *pb     = seen.head + 1;
+
+    seen.head = (seen.head + 1) % SEEN_SLOTS;
+
+    pthread_mutex_unlock(&seen.mutex);
+}
+
+
+/** followers **/
+
+int follower_add(snac *snac, const char *actor)
+/* adds a follower */
+{
+    int ret = object_user_cache_add(snac, actor, "followers");
+
+    if (ret != -1)
+        _rel_changed(snac, actor, REL_FOLLOWER, 1);
+
+    snac_debug(snac, 2, xs_fmt("follower_add %s", actor));
+
+    return ret == -1 ? 500 : 200;
+}
+
+
+int follower_del(snac *snac, const char *actor)
+/* deletes a follower */
+{
+    int ret = object_user_cache_del(snac, actor, "followers");
+
+    if (ret != -1)
+        _rel_changed(snac, actor, REL_FOLLOWER, 0);
+
+    snac_debug(snac, 2, xs_fmt("follower_del %s", actor));
+
+    return ret == -1 ? 404 : 200;
+}
+
+
+int follower_check(snac *snac, const char *actor)
+/* checks if someone is a follower */
+{
+    return object_user_cache_in(snac, actor, "followers");
+}
+
+
+xs_list *follower_list(snac *snac)
+/* returns the list of followers */
+{
+    xs *list       = object_user_cache_list(snac, "followers", XS_ALL, 0);
+    xs_list *fwers = xs_list_new();
+    char *p;
+    const char *v;
+
+    /* resolve the list of md5 to be a list of actors */
+    p = list;
+    while (xs_list_iter(&p, &v)) {
+        xs *a_obj = NULL;
+
+        if (valid_status(object_peek_by_md5(v, &a_obj, "id"))) {
+            const char *actor = xs_dict_get(a_obj, "id");
+
+            if (!xs_is_null(actor)) {
+                /* check if the actor is still cached */
+                xs *fn = xs_fmt("%s/followers/%s.json", snac->basedir, v);
+
+                if (mtime(fn) > 0.0)
+                    fwers = xs_list_append(fwers, actor);
+            }
+        }
+    }
+
+    return fwers;
+}
+
+
+/** timeline **/
+
+double timeline_mtime(snac *snac)
+{
+    xs *fn = xs_fmt("%s/private.idx", snac->basedir);
+    return mtime(fn);
+}
+
+
+int timeline_touch(snac *snac)
+/* changes the date of the timeline index */
+{
+    xs *fn = xs_fmt("%s/private.idx", snac->basedir);
+    return utimes(fn, NULL);
+}
+
+
+xs_str *timeline_fn_by_md5(snac *snac, const char *md5)
+/* get the filename of an entry by md5 from any timeline */
+{
+    xs_str *fn = NULL;
+
+    if (xs_is_hex(md5) && strlen(md5) == 32) {
+        fn = xs_fmt("%s/private/%s.json", snac->basedir, md5);
+
+        if (mtime(fn) == 0.0) {
+            fn = xs_free(fn);
+            fn = xs_fmt("%s/public/%s.json", snac->basedir, md5);
+
+            if (mtime(fn) == 0.0)
+                fn = xs_free(fn);
+        }
+    }
+
+    return fn;
+}
+
+
+int timeline_here(snac *snac, const char *md5)
+/* checks if an object is in the user cache */
+{
+    xs *fn = timeline_fn_by_md5(snac, md5);
+
+    return !(fn == NULL);
+}
+
+
+int timeline_get_by_md5(snac *snac, const char *md5, xs_dict **msg)
+/* gets a message from the timeline */
+{
+    int status = 404;
+    FILE *f    = NULL;
+
+    xs *fn = timeline_fn_by_md5(snac, md5);
+
+    if (fn == NULL)
+        return status;
+
+    /* the timeline entries are hard links to the object files,
+       so they are probably in the object cache */
+    if (valid_status(object_get_by_md5(md5, msg)))
+        return 200;
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        *msg = xs_json_load(f);
+        fclose(f);
+
+        if (*msg != NULL)
+            status = 200;
+    }
+
+    return status;
+}
+
+
+int timeline_del(snac *snac, const char *id)
+/* deletes a message from the timeline */
+{
+    /* delete from the user's caches */
+    object_user_cache_del(snac, id, "public");
+    object_user_cache_del(snac, id, "private");
+
+    /* try to delete the object if it's not used elsewhere */
+    return object_del_if_unref(id);
+}
+
+
+void timeline_update_indexes(snac *snac, const char *id)
+/* updates the indexes */
+{
+    object_user_cache_add(snac, id, "private");
+
+    if (xs_startswith(id, snac->actor)) {
+        xs *msg = NULL;
+
+        if (valid_status(object_get(id, &msg))) {
+            /* if its ours and is public, also store in public */
+            if (is_msg_public(msg)) {
+                object_user_cache_add(snac, id, "public");
+
+                /* also add it to the instance public timeline */
+                xs *ipt = xs_fmt("%s/public.idx", srv_basedir);
+                index_add(ipt, id);
+            }
+        }
+    }
+}
+
+
+int timeline_add(snac *snac, const char *id, const xs_dict *o_msg)
+/* adds a message to the timeline */
+{
+    int ret = object_add(id, o_msg);
+    timeline_update_indexes(snac, id);
+
+    tag_index(id, o_msg);
+
+    list_distribute(snac, NULL, o_msg);
+
+    snac_debug(snac, 1, xs_fmt("timeline_add %s", id));
+
+    return ret;
+}
+
+
+int timeline_admire(snac *snac, const char *id, const char *admirer, int like)
+/* updates a timeline entry with a new admiration */
+{
+    /* if we are admiring this, add to both timelines */
+    if (!like && strcmp(admirer, snac->actor) == 0) {
+        object_user_cache_add(snac, id, "public");
+        object_user_cache_add(snac, id, "private");
+    }
+
+    int ret = object_admire(id, admirer, like);
+
+    snac_debug(snac, 1, xs_fmt("timeline_admire (%s) %s %s",
+            like ? "Like" : "Announce", id, admirer));
+
+    return ret;
+}
+
+
+xs_list *timeline_top_level(snac *snac, const xs_list *list)
+/* returns the top level md5 entries from this index */
+{
+    xs_set seen;
+    const xs_str *v;
+
+    xs_set_init(&seen);
+
+    int c = 0;
+    while (xs_list_next(list, &v, &c)) {
+        char line[256] = "";
+
+        strncpy(line, v, sizeof(line));
+
+        for (;;) {
+            char line2[256];
+
+            /* if it doesn't have a parent, use this */
+            if (!object_parent(line, line2, sizeof(line2)))
+                break;
+
+            /* well, there is a parent... but is it here? */
+            if (!timeline_here(snac, line2))
+                break;
+
+            /* it's here! try again with its own parent */
+            strncpy(line, line2, sizeof(line));
+        }
+
+        xs_set_add(&seen, line);
+    }
+
+    return xs_set_result(&seen);
+}
+
+
+xs_list *timeline_simple_list(snac *snac, const char *idx_name, int skip, int show)
+/* returns a timeline (with all entries) */
+{
+    xs *idx = xs_fmt("%s/%s.idx", snac->basedir, idx_name);
+
+    return index_list_desc(idx, skip, show);
+}
+
+
+xs_list *timeline_list(snac *snac, const char *idx_name, int skip, int show)
+/* returns a timeline (only top level entries) */
+{
+    int c_max;
+
+    /* maximum number of items in the timeline */
+    c_max = xs_number_get(xs_dict_get(srv_config, "max_timeline_entries"));
+
+    /* never more timeline entries than the configured maximum */
+    if (show > c_max)
+        show = c_max;
+
+    xs *list = timeline_simple_list(snac, idx_name, skip, show);
+
+    return timeline_top_level(snac, list);
+}
+
+
+xs_list *timeline_instance_list(int skip, int show)
+/* returns the timeline for the full instance */
+{
+    xs *idx = xs_fmt("%s/public.idx", srv_basedir);
+
+    return index_list_desc(idx, skip, show);
+}
+
+
+/** following **/
+
+/* this needs special treatment and cannot use the object db as is,
+   with a link to a cached author, because we need the Follow object
+   in case we need to unfollow (Undo + original Follow) */
+
+xs_str *_following_fn(snac *snac, const char *actor)
+{
+    xs *md5 = xs_md5_hex(actor, strlen(actor));
+    return xs_fmt("%s/following/%s.json", snac->basedir, md5);
+}
+
+
+int following_add(snac *snac, const char *actor, const xs_dict *msg)
+/* adds to the following list */
+{
+    int ret = 201; /* created */
+    xs *fn = _following_fn(snac, actor);
+    FILE *f;
+    xs *p_object = NULL;
+
+    if (valid_status(following_get(snac, actor, &p_object))) {
+        /* object already exists; if it's of type Accept,
+           the actor is already being followed and confirmed,
+           so do nothing */
+        const char *type = xs_dict_get(p_object, "type");
+
+        if (!xs_is_null(type) && strcmp(type, "Accept") == 0) {
+            snac_debug(snac, 1, xs_fmt("following_add actor already confirmed %s", actor));
+            return 200;
+        }
+    }
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        xs_json_dump(msg, json_indent(), f);
+        fclose(f);
+
+        /* get the filename of the actor object */
+        _object_unpack(actor);
+        xs *actor_fn = _object_fn(actor);
+
+        /* increase its reference count */
+        fn = xs_replace_i(fn, ".json", "_a.json");
+        link(actor_fn, fn);
+
+        _rel_changed(snac, actor, REL_FOLLOWING, 1);
+    }
+    else
+        ret = 500;
+
+    snac_debug(snac, 2, xs_fmt("following_add %s %s", actor, fn));
+
+    return ret;
+}
+
+
+int following_del(snac *snac, const char *actor)
+/* we're not following this actor any longer */
+{
+    xs *fn = _following_fn(snac, actor);
+
+    snac_debug(snac, 2, xs_fmt("following_del %s %s", actor, fn));
+
+    unlink(fn);
+
+    /* also delete the reference to the author */
+    fn = xs_replace_i(fn, ".json", "_a.json");
+    unlink(fn);
+
+    _rel_changed(snac, actor, REL_FOLLOWING, 0);
+
+    return 200;
+}
+
+
+int following_check(snac *snac, const char *actor)
+/* checks if we are following this actor */
+{
+    xs *fn = _following_fn(snac, actor);
+
+    return !!(mtime(fn) != 0.0);
+}
+
+
+int following_get(snac *snac, const char *actor, xs_dict **data)
+/* returns the 'Follow' object */
+{
+    xs *fn = _following_fn(snac, actor);
+    FILE *f;
+    int status = 200;
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        *data = xs_json_load(f);
+        fclose(f);
+    }
+    else
+        status = 404;
+
+    return status;
+}
+
+
+xs_list *following_list(snac *snac)
+/* returns the list of people being followed */
+{
+    xs *spec = xs_fmt("%s/following/" "*.json", snac->basedir);
+    xs *glist = xs_glob(spec, 0, 0);
+    xs_list *p;
+    const xs_str *v;
+    xs_list *list = xs_list_new();
+
+    /* iterate the list of files */
+    p = glist;
+    while (xs_list_iter(&p, &v)) {
+        FILE *f;
+
+        /* load the follower data */
+        if ((f = fopen(v, "r")) != NULL) {
+            xs *o = xs_json_load(f);
+            fclose(f);
+
+            if (o != NULL) {
+                const char *type = xs_dict_get(o, "type");
+
+                if (!xs_is_null(type) && strcmp(type, "Accept") == 0) {
+                    const char *actor = xs_dict_get(o, "actor");
+
+                    if (!xs_is_null(actor)) {
+                        list = xs_list_append(list, actor);
+
+                        /* check if there is a link to the actor object */
+                        xs *v2 = xs_replace(v, ".json", "_a.json");
+
+                        if (mtime(v2) == 0.0) {
+                            /* no; add a link to it */
+                            _object_unpack(actor);
+                            xs *actor_fn = _object_fn(actor);
+                            link(actor_fn, v2);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return list;
+}
+
+
+xs_str *_muted_fn(snac *snac, const char *actor)
+{
+    xs *md5 = xs_md5_hex(actor, strlen(actor));
+    return xs_fmt("%s/muted/%s", snac->basedir, md5);
+}
+
+
+void mute(snac *snac, const char *actor)
+/* mutes a moron */
+{
+    xs *fn = _muted_fn(snac, actor);
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%s\n", actor);
+        fclose(f);
+
+        snac_debug(snac, 2, xs_fmt("muted %s %s", actor, fn));
+    }
+}
+
+
+void unmute(snac *snac, const char *actor)
+/* actor is no longer a moron */
+{
+    xs *fn = _muted_fn(snac, actor);
+
+    unlink(fn);
+
+    snac_debug(snac, 2, xs_fmt("unmuted %s %s", actor, fn));
+}
+
+
+int is_muted(snac *snac, const char *actor)
+/* check if someone is muted */
+{
+    xs *fn = _muted_fn(snac, actor);
+
+    return !!(mtime(fn) != 0.0);
+}
+
+
+/** pinning **/
+
+xs_str *_pinned_fn(snac *user, const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return xs_fmt("%s/pinned/%s.json", user->basedir, md5);
+}
+
+
+int is_pinned(snac *user, const char *id)
+/* returns true if this note is pinned */
+{
+    xs *fn = _pinned_fn(user, id);
+    return !!(mtime(fn) != 0.0);
+}
+
+
+int is_pinned_by_md5(snac *user, const char *md5)
+{
+    xs *fn = xs_fmt("%s/pinned/%s.json", user->basedir, md5);
+    return !!(mtime(fn) != 0.0);
+}
+
+
+int pin(snac *user, const char *id)
+/* pins a message */
+{
+    int ret = -2;
+
+    if (xs_startswith(id, user->actor)) {
+        if (is_pinned(user, id))
+            ret = -3;
+        else {
+            /* create the subfolder, if it does not exist */
+            xs *fn = xs_fmt("%s/pinned/", user->basedir);
+            mkdirx(fn);
+
+            ret = object_user_cache_add(user, id, "pinned");
+        }
+    }
+
+    return ret;
+}
+
+
+int unpin(snac *user, const char *id)
+/* unpin a message */
+{
+    int ret = object_user_cache_del(user, id, "pinned");
+
+    if (ret != -1) {
+        /* delete from the index */
+        xs *idx = xs_fmt("%s/pinned.idx", user->basedir);
+        index_del(idx, id);
+    }
+
+    return ret;
+}
+
+
+xs_list *pinned_list(snac *user)
+/* return the lists of pinned posts */
+{
+    return object_user_cache_list(user, "pinned", XS_ALL, 1);
+}
+
+
+xs_str *_hidden_fn(snac *snac, const char *id)
+{
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    return xs_fmt("%s/hidden/%s", snac->basedir, md5);
+}
+
+
+void hide(snac *snac, const char *id)
+/* hides a message tree */
+{
+    xs *fn = _hidden_fn(snac, id);
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%s\n", id);
+        fclose(f);
+
+        snac_debug(snac, 2, xs_fmt("hidden %s %s", id, fn));
+
+        /* hide all the children */
+        xs *chld = object_children(id);
+        char *p;
+        const char *v;
+
+        p = chld;
+        while (xs_list_iter(&p, &v)) {
+            xs *co = NULL;
+
+            /* resolve to get the id */
+            if (valid_status(object_get_by_md5(v, &co))) {
+                const char *id = xs_dict_get(co, "id");
+                if (id != NULL)
+                    hide(snac, id);
+            }
+        }
+    }
+}
+
+
+int is_hidden(snac *snac, const char *id)
+/* check is id is hidden */
+{
+    xs *fn = _hidden_fn(snac, id);
+
+    return !!(mtime(fn) != 0.0);
+}
+
+
+/** actor summaries **/
+
+/* Compact versions of the actor objects, with only what's needed to
+   deliver messages to them, verify their signatures and show them in
+   timelines. They are stored in actor/ and kept in memory, along with
+   the validator of the actor object they were built from. */
+
+#ifndef ACTOR_CACHE_SIZE
+#define ACTOR_CACHE_SIZE (8 * 1024 * 1024)
+#endif
+
+/* maximum time for the actor data to be considered stale */
+#define ACTOR_MAX_TIME (3600.0 * 36.0)
+
+static obj_cache actor_cache = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+
+static xs_str *_actor_summary_fn(const char *md5)
+{
+    xs *dir = xs_fmt("%s/actor/%c%c", srv_basedir, md5[0], md5[1]);
+
+    mkdirx(dir);
+
+    return xs_fmt("%s/%s.json", dir, md5);
+}
+
+
+static xs_str *_actor_summary_stamp(const uint64_t v[3])
+/* returns the validator as a string */
+{
+    return xs_fmt("%016llx%016llx%016llx",
+        (unsigned long long)v[0], (unsigned long long)v[1], (unsigned long long)v[2]);
+}
+
+
+static xs_dict *_actor_summary_new(const xs_dict *actor)
+/* builds the summary of an actor */
+{
+    const char *keys[] = { "id", "type", "name", "preferredUsername", "inbox", NULL };
+    xs_dict *s = xs_dict_new();
+    const xs_val *v;
+    int n;
+
+    for (n = 0; keys[n]; n++) {
+        if ((v = xs_dict_get(actor, keys[n])) != NULL)
+            s = xs_dict_append(s, keys[n], v);
+    }
+
+    if (xs_type(v = xs_dict_get(actor, "endpoints")) == XSTYPE_DICT &&
+        xs_type(v = xs_dict_get(v, "sharedInbox")) == XSTYPE_STRING) {
+        xs *d = xs_dict_new();
+        d = xs_dict_append(d, "sharedInbox", v);
+        s = xs_dict_append(s, "endpoints", d);
+    }
+
+    if ((v = xs_dict_get(actor, "icon")) != NULL) {
+        /* if it's a list (Peertube), get the first one */
+        if (xs_type(v) == XSTYPE_LIST)
+            v = xs_list_get(v, 0);
+
+        if (xs_type(v) == XSTYPE_DICT && xs_type(v = xs_dict_get(v, "url")) == XSTYPE_STRING) {
+            xs *d = xs_dict_new();
+            d = xs_dict_append(d, "url", v);
+            s = xs_dict_append(s, "icon", d);
+        }
+    }
+
+    if (xs_type(v = xs_dict_get(actor, "publicKey")) == XSTYPE_DICT) {
+        const char *id  = xs_dict_get(v, "id");
+        const char *pem = xs_dict_get(v, "publicKeyPem");
+
+        if (xs_type(pem) == XSTYPE_STRING) {
+            xs *d = xs_dict_new();
+
+            if (xs_type(id) == XSTYPE_STRING)
+                d = xs_dict_append(d, "id", id);
+
+            d = xs_dict_append(d, "publicKeyPem", pem);
+            s = xs_dict_append(s, "publicKey", d);
+        }
+    }
+
+    if (xs_type(v = xs_dict_get(actor, "tag")) == XSTYPE_LIST) {
+        /* only the emojis, that can be used in the name */
+        xs *l = xs_list_new();
+        xs_list *p = (xs_list *)v;
+        const xs_dict *t;
+
+        while (xs_list_iter(&p, &t)) {
+            if (xs_type(t) == XSTYPE_DICT && xs_type(xs_dict_get(t, "type")) == XSTYPE_STRING &&
+                strcmp(xs_dict_get(t, "type"), "Emoji") == 0)
+                l = xs_list_append(l, t);
+        }
+
+        if (xs_list_len(l))
+            s = xs_dict_append(s, "tag", l);
+    }
+
+    return s;
+}
+
+
+static void _actor_summary_store(const char *md5, const uint64_t v[3], const xs_dict *sum)
+/* stores the summary of an actor */
+{
+    xs *fn    = _actor_summary_fn(md5);
+    xs *tfn   = xs_fmt("%s.tmp", fn);
+    xs *stamp = _actor_summary_stamp(v);
+    xs *d     = xs_dict_new();
+    FILE *f;
+
+    d = xs_dict_append(d, "stamp", stamp);
+    d = xs_dict_append(d, "actor", sum);
+
+    data_lock(fn);
+
+    if ((f = fopen(tfn, "w")) != NULL) {
+        xs_json_dump(d, json_indent(), f);
+        fclose(f);
+
+        rename(tfn, fn);
+    }
+
+    data_unlock(fn);
+
+    _obj_cache_put(&actor_cache, md5, v, sum, ACTOR_CACHE_SIZE);
+}
+
+
+int actor_summary_get(const char *actor, xs_dict **data)
+/* returns the summary of an already downloaded actor */
+{
+    /* local users are built on the fly */
+    if (xs_startswith(actor, srv_baseurl))
+        return actor_get(actor, data);
+
+    xs *md5 = xs_md5_hex(actor, strlen(actor));
+    xs *ofn = _object_fn_by_md5(md5, "actor_summary_get");
+    xs_dict *s = NULL;
+    uint64_t v[3];
+    double mt;
+
+    if (!_object_stamp(md5, ofn, v, &mt))
+        return 404;
+
+    if (!_obj_cache_get(&actor_cache, md5, v, &s, NULL)) {
+        xs *fn = _actor_summary_fn(md5);
+        FILE *f;
+
+        if ((f = fopen(fn, "r")) != NULL) {
+            xs *d = xs_json_load(f);
+            fclose(f);
+
+            xs *stamp = _actor_summary_stamp(v);
+            const char *st = xs_dict_get(d, "stamp");
+            const xs_dict *a = xs_dict_get(d, "actor");
+
+            /* still valid? */
+            if (xs_type(st) == XSTYPE_STRING && strcmp(st, stamp) == 0 &&
+                xs_type(a) == XSTYPE_DICT) {
+                s = xs_dup(a);
+                _obj_cache_put(&actor_cache, md5, v, s, ACTOR_CACHE_SIZE);
+            }
+        }
+
+        if (s == NULL) {
+            /* build it from the actor object */
+            xs *a = NULL;
+            int status;
+
+            if (!valid_status(status = actor_get(actor, &a)))
+                return status;
+
+            s = _actor_summary_new(a);
+            _actor_summary_store(md5, v, s);
+        }
+    }
+
+    if (data)
+        *data = s;
+    else
+        s = xs_free(s);
+
+    if (mt + ACTOR_MAX_TIME < (double) time(NULL))
+        return 205; /* stale */
+
+    return 200;
+}
+
+
+int actor_summary_get_refresh(snac *user, const char *actor, xs_dict **data)
+/* gets an actor summary and requests a refresh if it's stale */
+{
+    int status = actor_summary_get(actor, data);
+
+    if (status == 205 && user && !xs_startswith(actor, srv_baseurl))
+        enqueue_actor_refresh(user, actor, 0);
+
+    return status;
+}
+
+
+/** actors **/
+
+int actor_add(const char *actor, const xs_dict *msg)
+/* adds an actor */
+{
+    int status = object_add_ow(actor, msg);
+
+    if (valid_status(status)) {
+        /* renew its summary */
+        xs *md5 = xs_md5_hex(actor, strlen(actor));
+        xs *fn  = _object_fn_by_md5(md5, "actor_add");
+        uint64_t v[3];
+
+        if (_object_stamp(md5, fn, v, NULL)) {
+            xs *sum = _actor_summary_new(msg);
+            _actor_summary_store(md5, v, sum);
+        }
+    }
+
+    return status;
+}
+
+
+int actor_get(const char *actor, xs_dict **data)
+/* returns an already downloaded actor */
+{
+    int status = 200;
+    xs_dict *d = NULL;
+
+    if (xs_startswith(actor, srv_baseurl)) {
+        /* it's a (possible) local user */
+        xs *l = xs_split(actor, "/");
+        const char *uid = xs_list_get(l, -1);
+        snac user;
+
+        if (!xs_is_null(uid) && user_open(&user, uid)) {
+            if (data)
+                *data = msg_actor(&user);
+
+            user_free(&user);
+            return 200;
+        }
+        else
+            return 404;
+    }
+
+    /* read the object */
+    if (!valid_status(status = object_get(actor, &d))) {
+        d = xs_free(d);
+        return status;
+    }
+
+    /* if the object is corrupted, discard it */
+    if (xs_is_null(xs_dict_get(d, "id")) || xs_is_null(xs_dict_get(d, "type"))) {
+        srv_debug(1, xs_fmt("corrupted actor object %s", actor));
+        d = xs_free(d);
+        return 404;
+    }
+
+    if (data)
+        *data = d;
+    else
+        d = xs_free(d);
+
+    if (object_mtime(actor) + ACTOR_MAX_TIME < (double) time(NULL)) {
+        /* actor data exists but also stinks */
+        status = 205; /* "205: Reset Content" "110: Response Is Stale" */
+    }
+
+    return status;
+}
+
+
+int actor_get_refresh(snac *user, const char *actor, xs_dict **data)
+/* gets an actor and requests a refresh if it's stale */
+{
+    int status = actor_get(actor, data);
+
+    if (status == 205 && user && !xs_startswith(actor, srv_baseurl))
+        enqueue_actor_refresh(user, actor, 0);
+
+    return status;
+}
+
+
+/** user limiting (announce blocks) **/
+
+int limited(snac *user, const char *id, int cmd)
+/* announce messages from a followed (0: check, 1: limit; 2: unlimit) */
+{
+    int ret = 0;
+    xs *dir = xs_fmt("%s/limited", user->basedir);
+    xs *md5 = xs_md5_hex(id, strlen(id));
+    xs *fn  = xs_fmt("%s/%s", dir, md5);
+
+    switch (cmd) {
+    case 0: /** check **/
+        ret = !!(mtime(fn) > 0.0);
+        break;
+
+    case 1: /** limit **/
+        mkdirx(dir);
+
+        if (mtime(fn) > 0.0)
+            ret = -1;
+        else {
+            FILE *f;
+
+            if ((f = fopen(fn, "w")) != NULL) {
+                fprintf(f, "%s\n", id);
+                fclose(f);
+            }
+            else
+                ret = -2;
+        }
+        break;
+
+    case 2: /** unlimit **/
+        if (mtime(fn) > 0.0)
+            ret = unlink(fn);
+        else
+            ret = -1;
+        break;
+    }
+
+    return ret;
+}
+
+
+/** tag indexing **/
+
+void tag_index(const char *id, const xs_dict *obj)
+/* update the tag indexes for this object */
+{
+    const xs_list *tags = xs_dict_get(obj, "tag");
+
+    if (is_msg_public(obj) && xs_type(tags) == XSTYPE_LIST && xs_list_len(tags) > 0) {
+        xs *g_tag_dir = xs_fmt("%s/tag", srv_basedir);
+
+        mkdirx(g_tag_dir);
+
+        const xs_dict *v;
+        int ct = 0;
+        while (xs_list_next(tags, &v, &ct)) {
+            const char *type = xs_dict_get(v, "type");
+            const char *name = xs_dict_get(v, "name");
+
+            if (!xs_is_null(type) && !xs_is_null(name) && strcmp(type, "Hashtag") == 0) {
+                while (*name == '#' || *name == '@')
+                    name++;
+
+                if (*name == '\0')
+                    continue;
+
+                name = xs_tolower_i((xs_str *)name);
+
+                xs *md5_tag   = xs_md5_hex(name, strlen(name));
+                xs *tag_dir   = xs_fmt("%s/%c%c", g_tag_dir, md5_tag[0], md5_tag[1]);
+                mkdirx(tag_dir);
+
+                xs *g_tag_idx = xs_fmt("%s/%s.idx", tag_dir, md5_tag);
+                index_add(g_tag_idx, id);
+
+                FILE *f;
+                xs *g_tag_name = xs_replace(g_tag_idx, ".idx", ".tag");
+                if ((f = fopen(g_tag_name, "w")) != NULL) {
+                    fprintf(f, "%s\n", name);
+                    fclose(f);
+                }
+
+                srv_debug(0, xs_fmt("tagged %s #%s (#%s)", id, name, md5_tag));
+            }
+        }
+    }
+}
+
+
+xs_list *tag_search(const char *tag, int skip, int show)
+/* returns the list of posts tagged with tag */
+{
+    if (*tag == '#')
+        tag++;
+
+    xs *lw_tag = xs_tolower_i(xs_dup(tag));
+    xs *md5    = xs_md5_hex(lw_tag, strlen(lw_tag));
+    xs *idx    = xs_fmt("%s/tag/%c%c/%s.idx", srv_basedir, md5[0], md5[1], md5);
+
+    return index_list_desc(idx, skip, show);
+}
+
+
+/** lists **/
+
+xs_val *list_maint(snac *user, const char *list, int op)
+/* list maintenance */
+{
+    xs_val *l = NULL;
+
+    switch (op) {
+    case 0: /** list of lists **/
+        {
+            FILE *f;
+            xs *spec = xs_fmt("%s/list/" "*.id", user->basedir);
+            xs *ls   = xs_glob(spec, 0, 0);
+            int c = 0;
+            const char *v;
+
+            l = xs_list_new();
+
+            while (xs_list_next(ls, &v, &c)) {
+                if ((f = fopen(v, "r")) != NULL) {
+                    xs *title = xs_readline(f);
+                    fclose(f);
+
+                    title = xs_strip_i(title);
+
+                    xs *v2 = xs_replace(v, ".id", "");
+                    xs *l2 = xs_split(v2, "/");
+
+                    /* return [ list_id, list_title ] */
+                    l = xs_list_append(l, xs_list_append(xs_list_new(), xs_list_get(l2, -1), title));
+                }
+            }
+        }
+
+        break;
+
+    case 1: /** create new list (list is the name) **/
+        {
+            xs *lol = list_maint(user, NULL, 0);
+            int c = 0;
+            const xs_list *v;
+            int add = 1;
+
+            /* check if this list name already exists */
+            while (xs_list_next(lol, &v, &c)) {
+                if (strcmp(xs_list_get(v, 1), list) == 0) {
+                    add = 0;
+                    break;
+                }
+            }
+
+            if (add) {
+                FILE *f;
+                xs *dir = xs_fmt("%s/list/", user->basedir);
+                xs *id  = xs_fmt("%010x", time(NULL));
+
+                mkdirx(dir);
+
+                xs *fn = xs_fmt("%s%s.id", dir, id);
+
+                if ((f = fopen(fn, "w")) != NULL) {
+                    fprintf(f, "%s\n", list);
+                    fclose(f);
+                }
+
+                l = xs_stock(XSTYPE_TRUE);
+            }
+            else
+                l = xs_stock(XSTYPE_FALSE);
+        }
+
+        break;
+
+    case 2: /** delete list (list is the id) **/
+        {
+            if (xs_is_hex(list)) {
+                xs *fn = xs_fmt("%s/list/%s.id", user->basedir, list);
+                unlink(fn);
+
+                fn = xs_replace_i(fn, ".id", ".lst");
+                unlink(fn);
+
+                fn = xs_replace_i(fn, ".lst", ".idx");
+                unlink(fn);
+
+                fn = xs_str_cat(fn, ".bak");
+                unlink(fn);
+            }
+        }
+
+        break;
+
+    case 3: /** get list name **/
+        if (xs_is_hex(list)) {
+            FILE *f;
+            xs *fn = xs_fmt("%s/list/%s.id", user->basedir, list);
+
+            if ((f = fopen(fn, "r")) != NULL) {
+                l = xs_strip_i(xs_readline(f));
+                fclose(f);
+            }
+        }
+
+        break;
+    }
+
+    return l;
+}
+
+
+xs_list *list_timeline(snac *user, const char *list, int skip, int show)
+/* returns the timeline of a list */
+{
+    xs_list *l = NULL;
+
+    if (!xs_is_hex(list))
+        return NULL;
+
+    xs *fn = xs_fmt("%s/list/%s.idx", user->basedir, list);
+
+    if (mtime(fn) > 0.0)
+        l = index_list_desc(fn, skip, show);
+
+    return l;
+}
+
+
+xs_val *list_content(snac *user, const char *list, const char *actor_md5, int op)
+/* list content management */
+{
+    xs_val *l = NULL;
+
+    if (!xs_is_hex(list))
+        return NULL;
+
+    if (actor_md5 != NULL && !xs_is_hex(actor_md5))
+        return NULL;
+
+    xs *fn = xs_fmt("%s/list/%s.lst", user->basedir, list);
+
+    switch (op) {
+    case 0: /** list content **/
+        l = index_list(fn, XS_ALL);
+
+        break;
+
+    case 1: /** append actor to list **/
+        if (actor_md5 != NULL) {
+            if (!index_in_md5(fn, actor_md5))
+                index_add_md5(fn, actor_md5);
+        }
+
+        break;
+
+    case 2: /** delete actor from list **/
+        if (actor_md5 != NULL)
+            index_del_md5(fn, actor_md5);
+
+        break;
+
+    default:
+        srv_log(xs_fmt("ERROR: list_content: bad op %d", op));
+        break;
+    }
+
+    return l;
+}
+
+
+void list_distribute(snac *user, const char *who, const xs_dict *post)
+/* distributes the post to all appropriate lists */
+{
+    const char *id = xs_dict_get(post, "id");
+
+    /* if who is not set, use the attributedTo in the message */
+    if (xs_is_null(who))
+        who = get_atto(post);
+
+    if (xs_type(who) == XSTYPE_STRING && xs_type(id) == XSTYPE_STRING) {
+        xs *a_md5 = xs_md5_hex(who, strlen(who));
+        xs *i_md5 = xs_md5_hex(id, strlen(id));
+        xs *spec  = xs_fmt("%s/list/" "*.lst", user->basedir);
+        xs *ls    = xs_glob(spec, 0, 0);
+        int c = 0;
+        const char *v;
+
+        while (xs_list_next(ls, &v, &c)) {
+            /* is the actor in this list? */
+            if (index_in_md5(v, a_md5)) {
+                /* it is; add post md5 to its timeline */
+                xs *idx = xs_replace(v, ".lst", ".idx");
+                index_add_md5(idx, i_md5);
+
+                snac_debug(user, 1, xs_fmt("listed post %s in %s", id, idx));
+            }
+        }
+    }
+}
+
+
+/** static data **/
+
+static int _load_raw_file(const char *fn, xs_val **data, int *size,
+                        const char *inm, xs_str **etag)
+/* loads a cached file */
+{
+    int status = 404;
+
+    if (fn) {
+        double tm = mtime(fn);
+
+        if (tm > 0.0) {
+            /* file exists; build the etag */
+            xs *e = xs_fmt("W/\"snac-%.0lf\"", tm);
+
+            /* if if-none-match is set, check if it's the same */
+            if (!xs_is_null(inm) && strcmp(e, inm) == 0) {
+                /* client has the newest version */
+                status = 304;
+            }
+            else {
+                /* newer or never downloaded; read the full file */
+                FILE *f;
+
+                if ((f = fopen(fn, "rb")) != NULL) {
+                    *size = XS_ALL;
+                    *data = xs_read(f, size);
+                    fclose(f);
+
+                    status = 200;
+                }
+            }
+
+            /* if caller wants the etag, return it */
+            if (etag != NULL)
+                *etag = xs_dup(e);
+
+            srv_debug(1, xs_fmt("_load_raw_file(): %s %d", fn, status));
+        }
+    }
+
+    return status;
+}
+
+
+xs_str *_static_fn(snac *snac, const char *id)
+/* gets the filename for a static file */
+{
+    if (strchr(id, '/'))
+        return NULL;
+    else
+        return xs_fmt("%s/static/%s", snac->basedir, id);
+}
+
+
+int static_get(snac *snac, const char *id, xs_val **data, int *size,
+                const char *inm, xs_str **etag)
+/* returns static content */
+{
+    xs *fn = _static_fn(snac, id);
+
+    return _load_raw_file(fn, data, size, inm, etag);
+}
+
+
+void static_put(snac *snac, const char *id, const char *data, int size)
+/* writes status content */
+{
+    xs *fn = _static_fn(snac, id);
+    FILE *f;
+
+    if (fn && (f = fopen(fn, "wb")) != NULL) {
+        fwrite(data, size, 1, f);
+        fclose(f);
+    }
+}
+
+
+void static_put_meta(snac *snac, const char *id, const char *str)
+/* puts metadata (i.e. a media description string) to id */
+{
+    xs *fn = _static_fn(snac, id);
+
+    if (fn) {
+        fn = xs_str_cat(fn, ".txt");
+        FILE *f;
+
+        if ((f = fopen(fn, "w")) != NULL) {
+            fprintf(f, "%s\n", str);
+            fclose(f);
+        }
+    }
+}
+
+
+xs_str *static_get_meta(snac *snac, const char *id)
+/* gets metadata from a media */
+{
+    xs *fn    = _static_fn(snac, id);
+    xs_str *r = NULL;
+
+    if (fn) {
+        fn = xs_str_cat(fn, ".txt");
+        FILE *f;
+
+        if ((f = fopen(fn, "r")) != NULL) {
+            r = xs_strip_i(xs_readline(f));
+            fclose(f);
+        }
+    }
+    else
+        r = xs_str_new("");
+
+    return r;
+}
+
+
+/** history **/
+
+xs_str *_history_fn(snac *snac, const char *id)
+/* gets the filename for the history */
+{
+    if (strchr(id, '/'))
+        return NULL;
+    else
+        return xs_fmt("%s/history/%s", snac->basedir, id);
+}
+
+
+double history_mtime(snac *snac, const char *id)
+{
+    double t = 0.0;
+    xs *fn = _history_fn(snac, id);
+
+    if (fn != NULL)
+        t = mtime(fn);
+
+    return t;
+}
+
+
+void history_add(snac *snac, const char *id, const char *content, int size,
+                    xs_str **etag)
+/* adds something to the history */
+{
+    xs *fn = _history_fn(snac, id);
+    FILE *f;
+
+    if (fn && (f = fopen(fn, "w")) != NULL) {
+        fwrite(content, size, 1, f);
+        fclose(f);
+
+        if (etag) {
+            double tm = mtime(fn);
+            *etag = xs_fmt("W/\"snac-%.0lf\"", tm);
+        }
+    }
+}
+
+
+int history_get(snac *snac, const char *id, xs_str **content, int *size,
+                const char *inm, xs_str **etag)
+{
+    xs *fn = _history_fn(snac, id);
+
+    return _load_raw_file(fn, content, size, inm, etag);
+}
+
+
+int history_del(snac *snac, const char *id)
+{
+    xs *fn = _history_fn(snac, id);
+
+    if (fn)
+        return unlink(fn);
+    else
+        return -1;
+}
+
+
+xs_list *history_list(snac *snac)
+{
+    xs *spec = xs_fmt("%s/history/" "*.html", snac->basedir);
+
+    return xs_glob(spec, 1, 1);
+}
+
+
+void lastlog_write(snac *snac, const char *source)
+/* writes the last time the user logged in */
+{
+    xs *fn = xs_fmt("%s/lastlog.txt", snac->basedir);
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%lf %s\n", ftime(), source);
+        fclose(f);
+    }
+}
+
+
+/** inbox collection **/
+
+void inbox_add(const char *inbox)
+/* collects a shared inbox */
+{
+    /* don't collect ourselves */
+    if (xs_startswith(inbox, srv_baseurl))
+        return;
+
+    xs *md5 = xs_md5_hex(inbox, strlen(inbox));
+    xs *fn  = xs_fmt("%s/inbox/%s", srv_basedir, md5);
+    FILE *f;
+
+    if ((f = fopen(fn, "w")) != NULL) {
+        fprintf(f, "%s\n", inbox);
+        fclose(f);
+    }
+}
+
+
+void inbox_add_by_actor(const xs_dict *actor)
+/* collects an actor's shared inbox, if it has one */
+{
+    const char *v;
+
+    if (!xs_is_null(v = xs_dict_get(actor, "endpoints")) &&
+        !xs_is_null(v = xs_dict_get(v, "sharedInbox"))) {
+        /* only collect this inbox if its instance is not blocked */
+        if (!is_instance_blocked(v))
+            inbox_add(v);
+    }
+}
+
+
+xs_list *inbox_list(void)
+/* returns the collected inboxes as a list */
+{
+    xs_list *ibl = xs_list_new();
+    xs *spec     = xs_fmt("%s/inbox/" "*", srv_basedir);
+    xs *files    = xs_glob(spec, 0, 0);
+    xs_list *p   = files;
+    const xs_val *v;
+
+    while (xs_list_iter(&p, &v)) {
+        FILE *f;
+
+        if ((f = fopen(v, "r")) != NULL) {
+            xs *line = xs_readline(f);
+
+            if (line) {
+                line = xs_strip_i(line);
+                ibl  = xs_list_append(ibl, line);
+            }
+
+            fclose(f);
+        }
+    }
+
+    return ibl;
+}
+
+
+/** instance-wide operations **/
+
+xs_str *_instance_block_fn(const char *instance)
+{
+    xs *s   = xs_replace(instance, "http:/" "/", "");
+    xs *s1  = xs_replace(s, "https:/" "/", "");
+    xs *l   = xs_split(s1, "/");
+    const char *p = xs_list_get(l, 0);
+    xs *md5 = xs_md5_hex(p, strlen(p));
+
+    return xs_fmt("%s/block/%s", srv_basedir, md5);
+}
+
+
+int is_instance_blocked(const char *instance)
+{
+    xs *fn = _instance_block_fn(instance);
+
+    return !!(mtime(fn) != 0.0);
+}
+
+
+int instance_block(const char *instance)
+/* blocks a full instance */
+{
+    int ret;
+
+    /* create the subdir */
+    xs *dir = xs_fmt("%s/block/", srv_basedir);
+    mkdirx(dir);
+
+    if (!is_instance_blocked(instance)) {
+        xs *fn = _instance_block_fn(instance);
+        FILE *f;
+
+        if ((f = fopen(fn, "w")) != NULL) {
+            fprintf(f, "%s\n", instance);
+            fclose(f);
+
+            ret = 0;
+        }
+        else
+            ret = -1;
+    }
+    else
+        ret = -2;
+
+    return ret;
+}
+
+
+int instance_unblock(const char *instance)
+/* unblocks a full instance */
+{
+    int ret;
+
+    if (is_instance_blocked(instance)) {
+        xs *fn = _instance_block_fn(instance);
+        ret = unlink(fn);
+    }
+    else
+        ret = -2;
+
+    return ret;
+}
+
+
+/** full-text search index **/
+
+#define SEARCH_MIN_WORD     2       /* in bytes; shorter words are not indexed */
+#define SEARCH_MAX_WORD     64      /* in bytes; longer words are truncated */
+#define SEARCH_MAX_TERMS    16      /* maximum number of query chunks and words */
+#define SEARCH_MAX_INDEXED  256     /* maximum number of distinct words indexed by post */
+#define SEARCH_MAX_PHRASE   16      /* maximum number of words in a phrase */
+#define SEARCH_MAX_RANKED   1000    /* maximum number of matching posts to be ranked */
+#define SEARCH_AVG_WORDS    50      /* assumed average length of a post, in words */
+
+typedef struct {
+    const char *w[SEARCH_MAX_PHRASE];   /* the words */
+    int n;                              /* number of words */
+    double weight;                      /* sum of the idf of its indexed words */
+} search_chunk;
+
+typedef struct {
+    double score;
+    int order;
+    const char *md5;
+} search_hit;
+
+
+static int _search_enabled(void)
+/* returns true if the full-text search index is to be maintained and used */
+{
+    return xs_type(xs_dict_get(srv_config, "search_index")) == XSTYPE_TRUE;
+}
+
+
+static int _search_is_cjk(unsigned int cpoint)
+/* returns true if the codepoint is an ideograph or a kana (indexed one by one) */
+{
+    return (cpoint >= 0x3040 && cpoint <= 0x30ff) ||    /* hiragana and katakana */
+           (cpoint >= 0x3400 && cpoint <= 0x9fff) ||    /* CJK unified ideographs */
+           (cpoint >= 0xf900 && cpoint <= 0xfaff) ||    /* CJK compatibility ideographs */
+           (cpoint >= 0x20000 && cpoint <= 0x3ffff);    /* more CJK */
+}
+
+
+static xs_list *_search_word_end(xs_list *list, xs_str_bld *b)
+/* appends the word being built (if any) to the list */
+{
+    if (b->len) {
+        xs *w = xs_str_bld_done(b);
+        list = xs_list_append(list, w);
+    }
+
+    return list;
+}
+
+
+xs_list *search_words(const char *text)
+/* splits a text (HTML allowed) into a list of case-folded words */
+{
+    xs_list *list = xs_list_new();
+    xs_str_bld b = { NULL, 0, 0 };
+
+    while (*text) {
+        unsigned int cpoint;
+
+        if (*text == '<') {
+            /* HTML tags separate words */
+            const char *e = strchr(text, '>');
+            text   = e ? e + 1 : text + strlen(text);
+            cpoint = ' ';
+        }
+        else
+        if (*text == '&') {
+            /* and so do HTML entities */
+            size_t n = strspn(text + 1, "#0123456789"
+                "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+            text  += (n < 10 && text[n + 1] == ';') ? n + 2 : 1;
+            cpoint = ' ';
+        }
+        else
+            cpoint = xs_utf8_dec(&text);
+
+        /* combining diacritics are dropped */
+        if (cpoint >= 0x300 && cpoint <= 0x36f && b.len)
+            continue;
+
+        if (xs_unicode_is_alpha(cpoint) || (cpoint >= '0' && cpoint <= '9')) {
+            unsigned int base, diac;
+            char tmp[4];
+
+            /* case-fold and strip the diacritics */
+            cpoint = xs_unicode_to_lower(cpoint);
+
+            while (xs_unicode_nfd(cpoint, &base, &diac))
+                cpoint = base;
+
+            int cjk = _search_is_cjk(cpoint);
+
+            if (cjk)
+                list = _search_word_end(list, &b);
+
+            if (b.len + 4 <= SEARCH_MAX_WORD)
+                xs_str_bld_cat_m(&b, tmp, _xs_utf8_enc(tmp, cpoint));
+
+            if (cjk)
+                list = _search_word_end(list, &b);
+        }
+        else
+            list = _search_word_end(list, &b);
+    }
+
+    return _search_word_end(list, &b);
+}
+
+
+static xs_str *_search_text(const xs_dict *obj)
+/* returns the searchable text of a post */
+{
+    const char *keys[] = { "summary", "name", "content", NULL };
+    xs_str_bld b = { NULL, 0, 0 };
+    int n;
+
+    for (n = 0; keys[n]; n++) {
+        const char *v = xs_dict_get(obj, keys[n]);
+
+        if (xs_type(v) == XSTYPE_STRING) {
+            xs_str_bld_cat(&b, v);
+            xs_str_bld_chr(&b, ' ');
+        }
+    }
+
+    return xs_str_bld_done(&b);
+}
+
+
+static xs_str *_search_word_fn(const char *word)
+/* returns the file name of the index of a word */
+{
+    xs *md5 = xs_md5_hex(word, strlen(word));
+    return xs_fmt("%s/search/%c%c/%s.idx", srv_basedir, md5[0], md5[1], md5);
+}
+
+
+static int _search_index_add(const char *md5, const xs_dict *obj)
+/* adds a post to the full-text search index */
+{
+    const char *type = xs_dict_get(obj, "type");
+
+    if (xs_type(type) != XSTYPE_STRING || !xs_match(type, POSTLIKE_OBJECT_TYPE))
+        return 0;
+
+    xs *text  = _search_text(obj);
+    xs *words = search_words(text);
+    xs_set seen;
+    const char *v;
+    int c = 0;
+    int n = 0;
+
+    xs_set_init(&seen);
+
+    /* each word is an append to its index, so very long posts
+       are only indexed by their first distinct words */
+    while (n < SEARCH_MAX_INDEXED && xs_list_next(words, &v, &c)) {
+        if (strlen(v) < SEARCH_MIN_WORD || xs_set_add(&seen, v) != 1)
+            continue;
+
+        xs *fn = _search_word_fn(v);
+
+        if (index_add_md5(fn, md5) == 500) {
+            /* first time this word is seen: create the directories */
+            xs *dir = xs_fmt("%s/search", srv_basedir);
+            mkdirx(dir);
+
+            xs *sub = xs_str_new_sz(fn, strrchr(fn, '/') - fn);
+            mkdirx(sub);
+
+            index_add_md5(fn, md5);
+        }
+
+        n++;
+    }
+
+    xs_set_free(&seen);
+
+    if (n) {
+        /* the list of indexed posts, for counting */
+        xs *docs = xs_fmt("%s/search/docs.idx", srv_basedir);
+        index_add_md5(docs, md5);
+
+        srv_debug(2, xs_fmt("search_index %s (%d words)", md5, n));
+    }
+
+    return n;
+}
+
+
+void search_index(const char *id, const xs_dict *obj)
+/* updates the full-text search index for this object */
+{
+    if (_search_enabled()) {
+        xs *md5 = xs_md5_hex(id, strlen(id));
+        _search_index_add(md5, obj);
+    }
+}
+
+
+int search_index_rebuild(void)
+/* rebuilds the full-text search index from the instance and user timelines */
+{
+    xs *spec = xs_fmt("%s/search/??" "/" "*.idx", srv_basedir);
+    xs *idxs = xs_glob(spec, 0, 0);
+    xs *docs = xs_fmt("%s/search/docs.idx", srv_basedir);
+    const char *v;
+    int c = 0;
+    int n = 0;
+
+    /* start from scratch */
+    while (xs_list_next(idxs, &v, &c))
+        unlink(v);
+
+    unlink(docs);
+
+    xs *tls  = xs_list_new();
+    xs *itl  = xs_fmt("%s/public.idx", srv_basedir);
+    xs *uids = user_list();
+
+    tls = xs_list_append(tls, itl);
+
+    c = 0;
+    while (xs_list_next(uids, &v, &c)) {
+        xs *pub  = xs_fmt("%s/user/%s/public.idx", srv_basedir, v);
+        xs *priv = xs_fmt("%s/user/%s/private.idx", srv_basedir, v);
+
+        tls = xs_list_append(tls, pub, priv);
+    }
+
+    xs_set seen;
+    xs_set_init(&seen);
+
+    c = 0;
+    while (xs_list_next(tls, &v, &c)) {
+        xs *list = index_list(v, XS_ALL);
+        const char *md5;
+        int c2 = 0;
+
+        while (xs_list_next(list, &md5, &c2)) {
+            xs *obj = NULL;
+
+            if (xs_set_add(&seen, md5) == 1 &&
+                valid_status(object_get_by_md5(md5, &obj)) &&
+                _search_index_add(md5, obj))
+                n++;
+        }
+    }
+
+    xs_set_free(&seen);
+
+    return n;
+}
+
+
+static double _search_idf(int docs, int df)
+/* returns a rough inverse document frequency (log2(docs / df) + 1, without libm) */
+{
+    double r = (double)(docs + 1) / (df + 1);
+    double l = 1.0;
+
+    while (r >= 2.0) {
+        r /= 2.0;
+        l += 1.0;
+    }
+
+    return l + r - 1.0;
+}
+
+
+static double _search_score(const xs_list *words, const search_chunk *chunks, int n_chunks)
+/* scores a post given its words (0 if it doesn't match all query chunks) */
+{
+    int nw = xs_list_len(words);
+    const char **wv = xs_realloc(NULL, (nw + 1) * sizeof(char *));
+    const char *v;
+    double score = 0.0;
+    int c = 0, i, j, k;
+
+    for (i = 0; xs_list_next(words, &v, &c); i++)
+        wv[i] = v;
+
+    /* BM25-like, with the usual k1 = 1.2 and b = 0.75 */
+    double norm = 1.2 * (0.25 + 0.75 * nw / SEARCH_AVG_WORDS);
+
+    for (k = 0; k < n_chunks; k++) {
+        const search_chunk *ch = &chunks[k];
+        int tf = 0;
+
+        /* count the occurrences of the chunk as a sequence of words */
+        for (i = 0; i + ch->n <= nw; i++) {
+            for (j = 0; j < ch->n && strcmp(wv[i + j], ch->w[j]) == 0; j++);
+
+            if (j == ch->n)
+                tf++;
+        }
+
+        if (tf == 0) {
+            score = 0.0;
+            break;
+        }
+
+        score += ch->weight * tf * 2.2 / (tf + norm);
+    }
+
+    xs_free(wv);
+
+    return score;
+}
+
+
+static int _search_hit_cmp(const void *a, const void *b)
+/* sorts hits by score, then by recency */
+{
+    const search_hit *ha = a;
+    const search_hit *hb = b;
+
+    if (ha->score != hb->score)
+        return ha->score < hb->score ? 1 : -1;
+
+    return ha->order - hb->order;
+}
+
+
+static xs_list *_search_find(snac *user, const char *query,
+                int priv, int skip, int show, int max_secs, int *timeout)
+/* returns a list of posts matching the query, ranked, using the full-text index */
+{
+    search_chunk chunks[SEARCH_MAX_TERMS];
+    xs *chunk_words = xs_list_new();
+    xs *terms = xs_list_new();
+    xs *fns   = xs_list_new();
+    int df[SEARCH_MAX_TERMS];
+    int n_chunks = 0, n_terms = 0, rarest = 0;
+    const char *p = query;
+    const char *v;
+    int c, i, k;
+
+    *timeout = 0;
+
+    /* split the query in "quoted phrases" and space-separated chunks
+       (chunks with more than one word are also treated as phrases) */
+    while (*p && n_chunks < SEARCH_MAX_TERMS) {
+        const char *e;
+
+        if (*p == ' ' || *p == '\t') {
+            p++;
+            continue;
+        }
+
+        if (*p == '"') {
+            p++;
+            if ((e = strchr(p, '"')) == NULL)
+                e = p + strlen(p);
+        }
+        else
+            e = p + strcspn(p, " \t\"");
+
+        xs *s = xs_str_new_sz(p, e - p);
+        xs *w = search_words(s);
+
+        p = *e == '"' ? e + 1 : e;
+
+        if (xs_list_len(w) == 0)
+            continue;
+
+        chunk_words = xs_list_append(chunk_words, w);
+        n_chunks++;
+    }
+
+    /* collect the distinct words to be looked up in the index */
+    c = 0;
+    while (xs_list_next(chunk_words, &v, &c)) {
+        const char *w;
+        int c2 = 0;
+
+        while (n_terms < SEARCH_MAX_TERMS && xs_list_next(v, &w, &c2)) {
+            if (strlen(w) < SEARCH_MIN_WORD || xs_list_in(terms, w) != -1)
+                continue;
+
+            xs *fn = _search_word_fn(w);
+
+            if ((df[n_terms] = index_len(fn)) == 0) {
+                /* no post has this word: nothing can match */
+                return xs_list_new();
+            }
+
+            if (df[n_terms] < df[rarest])
+                rarest = n_terms;
+
+            terms = xs_list_append(terms, w);
+            fns   = xs_list_append(fns, fn);
+            n_terms++;
+        }
+    }
+
+    if (n_terms == 0)
+        return xs_list_new();
+
+    xs *docs_fn = xs_fmt("%s/search/docs.idx", srv_basedir);
+    int docs = index_len(docs_fn);
+
+    /* prepare the chunks with the weight of their words */
+    c = 0;
+    for (k = 0; xs_list_next(chunk_words, &v, &c); k++) {
+        const char *w;
+        int c2 = 0;
+
+        chunks[k].n = 0;
+        chunks[k].weight = 0.0;
+
+        while (chunks[k].n < SEARCH_MAX_PHRASE && xs_list_next(v, &w, &c2)) {
+            chunks[k].w[chunks[k].n++] = w;
+
+            if ((i = xs_list_in(terms, w)) != -1)
+                chunks[k].weight += _search_idf(docs, df[i]);
+        }
+    }
+
+    xs_lidx fi = xs_list_idx_new(fns);
+
+    /* start from the posts with the rarest word, newest first */
+    xs_list *cands = index_list_desc(xs_list_idx_get(&fi, rarest), 0, XS_ALL);
+
+    /* intersect them with the posts with the other words,
+       unless these lists are too long to be worth reading */
+    for (i = 0; i < n_terms; i++) {
+        if (i == rarest || df[i] > 16 * xs_list_len(cands))
+            continue;
+
+        xs *l = index_list(xs_list_idx_get(&fi, i), XS_ALL);
+        xs_list *n_cands = xs_list_new();
+        xs_set s;
+
+        xs_set_init(&s);
+
+        c = 0;
+        while (xs_list_next(l, &v, &c))
+            xs_set_add(&s, v);
+
+        c = 0;
+        while (xs_list_next(cands, &v, &c)) {
+            if (xs_set_in(&s, v))
+                n_cands = xs_list_append(n_cands, v);
+        }
+
+        xs_set_free(&s);
+        xs_free(cands);
+        cands = n_cands;
+    }
+
+    /* check and rank the candidates */
+    search_hit *hits = xs_realloc(NULL, SEARCH_MAX_RANKED * sizeof(search_hit));
+    int n_hits = 0;
+    xs *itl_fn = xs_fmt("%s/public.idx", srv_basedir);
+    xs_set itl;
+    int itl_loaded = 0;
+    xs_set seen;
+
+    if (max_secs == 0)
+        max_secs = 3;
+
+    time_t t = time(NULL) + max_secs;
+
+    xs_set_init(&seen);
+
+    c = 0;
+    while (n_hits < SEARCH_MAX_RANKED && xs_list_next(cands, &v, &c)) {
+        if (time(NULL) > t) {
+            *timeout = 1;
+            break;
+        }
+
+        if (xs_set_add(&seen, v) != 1)
+            continue;
+
+        /* only posts in the user timelines or in the instance one */
+        xs *pub_fn = xs_fmt("%s/public/%s.json", user->basedir, v);
+
+        if (!(priv ? timeline_here(user, v) : mtime(pub_fn) > 0.0)) {
+            if (!itl_loaded) {
+                xs *l = index_list(itl_fn, XS_ALL);
+                const char *md5;
+                int c2 = 0;
+
+                xs_set_init(&itl);
+
+                while (xs_list_next(l, &md5, &c2))
+                    xs_set_add(&itl, md5);
+
+                itl_loaded = 1;
+            }
+
+            if (!xs_set_in(&itl, v))
+                continue;
+        }
+
+        xs *post = NULL;
+
+        if (!valid_status(object_peek_by_md5(v, &post, "type", "id", "summary", "name", "content")))
+            continue;
+
+        if (!xs_match(xs_dict_get_def(post, "type", "-"), POSTLIKE_OBJECT_TYPE))
+            continue;
+
+        const char *id = xs_dict_get(post, "id");
+
+        if (id == NULL || is_hidden(user, id))
+            continue;
+
+        /* the index may be stale (e.g. edited posts), so check the words again */
+        xs *text  = _search_text(post);
+        xs *words = search_words(text);
+        double score = _search_score(words, chunks, n_chunks);
+
+        if (score > 0.0) {
+            hits[n_hits].score = score;
+            hits[n_hits].order = n_hits;
+            hits[n_hits].md5   = v;
+            n_hits++;
+        }
+    }
+
+    qsort(hits, n_hits, sizeof(search_hit), _search_hit_cmp);
+
+    xs_list *r = xs_list_new();
+
+    for (i = skip; i < n_hits && i < skip + show; i++)
+        r = xs_list_append(r, hits[i].md5);
+
+    if (itl_loaded)
+        xs_set_free(&itl);
+
+    xs_set_free(&seen);
+    xs_free(hits);
+    xs_free(cands);
+
+    return r;
+}
+
+
+/** operations by content **/
+
+static struct {
+    pthread_mutex_t mutex;
+    xs_str *fn;             /* file the rules were read from */
+    double mtime;           /* its mtime at that moment */
+    xs_str *rx;             /* the rules merged into a single regex (or NULL) */
+    xs_list *solo;          /* the rules that must be applied one by one */
+    xs_list *rules;         /* all the valid rules */
+} content_filter = { PTHREAD_MUTEX_INITIALIZER, NULL, 0.0, NULL, NULL, NULL };
+
+
+static void _content_filter_load(const char *fn, double mt)
+/* (re)loads the content filter rules from a file */
+{
+    int paused = xs_arena_pause();
+    xs_str_bld b = { NULL, 0, 0 };
+    xs_list *rules = xs_list_new();
+    xs_list *solo  = xs_list_new();
+    FILE *f;
+
+    if ((f = fopen(fn, "r")) != NULL) {
+        while (!feof(f)) {
+            xs *rx = xs_strip_i(xs_readline(f));
+
+            if (*rx == '\0')
+                continue;
+
+            if (!xs_regex_valid(rx)) {
+                srv_log(xs_fmt("content_match: invalid regex '%s' in %s", rx, fn));
+                continue;
+            }
+
+            rules = xs_list_append(rules, rx);
+
+            /* back-references can't be merged into an alternation */
+            if (xs_regex_match(rx, "\\\\[1-9]")) {
+                solo = xs_list_append(solo, rx);
+                continue;
+            }
+
+            if (b.len)
+                xs_str_bld_chr(&b, '|');
+
+            xs_str_bld_chr(&b, '(');
+            xs_str_bld_cat(&b, rx);
+            xs_str_bld_chr(&b, ')');
+        }
+
+        fclose(f);
+    }
+
+    xs *rx = xs_str_bld_done(&b);
+
+    if (*rx && !xs_regex_valid(rx)) {
+        /* merging failed for some reason: apply all of them one by one */
+        xs_free(solo);
+        solo = xs_dup(rules);
+        *rx  = '\0';
+    }
+
+    xs_free(content_filter.fn);
+    xs_free(content_filter.rx);
+    xs_free(content_filter.solo);
+    xs_free(content_filter.rules);
+
+    content_filter.fn    = xs_dup(fn);
+    content_filter.mtime = mt;
+    content_filter.rx    = *rx ? xs_dup(rx) : NULL;
+    content_filter.solo  = solo;
+    content_filter.rules = rules;
+
+    srv_debug(1, xs_fmt("content_match: loaded %d regexes from %s (%d not merged)",
+                xs_list_len(rules), fn, xs_list_len(solo)));
+
+    xs_arena_resume(paused);
+}
+
+
+int content_match(const char *file, const xs_dict *msg)
+/* checks if a message's content matches any of the regexes in file */
+/* file format: one regex per line */
+{
+    xs *fn = xs_fmt("%s/%s", srv_basedir, file);
+    const char *v = xs_dict_get(msg, "content");
+    double mt;
+    int r = 0;
+
+    if (xs_type(v) != XSTYPE_STRING || *v == '\0' || (mt = mtime(fn)) == 0.0)
+        return 0;
+
+    /* get the rules, reloading them if the file changed */
+    pthread_mutex_lock(&content_filter.mutex);
+
+    if (content_filter.fn == NULL || content_filter.mtime != mt || strcmp(content_filter.fn, fn) != 0)
+        _content_filter_load(fn, mt);
+
+    xs *rx   = xs_dup(content_filter.rx);
+    xs *solo = xs_dup(content_filter.solo);
+
+    pthread_mutex_unlock(&content_filter.mutex);
+
+    /* massage content (strip HTML tags, etc.) */
+    xs *c = xs_regex_replace(v, "<[^>]+>", " ");
+    c = xs_regex_replace_i(c, " {2,}", " ");
+    c = xs_tolower_i(c);
+
+    /* the merged rules are applied in a single pass over the content */
+    if (rx != NULL && xs_regex_match(c, rx))
+        r = 1;
+    else {
+        const char *s;
+        int ct = 0;
+
+        while (!r && xs_list_next(solo, &s, &ct))
+            r = xs_regex_match(c, s);
+    }
+
+    if (r && dbglevel >= 1) {
+        /* find which one matched, just for the log */
+        pthread_mutex_lock(&content_filter.mutex);
+        xs *rules = xs_dup(content_filter.rules);
+        pthread_mutex_unlock(&content_filter.mutex);
+
+        const char *s;
+        int ct = 0;
+
+        while (xs_list_next(rules, &s, &ct)) {
+            if (xs_regex_match(c, s)) {
+                srv_debug(1, xs_fmt("content_match: match for '%s'", s));
+                break;
+            }
+        }
+    }
+
+    return r;
+}
+
+
+xs_list *content_search(snac *user, const char *regex,
+                int priv, int skip, int show, int max_secs, int *timeout)
+/* returns a list of posts which content matches the regex */
+{
+    if (regex == NULL || *regex == '\0')
+        return xs_list_new();
+
+    /* use the full-text index, unless it really looks like a regex */
+    if (_search_enabled() && strpbrk(regex, "[]()|*+?^$\\{}") == NULL)
+        return _search_find(user, regex, priv, skip, show, max_secs, timeout);
+
+    xs *i_regex = xs_tolower_i(xs_dup(regex));
+
+    xs_set seen;
+
+    xs_set_init(&seen);
+
+    if (max_secs == 0)
+        max_secs = 3;
+
+    time_t t = time(NULL) + max_secs;
+    *timeout = 0;
+
+    /* iterate all timelines simultaneously */
+    xs_list *tls[3] = {0};
+    const char *md5s[3] = {0};
+    int c[3] = {0};
+
+    tls[0] = timeline_simple_list(user, "public", 0, XS_ALL);   /* public */
+    tls[1] = timeline_instance_list(0, XS_ALL); /* instance */
+    tls[2] = priv ? timeline_simple_list(user, "private", 0, XS_ALL) : xs_list_new(); /* private or none */
+
+    /* first positioning */
+    for (int n = 0; n < 3; n++)
+        xs_list_next(tls[n], &md5s[n], &c[n]);
+
+    show += skip;
+
+    while (show > 0) {
+        /* timeout? */
+        if (time(NULL) > t) {
+            *timeout = 1;
+            break;
+        }
+
+        /* find the newest post */
+        int newest = -1;
+        double mtime = 0.0;
+
+        for (int n = 0; n < 3; n++) {
+            if (md5s[n] != NULL) {
+                double mt = object_mtime_by_md5(md5s[n]);
+
+                if (mt > mtime) {
+                    newest = n;
+                    mtime = mt;
+                }
+            }
+        }
+
+        if (newest == -1)
+            break;
+
+        const char *md5 = md5s[newest];
+
+        /* advance the chosen timeline */
+        if (!xs_list_next(tls[newest], &md5s[newest], &c[newest]))
+            md5s[newest] = NULL;
+
+        xs *post = NULL;
+
+        if (!valid_status(object_peek_by_md5(md5, &post, "type", "id", "content")))
+            continue;
+
+        if (!xs_match(xs_dict_get_def(post, "type", "-"), POSTLIKE_OBJECT_TYPE))
+            continue;
+
+        const char *id = xs_dict_get(post, "id");
+
+        if (id == NULL || is_hidden(user, id))
+            continue;
+
+        const char *content = xs_dict_get(post, "content");
+
+        if (xs_is_null(content))
+            continue;
+
+        /* strip HTML */
+        xs *c = xs_regex_replace(content, "<[^>]+>", " ");
+        c = xs_regex_replace_i(c, " {2,}", " ");
+        c = xs_tolower_i(c);
+
+        /* apply regex */
+        if (xs_regex_match(c, i_regex)) {
+            if (xs_set_add(&seen, md5) == 1)
+            show--;
+        }
+    }
+
+    xs_list *r = xs_set_result(&seen);
+
+    if (skip) {
+        /* keep only what's after the skipped ones, in a single pass */
+        xs_list *s = xs_list_new();
+        const char *v;
+        int c = 0, n = 0;
+
+        while (xs_list_next(r, &v, &c)) {
+            if (n++ >= skip)
+                s = xs_list_append(s, v);
+        }
+
+        xs_free(r);
+        r = s;
+    }
+
+    xs_free(tls[0]);
+    xs_free(tls[1]);
+    xs_free(tls[2]);
+
+    return r;
+}
+
+
+/** notifications **/
+
+xs_str *notify_check_time(snac *snac, int reset)
+/* gets or resets the latest notification check time */
+{
+    xs_str *t = NULL;
+    xs *fn    = xs_fmt("%s/notifydate.txt", snac->basedir);
+    FILE *f;
+
+    if (reset) {
+        if ((f = fopen(fn, "w")) != NULL) {
+            t = tid(0);
+            fprintf(f, "%s\n", t);
+            fclose(f);
+        }
+    }
+    else {
+        if ((f = fopen(fn, "r")) != NULL) {
+            t = xs_readline(f);
+            fclose(f);
+        }
+        else
+            /* never set before */
+            t = xs_fmt("%16.6f", 0.0);
+    }
+
+    return t;
+}
+
+
+void notify_add(snac *snac, const char *type, const char *utype,
+                const char *actor, const char *objid)
+/* adds a new notification */
+{
+    xs *ntid = tid(0);
+    xs *fn   = xs_fmt("%s/notify/", snac->basedir);
+    xs *date = xs_str_utctime(0, ISO_DATE_SPEC);
+    FILE *f;
+
+    /* create the directory */
+    mkdirx(fn);
+    fn = xs_str_cat(fn, ntid);
+    fn = xs_str_cat(fn, ".json");
 
-    case 2: /** delete list (list is the id) **/
-        {
-            if (xs_is_hex(list)) {
-                xs *fn = xs_fmt("%s/list/%s.id", user->basedir, list);
-                unlink(fn);
+    xs *noti = xs_dict_new();
 
-                fn = xs_replace_i(fn, ".id", ".lst");
-                unlink(fn);
+    noti = xs_dict_append(noti, "id",    ntid);
+    noti = xs_dict_append(noti, "type",  type);
+    noti = xs_dict_append(noti, "utype", utype);
+    noti = xs_dict_append(noti, "actor", actor);
+    noti = xs_dict_append(noti, "date",  date);
 
-                fn = xs_replace_i(fn, ".lst", ".idx");
-                unlink(fn);
+    if (!xs_is_null(objid))
+        noti = xs_dict_append(noti, "objid", objid);
 
-                fn = xs_str_cat(fn, ".bak");
-                unlink(fn);
-            }
-        }
+    if ((f = fopen(fn, "w")) != NULL) {
+        xs_json_dump(noti, json_indent(), f);
+        fclose(f);
+    }
 
-        break;
+    /* add it to the index if it already exists */
+    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
 
-    case 3: /** get list name **/
-        if (xs_is_hex(list)) {
-            FILE *f;
-            xs *fn = xs_fmt("%s/list/%s.id", user->basedir, list);
+    if (mtime(idx) != 0.0) {
+        data_lock(idx);
 
-            if ((f = fopen(fn, "r")) != NULL) {
-                l = xs_strip_i(xs_readline(f));
-                fclose(f);
-            }
+        if ((f = fopen(idx, "a")) != NULL) {
+            fprintf(f, "%-32s\n", ntid);
+            fclose(f);
         }
 
-        break;
+        data_unlock(idx);
     }
-
-    return l;
 }
 
 
-xs_list *list_timeline(snac *user, const char *list, int skip, int show)
-/* returns the timeline of a list */
+xs_dict *notify_get(snac *snac, const char *id)
+/* gets a notification */
 {
-    xs_list *l = NULL;
+    /* base file */
+    xs *fn = xs_fmt("%s/notify/%s", snac->basedir, id);
 
-    if (!xs_is_hex(list))
-        return NULL;
+    /* strip spaces and add extension */
+    fn = xs_strip_i(fn);
+    fn = xs_str_cat(fn, ".json");
 
-    xs *fn = xs_fmt("%s/list/%s.idx", user->basedir, list);
+    FILE *f;
+    xs_dict *out = NULL;
 
-    if (mtime(fn) > 0.0)
-        l = index_list_desc(fn, skip, show);
+    if ((f = fopen(fn, "r")) != NULL) {
+        out = xs_json_load(f);
+        fclose(f);
+    }
 
-    return l;
+    return out;
 }
 
 
-xs_val *list_content(snac *user, const char *list, const char *actor_md5, int op)
-/* list content management */
+xs_list *notify_list(snac *snac, int skip, int show)
+/* returns a list of notification ids */
 {
-    xs_val *l = NULL;
-
-    if (!xs_is_hex(list))
-        return NULL;
+    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
 
-    if (actor_md5 != NULL && !xs_is_hex(actor_md5))
-        return NULL;
+    if (mtime(idx) == 0.0) {
+        /* create the index from scratch */
+        FILE *f;
 
-    xs *fn = xs_fmt("%s/list/%s.lst", user->basedir, list);
+        data_lock(idx);
 
-    switch (op) {
-    case 0: /** list content **/
-        l = index_list(fn, XS_ALL);
+        if ((f = fopen(idx, "w")) != NULL) {
+            xs *spec = xs_fmt("%s/notify/" "*.json", snac->basedir);
+            xs *lst  = xs_glob(spec, 1, 0);
+            xs_list *p = lst;
+            const char *v;
 
-        break;
+            while (xs_list_iter(&p, &v)) {
+                char *p = strrchr(v, '.');
+                if (p) {
+                    *p = '\0';
+                    fprintf(f, "%-32s\n", v);
+                }
+            }
 
-    case 1: /** append actor to list **/
-        if (actor_md5 != NULL) {
-            if (!index_in(fn, actor_md5))
-                index_add_md5(fn, actor_md5);
+            fclose(f);
         }
 
-        break;
-
-    case 2: /** delete actor from list **/
-        if (actor_md5 != NULL)
-            index_del_md5(fn, actor_md5);
-
-        break;
-
-    default:
-        srv_log(xs_fmt("ERROR: list_content: bad op %d", op));
-        break;
+        data_unlock(idx);
     }
 
-    return l;
+    return index_list_desc(idx, skip, show);
 }
 
 
-void list_distribute(snac *user, const char *who, const xs_dict *post)
-/* distributes the post to all appropriate lists */
+int notify_new_num(snac *snac)
+/* counts the number of new notifications */
 {
-    const char *id = xs_dict_get(post, "id");
+    xs *t = notify_check_time(snac, 0);
+    xs *lst = notify_list(snac, 0, XS_ALL);
+    int cnt = 0;
 
-    /* if who is not set, use the attributedTo in the message */
-    if (xs_is_null(who))
-        who = get_atto(post);
+    xs_list *p = lst;
+    const xs_str *v;
 
-    if (xs_type(who) == XSTYPE_STRING && xs_type(id) == XSTYPE_STRING) {
-        xs *a_md5 = xs_md5_hex(who, strlen(who));
-        xs *i_md5 = xs_md5_hex(id, strlen(id));
-        xs *spec  = xs_fmt("%s/list/" "*.lst", user->basedir);
-        xs *ls    = xs_glob(spec, 0, 0);
-        int c = 0;
-        const char *v;
+    while (xs_list_iter(&p, &v)) {
+        xs *id = xs_strip_i(xs_dup(v));
 
-        while (xs_list_next(ls, &v, &c)) {
-            /* is the actor in this list? */
-            if (index_in_md5(v, a_md5)) {
-                /* it is; add post md5 to its timeline */
-                xs *idx = xs_replace(v, ".lst", ".idx");
-                index_add_md5(idx, i_md5);
+        /* old? count no more */
+        if (strcmp(id, t) < 0)
+            break;
 
-                snac_debug(user, 1, xs_fmt("listed post %s in %s", id, idx));
-            }
-        }
+        cnt++;
     }
-}
 
+    return cnt;
+}
 
-/** static data **/
 
-static int _load_raw_file(const char *fn, xs_val **data, int *size,
-                        const char *inm, xs_str **etag)
-/* loads a cached file */
+void notify_clear(snac *snac)
+/* clears all notifications */
 {
-    int status = 404;
-
-    if (fn) {
-        double tm = mtime(fn);
-
-        if (tm > 0.0) {
-            /* file exists; build the etag */
-            xs *e = xs_fmt("W/\"snac-%.0lf\"", tm);
-
-            /* if if-none-match is set, check if it's the same */
-            if (!xs_is_null(inm) && strcmp(e, inm) == 0) {
-                /* client has the newest version */
-                status = 304;
-            }
-            else {
-                /* newer or never downloaded; read the full file */
-                FILE *f;
-
-                if ((f = fopen(fn, "rb")) != NULL) {
-                    *size = XS_ALL;
-                    *data = xs_read(f, size);
-                    fclose(f);
+    xs *spec   = xs_fmt("%s/notify/" "*", snac->basedir);
+    xs *lst    = xs_glob(spec, 0, 0);
+    xs_list *p = lst;
+    const xs_str *v;
 
-                    status = 200;
-                }
-            }
+    while (xs_list_iter(&p, &v))
+        unlink(v);
 
-            /* if caller wants the etag, return it */
-            if (etag != NULL)
-                *etag = xs_dup(e);
+    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
 
-            srv_debug(1, xs_fmt("_load_raw_file(): %s %d", fn, status));
-        }
+    if (mtime(idx) != 0.0) {
+        data_lock(idx);
+        truncate(idx, 0);
+        data_unlock(idx);
     }
-
-    return status;
 }
 
 
-xs_str *_static_fn(snac *snac, const char *id)
-/* gets the filename for a static file */
-{
-    if (strchr(id, '/'))
-        return NULL;
-    else
-        return xs_fmt("%s/static/%s", snac->basedir, id);
-}
+/** the queue **/
 
+/* The server keeps the retry time of all queued files in a min-heap,
+   so it doesn't have to glob all the queue directories to find the
+   ones that are due. Other processes (like the command line) just
+   touch the queue/.changed file after enqueueing something, and the
+   server reloads everything from disk when it sees it changed. The
+   new heap is built without holding the mutex, so enqueueing is not
+   stopped meanwhile; the files added while globbing are kept apart
+   and added to it before it replaces the old one. */
+
+typedef struct {
+    time_t t;               /* retry time */
+    xs_str *fn;             /* queue file */
+    xs_str *uid;            /* user id (NULL for the global queue) */
+} queue_entry;
+
+typedef struct {
+    queue_entry *h;         /* the entries */
+    int n;                  /* number of entries */
+    int size;               /* allocated entries */
+} queue_heap;
+
+static struct {
+    pthread_mutex_t mutex;
+    int on;                 /* the schedule is being used */
+    queue_heap hp;          /* the heap */
+    xs_list *pending;       /* files added while reloading it (NULL: not reloading) */
+    double stamp;           /* mtime of queue/.changed when loaded */
+    time_t loaded;          /* time of the last load */
+} queue_sched = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+#define QUEUE_SCHED_RELOAD (10 * 60)
+
+
+static double _queue_stamp(void)
+/* returns the mtime of the queue change stamp file */
+{
+    xs *fn = xs_fmt("%s/queue/.changed", srv_basedir);
+    struct stat st;
 
-int static_get(snac *snac, const char *id, xs_val **data, int *size,
-                const char *inm, xs_str **etag)
-/* returns static content */
-{
-    xs *fn = _static_fn(snac, id);
+    if (stat(fn, &st) == -1)
+        return 0.0;
 
-    return _load_raw_file(fn, data, size, inm, etag);
+    return (double) st.st_mtim.tv_sec + (double) st.st_mtim.tv_nsec / 1000000000.0;
 }
 
 
-void static_put(snac *snac, const char *id, const char *data, int size)
-/* writes status content */
+static void _queue_heap_push(queue_heap *hp, time_t t, const char *fn, const char *uid)
+/* adds an entry to a heap */
 {
-    xs *fn = _static_fn(snac, id);
-    FILE *f;
+    int paused = xs_arena_pause();
+    int i;
 
-    if (fn && (f = fopen(fn, "wb")) != NULL) {
-        fwrite(data, size, 1, f);
-        fclose(f);
+    if (hp->n == hp->size) {
+        hp->size = hp->size ? hp->size * 2 : 256;
+        hp->h = xs_realloc(hp->h, hp->size * sizeof(queue_entry));
     }
-}
 
+    /* sift up */
+    for (i = hp->n++; i > 0; i = (i - 1) / 2) {
+        queue_entry *parent = &hp->h[(i - 1) / 2];
 
-void static_put_meta(snac *snac, const char *id, const char *str)
-/* puts metadata (i.e. a media description string) to id */
-{
-    xs *fn = _static_fn(snac, id);
-
-    if (fn) {
-        fn = xs_str_cat(fn, ".txt");
-        FILE *f;
+        if (parent->t <= t)
+            break;
 
-        if ((f = fopen(fn, "w")) != NULL) {
-            fprintf(f, "%s\n", str);
-            fclose(f);
-        }
+        hp->h[i] = *parent;
     }
+
+    hp->h[i] = (queue_entry){ t, xs_dup(fn), uid ? xs_dup(uid) : NULL };
+
+    xs_arena_resume(paused);
 }
 
 
-xs_str *static_get_meta(snac *snac, const char *id)
-/* gets metadata from a media */
+static queue_entry _queue_heap_pop(queue_heap *hp)
+/* takes the earliest entry from a heap (n > 0) */
 {
-    xs *fn    = _static_fn(snac, id);
-    xs_str *r = NULL;
+    queue_entry top  = hp->h[0];
+    queue_entry last = hp->h[--hp->n];
+    int i = 0;
 
-    if (fn) {
-        fn = xs_str_cat(fn, ".txt");
-        FILE *f;
+    /* sift down */
+    for (;;) {
+        int c = 2 * i + 1;
 
-        if ((f = fopen(fn, "r")) != NULL) {
-            r = xs_strip_i(xs_readline(f));
-            fclose(f);
-        }
-    }
-    else
-        r = xs_str_new("");
+        if (c >= hp->n)
+            break;
 
-    return r;
-}
+        if (c + 1 < hp->n && hp->h[c + 1].t < hp->h[c].t)
+            c++;
+
+        if (last.t <= hp->h[c].t)
+            break;
 
+        hp->h[i] = hp->h[c];
+        i = c;
+    }
 
-/** history **/
+    if (hp->n > 0)
+        hp->h[i] = last;
 
-xs_str *_history_fn(snac *snac, const char *id)
-/* gets the filename for the history */
-{
-    if (strchr(id, '/'))
-        return NULL;
-    else
-        return xs_fmt("%s/history/%s", snac->basedir, id);
+    return top;
 }
 
 
-double history_mtime(snac *snac, const char *id)
+static void _queue_heap_free(queue_heap *hp)
+/* frees all the entries of a heap */
 {
-    double t = 0.0;
-    xs *fn = _history_fn(snac, id);
+    int i;
 
-    if (fn != NULL)
-        t = mtime(fn);
+    for (i = 0; i < hp->n; i++) {
+        xs_free(hp->h[i].fn);
+        xs_free(hp->h[i].uid);
+    }
 
-    return t;
+    xs_free(hp->h);
+    *hp = (queue_heap){0};
 }
 
 
-void history_add(snac *snac, const char *id, const char *content, int size,
-                    xs_str **etag)
-/* adds something to the history */
+static void _queue_heap_add(queue_heap *hp, const char *fn)
+/* adds a queue file to a heap */
 {
-    xs *fn = _history_fn(snac, id);
-    FILE *f;
+    const char *bn = strrchr(fn, '/');
+    xs *uprefix = xs_fmt("%s/user/", srv_basedir);
+    xs *uid     = NULL;
 
-    if (fn && (f = fopen(fn, "w")) != NULL) {
-        fwrite(content, size, 1, f);
-        fclose(f);
+    if (bn == NULL)
+        return;
 
-        if (etag) {
-            double tm = mtime(fn);
-            *etag = xs_fmt("W/\"snac-%.0lf\"", tm);
-        }
+    /* user queues are in user/<uid>/queue/ */
+    if (xs_startswith(fn, uprefix)) {
+        xs *l = xs_split_n(fn + strlen(uprefix), "/", 1);
+        uid = xs_dup(xs_list_get(l, 0));
     }
+
+    _queue_heap_push(hp, atol(bn + 1), fn, uid);
 }
 
 
-int history_get(snac *snac, const char *id, xs_str **content, int *size,
-                const char *inm, xs_str **etag)
+static void _queue_sched_add(const char *fn)
+/* adds a queue file to the schedule (mutex held) */
 {
-    xs *fn = _history_fn(snac, id);
+    _queue_heap_add(&queue_sched.hp, fn);
 
-    return _load_raw_file(fn, content, size, inm, etag);
+    if (queue_sched.pending != NULL) {
+        /* being reloaded: also keep it to be added to the new heap */
+        int paused = xs_arena_pause();
+        queue_sched.pending = xs_list_append(queue_sched.pending, fn);
+        xs_arena_resume(paused);
+    }
 }
 
 
-int history_del(snac *snac, const char *id)
-{
-    xs *fn = _history_fn(snac, id);
+/* The queue journal (if enabled) replaces the queue files written by the
+   server itself: items are appended to queue/journal/%08x.log as JSON
+   lines, and taking them out is just a short record. Big values (the
+   message, the serialized body, the keys) are stored apart, only once
+   for all the items that share them, like the retries of a message or
+   the deliveries of the same note to different inboxes. The journal is
+   rewritten with only the pending items when it grows too big. */
 
-    if (fn)
-        return unlink(fn);
-    else
-        return -1;
+typedef struct queue_jentry {
+    struct queue_jentry *next;
+    xs_str *fn;             /* (virtual) queue file */
+    xs_dict *item;          /* the item, without the big values */
+    xs_dict *refs;          /* keys of the big values -> their md5 */
+} queue_jentry;
+
+typedef struct queue_jblob {
+    struct queue_jblob *next;
+    xs_str *md5;            /* md5 of the value */
+    xs_val *v;              /* the value */
+    int refs;               /* items using it */
+} queue_jblob;
+
+#define QUEUE_JOURNAL_BUCKETS 4096
+#define QUEUE_JOURNAL_BLOB_MIN 256
+#define QUEUE_JOURNAL_SEG_MAX (16 * 1024 * 1024)
+
+static struct {
+    int on;                 /* the journal is being used */
+    FILE *f;                /* current segment */
+    int seg;                /* its number */
+    long size;              /* its size */
+    long ckpt_size;         /* its size after the last checkpoint */
+    queue_jentry *e[QUEUE_JOURNAL_BUCKETS];
+    queue_jblob *b[QUEUE_JOURNAL_BUCKETS];
+} queue_journal;
+
+
+static xs_str *_qj_fn(int seg)
+/* returns the file name of a journal segment */
+{
+    return xs_fmt("%s/queue/journal/%08x.log", srv_basedir, seg);
 }
 
 
-xs_list *history_list(snac *snac)
+static const char *_qj_rel(const char *fn)
+/* returns a queue file name relative to the base directory, as stored */
 {
-    xs *spec = xs_fmt("%s/history/" "*.html", snac->basedir);
+    int l = strlen(srv_basedir);
 
-    return xs_glob(spec, 1, 1);
+    if (strncmp(fn, srv_basedir, l) == 0 && fn[l] == '/')
+        return fn + l + 1;
+
+    return fn;
 }
 
 
-void lastlog_write(snac *snac, const char *source)
-/* writes the last time the user logged in */
+static queue_jentry **_qj_entry(const char *fn)
+/* returns a pointer to the link to an entry (or to the NULL link at the end) */
 {
-    xs *fn = xs_fmt("%s/lastlog.txt", snac->basedir);
-    FILE *f;
+    queue_jentry **pe = &queue_journal.e[xs_hash_func(fn, strlen(fn)) % QUEUE_JOURNAL_BUCKETS];
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%lf %s\n", ftime(), source);
-        fclose(f);
-    }
-}
+    while (*pe != NULL && strcmp((*pe)->fn, fn) != 0)
+        pe = &(*pe)->next;
 
+    return pe;
+}
 
-/** inbox collection **/
 
-void inbox_add(const char *inbox)
-/* collects a shared inbox */
+static queue_jblob **_qj_blob(const char *md5)
+/* returns a pointer to the link to a blob (or to the NULL link at the end) */
 {
-    /* don't collect ourselves */
-    if (xs_startswith(inbox, srv_baseurl))
-        return;
+    queue_jblob **pb = &queue_journal.b[xs_hash_func(md5, strlen(md5)) % QUEUE_JOURNAL_BUCKETS];
 
-    xs *md5 = xs_md5_hex(inbox, strlen(inbox));
-    xs *fn  = xs_fmt("%s/inbox/%s", srv_basedir, md5);
-    FILE *f;
+    while (*pb != NULL && strcmp((*pb)->md5, md5) != 0)
+        pb = &(*pb)->next;
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        fprintf(f, "%s\n", inbox);
-        fclose(f);
-    }
+    return pb;
 }
 
 
-void inbox_add_by_actor(const xs_dict *actor)
-/* collects an actor's shared inbox, if it has one */
+static void _qj_write(const xs_dict *rec)
+/* appends a record to the current segment */
 {
-    const char *v;
+    if (queue_journal.f == NULL)
+        return;
 
-    if (!xs_is_null(v = xs_dict_get(actor, "endpoints")) &&
-        !xs_is_null(v = xs_dict_get(v, "sharedInbox"))) {
-        /* only collect this inbox if its instance is not blocked */
-        if (!is_instance_blocked(v))
-            inbox_add(v);
-    }
+    xs *j = xs_json_dumps(rec, 0);
+
+    fprintf(queue_journal.f, "%s\n", j);
+    fflush(queue_journal.f);
+
+    queue_journal.size += strlen(j) + 1;
 }
 
 
-xs_list *inbox_list(void)
-/* returns the collected inboxes as a list */
+static void _qj_blob_new(const char *md5, const xs_val *v, int write)
+/* stores a big value, if not already stored */
 {
-    xs_list *ibl = xs_list_new();
-    xs *spec     = xs_fmt("%s/inbox/" "*", srv_basedir);
-    xs *files    = xs_glob(spec, 0, 0);
-    xs_list *p   = files;
-    const xs_val *v;
+    queue_jblob **pb = _qj_blob(md5);
 
-    while (xs_list_iter(&p, &v)) {
-        FILE *f;
+    if (*pb != NULL)
+        return;
 
-        if ((f = fopen(v, "r")) != NULL) {
-            xs *line = xs_readline(f);
+    int paused = xs_arena_pause();
 
-            if (line) {
-                line = xs_strip_i(line);
-                ibl  = xs_list_append(ibl, line);
-            }
+    *pb = xs_realloc(NULL, sizeof(queue_jblob));
+    **pb = (queue_jblob){ NULL, xs_dup(md5), xs_dup(v), 0 };
 
-            fclose(f);
-        }
-    }
+    xs_arena_resume(paused);
 
-    return ibl;
+    if (write) {
+        xs *rec = xs_dict_new();
+        rec = xs_dict_append(rec, "b", md5);
+        rec = xs_dict_append(rec, "v", v);
+        _qj_write(rec);
+    }
 }
 
 
-/** instance-wide operations **/
-
-xs_str *_instance_block_fn(const char *instance)
+static void _qj_link(const char *fn, const xs_dict *item, const xs_dict *refs)
+/* adds an entry, referencing its big values */
 {
-    xs *s   = xs_replace(instance, "http:/" "/", "");
-    xs *s1  = xs_replace(s, "https:/" "/", "");
-    xs *l   = xs_split(s1, "/");
-    const char *p = xs_list_get(l, 0);
-    xs *md5 = xs_md5_hex(p, strlen(p));
+    queue_jentry **pe = _qj_entry(fn);
+    const char *k, *md5;
+    int c = 0;
 
-    return xs_fmt("%s/block/%s", srv_basedir, md5);
-}
+    if (*pe != NULL)
+        return;
 
+    int paused = xs_arena_pause();
 
-int is_instance_blocked(const char *instance)
-{
-    xs *fn = _instance_block_fn(instance);
+    *pe = xs_realloc(NULL, sizeof(queue_jentry));
+    **pe = (queue_jentry){ NULL, xs_dup(fn), xs_dup(item), xs_dup(refs) };
 
-    return !!(mtime(fn) != 0.0);
+    xs_arena_resume(paused);
+
+    while (xs_dict_next(refs, &k, &md5, &c)) {
+        queue_jblob *b = *_qj_blob(md5);
+
+        if (b != NULL)
+            b->refs++;
+    }
 }
 
 
-int instance_block(const char *instance)
-/* blocks a full instance */
+static xs_dict *_qj_unlink(const char *fn)
+/* removes an entry, returning the full item */
 {
-    int ret;
-
-    /* create the subdir */
-    xs *dir = xs_fmt("%s/block/", srv_basedir);
-    mkdirx(dir);
+    queue_jentry **pe = _qj_entry(fn);
+    queue_jentry *e   = *pe;
+    const char *k, *md5;
+    int c = 0;
 
-    if (!is_instance_blocked(instance)) {
-        xs *fn = _instance_block_fn(instance);
-        FILE *f;
+    if (e == NULL)
+        return NULL;
 
-        if ((f = fopen(fn, "w")) != NULL) {
-            fprintf(f, "%s\n", instance);
-            fclose(f);
+    *pe = e->next;
 
-            ret = 0;
-        }
-        else
-            ret = -1;
-    }
-    else
-        ret = -2;
+    xs_dict *item = e->item;
 
-    return ret;
-}
+    while (xs_dict_next(e->refs, &k, &md5, &c)) {
+        queue_jblob **pb = _qj_blob(md5);
+        queue_jblob *b   = *pb;
 
+        if (b == NULL)
+            continue;
 
-int instance_unblock(const char *instance)
-/* unblocks a full instance */
-{
-    int ret;
+        item = xs_dict_set(item, k, b->v);
 
-    if (is_instance_blocked(instance)) {
-        xs *fn = _instance_block_fn(instance);
-        ret = unlink(fn);
+        /* unused blobs are kept until the next checkpoint,
+           as the item may be enqueued again for a retry */
+        b->refs--;
     }
-    else
-        ret = -2;
 
-    return ret;
-}
+    xs_free(e->fn);
+    xs_free(e->refs);
+    xs_free(e);
 
+    return item;
+}
 
-/** operations by content **/
 
-int content_match(const char *file, const xs_dict *msg)
-/* checks if a message's content matches any of the regexes in file */
-/* file format: one regex per line */
+static void _qj_blob_purge(void)
+/* drops the blobs no pending item uses */
 {
-    xs *fn = xs_fmt("%s/%s", srv_basedir, file);
-    FILE *f;
-    int r = 0;
-    const char *v = xs_dict_get(msg, "content");
-
-    if (xs_type(v) == XSTYPE_STRING && *v) {
-        if ((f = fopen(fn, "r")) != NULL) {
-            srv_debug(1, xs_fmt("content_match: loading regexes from %s", fn));
+    int n;
 
-            /* massage content (strip HTML tags, etc.) */
-            xs *c = xs_regex_replace(v, "<[^>]+>", " ");
-            c = xs_regex_replace_i(c, " {2,}", " ");
-            c = xs_tolower_i(c);
+    for (n = 0; n < QUEUE_JOURNAL_BUCKETS; n++) {
+        queue_jblob **pb = &queue_journal.b[n];
 
-            while (!r && !feof(f)) {
-                xs *rx = xs_strip_i(xs_readline(f));
+        while (*pb != NULL) {
+            queue_jblob *b = *pb;
 
-                if (*rx && xs_regex_match(c, rx)) {
-                    srv_debug(1, xs_fmt("content_match: match for '%s'", rx));
-                    r = 1;
-                }
+            if (b->refs <= 0) {
+                *pb = b->next;
+                xs_free(b->md5);
+                xs_free(b->v);
+                xs_free(b);
             }
-
-            fclose(f);
+            else
+                pb = &b->next;
         }
     }
-
-    return r;
 }
 
 
-xs_list *content_search(snac *user, const char *regex,
-                int priv, int skip, int show, int max_secs, int *timeout)
-/* returns a list of posts which content matches the regex */
+static void _qj_checkpoint(void)
+/* writes a new segment with only the pending items and deletes the old ones */
 {
-    if (regex == NULL || *regex == '\0')
-        return xs_list_new();
-
-    xs *i_regex = xs_tolower_i(xs_dup(regex));
-
-    xs_set seen;
+    int seg = queue_journal.seg + 1;
+    xs *nfn = _qj_fn(seg);
+    FILE *f;
+    int n;
 
-    xs_set_init(&seen);
+    if ((f = fopen(nfn, "w")) == NULL) {
+        srv_log(xs_fmt("cannot create queue journal %s", nfn));
+        return;
+    }
 
-    if (max_secs == 0)
-        max_secs = 3;
+    if (queue_journal.f != NULL)
+        fclose(queue_journal.f);
 
-    time_t t = time(NULL) + max_secs;
-    *timeout = 0;
+    queue_journal.f    = f;
+    queue_journal.seg  = seg;
+    queue_journal.size = 0;
 
-    /* iterate all timelines simultaneously */
-    xs_list *tls[3] = {0};
-    const char *md5s[3] = {0};
-    int c[3] = {0};
+    _qj_blob_purge();
 
-    tls[0] = timeline_simple_list(user, "public", 0, XS_ALL);   /* public */
-    tls[1] = timeline_instance_list(0, XS_ALL); /* instance */
-    tls[2] = priv ? timeline_simple_list(user, "private", 0, XS_ALL) : xs_list_new(); /* private or none */
+    /* blobs go first, so that they are there when replaying the entries */
+    for (n = 0; n < QUEUE_JOURNAL_BUCKETS; n++) {
+        queue_jblob *b;
 
-    /* first positioning */
-    for (int n = 0; n < 3; n++)
-        xs_list_next(tls[n], &md5s[n], &c[n]);
+        for (b = queue_journal.b[n]; b != NULL; b = b->next) {
+            xs *rec = xs_dict_new();
+            rec = xs_dict_append(rec, "b", b->md5);
+            rec = xs_dict_append(rec, "v", b->v);
+            _qj_write(rec);
+        }
+    }
 
-    show += skip;
+    for (n = 0; n < QUEUE_JOURNAL_BUCKETS; n++) {
+        queue_jentry *e;
 
-    while (show > 0) {
-        /* timeout? */
-        if (time(NULL) > t) {
-            *timeout = 1;
-            break;
+        for (e = queue_journal.e[n]; e != NULL; e = e->next) {
+            xs *rec = xs_dict_new();
+            rec = xs_dict_append(rec, "a", _qj_rel(e->fn));
+            rec = xs_dict_append(rec, "i", e->item);
+            rec = xs_dict_append(rec, "r", e->refs);
+            _qj_write(rec);
         }
+    }
 
-        /* find the newest post */
-        int newest = -1;
-        double mtime = 0.0;
+    queue_journal.ckpt_size = queue_journal.size;
 
-        for (int n = 0; n < 3; n++) {
-            if (md5s[n] != NULL) {
-                xs *fn = _object_fn_by_md5(md5s[n], "content_search");
-                double mt = mtime(fn);
+    /* the previous segments are no longer needed */
+    xs *spec = xs_fmt("%s/queue/journal/" "*.log", srv_basedir);
+    xs *segs = xs_glob(spec, 0, 0);
+    xs_list *p = segs;
+    const char *v;
 
-                if (mt > mtime) {
-                    newest = n;
-                    mtime = mt;
-                }
-            }
-        }
+    while (xs_list_iter(&p, &v)) {
+        if (strcmp(v, nfn) != 0)
+            unlink(v);
+    }
+}
 
-        if (newest == -1)
-            break;
 
-        const char *md5 = md5s[newest];
+static void _qj_replay(void)
+/* loads the pending items from the journal segments */
+{
+    xs *spec = xs_fmt("%s/queue/journal/" "*.log", srv_basedir);
+    xs *segs = xs_glob(spec, 0, 0);
+    xs_list *p = segs;
+    const char *v;
 
-        /* advance the chosen timeline */
-        if (!xs_list_next(tls[newest], &md5s[newest], &c[newest]))
-            md5s[newest] = NULL;
+    while (xs_list_iter(&p, &v)) {
+        FILE *f;
+        const char *bn = strrchr(v, '/') + 1;
+        int seg = (int) strtol(bn, NULL, 16);
 
-        xs *post = NULL;
+        if (seg > queue_journal.seg)
+            queue_journal.seg = seg;
 
-        if (!valid_status(object_get_by_md5(md5, &post)))
+        if ((f = fopen(v, "r")) == NULL)
             continue;
 
-        if (!xs_match(xs_dict_get_def(post, "type", "-"), POSTLIKE_OBJECT_TYPE))
-            continue;
+        for (;;) {
+            xs *l = xs_readline(f);
 
-        const char *id = xs_dict_get(post, "id");
+            if (l == NULL || *l == '\0')
+                break;
 
-        if (id == NULL || is_hidden(user, id))
-            continue;
+            /* a broken last line (e.g. after a crash) is just skipped */
+            xs *rec = xs_json_loads(l);
+            const char *k;
+            xs *fn = NULL;
 
-        const char *content = xs_dict_get(post, "content");
+            if (xs_type(rec) != XSTYPE_DICT)
+                continue;
 
-        if (xs_is_null(content))
-            continue;
+            if ((k = xs_dict_get(rec, "b")) != NULL)
+                _qj_blob_new(k, xs_dict_get(rec, "v"), 0);
+            else
+            if ((k = xs_dict_get(rec, "a")) != NULL) {
+                const xs_dict *item = xs_dict_get(rec, "i");
+                const xs_dict *refs = xs_dict_get(rec, "r");
 
-        /* strip HTML */
-        xs *c = xs_regex_replace(content, "<[^>]+>", " ");
-        c = xs_regex_replace_i(c, " {2,}", " ");
-        c = xs_tolower_i(c);
+                fn = xs_fmt("%s/%s", srv_basedir, k);
 
-        /* apply regex */
-        if (xs_regex_match(c, i_regex)) {
-            if (xs_set_add(&seen, md5) == 1)
-            show--;
+                if (xs_type(item) == XSTYPE_DICT && xs_type(refs) == XSTYPE_DICT)
+                    _qj_link(fn, item, refs);
+            }
+            else
+            if ((k = xs_dict_get(rec, "d")) != NULL) {
+                fn = xs_fmt("%s/%s", srv_basedir, k);
+                xs *item = _qj_unlink(fn);
+            }
         }
+
+        fclose(f);
     }
 
-    xs_list *r = xs_set_result(&seen);
+}
 
-    if (skip) {
-        /* BAD */
-        while (skip--) {
-            r = xs_list_del(r, 0);
+
+static void _qj_put(const char *fn, const xs_dict *msg)
+/* appends an item to the journal */
+{
+    xs *item = xs_dict_new();
+    xs *refs = xs_dict_new();
+    const char *k;
+    const xs_val *v;
+    int c = 0;
+
+    /* store the big values apart */
+    while (xs_dict_next(msg, &k, &v, &c)) {
+        if (xs_size(v) > QUEUE_JOURNAL_BLOB_MIN) {
+            xs *md5 = xs_md5_hex(v, xs_size(v));
+
+            _qj_blob_new(md5, v, 1);
+            refs = xs_dict_append(refs, k, md5);
         }
+        else
+            item = xs_dict_append(item, k, v);
     }
 
-    xs_free(tls[0]);
-    xs_free(tls[1]);
-    xs_free(tls[2]);
+    _qj_link(fn, item, refs);
 
-    return r;
-}
+    xs *rec = xs_dict_new();
+    rec = xs_dict_append(rec, "a", _qj_rel(fn));
+    rec = xs_dict_append(rec, "i", item);
+    rec = xs_dict_append(rec, "r", refs);
+    _qj_write(rec);
 
+    /* too big? rewrite it */
+    if (queue_journal.size > QUEUE_JOURNAL_SEG_MAX &&
+        queue_journal.size > 2 * queue_journal.ckpt_size)
+        _qj_checkpoint();
+}
 
-/** notifications **/
 
-xs_str *notify_check_time(snac *snac, int reset)
-/* gets or resets the latest notification check time */
+static xs_dict *_qj_take(const char *fn)
+/* takes an item from the journal */
 {
-    xs_str *t = NULL;
-    xs *fn    = xs_fmt("%s/notifydate.txt", snac->basedir);
-    FILE *f;
+    xs_dict *item = _qj_unlink(fn);
 
-    if (reset) {
-        if ((f = fopen(fn, "w")) != NULL) {
-            t = tid(0);
-            fprintf(f, "%s\n", t);
-            fclose(f);
-        }
-    }
-    else {
-        if ((f = fopen(fn, "r")) != NULL) {
-            t = xs_readline(f);
-            fclose(f);
-        }
-        else
-            /* never set before */
-            t = xs_fmt("%16.6f", 0.0);
+    if (item != NULL) {
+        xs *rec = xs_dict_new();
+        rec = xs_dict_append(rec, "d", _qj_rel(fn));
+        _qj_write(rec);
     }
 
-    return t;
+    return item;
 }
 
 
-void notify_add(snac *snac, const char *type, const char *utype,
-                const char *actor, const char *objid)
-/* adds a new notification */
+static void _queue_sched_load(void)
+/* rebuilds the heap from all the queue directories and starts using it */
 {
-    xs *ntid = tid(0);
-    xs *fn   = xs_fmt("%s/notify/", snac->basedir);
-    xs *date = xs_str_utctime(0, ISO_DATE_SPEC);
-    FILE *f;
+    queue_heap nh = {0};
+    queue_heap oh;
+    time_t t = time(NULL);
 
-    /* create the directory */
-    mkdirx(fn);
-    fn = xs_str_cat(fn, ntid);
-    fn = xs_str_cat(fn, ".json");
+    /* get the stamp before globbing, so that nothing is missed */
+    double stamp = _queue_stamp();
 
-    xs *noti = xs_dict_new();
+    pthread_mutex_lock(&queue_sched.mutex);
 
-    noti = xs_dict_append(noti, "id",    ntid);
-    noti = xs_dict_append(noti, "type",  type);
-    noti = xs_dict_append(noti, "utype", utype);
-    noti = xs_dict_append(noti, "actor", actor);
-    noti = xs_dict_append(noti, "date",  date);
+    int paused = xs_arena_pause();
+    queue_sched.pending = xs_list_new();
+    xs_arena_resume(paused);
 
-    if (!xs_is_null(objid))
-        noti = xs_dict_append(noti, "objid", objid);
+    /* the items in the journal are only in memory */
+    if (queue_journal.on) {
+        int n;
 
-    if ((f = fopen(fn, "w")) != NULL) {
-        xs_json_dump(noti, 4, f);
-        fclose(f);
+        for (n = 0; n < QUEUE_JOURNAL_BUCKETS; n++) {
+            queue_jentry *e;
+
+            for (e = queue_journal.e[n]; e != NULL; e = e->next)
+                _queue_heap_add(&nh, e->fn);
+        }
     }
 
-    /* add it to the index if it already exists */
-    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
+    pthread_mutex_unlock(&queue_sched.mutex);
 
-    if (mtime(idx) != 0.0) {
-        pthread_mutex_lock(&data_mutex);
+    xs *specs = xs_list_new();
+    xs *users = user_list();
+    const char *v;
+    xs_list *p;
 
-        if ((f = fopen(idx, "a")) != NULL) {
-            fprintf(f, "%-32s\n", ntid);
-            fclose(f);
-        }
+    {
+        xs *spec = xs_fmt("%s/queue/" "*.json", srv_basedir);
+        specs = xs_list_append(specs, spec);
+    }
 
-        pthread_mutex_unlock(&data_mutex);
+    p = users;
+    while (xs_list_iter(&p, &v)) {
+        xs *spec = xs_fmt("%s/user/%s/queue/" "*.json", srv_basedir, v);
+        specs = xs_list_append(specs, spec);
     }
-}
 
+    p = specs;
+    while (xs_list_iter(&p, &v)) {
+        xs *fns = xs_glob(v, 0, 0);
+        xs_list *q = fns;
+        const char *fn;
 
-xs_dict *notify_get(snac *snac, const char *id)
-/* gets a notification */
-{
-    /* base file */
-    xs *fn = xs_fmt("%s/notify/%s", snac->basedir, id);
+        while (xs_list_iter(&q, &fn))
+            _queue_heap_add(&nh, fn);
+    }
 
-    /* strip spaces and add extension */
-    fn = xs_strip_i(fn);
-    fn = xs_str_cat(fn, ".json");
+    pthread_mutex_lock(&queue_sched.mutex);
 
-    FILE *f;
-    xs_dict *out = NULL;
+    /* add the files enqueued while globbing; if one was also found
+       by the glob, the second dequeue() of it just returns NULL */
+    p = queue_sched.pending;
+    while (xs_list_iter(&p, &v))
+        _queue_heap_add(&nh, v);
 
-    if ((f = fopen(fn, "r")) != NULL) {
-        out = xs_json_load(f);
-        fclose(f);
-    }
+    paused = xs_arena_pause();
+    queue_sched.pending = xs_free(queue_sched.pending);
+    xs_arena_resume(paused);
 
-    return out;
-}
+    oh = queue_sched.hp;
+    queue_sched.hp     = nh;
+    queue_sched.stamp  = stamp;
+    queue_sched.loaded = t;
 
+    pthread_mutex_unlock(&queue_sched.mutex);
 
-xs_list *notify_list(snac *snac, int skip, int show)
-/* returns a list of notification ids */
-{
-    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
+    paused = xs_arena_pause();
+    _queue_heap_free(&oh);
+    xs_arena_resume(paused);
 
-    if (mtime(idx) == 0.0) {
-        /* create the index from scratch */
-        FILE *f;
+    srv_debug(1, xs_fmt("queue schedule loaded (%d entries)", nh.n));
+}
 
-        pthread_mutex_lock(&data_mutex);
 
-        if ((f = fopen(idx, "w")) != NULL) {
-            xs *spec = xs_fmt("%s/notify/" "*.json", snac->basedir);
-            xs *lst  = xs_glob(spec, 1, 0);
-            xs_list *p = lst;
-            const char *v;
+void queue_sched_start(void)
+/* starts using the in-memory queue schedule (server only) */
+{
+    pthread_mutex_lock(&queue_sched.mutex);
 
-            while (xs_list_iter(&p, &v)) {
-                char *p = strrchr(v, '.');
-                if (p) {
-                    *p = '\0';
-                    fprintf(f, "%-32s\n", v);
-                }
-            }
+    queue_sched.on = 1;
 
-            fclose(f);
-        }
+    if (xs_type(xs_dict_get(srv_config, "queue_journal")) == XSTYPE_TRUE) {
+        xs *jdir = xs_fmt("%s/queue/journal", srv_basedir);
+        mkdirx(jdir);
 
-        pthread_mutex_unlock(&data_mutex);
+        _qj_replay();
+        _qj_checkpoint();
+
+        queue_journal.on = queue_journal.f != NULL;
     }
 
-    return index_list_desc(idx, skip, show);
+    pthread_mutex_unlock(&queue_sched.mutex);
+
+    _queue_sched_load();
 }
 
 
-int notify_new_num(snac *snac)
-/* counts the number of new notifications */
+void queue_sched_add(const char *fn)
+/* notifies that a file has been added to a queue */
 {
-    xs *t = notify_check_time(snac, 0);
-    xs *lst = notify_list(snac, 0, XS_ALL);
-    int cnt = 0;
-
-    xs_list *p = lst;
-    const xs_str *v;
-
-    while (xs_list_iter(&p, &v)) {
-        xs *id = xs_strip_i(xs_dup(v));
+    pthread_mutex_lock(&queue_sched.mutex);
 
-        /* old? count no more */
-        if (strcmp(id, t) < 0)
-            break;
+    if (queue_sched.on)
+        _queue_sched_add(fn);
+    else {
+        /* tell the server */
+        xs *sfn = xs_fmt("%s/queue/.changed", srv_basedir);
+        FILE *f;
 
-        cnt++;
+        if ((f = fopen(sfn, "w")) != NULL)
+            fclose(f);
     }
 
-    return cnt;
+    pthread_mutex_unlock(&queue_sched.mutex);
 }
 
 
-void notify_clear(snac *snac)
-/* clears all notifications */
+xs_list *queue_sched_due(time_t *next)
+/* returns the due queue files as a list of [ uid, fn ] pairs
+   (with uid being null for the global queue), taking them out
+   of the schedule; next is set to the next retry time, or 0 */
 {
-    xs *spec   = xs_fmt("%s/notify/" "*", snac->basedir);
-    xs *lst    = xs_glob(spec, 0, 0);
-    xs_list *p = lst;
-    const xs_str *v;
+    xs_list *list = xs_list_new();
+    time_t t = time(NULL);
 
-    while (xs_list_iter(&p, &v))
-        unlink(v);
+    /* was anything enqueued from outside? */
+    pthread_mutex_lock(&queue_sched.mutex);
+    int due = t - queue_sched.loaded >= QUEUE_SCHED_RELOAD || _queue_stamp() != queue_sched.stamp;
+    pthread_mutex_unlock(&queue_sched.mutex);
 
-    xs *idx = xs_fmt("%s/notify.idx", snac->basedir);
+    if (due)
+        _queue_sched_load();
 
-    if (mtime(idx) != 0.0) {
-        pthread_mutex_lock(&data_mutex);
-        truncate(idx, 0);
-        pthread_mutex_unlock(&data_mutex);
+    pthread_mutex_lock(&queue_sched.mutex);
+
+    while (queue_sched.hp.n > 0 && queue_sched.hp.h[0].t <= t) {
+        queue_entry e = _queue_heap_pop(&queue_sched.hp);
+        xs *pair = xs_list_new();
+
+        pair = xs_list_append(pair, e.uid ? (xs_val *)e.uid : xs_stock(XSTYPE_NULL));
+        pair = xs_list_append(pair, e.fn);
+        list = xs_list_append(list, pair);
+
+        xs_free(e.fn);
+        xs_free(e.uid);
     }
-}
 
+    *next = queue_sched.hp.n > 0 ? queue_sched.hp.h[0].t : 0;
+
+    pthread_mutex_unlock(&queue_sched.mutex);
+
+    return list;
+}
 
-/** the queue **/
 
 static xs_dict *_enqueue_put(const char *fn, xs_dict *msg)
 /* writes safely to the queue */
@@ -2613,11 +6448,25 @@ static xs_dict *_enqueue_put(const char *fn, xs_dict *msg)
     xs *tfn = xs_fmt("%s.tmp", fn);
     FILE *f;
 
+    pthread_mutex_lock(&queue_sched.mutex);
+
+    if (queue_journal.on) {
+        _qj_put(fn, msg);
+        _queue_sched_add(fn);
+
+        pthread_mutex_unlock(&queue_sched.mutex);
+        return msg;
+    }
+
+    pthread_mutex_unlock(&queue_sched.mutex);
+
     if ((f = fopen(tfn, "w")) != NULL) {
-        xs_json_dump(msg, 4, f);
+        xs_json_dump(msg, json_indent(), f);
         fclose(f);
 
         rename(tfn, fn);
+
+        queue_sched_add(fn);
     }
 
     return msg;
@@ -2672,9 +6521,9 @@ void enqueue_shared_input(const xs_dict *msg, const xs_dict *req, int retries)
 }
 
 
-void enqueue_output_raw(const char *keyid, const char *seckey,
-                        const xs_dict *msg, const xs_str *inbox,
-                        int retries, int p_status)
+static void _enqueue_output(const char *keyid, const char *seckey,
+                            const xs_dict *msg, const xs_str *body, const xs_str *digest,
+                            const xs_str *inbox, int retries, int p_status)
 /* enqueues an output message to an inbox */
 {
     xs *qmsg   = _new_qmsg("output", msg, retries);
@@ -2688,8 +6537,14 @@ void enqueue_output_raw(const char *keyid, const char *seckey,
     qmsg = xs_dict_append(qmsg, "keyid",  keyid);
     qmsg = xs_dict_append(qmsg, "seckey", seckey);
 
+    /* already serialized body and its digest */
+    if (body != NULL && digest != NULL) {
+        qmsg = xs_dict_append(qmsg, "body",   body);
+        qmsg = xs_dict_append(qmsg, "digest", digest);
+    }
+
     /* if it's to be sent right now, bypass the disk queue and post the job */
-    if (retries == 0 && p_state != NULL)
+    if (retries == 0 && p_state != NULL && !job_queue_full())
         job_post(qmsg, 0);
     else {
         qmsg = _enqueue_put(fn, qmsg);
@@ -2698,6 +6553,37 @@ void enqueue_output_raw(const char *keyid, const char *seckey,
 }
 
 
+void enqueue_output_raw(const char *keyid, const char *seckey,
+                        const xs_dict *msg, const xs_str *inbox,
+                        int retries, int p_status)
+/* enqueues an output message to an inbox */
+{
+    _enqueue_output(keyid, seckey, msg, NULL, NULL, inbox, retries, p_status);
+}
+
+
+void enqueue_output_park(const xs_dict *q_item, int secs)
+/* puts an output message back in the queue for some seconds,
+   without counting it as a retry (it was not even tried) */
+{
+    xs *qmsg = xs_dup(q_item);
+    xs *ntid = tid(secs);
+    xs *fn   = xs_fmt("%s/queue/%s.json", srv_basedir, ntid);
+
+    qmsg = xs_dict_set(qmsg, "ntid", ntid);
+
+    /* keep when it was first parked */
+    if (xs_type(xs_dict_get(qmsg, "parked")) != XSTYPE_NUMBER) {
+        xs *now = xs_number_new(time(NULL));
+        qmsg = xs_dict_set(qmsg, "parked", now);
+    }
+
+    qmsg = _enqueue_put(fn, qmsg);
+
+    srv_debug(1, xs_fmt("enqueue_output_park %s %s %d", xs_dict_get(qmsg, "inbox"), fn, secs));
+}
+
+
 void enqueue_output(snac *snac, const xs_dict *msg,
                     const xs_str *inbox, int retries, int p_status)
 /* enqueues an output message to an inbox */
@@ -2713,6 +6599,23 @@ void enqueue_output(snac *snac, const xs_dict *msg,
 }
 
 
+void enqueue_output_wave(snac *snac, const xs_dict *msg,
+                         const xs_str *body, const xs_str *digest,
+                         const xs_str *inbox)
+/* enqueues an output message to an inbox, as part of a delivery wave
+   (all of them share the same already serialized body and digest) */
+{
+    if (xs_startswith(inbox, snac->actor)) {
+        snac_debug(snac, 1, xs_str_new("refusing enqueue to myself"));
+        return;
+    }
+
+    const char *seckey = xs_dict_get(snac->key, "secret");
+
+    _enqueue_output(snac->actor, seckey, msg, body, digest, inbox, 0, 0);
+}
+
+
 void enqueue_output_by_actor(snac *snac, const xs_dict *msg,
                             const xs_str *actor, int retries)
 /* enqueues an output message for an actor */
@@ -2944,7 +6847,19 @@ xs_dict *queue_get(const char *fn)
 xs_dict *dequeue(const char *fn)
 /* dequeues a message */
 {
-    xs_dict *obj = queue_get(fn);
+    xs_dict *obj = NULL;
+
+    pthread_mutex_lock(&queue_sched.mutex);
+
+    if (queue_journal.on)
+        obj = _qj_take(fn);
+
+    pthread_mutex_unlock(&queue_sched.mutex);
+
+    if (obj != NULL)
+        return obj;
+
+    obj = queue_get(fn);
 
     unlink(fn);
 
@@ -3052,9 +6967,9 @@ void purge_server(void)
 
                     if (ext) {
                         *ext = '\0';
-                        o = xs_str_cat(o, ".json");
+                        xs *l = xs_split(o, "/");
 
-                        if (mtime(o) == 0.0) {
+                        if (!object_here_by_md5(xs_list_get(l, -1))) {
                             /* delete */
                             unlink(v2);
                             srv_debug(1, xs_fmt("purged %s", v2));
@@ -3076,6 +6991,36 @@ void purge_server(void)
         }
     }
 
+    {
+        /* purge old packed objects (they are never linked) */
+        xs *pl = _pack_list(mt);
+
+        p = pl;
+        while (xs_list_iter(&p, &v)) {
+            object_del_by_md5(v);
+            cnt++;
+        }
+
+        _pack_compact();
+    }
+
+    {
+        /* purge the summaries of the actors that are no longer here */
+        xs *spec = xs_fmt("%s/actor/??" "/*.json", srv_basedir);
+        xs *files = xs_glob(spec, 0, 0);
+
+        p = files;
+        while (xs_list_iter(&p, &v)) {
+            xs *s1 = xs_replace(v, ".json", "");
+            xs *l  = xs_split(s1, "/");
+
+            if (!object_here_by_md5(xs_list_get(l, -1))) {
+                unlink(v);
+                srv_debug(1, xs_fmt("purged %s", v));
+            }
+        }
+    }
+
     /* purge collected inboxes */
     xs *ib_dir = xs_fmt("%s/inbox", srv_basedir);
     _purge_dir(ib_dir, 7);
@@ -3112,8 +7057,39 @@ void purge_server(void)
         }
     }
 
+    /* purge the full-text search index */
+    xs *search_spec = xs_fmt("%s/search/??", srv_basedir);
+    xs *search_dirs = xs_glob(search_spec, 0, 0);
+    p = search_dirs;
+
+    int search_gc = 0;
+    while (xs_list_iter(&p, &v)) {
+        xs *spec2 = xs_fmt("%s/" "*.idx", v);
+        xs *files = xs_glob(spec2, 0, 0);
+        xs_list *p2;
+        const xs_str *v2;
+
+        p2 = files;
+        while (xs_list_iter(&p2, &v2)) {
+            search_gc += index_gc(v2);
+            xs *bak = xs_fmt("%s.bak", v2);
+            unlink(bak);
+
+            /* no post has this word anymore */
+            if (index_len(v2) == 0)
+                unlink(v2);
+        }
+    }
+
+    xs *docs_fn = xs_fmt("%s/search/docs.idx", srv_basedir);
+
+    if (index_gc(docs_fn) >= 0) {
+        xs *bak = xs_fmt("%s.bak", docs_fn);
+        unlink(bak);
+    }
+
     srv_debug(1, xs_fmt("purge: global "
-            "(obj: %d, idx: %d, itl: %d, tag: %d)", cnt, icnt, itl_gc, tag_gc));
+            "(obj: %d, idx: %d, itl: %d, tag: %d, search: %d)", cnt, icnt, itl_gc, tag_gc, search_gc));
 }
 
 
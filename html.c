@@ -249,7 +249,7 @@ xs_html *html_msg_icon(snac *user, const char *actor_id, const xs_dict *msg)
     xs *actor = NULL;
     xs_html *actor_icon = NULL;
 
-    if (actor_id && valid_status(actor_get_refresh(user, actor_id, &actor))) {
+    if (actor_id && valid_status(actor_summary_get_refresh(user, actor_id, &actor))) {
         const char *date  = NULL;
         const char *udate = NULL;
         const char *url   = NULL;
@@ -750,7 +750,7 @@ static xs_html *html_user_body(snac *user, int read_only)
                     xs_html_sctag("input",
                         xs_html_attr("type", "text"),
                         xs_html_attr("name", "q"),
-                        xs_html_attr("title", L("Search posts by content (regular expression) or #tag")),
+                        xs_html_attr("title", L("Search posts by content (words, \"phrases\" or regular expression) or #tag")),
                         xs_html_attr("placeholder", L("Content search")))));
     }
 
@@ -1384,8 +1384,10 @@ xs_html *html_entry_controls(snac *snac, const char *actor,
 xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
                    int level, const char *md5, int hide_children)
 {
-    const char *id    = xs_dict_get(msg, "id");
-    const char *type  = xs_dict_get(msg, "type");
+    /* the message fields are looked up many times */
+    xs_idx mi = xs_dict_idx_new(msg);
+    const char *id    = xs_dict_idx_get(&mi, "id");
+    const char *type  = xs_dict_idx_get(&mi, "type");
     const char *actor;
     const char *v;
     int has_title = 0;
@@ -1417,7 +1419,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
                 xs_html_tag("div",
                     xs_html_attr("class", "snac-origin"),
                     xs_html_text(L("follows you"))),
-                html_msg_icon(read_only ? NULL : user, xs_dict_get(msg, "actor"), msg)));
+                html_msg_icon(read_only ? NULL : user, xs_dict_idx_get(&mi, "actor"), msg)));
     }
     else
     if (!xs_match(type, POSTLIKE_OBJECT_TYPE)) {
@@ -1427,7 +1429,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
     }
 
     /* ignore notes with "name", as they are votes to Questions */
-    if (strcmp(type, "Note") == 0 && !xs_is_null(xs_dict_get(msg, "name")))
+    if (strcmp(type, "Note") == 0 && !xs_is_null(xs_dict_idx_get(&mi, "name")))
         return NULL;
 
     /* get the attributedTo */
@@ -1572,7 +1574,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
     if (strcmp(type, "Note") == 0) {
         if (level == 0) {
             /* is the parent not here? */
-            const char *parent = xs_dict_get(msg, "inReplyTo");
+            const char *parent = xs_dict_idx_get(&mi, "inReplyTo");
 
             if (user && !xs_is_null(parent) && *parent && !timeline_here(user, parent)) {
                 xs_html_add(post_header,
@@ -1598,7 +1600,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
     xs_html_add(entry,
         snac_content_wrap);
 
-    if (!has_title && !xs_is_null(v = xs_dict_get(msg, "name"))) {
+    if (!has_title && !xs_is_null(v = xs_dict_idx_get(&mi, "name"))) {
         xs_html_add(snac_content_wrap,
             xs_html_tag("h3",
                 xs_html_attr("class", "snac-entry-title"),
@@ -1609,10 +1611,10 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
 
     xs_html *snac_content = NULL;
 
-    v = xs_dict_get(msg, "summary");
+    v = xs_dict_idx_get(&mi, "summary");
 
     /* is it sensitive? */
-    if (user && xs_type(xs_dict_get(msg, "sensitive")) == XSTYPE_TRUE) {
+    if (user && xs_type(xs_dict_idx_get(&mi, "sensitive")) == XSTYPE_TRUE) {
         if (xs_is_null(v) || *v == '\0')
             v = "...";
 
@@ -1646,7 +1648,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
 
     {
         /** build the content string **/
-        const char *content = xs_dict_get(msg, "content");
+        const char *content = xs_dict_idx_get(&mi, "content");
 
         xs *c = sanitize(xs_is_null(content) ? "" : content);
 
@@ -1661,10 +1663,10 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
         c = xs_str_cat(c, "<p>");
 
         /* replace the :shortnames: */
-        c = replace_shortnames(c, xs_dict_get(msg, "tag"), 2);
+        c = replace_shortnames(c, xs_dict_idx_get(&mi, "tag"), 2);
 
         /* Peertube videos content is in markdown */
-        const char *mtype = xs_dict_get(msg, "mediaType");
+        const char *mtype = xs_dict_idx_get(&mi, "mediaType");
         if (xs_type(mtype) == XSTYPE_STRING && strcmp(mtype, "text/markdown") == 0) {
             /* a full conversion could be better */
             c = xs_replace_i(c, "\r", "");
@@ -1677,8 +1679,8 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
     }
 
     if (strcmp(type, "Question") == 0) { /** question content **/
-        const xs_list *oo = xs_dict_get(msg, "oneOf");
-        const xs_list *ao = xs_dict_get(msg, "anyOf");
+        const xs_list *oo = xs_dict_idx_get(&mi, "oneOf");
+        const xs_list *ao = xs_dict_idx_get(&mi, "anyOf");
         const xs_list *p;
         const xs_dict *v;
         int closed = 0;
@@ -1695,7 +1697,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
         if (user && was_question_voted(user, id))
             closed = 1; /* we already voted; closed for us */
 
-        if ((f_closed = xs_dict_get(msg, "closed")) != NULL) {
+        if ((f_closed = xs_dict_idx_get(&mi, "closed")) != NULL) {
             /* it has a closed date... but is it in the past? */
             time_t t0 = time(NULL);
             time_t t1 = xs_parse_iso_date(f_closed, 0);
@@ -1793,12 +1795,12 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
         }
         else {
             /* show when the poll closes */
-            const char *end_time = xs_dict_get(msg, "endTime");
+            const char *end_time = xs_dict_idx_get(&mi, "endTime");
 
             /* Pleroma does not have an endTime field;
                it has a closed time in the future */
             if (xs_is_null(end_time))
-                end_time = xs_dict_get(msg, "closed");
+                end_time = xs_dict_idx_get(&mi, "closed");
 
             if (!xs_is_null(end_time)) {
                 time_t t0 = time(NULL);
@@ -1905,7 +1907,7 @@ xs_html *html_entry(snac *user, xs_dict *msg, int read_only,
     }
 
     /* has this message an audience (i.e., comes from a channel or community)? */
-    const char *audience = xs_dict_get(msg, "audience");
+    const char *audience = xs_dict_idx_get(&mi, "audience");
     if (strcmp(type, "Page") == 0 && !xs_is_null(audience)) {
         xs_html *au_tag = xs_html_tag("p",
             xs_html_text("("),
@@ -10,13 +10,92 @@
 
 #include "snac.h"
 
+#include <pthread.h>
+
+/* parsed keys, as un-PEMing them costs as much as signing */
+
+#ifndef KEY_CACHE_SIZE
+#define KEY_CACHE_SIZE 512
+#endif
+
+static struct {
+    unsigned int hash;          /* hash of the PEM text */
+    xs_str *pem;                /* the PEM text */
+    struct evp_pkey_st *pkey;   /* the parsed key */
+    unsigned int tick;          /* last time used */
+} key_cache[KEY_CACHE_SIZE];
+
+static unsigned int key_cache_tick = 0;
+static pthread_mutex_t key_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static struct evp_pkey_st *_key_get(const char *pem, int priv)
+/* returns a parsed key (to be freed with xs_evp_pkey_free()) */
+{
+    unsigned int hash = xs_hash_func(pem, strlen(pem));
+    struct evp_pkey_st *pkey = NULL;
+    int n, lru = 0;
+
+    pthread_mutex_lock(&key_cache_mutex);
+
+    for (n = 0; n < KEY_CACHE_SIZE; n++) {
+        if (key_cache[n].pem != NULL && key_cache[n].hash == hash &&
+            strcmp(key_cache[n].pem, pem) == 0) {
+            key_cache[n].tick = ++key_cache_tick;
+            pkey = xs_evp_pkey_ref(key_cache[n].pkey);
+            break;
+        }
+
+        if (key_cache[n].tick < key_cache[lru].tick)
+            lru = n;
+    }
+
+    pthread_mutex_unlock(&key_cache_mutex);
+
+    if (pkey == NULL && (pkey = xs_evp_pkey_new(pem, priv)) != NULL) {
+        pthread_mutex_lock(&key_cache_mutex);
+
+        /* the entry in use by other threads is kept alive by their references */
+        xs_evp_pkey_free(key_cache[lru].pkey);
+        xs_free(key_cache[lru].pem);
+
+        int paused = xs_arena_pause();
+
+        key_cache[lru].hash = hash;
+        key_cache[lru].pem  = xs_dup(pem);
+
+        xs_arena_resume(paused);
+        key_cache[lru].pkey = xs_evp_pkey_ref(pkey);
+        key_cache[lru].tick = ++key_cache_tick;
+
+        pthread_mutex_unlock(&key_cache_mutex);
+    }
+
+    return pkey;
+}
+
+
+xs_str *http_digest(const char *body, int b_size)
+/* returns the value of the digest header for a body */
+{
+    xs *s;
+
+    if (body != NULL)
+        s = xs_sha256_base64(body, b_size);
+    else
+        s = xs_sha256_base64("", 0);
+
+    return xs_fmt("SHA-256=%s", s);
+}
+
+
 xs_dict *http_signed_request_raw(const char *keyid, const char *seckey,
                             const char *method, const char *url,
                             const xs_dict *headers,
                             const char *body, int b_size,
                             int *status, xs_str **payload, int *p_size,
                             int timeout)
-/* does a signed HTTP request */
+/* does a signed HTTP request (the digest header can come already computed) */
 {
     xs *l1 = NULL;
     xs *date = NULL;
@@ -46,16 +125,10 @@ xs_dict *http_signed_request_raw(const char *keyid, const char *seckey,
         target = "";
 
     /* digest */
-    {
-        xs *s;
-
-        if (body != NULL)
-            s = xs_sha256_base64(body, b_size);
-        else
-            s = xs_sha256_base64("", 0);
-
-        digest = xs_fmt("SHA-256=%s", s);
-    }
+    if (xs_type(v = xs_dict_get(headers, "digest")) == XSTYPE_STRING)
+        digest = xs_dup(v);
+    else
+        digest = http_digest(body, b_size);
 
     {
         /* build the string to be signed */
@@ -66,7 +139,10 @@ xs_dict *http_signed_request_raw(const char *keyid, const char *seckey,
                     strcmp(method, "POST") == 0 ? "post" : "get",
                     target, host, digest, date);
 
-        s64 = xs_evp_sign(seckey, s, strlen(s));
+        struct evp_pkey_st *pkey = _key_get(seckey, 1);
+
+        s64 = xs_evp_sign_pkey(pkey, s, strlen(s));
+        xs_evp_pkey_free(pkey);
     }
 
     /* build now the signature header */
@@ -79,8 +155,10 @@ xs_dict *http_signed_request_raw(const char *keyid, const char *seckey,
     /* transfer the original headers */
     hdrs = xs_dict_new();
     int c = 0;
-    while (xs_dict_next(headers, &k, &v, &c))
-        hdrs = xs_dict_append(hdrs, k, v);
+    while (xs_dict_next(headers, &k, &v, &c)) {
+        if (strcmp(k, "digest") != 0)
+            hdrs = xs_dict_append(hdrs, k, v);
+    }
 
     /* add the new headers */
     if (strcmp(method, "POST") == 0)
@@ -188,7 +266,7 @@ int check_signature(const xs_dict *req, xs_str **err)
     xs *actor = NULL;
     int status;
 
-    if (!valid_status((status = actor_request(NULL, keyId, &actor)))) {
+    if (!valid_status((status = actor_summary_request(NULL, keyId, &actor)))) {
         *err = xs_fmt("actor request error %s %d", keyId, status);
         return 0;
     }
@@ -253,7 +331,12 @@ int check_signature(const xs_dict *req, xs_str **err)
         }
     }
 
-    if (xs_evp_verify(pubkey, sig_str, strlen(sig_str), signature) != 1) {
+    struct evp_pkey_st *pkey = _key_get(pubkey, 0);
+    int ok = xs_evp_verify_pkey(pkey, sig_str, strlen(sig_str), signature);
+
+    xs_evp_pkey_free(pkey);
+
+    if (ok != 1) {
         *err = xs_fmt("RSA verify error %s", keyId);
         return 0;
     }
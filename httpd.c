@@ -16,7 +16,6 @@
 
 #include <setjmp.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <fcntl.h>
 #include <stdint.h>
 
@@ -24,9 +23,7 @@
 
 #include <sys/mman.h>
 
-#ifdef USE_POLL_FOR_SLEEP
 #include <poll.h>
-#endif
 
 /** server state **/
 srv_state *p_state = NULL;
@@ -37,22 +34,74 @@ srv_state *p_state = NULL;
 /* mutex to access the lists of jobs */
 static pthread_mutex_t job_mutex;
 
-/* semaphore to trigger job processing */
-static sem_t *job_sem;
+/* destination hosts of output jobs */
+typedef struct job_host {
+    struct job_host *next;
+    xs_str *name;           /* host name */
+    int active;             /* deliveries in progress */
+    int failures;           /* consecutive failed deliveries */
+    int trips;              /* consecutive times the circuit was opened */
+    time_t open_until;      /* circuit open (deliveries parked) until */
+    int probing;            /* a delivery is testing a reopened circuit */
+} job_host;
+
+#define JOB_HOST_BUCKETS 256
+
+static job_host *job_hosts[JOB_HOST_BUCKETS];
 
 typedef struct job_fifo_item {
     struct job_fifo_item *next;
     xs_val *job;
+    job_host *host;         /* destination host (output jobs only) */
 } job_fifo_item;
 
-static job_fifo_item *job_fifo_first = NULL;
-static job_fifo_item *job_fifo_last  = NULL;
+/* job lanes: incoming connections and queue items don't share a fifo,
+   so that a big fan-out doesn't delay the web pages (and vice versa) */
+static struct {
+    job_fifo_item *first;
+    job_fifo_item *last;
+} job_lanes[JOB_LANES];
+
+/* the lanes attended by each job thread (bitmask, by thread id) */
+static int job_thread_lanes[MAX_THREADS];
+
+/* conditions to wake up the threads, by the lanes they attend */
+#define JOB_LANE_MASKS (1 << JOB_LANES)
+
+static pthread_cond_t job_cond[JOB_LANE_MASKS];
+static int job_waiting[JOB_LANE_MASKS];
+
+/* threads must exit once their lanes are empty */
+static int job_stopping = 0;
 
 
 /** other global data **/
 
 static jmp_buf on_break;
 
+/* signals that stop the server; they are only attended by the main
+   thread while it's waiting for connections, as the handler longjmps */
+static sigset_t term_sigs;
+
+/* seconds an idle connection is kept open (0: no keep-alive) */
+static int keep_alive_timeout = 0;
+
+/* maximum bytes of the arena of each job (0: no arenas) */
+static size_t job_arena_size = 0;
+
+/* connections waiting for a request to arrive */
+#define MAX_IDLE_CONNS 1024
+
+static struct {
+    FILE *f;
+    time_t since;
+} idle_conns[MAX_IDLE_CONNS];
+
+static int idle_conns_n = 0;
+
+/* pipe to return connections to the front end */
+static int idle_pipe[2] = { -1, -1 };
+
 
 /** code **/
 
@@ -264,8 +313,8 @@ int server_get_handler(xs_dict *req, const char *q_path,
 }
 
 
-void httpd_connection(FILE *f)
-/* the connection processor */
+int httpd_connection(FILE *f)
+/* the connection processor; returns true if the connection can be reused */
 {
     xs *req;
     const char *method;
@@ -280,6 +329,7 @@ void httpd_connection(FILE *f)
     int p_size   = 0;
     const char *p;
     int fcgi_id;
+    int keep = 0;
 
     if (p_state->use_fcgi)
         req = xs_fcgi_request(f, &payload, &p_size, &fcgi_id);
@@ -288,14 +338,45 @@ void httpd_connection(FILE *f)
 
     if (req == NULL) {
         /* probably because a timeout */
-        fclose(f);
-        return;
+        return 0;
     }
 
     if (!(method = xs_dict_get(req, "method")) || !(p = xs_dict_get(req, "path"))) {
         /* missing needed headers; discard */
-        fclose(f);
-        return;
+        return 0;
+    }
+
+    if (keep_alive_timeout > 0 && p_state->srv_running) {
+        if (p_state->use_fcgi)
+            keep = xs_type(xs_dict_get(req, "fcgi_keep_conn")) == XSTYPE_TRUE;
+        else {
+            const char *proto = xs_dict_get(req, "proto");
+            xs *conn = xs_tolower_i(xs_dup(xs_dict_get_def(req, "connection", "")));
+
+            if (xs_str_in(conn, "close") != -1)
+                keep = 0;
+            else
+            if (xs_str_in(conn, "keep-alive") != -1)
+                keep = 1;
+            else
+                keep = !xs_is_null(proto) && strcmp(proto, "HTTP/1.1") == 0;
+
+            /* the body must have been fully consumed, or whatever is
+               left in the stream would be read as the next request */
+            const char *clen = xs_dict_get(req, "content-length");
+
+            if (xs_dict_get(req, "transfer-encoding") != NULL)
+                keep = 0;
+            else
+            if (clen == NULL) {
+                if (strcmp(method, "POST") == 0 || strcmp(method, "PUT") == 0 ||
+                    strcmp(method, "PATCH") == 0)
+                    keep = 0;
+            }
+            else
+            if (atoi(clen) != p_size)
+                keep = 0;
+        }
     }
 
     q_path = xs_dup(p);
@@ -429,12 +510,45 @@ void httpd_connection(FILE *f)
     headers = xs_dict_append(headers, "access-control-allow-origin", "*");
     headers = xs_dict_append(headers, "access-control-allow-headers", "*");
 
+    /* the stdio buffer may still hold unread data (the next request
+       of a reused connection, or a body that was not consumed), that
+       would be mixed up when switching to writing, so the response
+       is sent through a stream of its own */
+    FILE *o = NULL;
+    int fd = dup(fileno(f));
+
+    if (fd != -1 && (o = fdopen(fd, "w")) == NULL)
+        close(fd);
+
+    if (o == NULL) {
+        o    = f;
+        keep = 0;
+    }
+
+    if (!p_state->use_fcgi) {
+        headers = xs_dict_append(headers, "connection", keep ? "keep-alive" : "close");
+
+        if (keep) {
+            xs *ka = xs_fmt("timeout=%d", keep_alive_timeout);
+            headers = xs_dict_append(headers, "keep-alive", ka);
+        }
+    }
+
     if (p_state->use_fcgi)
-        xs_fcgi_response(f, status, headers, body, b_size, fcgi_id);
+        xs_fcgi_response(o, status, headers, body, b_size, fcgi_id);
     else
-        xs_httpd_response(f, status, headers, body, b_size);
+        xs_httpd_response(o, status, headers, body, b_size);
+
+    if (o != f) {
+        /* if the response could not be sent, don't insist */
+        if (ferror(o))
+            keep = 0;
 
-    fclose(f);
+        if (fclose(o) == EOF)
+            keep = 0;
+    }
+    else
+        fflush(f);
 
     srv_archive("RECV", NULL, req, payload, p_size, status, headers, body, b_size);
 
@@ -449,6 +563,144 @@ void httpd_connection(FILE *f)
     }
 
     xs_free(body);
+
+    return keep;
+}
+
+
+static job_host *_job_host(const char *url)
+/* returns the host entry for an url (job_mutex held) */
+{
+    xs *s1 = xs_replace_n(url, "http:/" "/", "", 1);
+    xs *s2 = xs_replace_n(s1, "https:/" "/", "", 1);
+    xs *l  = xs_split_n(s2, "/", 1);
+    const char *name = xs_list_get(l, 0);
+    unsigned int hash;
+    job_host *h;
+
+    if (xs_is_null(name) || *name == '\0')
+        return NULL;
+
+    hash = xs_hash_func(name, strlen(name)) % JOB_HOST_BUCKETS;
+
+    for (h = job_hosts[hash]; h != NULL; h = h->next) {
+        if (strcmp(h->name, name) == 0)
+            return h;
+    }
+
+    /* the entry is kept forever: keep it out of this thread's arena */
+    int paused = xs_arena_pause();
+
+    h = xs_realloc(NULL, sizeof(job_host));
+    *h = (job_host){ .next = job_hosts[hash], .name = xs_dup(name) };
+    job_hosts[hash] = h;
+
+    xs_arena_resume(paused);
+
+    return h;
+}
+
+
+static int _job_host_max(void)
+/* maximum number of simultaneous deliveries to the same host */
+{
+    int n = xs_number_get(xs_dict_get(srv_config, "queue_host_threads"));
+
+    if (n <= 0)
+        n = p_state->n_threads / 2;
+
+    return n < 1 ? 1 : n;
+}
+
+
+int job_host_check(const char *url, int *wait)
+/* checks if deliveries to the host of url are allowed (circuit closed);
+   if not, wait is set to the seconds until it's worth checking again */
+{
+    int ret = 1;
+    time_t t = time(NULL);
+
+    pthread_mutex_lock(&job_mutex);
+
+    job_host *h = _job_host(url);
+
+    if (h != NULL && h->open_until) {
+        if (t < h->open_until) {
+            *wait = h->open_until - t;
+            ret = 0;
+        }
+        else
+        if (h->probing) {
+            /* another delivery is testing it: wait for the shortest opening */
+            *wait = 60;
+            ret = 0;
+        }
+        else {
+            /* half-open: let this one test the host */
+            h->probing = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&job_mutex);
+
+    return ret;
+}
+
+
+void job_host_result(const char *url, int status)
+/* updates the health of the host of url after a delivery */
+{
+    int max_failures = xs_number_get(xs_dict_get(srv_config, "queue_host_failures"));
+
+    if (max_failures <= 0)
+        max_failures = 5;
+
+    pthread_mutex_lock(&job_mutex);
+
+    job_host *h = _job_host(url);
+
+    if (h != NULL) {
+        if (status < 0 || status >= 500) {
+            h->failures++;
+
+            /* (deliveries started before the circuit was opened don't count) */
+            if (h->probing || (h->open_until == 0 && h->failures >= max_failures)) {
+                /* open the circuit, for increasingly longer times */
+                int secs = 60 << (h->trips < 6 ? h->trips : 6);
+
+                h->open_until = time(NULL) + secs;
+                h->trips++;
+
+                srv_log(xs_fmt("output circuit open for %s (%d secs)", h->name, secs));
+            }
+        }
+        else {
+            if (h->open_until)
+                srv_log(xs_fmt("output circuit closed for %s", h->name));
+
+            h->failures   = 0;
+            h->trips      = 0;
+            h->open_until = 0;
+        }
+
+        h->probing = 0;
+    }
+
+    pthread_mutex_unlock(&job_mutex);
+}
+
+
+static void _job_wake(int lane)
+/* wakes up a waiting thread that can attend a lane (job_mutex held) */
+{
+    int m = 1 << lane;
+
+    /* prefer the threads reserved for the lane */
+    if (job_waiting[m] > 0)
+        pthread_cond_signal(&job_cond[m]);
+    else
+    if (job_waiting[JOB_LANE_MASKS - 1] > 0)
+        pthread_cond_signal(&job_cond[JOB_LANE_MASKS - 1]);
 }
 
 
@@ -456,24 +708,40 @@ void job_post(const xs_val *job, int urgent)
 /* posts a job for the threads to process it */
 {
     if (job != NULL) {
+        /* sockets go to the http lane, everything else to the queue one */
+        int lane = xs_type(job) == XSTYPE_DATA ? JOB_LANE_HTTP : JOB_LANE_QUEUE;
+
+        /* the job is for another thread: keep it out of this one's arena */
+        int paused = xs_arena_pause();
+
         /* lock the mutex */
         pthread_mutex_lock(&job_mutex);
 
         job_fifo_item *i = xs_realloc(NULL, sizeof(job_fifo_item));
-        *i = (job_fifo_item){ NULL, xs_dup(job) };
+        *i = (job_fifo_item){ NULL, xs_dup(job), NULL };
+
+        /* output jobs are scheduled by destination host */
+        if (xs_type(job) == XSTYPE_DICT) {
+            const char *type  = xs_dict_get(job, "type");
+            const char *inbox = xs_dict_get(job, "inbox");
+
+            if (xs_type(type) == XSTYPE_STRING && strcmp(type, "output") == 0 &&
+                xs_type(inbox) == XSTYPE_STRING)
+                i->host = _job_host(inbox);
+        }
 
-        if (job_fifo_first == NULL)
-            job_fifo_first = job_fifo_last = i;
+        if (job_lanes[lane].first == NULL)
+            job_lanes[lane].first = job_lanes[lane].last = i;
         else
         if (urgent) {
             /* prepend */
-            i->next = job_fifo_first;
-            job_fifo_first = i;
+            i->next = job_lanes[lane].first;
+            job_lanes[lane].first = i;
         }
         else {
             /* append */
-            job_fifo_last->next = i;
-            job_fifo_last = i;
+            job_lanes[lane].last->next = i;
+            job_lanes[lane].last = i;
         }
 
         p_state->job_fifo_size++;
@@ -481,45 +749,190 @@ void job_post(const xs_val *job, int urgent)
         if (p_state->job_fifo_size > p_state->peak_job_fifo_size)
             p_state->peak_job_fifo_size = p_state->job_fifo_size;
 
+        p_state->job_lane_size[lane]++;
+
+        if (p_state->job_lane_size[lane] > p_state->peak_job_lane_size[lane])
+            p_state->peak_job_lane_size[lane] = p_state->job_lane_size[lane];
+
+        /* ask for someone to attend it */
+        _job_wake(lane);
+
         /* unlock the mutex */
         pthread_mutex_unlock(&job_mutex);
 
-        /* ask for someone to attend it */
-        sem_post(job_sem);
+        xs_arena_resume(paused);
     }
 }
 
 
-void job_wait(xs_val **job)
-/* waits for an available job */
+int job_queue_full(void)
+/* returns true if the queue lane has as many jobs as it can hold */
 {
-    *job = NULL;
+    int max = xs_number_get(xs_dict_get(srv_config, "queue_max_jobs"));
 
-    if (sem_wait(job_sem) == 0) {
-        /* lock the mutex */
-        pthread_mutex_lock(&job_mutex);
+    if (max <= 0)
+        max = 4096;
+
+    return p_state != NULL && p_state->job_lane_size[JOB_LANE_QUEUE] >= max;
+}
 
-        /* dequeue */
-        job_fifo_item *i = job_fifo_first;
 
-        if (i != NULL) {
-            job_fifo_first = i->next;
+static job_fifo_item *_job_take(int lane)
+/* takes the first job from a lane that can be processed now (job_mutex held) */
+{
+    job_fifo_item *i = job_lanes[lane].first;
+    job_fifo_item *prev = NULL;
+    int max = _job_host_max();
+
+    /* skip those to hosts already busy enough */
+    while (i != NULL && i->host != NULL && i->host->active >= max) {
+        prev = i;
+        i = i->next;
+    }
+
+    if (i != NULL) {
+        if (prev == NULL)
+            job_lanes[lane].first = i->next;
+        else
+            prev->next = i->next;
+
+        if (job_lanes[lane].last == i)
+            job_lanes[lane].last = prev;
+
+        p_state->job_fifo_size--;
+        p_state->job_lane_size[lane]--;
+
+        /* more jobs? chain the wake up */
+        if (job_lanes[lane].first != NULL)
+            _job_wake(lane);
+    }
+
+    return i;
+}
+
+
+static void _job_wait(int lanes, xs_val **job, job_host **host)
+/* waits for an available job in any of the lanes */
+{
+    *job  = NULL;
+    *host = NULL;
+
+    /* lock the mutex */
+    pthread_mutex_lock(&job_mutex);
+
+    for (;;) {
+        job_fifo_item *i = NULL;
+        int lane;
+
+        for (lane = 0; i == NULL && lane < JOB_LANES; lane++) {
+            if (lanes & (1 << lane))
+                i = _job_take(lane);
+        }
 
-            if (job_fifo_first == NULL)
-                job_fifo_last = NULL;
+        if (i != NULL) {
+            if (i->host != NULL)
+                i->host->active++;
 
-            *job = i->job;
+            *job  = i->job;
+            *host = i->host;
             xs_free(i);
 
-            p_state->job_fifo_size--;
+            break;
         }
 
-        /* unlock the mutex */
+        if (job_stopping) {
+            /* special message: exit */
+            *job = xs_dup(xs_stock(XSTYPE_FALSE));
+            break;
+        }
+
+        /* nothing to do (or all waiting for their hosts) */
+        job_waiting[lanes]++;
+        pthread_cond_wait(&job_cond[lanes], &job_mutex);
+        job_waiting[lanes]--;
+    }
+
+    /* unlock the mutex */
+    pthread_mutex_unlock(&job_mutex);
+}
+
+
+static void _job_done(job_host *host)
+/* marks a job as done */
+{
+    if (host != NULL) {
+        pthread_mutex_lock(&job_mutex);
+
+        host->active--;
+
+        /* a job to this host may be now eligible */
+        if (job_lanes[JOB_LANE_QUEUE].first != NULL)
+            _job_wake(JOB_LANE_QUEUE);
+
         pthread_mutex_unlock(&job_mutex);
     }
 }
 
 
+void job_wait(xs_val **job)
+/* waits for an available job */
+{
+    job_host *host;
+
+    _job_wait(JOB_LANE_MASKS - 1, job, &host);
+
+    /* the caller doesn't report back */
+    _job_done(host);
+}
+
+
+static void _job_stop(void)
+/* tells the job threads to exit when their work is done */
+{
+    int n;
+
+    pthread_mutex_lock(&job_mutex);
+
+    job_stopping = 1;
+
+    for (n = 0; n < JOB_LANE_MASKS; n++)
+        pthread_cond_broadcast(&job_cond[n]);
+
+    pthread_mutex_unlock(&job_mutex);
+}
+
+
+static int _conn_pending(FILE *f)
+/* returns true if the next request from this connection is already here */
+{
+    int fd    = fileno(f);
+    int flags = fcntl(fd, F_GETFL);
+    int c;
+
+    /* a pipelined request may be already in the stdio buffer,
+       so a poll() on the socket is not enough */
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    c = fgetc(f);
+    fcntl(fd, F_SETFL, flags);
+
+    if (c == EOF) {
+        clearerr(f);
+        return 0;
+    }
+
+    ungetc(c, f);
+    return 1;
+}
+
+
+static void _conn_park(FILE *f)
+/* returns a connection to the front end to wait for its next request */
+{
+    if (idle_pipe[1] == -1 || write(idle_pipe[1], &f, sizeof(f)) != sizeof(f))
+        fclose(f);
+}
+
+
 static void *job_thread(void *arg)
 /* job thread */
 {
@@ -529,10 +942,11 @@ static void *job_thread(void *arg)
 
     for (;;) {
         xs *job = NULL;
+        job_host *host = NULL;
 
         p_state->th_state[pid] = THST_WAIT;
 
-        job_wait(&job);
+        _job_wait(job_thread_lanes[pid], &job, &host);
 
         if (job == NULL) /* corrupted message? */
             continue;
@@ -548,14 +962,40 @@ static void *job_thread(void *arg)
 
             xs_data_get(&f, job);
 
-            if (f != NULL)
-                httpd_connection(f);
+            if (f != NULL) {
+                int keep;
+
+                if (job_arena_size)
+                    xs_arena_begin(job_arena_size);
+
+                keep = httpd_connection(f);
+
+                xs_arena_end();
+
+                if (!keep)
+                    fclose(f);
+                else
+                if (_conn_pending(f)) {
+                    /* go to the back of the queue, to be fair with the others */
+                    xs *job = xs_data_new(&f, sizeof(FILE *));
+                    job_post(job, 0);
+                }
+                else
+                    _conn_park(f);
+            }
         }
         else {
             /* it's a q_item */
             p_state->th_state[pid] = THST_QUEUE;
 
+            if (job_arena_size)
+                xs_arena_begin(job_arena_size);
+
             process_queue_item(job);
+
+            xs_arena_end();
+
+            _job_done(host);
         }
     }
 
@@ -582,31 +1022,23 @@ static void *background_thread(void *arg)
 
     srv_log(xs_fmt("background thread started"));
 
+    /* load the schedule of queued items */
+    queue_sched_start();
+
+    /* load who follows whom */
+    relations_start();
+
     while (p_state->srv_running) {
-        time_t t;
+        time_t t, next;
         int cnt = 0;
 
         p_state->th_state[0] = THST_QUEUE;
 
-        {
-            xs *list = user_list();
-            char *p;
-            const char *uid;
+        /* process all queues */
+        cnt += process_queues(&next);
 
-            /* process queues for all users */
-            p = list;
-            while (xs_list_iter(&p, &uid)) {
-                snac snac;
-
-                if (user_open(&snac, uid)) {
-                    cnt += process_user_queue(&snac);
-                    user_free(&snac);
-                }
-            }
-        }
-
-        /* global queue */
-        cnt += process_queue();
+        /* reload who follows whom, if it changed from outside */
+        relations_check();
 
         /* time to purge? */
         if ((t = time(NULL)) > purge_time) {
@@ -619,17 +1051,22 @@ static void *background_thread(void *arg)
         }
 
         if (cnt == 0) {
-            /* sleep 3 seconds */
+            /* sleep until the next queue item is due, but no more than
+               3 seconds, to look for items enqueued by other processes */
+            int secs = 3;
+
+            if (next != 0 && next - t < secs)
+                secs = next - t > 0 ? next - t : 1;
 
             p_state->th_state[0] = THST_WAIT;
 
 #ifdef USE_POLL_FOR_SLEEP
-            poll(NULL, 0, 3 * 1000);
+            poll(NULL, 0, secs * 1000);
 #else
             struct timespec ts;
 
             clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_sec += 3;
+            ts.tv_sec += secs;
 
             pthread_mutex_lock(&sleep_mutex);
             while (pthread_cond_timedwait(&sleep_cond, &sleep_mutex, &ts) == 0);
@@ -745,6 +1182,92 @@ srv_state *srv_state_op(xs_str **fname, int op)
 }
 
 
+static int _front_end(int rs)
+/* waits until a connection has a request to be processed and hands it
+   to the job threads; returns when the server socket fails */
+{
+    static struct pollfd pfd[MAX_IDLE_CONNS + 2];
+
+    for (;;) {
+        int n, i;
+        time_t t;
+
+        pfd[0] = (struct pollfd){ .fd = rs, .events = POLLIN };
+        pfd[1] = (struct pollfd){ .fd = idle_pipe[0], .events = POLLIN };
+
+        for (i = 0; i < idle_conns_n; i++)
+            pfd[i + 2] = (struct pollfd){ .fd = fileno(idle_conns[i].f), .events = POLLIN };
+
+        pthread_sigmask(SIG_UNBLOCK, &term_sigs, NULL);
+        n = poll(pfd, idle_conns_n + 2, idle_conns_n ? 1000 : -1);
+        pthread_sigmask(SIG_BLOCK, &term_sigs, NULL);
+
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return -1;
+        }
+
+        t = time(NULL);
+
+        /* walk the idle connections from the end, as they are removed
+           by moving the last one (already seen) into their place */
+        for (i = idle_conns_n - 1; i >= 0; i--) {
+            FILE *f = idle_conns[i].f;
+
+            if (pfd[i + 2].revents) {
+                /* a request (or an error, or a hangup) is here */
+                xs *job = xs_data_new(&f, sizeof(FILE *));
+                job_post(job, 1);
+            }
+            else
+            if (t - idle_conns[i].since >= keep_alive_timeout)
+                fclose(f);
+            else
+                continue;
+
+            idle_conns[i] = idle_conns[--idle_conns_n];
+        }
+
+        if (pfd[1].revents & POLLIN) {
+            FILE *f;
+
+            /* connections returned by the job threads */
+            while (read(idle_pipe[0], &f, sizeof(f)) == sizeof(f)) {
+                if (idle_conns_n < MAX_IDLE_CONNS) {
+                    idle_conns[idle_conns_n].f     = f;
+                    idle_conns[idle_conns_n].since = t;
+                    idle_conns_n++;
+                }
+                else
+                    fclose(f);
+            }
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            FILE *f = xs_socket_accept(rs);
+
+            if (f == NULL)
+                return -1;
+
+            if (idle_conns_n < MAX_IDLE_CONNS) {
+                /* don't bother a job thread until the request arrives */
+                idle_conns[idle_conns_n].f     = f;
+                idle_conns[idle_conns_n].since = t;
+                idle_conns_n++;
+            }
+            else {
+                xs *job = xs_data_new(&f, sizeof(FILE *));
+                job_post(job, 1);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
 void httpd(void)
 /* starts the server */
 {
@@ -753,9 +1276,7 @@ void httpd(void)
     int rs;
     pthread_t threads[MAX_THREADS] = {0};
     int n;
-    xs *sem_name = NULL;
     xs *shm_name = NULL;
-    sem_t anon_job_sem;
 
     address = xs_dict_get(srv_config, "address");
     port    = xs_number_str(xs_dict_get(srv_config, "port"));
@@ -778,6 +1299,12 @@ void httpd(void)
     signal(SIGTERM, term_handler);
     signal(SIGINT,  term_handler);
 
+    /* block them here, so that the threads inherit it */
+    sigemptyset(&term_sigs);
+    sigaddset(&term_sigs, SIGTERM);
+    sigaddset(&term_sigs, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &term_sigs, NULL);
+
     srv_log(xs_fmt("httpd%s start %s:%s %s", p_state->use_fcgi ? " (FastCGI)" : "",
                     address, port, USER_AGENT));
 
@@ -789,24 +1316,31 @@ void httpd(void)
 
     /* initialize the job control engine */
     pthread_mutex_init(&job_mutex, NULL);
-    sem_name = xs_fmt("/job_%d", getpid());
-    job_sem = sem_open(sem_name, O_CREAT, 0644, 0);
 
-    if (job_sem == NULL) {
-        /* error opening a named semaphore; try with an anonymous one */
-        if (sem_init(&anon_job_sem, 0, 0) != -1)
-            job_sem = &anon_job_sem;
-    }
-
-    if (job_sem == NULL) {
-        srv_log(xs_fmt("fatal error: cannot create semaphore -- cannot continue"));
-        return;
-    }
+    for (n = 0; n < JOB_LANE_MASKS; n++)
+        pthread_cond_init(&job_cond[n], NULL);
 
     /* initialize sleep control */
     pthread_mutex_init(&sleep_mutex, NULL);
     pthread_cond_init(&sleep_cond, NULL);
 
+    /* initialize connection keep-alive */
+    const xs_number *ka = xs_dict_get(srv_config, "keep_alive_timeout");
+    keep_alive_timeout = xs_type(ka) == XSTYPE_NUMBER ? xs_number_get(ka) : 5;
+
+    if (keep_alive_timeout > 0) {
+        if (pipe(idle_pipe) != -1)
+            fcntl(idle_pipe[0], F_SETFL, fcntl(idle_pipe[0], F_GETFL) | O_NONBLOCK);
+        else {
+            srv_log(xs_fmt("cannot create pipe -- keep-alive disabled"));
+            keep_alive_timeout = 0;
+        }
+    }
+
+    /* size of the per-job memory arenas, in megabytes */
+    int arena_mb = xs_number_get(xs_dict_get(srv_config, "job_arena_size"));
+    job_arena_size = arena_mb > 0 ? (size_t)arena_mb * 1024 * 1024 : 0;
+
     p_state->n_threads = xs_number_get(xs_dict_get(srv_config, "num_threads"));
 
 #ifdef _SC_NPROCESSORS_ONLN
@@ -827,37 +1361,64 @@ void httpd(void)
     /* thread #0 is the background thread */
     pthread_create(&threads[0], NULL, background_thread, NULL);
 
-    /* the rest of threads are for job processing */
+    /* the rest of threads are for job processing; some of them can be
+       reserved for a lane, but at least one always attends both */
+    int n_jobs  = p_state->n_threads - 1;
+    int n_http  = xs_number_get(xs_dict_get_def(srv_config, "http_threads", xs_stock(1)));
+    int n_queue = xs_number_get(xs_dict_get_def(srv_config, "queue_threads", xs_stock(1)));
+
+    n_http  = n_http < 0 ? 0 : n_http > n_jobs - 1 ? n_jobs - 1 : n_http;
+    n_queue = n_queue < 0 ? 0 : n_queue > n_jobs - 1 - n_http ? n_jobs - 1 - n_http : n_queue;
+
+    for (n = 1; n < p_state->n_threads; n++) {
+        if (n <= n_http)
+            job_thread_lanes[n] = 1 << JOB_LANE_HTTP;
+        else
+        if (n <= n_http + n_queue)
+            job_thread_lanes[n] = 1 << JOB_LANE_QUEUE;
+        else
+            job_thread_lanes[n] = JOB_LANE_MASKS - 1;
+    }
+
+    srv_debug(0, xs_fmt("job threads: %d http, %d queue, %d both",
+                n_http, n_queue, n_jobs - n_http - n_queue));
+
     char *ptr = (char *) 0x1;
     for (n = 1; n < p_state->n_threads; n++)
         pthread_create(&threads[n], NULL, job_thread, ptr++);
 
     if (setjmp(on_break) == 0) {
-        for (;;) {
-            FILE *f = xs_socket_accept(rs);
-
-            if (f != NULL) {
-                xs *job = xs_data_new(&f, sizeof(FILE *));
-                job_post(job, 1);
+        if (keep_alive_timeout > 0)
+            _front_end(rs);
+        else {
+            for (;;) {
+                pthread_sigmask(SIG_UNBLOCK, &term_sigs, NULL);
+                FILE *f = xs_socket_accept(rs);
+                pthread_sigmask(SIG_BLOCK, &term_sigs, NULL);
+
+                if (f != NULL) {
+                    xs *job = xs_data_new(&f, sizeof(FILE *));
+                    job_post(job, 1);
+                }
+                else
+                    break;
             }
-            else
-                break;
         }
     }
 
     p_state->srv_running = 0;
 
-    /* send as many exit jobs as working threads */
-    for (n = 1; n < p_state->n_threads; n++)
-        job_post(xs_stock(XSTYPE_FALSE), 0);
+    /* close the idle connections */
+    while (idle_conns_n > 0)
+        fclose(idle_conns[--idle_conns_n].f);
+
+    /* tell the working threads to exit */
+    _job_stop();
 
     /* wait for all the threads to exit */
     for (n = 0; n < p_state->n_threads; n++)
         pthread_join(threads[n], NULL);
 
-    sem_close(job_sem);
-    sem_unlink(sem_name);
-
     srv_state_op(&shm_name, 2);
 
     xs *uptime = xs_str_time_diff(time(NULL) - p_state->srv_start_time);
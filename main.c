@@ -24,6 +24,7 @@ int usage(void)
     printf("deluser {basedir} {uid}              Deletes a user\n");
     printf("httpd {basedir}                      Starts the HTTPD daemon\n");
     printf("purge {basedir}                      Purges old data\n");
+    printf("reindex {basedir}                    Rebuilds the full-text search index\n");
     printf("state {basedir}                      Prints server state\n");
     printf("webfinger {basedir} {actor}          Queries about an actor (@user@host or actor url)\n");
     printf("queue {basedir} {uid}                Processes a user queue\n");
@@ -44,7 +45,7 @@ int usage(void)
     printf("limit {basedir} {uid} {actor}        Limits an actor (drops their announces)\n");
     printf("unlimit {basedir} {uid} {actor}      Unlimits an actor\n");
     printf("verify_links {basedir} {uid}         Verifies a user's links (in the metadata)\n");
-    printf("search {basedir} {uid} {regex}       Searches posts by content\n");
+    printf("search {basedir} {uid} {query}       Searches posts by content\n");
 
     return 1;
 }
@@ -133,6 +134,13 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (strcmp(cmd, "reindex") == 0) { /** **/
+        int n = search_index_rebuild();
+
+        printf("%d posts indexed\n", n);
+        return 0;
+    }
+
     if (strcmp(cmd, "state") == 0) { /** **/
         xs *shm_name = NULL;
         srv_state *p_state = srv_state_op(&shm_name, 1);
@@ -148,6 +156,12 @@ int main(int argc, char *argv[])
         printf("uptime: %s\n", uptime);
         printf("job fifo size (cur): %d\n", ss.job_fifo_size);
         printf("job fifo size (peak): %d\n", ss.peak_job_fifo_size);
+        printf("job fifo size (http, cur / peak): %d / %d\n",
+            ss.job_lane_size[JOB_LANE_HTTP], ss.peak_job_lane_size[JOB_LANE_HTTP]);
+        printf("job fifo size (queue, cur / peak): %d / %d\n",
+            ss.job_lane_size[JOB_LANE_QUEUE], ss.peak_job_lane_size[JOB_LANE_QUEUE]);
+        printf("object cache hits: %ld\n", ss.obj_cache_hits);
+        printf("object cache misses: %ld\n", ss.obj_cache_misses);
         char *th_states[] = { "stopped", "waiting", "input", "output" };
 
         for (n = 0; n < ss.n_threads; n++)
@@ -378,7 +392,7 @@ int main(int argc, char *argv[])
     if (strcmp(cmd, "search") == 0) { /** **/
         int to;
 
-        /* 'url' contains the regex */
+        /* 'url' contains the query (words, "phrases" or a regex) */
         xs *r = content_search(&snac, url, 1, 0, XS_ALL, 10, &to);
 
         int c = 0;
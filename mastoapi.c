@@ -43,7 +43,7 @@ int app_add(const char *id, const xs_dict *app)
     fn = xs_str_cat(fn, ".json");
 
     if ((f = fopen(fn, "w")) != NULL) {
-        xs_json_dump(app, 4, f);
+        xs_json_dump(app, json_indent(), f);
         fclose(f);
     }
     else
@@ -106,7 +106,7 @@ int token_add(const char *id, const xs_dict *token)
     fn = xs_str_cat(fn, ".json");
 
     if ((f = fopen(fn, "w")) != NULL) {
-        xs_json_dump(token, 4, f);
+        xs_json_dump(token, json_indent(), f);
         fclose(f);
     }
     else
@@ -777,6 +777,7 @@ xs_dict *mastoapi_poll(snac *snac, const xs_dict *msg)
 xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
 /* converts an ActivityPub note to a Mastodon status */
 {
+    xs_idx mi = xs_dict_idx_new(msg);
     xs *actor = NULL;
     actor_get_refresh(snac, get_atto(msg), &actor);
 
@@ -784,8 +785,8 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     if (actor == NULL)
         return NULL;
 
-    const char *type = xs_dict_get(msg, "type");
-    const char *id   = xs_dict_get(msg, "id");
+    const char *type = xs_dict_idx_get(&mi, "type");
+    const char *id   = xs_dict_idx_get(&mi, "id");
 
     /* fail if it's not a valid actor */
     if (xs_is_null(type) || xs_is_null(id))
@@ -807,12 +808,12 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "url",          id);
     st = xs_dict_append(st, "account",      acct);
 
-    xs *fd = mastoapi_date(xs_dict_get(msg, "published"));
+    xs *fd = mastoapi_date(xs_dict_idx_get(&mi, "published"));
     st = xs_dict_append(st, "created_at", fd);
 
     {
-        const char *content = xs_dict_get(msg, "content");
-        const char *name    = xs_dict_get(msg, "name");
+        const char *content = xs_dict_idx_get(&mi, "content");
+        const char *name    = xs_dict_idx_get(&mi, "name");
         xs *s1 = NULL;
 
         if (name && content)
@@ -832,13 +833,13 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "visibility",
         is_msg_public(msg) ? "public" : "private");
 
-    tmp = xs_dict_get(msg, "sensitive");
+    tmp = xs_dict_idx_get(&mi, "sensitive");
     if (xs_is_null(tmp))
         tmp = xs_stock(XSTYPE_FALSE);
 
     st = xs_dict_append(st, "sensitive",    tmp);
 
-    tmp = xs_dict_get(msg, "summary");
+    tmp = xs_dict_idx_get(&mi, "summary");
     if (xs_is_null(tmp))
         tmp = "";
 
@@ -882,7 +883,7 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
         xs *ml  = xs_list_new();
         xs *htl = xs_list_new();
         xs *eml = xs_list_new();
-        const xs_list *tag = xs_dict_get(msg, "tag");
+        const xs_list *tag = xs_dict_idx_get(&mi, "tag");
         int n = 0;
 
         xs *tag_list = NULL;
@@ -1002,7 +1003,7 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "in_reply_to_id",         xs_stock(XSTYPE_NULL));
     st = xs_dict_append(st, "in_reply_to_account_id", xs_stock(XSTYPE_NULL));
 
-    tmp = xs_dict_get(msg, "inReplyTo");
+    tmp = xs_dict_idx_get(&mi, "inReplyTo");
     if (!xs_is_null(tmp)) {
         xs *irto = NULL;
 
@@ -1025,13 +1026,13 @@ xs_dict *mastoapi_status(snac *snac, const xs_dict *msg)
     st = xs_dict_append(st, "filtered", xs_stock(XSTYPE_LIST));
     st = xs_dict_append(st, "muted",    xs_stock(XSTYPE_FALSE));
 
-    tmp = xs_dict_get(msg, "sourceContent");
+    tmp = xs_dict_idx_get(&mi, "sourceContent");
     if (xs_is_null(tmp))
         tmp = "";
 
     st = xs_dict_append(st, "text", tmp);
 
-    tmp = xs_dict_get(msg, "updated");
+    tmp = xs_dict_idx_get(&mi, "updated");
     xs *fd2 = NULL;
     if (xs_is_null(tmp))
         tmp = xs_stock(XSTYPE_NULL);
@@ -1501,22 +1502,25 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
                         break;
                 }
 
-                /* get the entry */
-                if (!valid_status(timeline_get_by_md5(&snac1, v, &msg)))
+                /* get the fields to filter by, without converting the full entry */
+                xs *hdr = NULL;
+                if (!valid_status(object_peek_by_md5(v, &hdr,
+                        "id", "type", "audience", "attributedTo", "name")) &&
+                    !valid_status(timeline_get_by_md5(&snac1, v, &hdr)))
                     continue;
 
                 /* discard non-Notes */
-                const char *id   = xs_dict_get(msg, "id");
-                const char *type = xs_dict_get(msg, "type");
+                const char *id   = xs_dict_get(hdr, "id");
+                const char *type = xs_dict_get(hdr, "type");
                 if (!xs_match(type, POSTLIKE_OBJECT_TYPE))
                     continue;
 
                 const char *from = NULL;
                 if (strcmp(type, "Page") == 0)
-                    from = xs_dict_get(msg, "audience");
+                    from = xs_dict_get(hdr, "audience");
 
                 if (from == NULL)
-                    from = get_atto(msg);
+                    from = get_atto(hdr);
 
                 if (from == NULL)
                     continue;
@@ -1540,7 +1544,11 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
 
                 /* if it has a name and it's not a Page or a Video,
                    it's a poll vote, so discard it */
-                if (!xs_is_null(xs_dict_get(msg, "name")) && !xs_match(type, "Page|Video"))
+                if (!xs_is_null(xs_dict_get(hdr, "name")) && !xs_match(type, "Page|Video"))
+                    continue;
+
+                /* get the entry */
+                if (!valid_status(timeline_get_by_md5(&snac1, v, &msg)))
                     continue;
 
                 /* convert the Note into a Mastodon status */
@@ -1678,22 +1686,25 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
             while (xs_list_next(timeline, &md5, &c)) {
                 xs *msg = NULL;
 
-                /* get the entry */
-                if (!valid_status(timeline_get_by_md5(&snac1, md5, &msg)))
+                /* get the fields to filter by, without converting the full entry */
+                xs *hdr = NULL;
+                if (!valid_status(object_peek_by_md5(md5, &hdr,
+                        "id", "type", "audience", "attributedTo", "name")) &&
+                    !valid_status(timeline_get_by_md5(&snac1, md5, &hdr)))
                     continue;
 
                 /* discard non-Notes */
-                const char *id   = xs_dict_get(msg, "id");
-                const char *type = xs_dict_get(msg, "type");
+                const char *id   = xs_dict_get(hdr, "id");
+                const char *type = xs_dict_get(hdr, "type");
                 if (!xs_match(type, POSTLIKE_OBJECT_TYPE))
                     continue;
 
                 const char *from = NULL;
                 if (strcmp(type, "Page") == 0)
-                    from = xs_dict_get(msg, "audience");
+                    from = xs_dict_get(hdr, "audience");
 
                 if (from == NULL)
-                    from = get_atto(msg);
+                    from = get_atto(hdr);
 
                 if (from == NULL)
                     continue;
@@ -1717,7 +1728,11 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
 
                 /* if it has a name and it's not a Page or a Video,
                    it's a poll vote, so discard it */
-                if (!xs_is_null(xs_dict_get(msg, "name")) && !xs_match(type, "Page|Video"))
+                if (!xs_is_null(xs_dict_get(hdr, "name")) && !xs_match(type, "Page|Video"))
+                    continue;
+
+                /* get the entry */
+                if (!valid_status(timeline_get_by_md5(&snac1, md5, &msg)))
                     continue;
 
                 /* convert the Note into a Mastodon status */
@@ -2219,67 +2234,65 @@ int mastoapi_get_handler(const xs_dict *req, const char *q_path,
             const char *q      = xs_dict_get(args, "q");
             const char *type   = xs_dict_get(args, "type");
             const char *offset = xs_dict_get(args, "offset");
+            int skip = xs_is_null(offset) ? 0 : atoi(offset);
 
             xs *acl = xs_list_new();
             xs *stl = xs_list_new();
             xs *htl = xs_list_new();
             xs *res = xs_dict_new();
 
-            if (xs_is_null(offset) || strcmp(offset, "0") == 0) {
-                /* reply something only for offset 0; otherwise,
-                   apps like Tusky keep asking again and again */
-
-                if (!xs_is_null(q)) {
-                    if (xs_is_null(type) || strcmp(type, "accounts") == 0) {
-                        /* do a webfinger query */
-                        char *actor = NULL;
-                        char *user  = NULL;
+            if (!xs_is_null(q)) {
+                /* accounts and hashtags are replied only for offset 0;
+                   otherwise, apps like Tusky keep asking again and again */
+                if (skip == 0 && (xs_is_null(type) || strcmp(type, "accounts") == 0)) {
+                    /* do a webfinger query */
+                    char *actor = NULL;
+                    char *user  = NULL;
 
-                        if (valid_status(webfinger_request(q, &actor, &user)) && actor) {
-                            xs *actor_o = NULL;
+                    if (valid_status(webfinger_request(q, &actor, &user)) && actor) {
+                        xs *actor_o = NULL;
 
-                            if (valid_status(actor_request(&snac1, actor, &actor_o))) {
-                                xs *acct = mastoapi_account(actor_o);
+                        if (valid_status(actor_request(&snac1, actor, &actor_o))) {
+                            xs *acct = mastoapi_account(actor_o);
 
-                                acl = xs_list_append(acl, acct);
-                            }
+                            acl = xs_list_append(acl, acct);
                         }
                     }
+                }
 
-                    if (xs_is_null(type) || strcmp(type, "hashtags") == 0) {
-                        /* search this tag */
-                        xs *tl = tag_search((char *)q, 0, 1);
+                if (skip == 0 && (xs_is_null(type) || strcmp(type, "hashtags") == 0)) {
+                    /* search this tag */
+                    xs *tl = tag_search((char *)q, 0, 1);
 
-                        if (xs_list_len(tl)) {
-                            xs *d = xs_dict_new();
+                    if (xs_list_len(tl)) {
+                        xs *d = xs_dict_new();
 
-                            d = xs_dict_append(d, "name", q);
-                            xs *url = xs_fmt("%s?t=%s", srv_baseurl, q);
-                            d = xs_dict_append(d, "url", url);
-                            d = xs_dict_append(d, "history", xs_stock(XSTYPE_LIST));
+                        d = xs_dict_append(d, "name", q);
+                        xs *url = xs_fmt("%s?t=%s", srv_baseurl, q);
+                        d = xs_dict_append(d, "url", url);
+                        d = xs_dict_append(d, "history", xs_stock(XSTYPE_LIST));
 
-                            htl = xs_list_append(htl, d);
-                        }
+                        htl = xs_list_append(htl, d);
                     }
+                }
 
-                    if (xs_is_null(type) || strcmp(type, "statuses") == 0) {
-                        int to = 0;
-                        int cnt = 40;
-                        xs *tl = content_search(&snac1, q, 1, 0, cnt, 0, &to);
-                        int c = 0;
-                        const char *v;
+                if (xs_is_null(type) || strcmp(type, "statuses") == 0) {
+                    int to = 0;
+                    int cnt = 40;
+                    xs *tl = content_search(&snac1, q, 1, skip, cnt, 0, &to);
+                    int c = 0;
+                    const char *v;
 
-                        while (xs_list_next(tl, &v, &c) && --cnt) {
-                            xs *post = NULL;
+                    while (xs_list_next(tl, &v, &c) && --cnt) {
+                        xs *post = NULL;
 
-                            if (!valid_status(timeline_get_by_md5(&snac1, v, &post)))
-                                continue;
+                        if (!valid_status(timeline_get_by_md5(&snac1, v, &post)))
+                            continue;
 
-                            xs *s = mastoapi_status(&snac1, post);
+                        xs *s = mastoapi_status(&snac1, post);
 
-                            if (!xs_is_null(s))
-                                stl = xs_list_append(stl, s);
-                        }
+                        if (!xs_is_null(s))
+                            stl = xs_list_append(stl, s);
                     }
                 }
             }
@@ -2783,12 +2796,13 @@ int mastoapi_post_handler(const xs_dict *req, const char *q_path,
                             choices = xs_dict_get(args, "choices");
 
                         if (xs_type(choices) == XSTYPE_LIST) {
+                            xs_lidx oi = xs_list_idx_new(opts);
                             const xs_str *v;
 
                             int c = 0;
                             while (xs_list_next(choices, &v, &c)) {
                                 int io           = atoi(v);
-                                const xs_dict *o = xs_list_get(opts, io);
+                                const xs_dict *o = xs_list_idx_get(&oi, io);
 
                                 if (o) {
                                     const char *name = xs_dict_get(o, "name");
@@ -16,6 +16,9 @@
 #define MAX_THREADS 256
 #endif
 
+/* job lanes */
+enum { JOB_LANE_HTTP, JOB_LANE_QUEUE, JOB_LANES };
+
 #ifndef MAX_CONVERSATION_LEVELS
 #define MAX_CONVERSATION_LEVELS 48
 #endif
@@ -59,7 +62,11 @@ typedef struct {
     time_t srv_start_time;  /* start time */
     int job_fifo_size;      /* job fifo size */
     int peak_job_fifo_size; /* maximum job fifo size seen */
+    int job_lane_size[JOB_LANES];       /* job fifo size by lane */
+    int peak_job_lane_size[JOB_LANES];  /* maximum job fifo size seen by lane */
     int n_threads;          /* number of configured threads */
+    long obj_cache_hits;    /* object cache hits */
+    long obj_cache_misses;  /* object cache misses */
     enum { THST_STOP, THST_WAIT, THST_IN, THST_QUEUE } th_state[MAX_THREADS];
 } srv_state;
 
@@ -71,6 +78,7 @@ void snac_log(snac *user, xs_str *str);
 
 int srv_open(const char *basedir, int auto_upgrade);
 void srv_free(void);
+int json_indent(void);
 
 int user_open(snac *snac, const char *uid);
 void user_free(snac *snac);
@@ -108,6 +116,8 @@ int object_here_by_md5(const char *id);
 int object_here(const char *id);
 int object_get_by_md5(const char *md5, xs_dict **obj);
 int object_get(const char *id, xs_dict **obj);
+int _object_peek_by_md5(const char *md5, xs_dict **obj, const char *keys[]);
+#define object_peek_by_md5(md5, obj, ...) _object_peek_by_md5(md5, obj, (const char *[]){ __VA_ARGS__, NULL })
 int object_del(const char *id);
 int object_del_if_unref(const char *id);
 double object_ctime_by_md5(const char *md5);
@@ -130,6 +140,12 @@ int object_parent(const char *id, char *buf, int size);
 int object_user_cache_add(snac *snac, const char *id, const char *cachedir);
 int object_user_cache_del(snac *snac, const char *id, const char *cachedir);
 
+void relations_start(void);
+void relations_check(void);
+xs_list *relation_users(const char *actor, const char *cachedir);
+int activity_seen(const char *uid, const char *id);
+void activity_seen_add(const char *uid, const char *id);
+
 int follower_add(snac *snac, const char *actor);
 int follower_del(snac *snac, const char *actor);
 int follower_check(snac *snac, const char *actor);
@@ -176,6 +192,10 @@ int is_hidden(snac *snac, const char *id);
 void tag_index(const char *id, const xs_dict *obj);
 xs_list *tag_search(const char *tag, int skip, int show);
 
+xs_list *search_words(const char *text);
+void search_index(const char *id, const xs_dict *obj);
+int search_index_rebuild(void);
+
 xs_val *list_maint(snac *user, const char *list, int op);
 xs_list *list_timeline(snac *user, const char *list, int skip, int show);
 xs_val *list_content(snac *user, const char *list_id, const char *actor_md5, int op);
@@ -184,6 +204,8 @@ void list_distribute(snac *user, const char *who, const xs_dict *post);
 int actor_add(const char *actor, const xs_dict *msg);
 int actor_get(const char *actor, xs_dict **data);
 int actor_get_refresh(snac *user, const char *actor, xs_dict **data);
+int actor_summary_get(const char *actor, xs_dict **data);
+int actor_summary_get_refresh(snac *user, const char *actor, xs_dict **data);
 
 int static_get(snac *snac, const char *id, xs_val **data, int *size, const char *inm, xs_str **etag);
 void static_put(snac *snac, const char *id, const char *data, int size);
@@ -227,6 +249,10 @@ void enqueue_output_raw(const char *keyid, const char *seckey,
                         int retries, int p_status);
 void enqueue_output(snac *snac, const xs_dict *msg,
                     const xs_str *inbox, int retries, int p_status);
+void enqueue_output_wave(snac *snac, const xs_dict *msg,
+                         const xs_str *body, const xs_str *digest,
+                         const xs_str *inbox);
+void enqueue_output_park(const xs_dict *q_item, int secs);
 void enqueue_output_by_actor(snac *snac, const xs_dict *msg,
                              const xs_str *actor, int retries);
 void enqueue_email(const xs_str *msg, int retries);
@@ -241,12 +267,16 @@ int was_question_voted(snac *user, const char *id);
 
 xs_list *user_queue(snac *snac);
 xs_list *queue(void);
+void queue_sched_start(void);
+void queue_sched_add(const char *fn);
+xs_list *queue_sched_due(time_t *next);
 xs_dict *queue_get(const char *fn);
 xs_dict *dequeue(const char *fn);
 
 void purge(snac *snac);
 void purge_all(void);
 
+xs_str *http_digest(const char *body, int b_size);
 xs_dict *http_signed_request_raw(const char *keyid, const char *seckey,
                             const char *method, const char *url,
                             const xs_dict *headers,
@@ -294,9 +324,13 @@ xs_dict *msg_question(snac *user, const char *content, xs_list *attach,
 
 int activitypub_request(snac *snac, const char *url, xs_dict **data);
 int actor_request(snac *user, const char *actor, xs_dict **data);
+int actor_summary_request(snac *user, const char *actor, xs_dict **data);
 int send_to_inbox_raw(const char *keyid, const char *seckey,
                   const xs_str *inbox, const xs_dict *msg,
                   xs_val **payload, int *p_size, int timeout);
+int send_to_inbox_body(const char *keyid, const char *seckey,
+                  const xs_str *inbox, const char *body, const char *digest,
+                  xs_val **payload, int *p_size, int timeout);
 int send_to_inbox(snac *snac, const xs_str *inbox, const xs_dict *msg,
                   xs_val **payload, int *p_size, int timeout);
 xs_str *get_actor_inbox(const char *actor);
@@ -305,10 +339,12 @@ int send_to_actor(snac *snac, const char *actor, const xs_dict *msg,
 int is_msg_public(const xs_dict *msg);
 int is_msg_from_private_user(const xs_dict *msg);
 int is_msg_for_me(snac *snac, const xs_dict *msg);
+xs_list *msg_candidate_users(const xs_dict *c_msg);
 
 int process_user_queue(snac *snac);
 void process_queue_item(xs_dict *q_item);
 int process_queue(void);
+int process_queues(time_t *next);
 
 int activitypub_get_handler(const xs_dict *req, const char *q_path,
                             char **body, int *b_size, char **ctype);
@@ -340,7 +376,10 @@ int deluser(snac *user);
 extern const char *snac_blurb;
 
 void job_post(const xs_val *job, int urgent);
+int job_queue_full(void);
 void job_wait(xs_val **job);
+int job_host_check(const char *url, int *wait);
+void job_host_result(const char *url, int status);
 
 int oauth_get_handler(const xs_dict *req, const char *q_path,
                       char **body, int *b_size, char **ctype);
@@ -530,7 +530,7 @@ void verify_links(snac *user)
         rename(fn, bfn);
 
         if ((f = fopen(fn, "w")) != NULL) {
-            xs_json_dump(user->links, 4, f);
+            xs_json_dump(user->links, json_indent(), f);
             fclose(f);
         }
         else
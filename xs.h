@@ -12,6 +12,7 @@
 #include <stdarg.h>
 #include <signal.h>
 #include <errno.h>
+#include <pthread.h>
 
 typedef enum {
     XSTYPE_STRING = 0x02,       /* C string (\0 delimited) (NOT STORED) */
@@ -40,6 +41,10 @@ typedef char xs_data;
 /* size in bytes of the type size */
 #define _XS_TYPE_SIZE 4
 
+/* lists also store their number of elements and the offset of
+   the last one after the size (in memory only) */
+#define _XS_LIST_HDR (1 + _XS_TYPE_SIZE + _XS_TYPE_SIZE + _XS_TYPE_SIZE)
+
 /* auto-destroyable strings */
 #define xs __attribute__ ((__cleanup__ (_xs_destroy))) xs_val
 
@@ -55,6 +60,10 @@ void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char
 #define xs_realloc(ptr, size) _xs_realloc(ptr, size, __FILE__, __LINE__, __FUNCTION__)
 int _xs_blk_size(int sz);
 void _xs_destroy(char **var);
+void xs_arena_begin(size_t max);
+void xs_arena_end(void);
+int xs_arena_pause(void);
+void xs_arena_resume(int paused);
 #define xs_debug() raise(SIGTRAP)
 xstype xs_type(const xs_val *data);
 int xs_size(const xs_val *data);
@@ -90,6 +99,18 @@ xs_str *xs_strip_chars_i(xs_str *str, const char *chars);
 #define xs_strip_i(str) xs_strip_chars_i(str, " \r\n\t\v\f")
 xs_str *xs_tolower_i(xs_str *str);
 
+/* string builder: a string that knows its length and grows geometrically */
+typedef struct {
+    xs_str *s;      /* the string (NULL until something is added) */
+    int len;        /* its length */
+    int cap;        /* allocated size */
+} xs_str_bld;
+
+void xs_str_bld_cat_m(xs_str_bld *b, const char *mem, int sz);
+#define xs_str_bld_cat(b, str) xs_str_bld_cat_m(b, str, strlen(str))
+void xs_str_bld_chr(xs_str_bld *b, char c);
+xs_str *xs_str_bld_done(xs_str_bld *b);
+
 xs_list *xs_list_new(void);
 xs_list *xs_list_append_m(xs_list *list, const char *mem, int dsz);
 xs_list *_xs_list_append(xs_list *list, const xs_val *vals[]);
@@ -110,6 +131,18 @@ xs_list *xs_split_n(const char *str, const char *sep, int times);
 #define xs_split(str, sep) xs_split_n(str, sep, XS_ALL)
 xs_list *xs_list_cat(xs_list *l1, const xs_list *l2);
 
+/* offset table of a list that doesn't change, for random access */
+typedef struct {
+    const xs_list *list;    /* the indexed list */
+    int lookups;            /* number of lookups */
+    int *offs;              /* offsets of the elements (NULL: not built) */
+} xs_list_idx;
+
+#define xs_lidx __attribute__ ((__cleanup__ (xs_list_idx_free))) xs_list_idx
+xs_list_idx xs_list_idx_new(const xs_list *list);
+const xs_val *xs_list_idx_get(xs_list_idx *idx, int num);
+void xs_list_idx_free(xs_list_idx *idx);
+
 int xs_keyval_size(const xs_str *key, const xs_val *value);
 xs_str *xs_keyval_key(const xs_keyval *keyval);
 xs_val *xs_keyval_value(const xs_keyval *keyval);
@@ -123,6 +156,19 @@ const xs_val *xs_dict_get_def(const xs_dict *dict, const xs_str *key, const xs_v
 #define xs_dict_get(dict, key) xs_dict_get_def(dict, key, NULL)
 xs_dict *xs_dict_del(xs_dict *dict, const xs_str *key);
 xs_dict *xs_dict_set(xs_dict *dict, const xs_str *key, const xs_val *data);
+
+/* hashed index of a dict that doesn't change, for many lookups */
+typedef struct {
+    const xs_dict *dict;    /* the indexed dict */
+    int lookups;            /* number of lookups */
+    int n_slots;            /* size of the table (power of 2, 0: not built) */
+    int *slots;             /* offsets of the keyvals (0: empty) */
+} xs_dict_idx;
+
+#define xs_idx __attribute__ ((__cleanup__ (xs_dict_idx_free))) xs_dict_idx
+xs_dict_idx xs_dict_idx_new(const xs_dict *dict);
+const xs_val *xs_dict_idx_get(xs_dict_idx *idx, const xs_str *key);
+void xs_dict_idx_free(xs_dict_idx *idx);
 xs_dict *xs_dict_gc(xs_dict *dict);
 
 xs_val *xs_val_new(xstype t);
@@ -152,8 +198,248 @@ unsigned int xs_hash_func(const char *data, int size);
 
 #ifdef XS_IMPLEMENTATION
 
+/** arenas **/
+
+/* While a thread has an arena, its new allocations are taken from
+   a contiguous block of reserved address space that is all released
+   at once by xs_arena_end(), and freeing them does nothing (unless
+   it's the last one). Big values, and the ones allocated when the
+   arena is full or paused, come from the heap as usual. Values that
+   must outlive the arena (or be used by other threads) must be created
+   between xs_arena_pause() and xs_arena_resume(). */
+
+#include <sys/mman.h>
+
+#ifndef XS_ARENA_CHUNK
+#define XS_ARENA_CHUNK 65536
+#endif
+
+#ifndef XS_ARENA_BIG
+#define XS_ARENA_BIG 16384
+#endif
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+#define _XS_ARENA_ALIGN(sz) (((sz) + 15) & ~((size_t)15))
+#define _XS_ARENA_HDR _XS_ARENA_ALIGN(sizeof(size_t))
+
+typedef struct {
+    char *base;                     /* the reserved address space */
+    size_t size;                    /* its size */
+    size_t used;                    /* used bytes */
+    size_t peak;                    /* maximum used bytes since the last release */
+    char *last;                     /* last allocated block */
+    int active;
+    int paused;
+} _xs_arena;
+
+static pthread_once_t _xs_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _xs_arena_key;
+static volatile int _xs_arena_used = 0;
+
+
+static void _xs_arena_free(void *arena)
+{
+    _xs_arena *a = arena;
+
+    if (a->base != NULL)
+        munmap(a->base, a->size);
+
+    free(a);
+}
+
+
+static void _xs_arena_init(void)
+{
+    pthread_key_create(&_xs_arena_key, _xs_arena_free);
+}
+
+
+static _xs_arena *_xs_arena_get(void)
+/* returns the arena of this thread, if any */
+{
+    return _xs_arena_used ? pthread_getspecific(_xs_arena_key) : NULL;
+}
+
+
+static int _xs_arena_owns(const _xs_arena *a, const void *ptr)
+/* checks if a pointer is inside the arena */
+{
+    return (const char *)ptr >= a->base && (const char *)ptr < a->base + a->used;
+}
+
+
+static void *_xs_arena_alloc(_xs_arena *a, size_t size)
+/* allocates a block from the arena (NULL if it doesn't fit) */
+{
+    size_t need = _XS_ARENA_HDR + _XS_ARENA_ALIGN(size);
+
+    if (size > XS_ARENA_BIG || a->used + need > a->size)
+        return NULL;
+
+    char *p = a->base + a->used;
+
+    *(size_t *)p = size;
+    a->used += need;
+
+    if (a->used > a->peak)
+        a->peak = a->used;
+
+    a->last = p + _XS_ARENA_HDR;
+
+    return a->last;
+}
+
+
+static void *_xs_arena_realloc(_xs_arena *a, void *ptr, size_t size)
+/* reallocates an arena block (to the heap if it doesn't fit) */
+{
+    size_t *psz = (size_t *)((char *)ptr - _XS_ARENA_HDR);
+    void *n;
+
+    if (size <= *psz) {
+        *psz = size;
+        return ptr;
+    }
+
+    /* the last one? try to grow it in place */
+    if (ptr == a->last && size <= XS_ARENA_BIG &&
+        (char *)ptr + _XS_ARENA_ALIGN(size) <= a->base + a->size) {
+        a->used = (char *)ptr + _XS_ARENA_ALIGN(size) - a->base;
+
+        if (a->used > a->peak)
+            a->peak = a->used;
+
+        *psz = size;
+        return ptr;
+    }
+
+    if ((n = _xs_arena_alloc(a, size)) == NULL && (n = malloc(size)) == NULL) {
+        fprintf(stderr, "**OUT OF MEMORY**\n");
+        abort();
+    }
+
+    memcpy(n, ptr, *psz);
+
+    return n;
+}
+
+
+void xs_arena_begin(size_t max)
+/* starts using an arena of up to max bytes for this thread */
+{
+    _xs_arena *a;
+
+    pthread_once(&_xs_arena_once, _xs_arena_init);
+
+    if ((a = pthread_getspecific(_xs_arena_key)) == NULL) {
+        if ((a = calloc(1, sizeof(_xs_arena))) == NULL)
+            return;
+
+        pthread_setspecific(_xs_arena_key, a);
+    }
+
+    max = (max + XS_ARENA_CHUNK - 1) / XS_ARENA_CHUNK * XS_ARENA_CHUNK;
+
+    if (a->base != NULL && a->size != max) {
+        /* the size changed */
+        munmap(a->base, a->size);
+        a->base = NULL;
+    }
+
+    if (a->base == NULL) {
+        /* only reserved: the pages are not really used until touched */
+        void *p = mmap(NULL, max, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (p == MAP_FAILED)
+            return;
+
+        a->base = p;
+        a->size = max;
+        a->peak = 0;
+    }
+
+    a->used   = 0;
+    a->last   = NULL;
+    a->active = 1;
+    a->paused = 0;
+
+    _xs_arena_used = 1;
+}
+
+
+void xs_arena_end(void)
+/* releases everything allocated in this thread's arena */
+{
+    _xs_arena *a = _xs_arena_get();
+
+    if (a == NULL || !a->active)
+        return;
+
+#ifdef MADV_DONTNEED
+    /* give the pages back, but keep the first chunk for the next time */
+    if (a->peak > XS_ARENA_CHUNK)
+        madvise(a->base + XS_ARENA_CHUNK, a->peak - XS_ARENA_CHUNK, MADV_DONTNEED);
+#endif
+
+    a->used   = 0;
+    a->peak   = 0;
+    a->last   = NULL;
+    a->active = 0;
+}
+
+
+int xs_arena_pause(void)
+/* makes the new allocations come from the heap; returns the previous state */
+{
+    _xs_arena *a = _xs_arena_get();
+    int paused = 1;
+
+    if (a != NULL) {
+        paused = a->paused;
+        a->paused = 1;
+    }
+
+    return paused;
+}
+
+
+void xs_arena_resume(int paused)
+/* restores the state saved by xs_arena_pause() */
+{
+    _xs_arena *a = _xs_arena_get();
+
+    if (a != NULL)
+        a->paused = paused;
+}
+
+
 void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char *func)
 {
+    _xs_arena *a = _xs_arena_get();
+
+    if (a != NULL && a->active) {
+        void *p = NULL;
+
+        if (ptr == NULL) {
+            if (!a->paused)
+                p = _xs_arena_alloc(a, size);
+        }
+        else
+        if (_xs_arena_owns(a, ptr))
+            p = _xs_arena_realloc(a, ptr, size);
+
+        if (p != NULL)
+            return p;
+    }
+
     xs_val *ndata = realloc(ptr, size);
 
     if (ndata == NULL) {
@@ -198,6 +484,18 @@ void *_xs_realloc(void *ptr, size_t size, const char *file, int line, const char
 
 void *xs_free(void *ptr)
 {
+    _xs_arena *a = _xs_arena_get();
+
+    if (a != NULL && a->active && ptr != NULL && _xs_arena_owns(a, ptr)) {
+        /* only the last block can be given back */
+        if (ptr == a->last) {
+            a->used = (char *)ptr - _XS_ARENA_HDR - a->base;
+            a->last = NULL;
+        }
+
+        return NULL;
+    }
+
 #ifdef XS_DEBUG
     if (ptr != NULL) {
         FILE *f = fopen("xs_memory.out", "a");
@@ -231,6 +529,12 @@ int _xs_blk_size(int sz)
     else
     if (sz < 4096)
         blk_size = 256;
+    else {
+        /* grow geometrically (wasting up to 1/8), so that
+           appending to big values is not quadratic */
+        while (blk_size < sz / 8)
+            blk_size *= 2;
+    }
 
     return ((((sz) + blk_size) / blk_size) * blk_size);
 }
@@ -282,6 +586,38 @@ int _xs_get_size(const xs_val *ptr)
 }
 
 
+void _xs_put_count(xs_list *list, int i)
+/* stores the number of elements of a list */
+{
+    memcpy(list + 1 + _XS_TYPE_SIZE, &i, sizeof(i));
+}
+
+
+int _xs_get_count(const xs_list *list)
+/* gets the number of elements of a list */
+{
+    int i;
+    memcpy(&i, list + 1 + _XS_TYPE_SIZE, sizeof(i));
+    return i;
+}
+
+
+void _xs_put_last(xs_list *list, int offset)
+/* stores the offset of the last element of a list (0: empty) */
+{
+    memcpy(list + 1 + _XS_TYPE_SIZE + _XS_TYPE_SIZE, &offset, sizeof(offset));
+}
+
+
+int _xs_get_last(const xs_list *list)
+/* gets the offset of the last element of a list */
+{
+    int offset;
+    memcpy(&offset, list + 1 + _XS_TYPE_SIZE + _XS_TYPE_SIZE, sizeof(offset));
+    return offset;
+}
+
+
 int xs_size(const xs_val *data)
 /* returns the size of data in bytes */
 {
@@ -373,16 +709,14 @@ xs_val *xs_expand(xs_val *data, int offset, int size)
 /* opens a hole in data */
 {
     int sz = xs_size(data);
-    int n;
-
-    sz += size;
 
     /* open room */
-    data = xs_realloc(data, _xs_blk_size(sz));
+    data = xs_realloc(data, _xs_blk_size(sz + size));
 
     /* move up the rest of the data */
-    for (n = sz - 1; n >= offset + size; n--)
-        data[n] = data[n - size];
+    memmove(data + offset + size, data + offset, sz - offset);
+
+    sz += size;
 
     if (xs_type(data) == XSTYPE_LIST ||
         xs_type(data) == XSTYPE_DICT ||
@@ -397,7 +731,6 @@ xs_val *xs_collapse(xs_val *data, int offset, int size)
 /* shrinks data */
 {
     int sz = xs_size(data);
-    int n;
 
     /* don't try to delete beyond the limit */
     if (offset + size > sz)
@@ -406,8 +739,7 @@ xs_val *xs_collapse(xs_val *data, int offset, int size)
     /* shrink total size */
     sz -= size;
 
-    for (n = offset; n < sz; n++)
-        data[n] = data[n + size];
+    memmove(data + offset, data + offset + size, sz - offset);
 
     if (xs_type(data) == XSTYPE_LIST ||
         xs_type(data) == XSTYPE_DICT ||
@@ -447,13 +779,19 @@ xs_val *xs_stock(int type)
     case XSTYPE_FALSE: return stock_false;
 
     case XSTYPE_LIST:
-        if (stock_list == NULL)
+        if (stock_list == NULL) {
+            int paused = xs_arena_pause();
             stock_list = xs_list_new();
+            xs_arena_resume(paused);
+        }
         return stock_list;
 
     case XSTYPE_DICT:
-        if (stock_dict == NULL)
+        if (stock_dict == NULL) {
+            int paused = xs_arena_pause();
             stock_dict = xs_dict_new();
+            xs_arena_resume(paused);
+        }
         return stock_dict;
     }
 
@@ -666,17 +1004,68 @@ xs_str *xs_tolower_i(xs_str *str)
 }
 
 
+/** string builders **/
+
+void xs_str_bld_cat_m(xs_str_bld *b, const char *mem, int sz)
+/* appends a memory block to the string being built */
+{
+    if (b->len + sz + 1 > b->cap) {
+        int cap = b->cap ? b->cap : 32;
+
+        while (cap < b->len + sz + 1)
+            cap *= 2;
+
+        b->s   = xs_realloc(b->s, cap);
+        b->cap = cap;
+    }
+
+    memcpy(b->s + b->len, mem, sz);
+    b->len += sz;
+    b->s[b->len] = '\0';
+}
+
+
+void xs_str_bld_chr(xs_str_bld *b, char c)
+/* appends a char to the string being built */
+{
+    if (b->len + 2 <= b->cap) {
+        b->s[b->len++] = c;
+        b->s[b->len]   = '\0';
+    }
+    else
+        xs_str_bld_cat_m(b, &c, 1);
+}
+
+
+xs_str *xs_str_bld_done(xs_str_bld *b)
+/* returns the built string, leaving the builder empty */
+{
+    xs_str *s = b->s;
+
+    if (s == NULL)
+        s = xs_str_new(NULL);
+    else
+        s = xs_realloc(s, _xs_blk_size(b->len + 1));
+
+    *b = (xs_str_bld){ NULL, 0, 0 };
+
+    return s;
+}
+
+
 /** lists **/
 
 xs_list *xs_list_new(void)
 /* creates a new list */
 {
-    int sz = 1 + _XS_TYPE_SIZE + 1;
+    int sz = _XS_LIST_HDR + 1;
     xs_list *l = xs_realloc(NULL, sz);
     memset(l, XSTYPE_EOM, sz);
 
     l[0] = XSTYPE_LIST;
     _xs_put_size(l, sz);
+    _xs_put_count(l, 0);
+    _xs_put_last(l, 0);
 
     return l;
 }
@@ -692,11 +1081,17 @@ xs_list *_xs_list_write_litem(xs_list *list, int offset, const char *mem, int ds
         dsz = xs_size(mem);
     }
 
+    /* at the end or before the last one? */
+    int last = offset == xs_size(list) - 1 ? offset : _xs_get_last(list) + dsz + 1;
+
     list = xs_expand(list, offset, dsz + 1);
 
     list[offset] = XSTYPE_LITEM;
     memcpy(list + offset + 1, mem, dsz);
 
+    _xs_put_count(list, _xs_get_count(list) + 1);
+    _xs_put_last(list, last);
+
     return list;
 }
 
@@ -735,7 +1130,7 @@ int xs_list_iter(xs_list **list, const xs_val **value)
 
     /* skip the start of the list */
     if (xs_type(p) == XSTYPE_LIST)
-        p += 1 + _XS_TYPE_SIZE;
+        p += _XS_LIST_HDR;
 
     /* an element? */
     if (xs_type(p) == XSTYPE_LITEM) {
@@ -769,7 +1164,7 @@ int xs_list_next(const xs_list *list, const xs_val **value, int *ctxt)
 
     /* skip the start of the list */
     if (*ctxt == 0)
-        *ctxt = 1 + _XS_TYPE_SIZE;
+        *ctxt = _XS_LIST_HDR;
 
     p += *ctxt;
 
@@ -798,13 +1193,10 @@ int xs_list_len(const xs_list *list)
 {
     XS_ASSERT_TYPE_NULL(list, XSTYPE_LIST);
 
-    int c = 0, ct = 0;
-    const xs_val *v;
-
-    while (xs_list_next(list, &v, &ct))
-        c++;
+    if (xs_type(list) != XSTYPE_LIST)
+        return 0;
 
-    return c;
+    return _xs_get_count(list);
 }
 
 
@@ -813,8 +1205,17 @@ const xs_val *xs_list_get(const xs_list *list, int num)
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
+    int n = xs_list_len(list);
+
     if (num < 0)
-        num = xs_list_len(list) + num;
+        num = n + num;
+
+    if (num < 0 || num >= n)
+        return NULL;
+
+    /* the last one is known */
+    if (num == n - 1)
+        return list + _xs_get_last(list) + 1;
 
     int c = 0, ct = 0;
     const xs_val *v;
@@ -830,6 +1231,33 @@ const xs_val *xs_list_get(const xs_list *list, int num)
 }
 
 
+xs_list *_xs_list_del_litem(xs_list *list, int offset)
+/* deletes the list item at offset */
+{
+    int sz   = xs_size(list + offset);
+    int last = _xs_get_last(list);
+
+    list = xs_collapse(list, offset, sz);
+    _xs_put_count(list, _xs_get_count(list) - 1);
+
+    if (offset < last)
+        last -= sz;
+    else {
+        /* it was the last one: find the new last one */
+        const xs_val *v;
+        int ct = 0;
+
+        last = 0;
+        while (xs_list_next(list, &v, &ct))
+            last = v - 1 - list;
+    }
+
+    _xs_put_last(list, last);
+
+    return list;
+}
+
+
 xs_list *xs_list_del(xs_list *list, int num)
 /* deletes element #num */
 {
@@ -838,7 +1266,7 @@ xs_list *xs_list_del(xs_list *list, int num)
     const xs_val *v;
 
     if ((v = xs_list_get(list, num)) != NULL)
-        list = xs_collapse(list, v - 1 - list, xs_size(v - 1));
+        list = _xs_list_del_litem(list, v - 1 - list);
 
     return list;
 }
@@ -866,8 +1294,32 @@ xs_list *xs_list_set(xs_list *list, int num, const xs_val *data)
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
-    list = xs_list_del(list, num);
-    list = xs_list_insert(list, num, data);
+    const xs_val *v;
+
+    if (data == NULL)
+        data = xs_stock(XSTYPE_NULL);
+
+    if ((v = xs_list_get(list, num)) != NULL) {
+        /* replace the value in place */
+        int offset = v - list;
+        int o_sz   = xs_size(v);
+        int n_sz   = xs_size(data);
+
+        if (n_sz > o_sz)
+            list = xs_expand(list, offset + o_sz, n_sz - o_sz);
+        else
+        if (n_sz < o_sz)
+            list = xs_collapse(list, offset + n_sz, o_sz - n_sz);
+
+        memcpy(list + offset, data, n_sz);
+
+        /* the last one moves if this was before it */
+        int last = _xs_get_last(list);
+        if (offset < last)
+            _xs_put_last(list, last + n_sz - o_sz);
+    }
+    else
+        list = xs_list_insert(list, num, data);
 
     return list;
 }
@@ -878,23 +1330,11 @@ xs_list *xs_list_dequeue(xs_list *list, xs_val **data, int last)
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
-    int ct = 0;
-    const xs_val *v = NULL;
-
-    if (!last) {
-        /* get the first */
-        xs_list_next(list, &v, &ct);
-    }
-    else {
-        /* iterate to the end */
-        while (xs_list_next(list, &v, &ct));
-    }
+    const xs_val *v;
 
-    if (v != NULL) {
+    if ((v = xs_list_get(list, last ? -1 : 0)) != NULL) {
         *data = xs_dup(v);
-
-        /* collapse from the address of the element */
-        list = xs_collapse(list, v - 1 - list, xs_size(v - 1));
+        list = _xs_list_del_litem(list, v - 1 - list);
     }
 
     return list;
@@ -927,41 +1367,27 @@ xs_str *xs_join(const xs_list *list, const char *sep)
 {
     XS_ASSERT_TYPE(list, XSTYPE_LIST);
 
-    xs_str *s = NULL;
+    xs_str_bld b = { NULL, 0, 0 };
     const xs_val *v;
     int c = 0;
     int ct = 0;
-    int offset = 0;
     int ssz = strlen(sep);
 
     while (xs_list_next(list, &v, &ct)) {
         /* refuse to join non-string values */
         if (xs_type(v) == XSTYPE_STRING) {
-            int sz;
-
             /* add the separator */
-            if (c != 0 && ssz) {
-                s = xs_realloc(s, offset + ssz);
-                memcpy(s + offset, sep, ssz);
-                offset += ssz;
-            }
+            if (c != 0 && ssz)
+                xs_str_bld_cat_m(&b, sep, ssz);
 
             /* add the element */
-            if ((sz = strlen(v)) > 0) {
-                s = xs_realloc(s, offset + sz);
-                memcpy(s + offset, v, sz);
-                offset += sz;
-            }
+            xs_str_bld_cat(&b, v);
 
             c++;
         }
     }
 
-    /* null-terminate */
-    s = xs_realloc(s, _xs_blk_size(offset + 1));
-    s[offset] = '\0';
-
-    return s;
+    return xs_str_bld_done(&b);
 }
 
 
@@ -998,9 +1424,68 @@ xs_list *xs_list_cat(xs_list *l1, const xs_list *l2)
     XS_ASSERT_TYPE(l1, XSTYPE_LIST);
     XS_ASSERT_TYPE(l2, XSTYPE_LIST);
 
+    int c = _xs_get_count(l1) + _xs_get_count(l2);
+    int last = _xs_get_last(l1);
+
+    if (_xs_get_count(l2))
+        last = xs_size(l1) - 1 + _xs_get_last(l2) - _XS_LIST_HDR;
+
     /* inserts at the end of l1 the content of l2 (skipping header and footer) */
-    return xs_insert_m(l1, xs_size(l1) - 1,
-        l2 + 1 + _XS_TYPE_SIZE, xs_size(l2) - (1 + _XS_TYPE_SIZE + 1));
+    l1 = xs_insert_m(l1, xs_size(l1) - 1,
+        l2 + _XS_LIST_HDR, xs_size(l2) - (_XS_LIST_HDR + 1));
+
+    _xs_put_count(l1, c);
+    _xs_put_last(l1, last);
+
+    return l1;
+}
+
+
+#ifndef XS_LIST_IDX_LAZY
+#define XS_LIST_IDX_LAZY 4
+#endif
+
+xs_list_idx xs_list_idx_new(const xs_list *list)
+/* creates an offset table for a list; it's built after some lookups */
+{
+    XS_ASSERT_TYPE_NULL(list, XSTYPE_LIST);
+
+    return (xs_list_idx){ list, 0, NULL };
+}
+
+
+const xs_val *xs_list_idx_get(xs_list_idx *idx, int num)
+/* returns the element #num */
+{
+    int n = xs_list_len(idx->list);
+
+    if (num < 0)
+        num = n + num;
+
+    if (num < 0 || num >= n)
+        return NULL;
+
+    if (idx->offs == NULL) {
+        if (++idx->lookups <= XS_LIST_IDX_LAZY)
+            return xs_list_get(idx->list, num);
+
+        const xs_val *v;
+        int c = 0, ct = 0;
+
+        idx->offs = xs_realloc(NULL, n * sizeof(int));
+
+        while (xs_list_next(idx->list, &v, &ct))
+            idx->offs[c++] = v - idx->list;
+    }
+
+    return &idx->list[idx->offs[num]];
+}
+
+
+void xs_list_idx_free(xs_list_idx *idx)
+/* frees an offset table */
+{
+    idx->offs = xs_free(idx->offs);
 }
 
 
@@ -1134,7 +1619,7 @@ const xs_val *xs_dict_get_def(const xs_dict *dict, const xs_str *key, const xs_v
     int c = 0;
 
     while (xs_dict_next(dict, &k, &v, &c)) {
-        if (strcmp(k, key) == 0)
+        if (*k == *key && strcmp(k, key) == 0)
             return v;
     }
 
@@ -1172,13 +1657,109 @@ xs_dict *xs_dict_set(xs_dict *dict, const xs_str *key, const xs_val *data)
     XS_ASSERT_TYPE(dict, XSTYPE_DICT);
     XS_ASSERT_TYPE(key, XSTYPE_STRING);
 
-    /* delete the possibly existing key */
-    dict = xs_dict_del(dict, key);
+    const xs_str *k;
+    const xs_val *v;
+    int c = 0;
 
-    /* add the data */
-    dict = xs_dict_append(dict, key, data);
+    if (data == NULL)
+        data = xs_stock(XSTYPE_NULL);
 
-    return dict;
+    while (xs_dict_next(dict, &k, &v, &c)) {
+        if (*k == *key && strcmp(k, key) == 0) {
+            /* replace the value in place */
+            int offset = v - dict;
+            int o_size = xs_size(v);
+            int n_size = xs_size(data);
+
+            if (n_size > o_size)
+                dict = xs_expand(dict, offset + o_size, n_size - o_size);
+            else
+            if (n_size < o_size)
+                dict = xs_collapse(dict, offset + n_size, o_size - n_size);
+
+            memcpy(&dict[offset], data, n_size);
+
+            return dict;
+        }
+    }
+
+    /* not there; add the data */
+    return xs_dict_append(dict, key, data);
+}
+
+
+#ifndef XS_DICT_IDX_LAZY
+#define XS_DICT_IDX_LAZY 8
+#endif
+
+xs_dict_idx xs_dict_idx_new(const xs_dict *dict)
+/* creates an index for a dict; the table is built after some lookups */
+{
+    XS_ASSERT_TYPE(dict, XSTYPE_DICT);
+
+    return (xs_dict_idx){ dict, 0, 0, NULL };
+}
+
+
+static void _xs_dict_idx_build(xs_dict_idx *idx)
+/* builds the hash table of the index */
+{
+    const xs_str *k;
+    const xs_val *v;
+    int c = 0, n = 0;
+
+    while (xs_dict_next(idx->dict, &k, &v, &c))
+        n++;
+
+    for (idx->n_slots = 8; idx->n_slots < n * 2; idx->n_slots *= 2);
+
+    idx->slots = xs_realloc(NULL, idx->n_slots * sizeof(int));
+    memset(idx->slots, '\0', idx->n_slots * sizeof(int));
+
+    c = 0;
+    while (xs_dict_next(idx->dict, &k, &v, &c)) {
+        unsigned int i = xs_hash_func(k, strlen(k)) & (idx->n_slots - 1);
+
+        /* the first one wins, as in xs_dict_get() */
+        while (idx->slots[i] && strcmp(&idx->dict[idx->slots[i] + 1], k) != 0)
+            i = (i + 1) & (idx->n_slots - 1);
+
+        if (idx->slots[i] == 0)
+            idx->slots[i] = k - 1 - idx->dict;
+    }
+}
+
+
+const xs_val *xs_dict_idx_get(xs_dict_idx *idx, const xs_str *key)
+/* returns the value directed by key, or NULL */
+{
+    if (idx->n_slots == 0) {
+        if (++idx->lookups <= XS_DICT_IDX_LAZY)
+            return xs_dict_get(idx->dict, key);
+
+        _xs_dict_idx_build(idx);
+    }
+
+    unsigned int i = xs_hash_func(key, strlen(key)) & (idx->n_slots - 1);
+
+    while (idx->slots[i]) {
+        const xs_keyval *kv = &idx->dict[idx->slots[i]];
+
+        if (strcmp(xs_keyval_key(kv), key) == 0)
+            return xs_keyval_value(kv);
+
+        i = (i + 1) & (idx->n_slots - 1);
+    }
+
+    return NULL;
+}
+
+
+void xs_dict_idx_free(xs_dict_idx *idx)
+/* frees an index */
+{
+    idx->slots = xs_free(idx->slots);
+    idx->n_slots = 0;
 }
 
 
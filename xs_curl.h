@@ -12,6 +12,91 @@ xs_dict *xs_http_request(const char *method, const char *url,
 #ifdef XS_IMPLEMENTATION
 
 #include <curl/curl.h>
+#include <pthread.h>
+
+/* each thread keeps its own handle (and, with it, its cache of open
+   connections), and all of them share the DNS and TLS session caches */
+
+#ifndef XS_CURL_MAXCONNECTS
+#define XS_CURL_MAXCONNECTS 16
+#endif
+
+static pthread_once_t _xs_curl_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _xs_curl_key;
+static CURLSH *_xs_curl_share = NULL;
+static pthread_mutex_t _xs_curl_mutex[CURL_LOCK_DATA_LAST];
+
+
+static void _xs_curl_lock(CURL *handle, curl_lock_data data,
+                          curl_lock_access access, void *userptr)
+{
+    (void)handle;
+    (void)access;
+    (void)userptr;
+
+    pthread_mutex_lock(&_xs_curl_mutex[data]);
+}
+
+
+static void _xs_curl_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+    (void)handle;
+    (void)userptr;
+
+    pthread_mutex_unlock(&_xs_curl_mutex[data]);
+}
+
+
+static void _xs_curl_free(void *curl)
+{
+    curl_easy_cleanup(curl);
+}
+
+
+static void _xs_curl_init(void)
+{
+    int n;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    for (n = 0; n < CURL_LOCK_DATA_LAST; n++)
+        pthread_mutex_init(&_xs_curl_mutex[n], NULL);
+
+    pthread_key_create(&_xs_curl_key, _xs_curl_free);
+
+    if ((_xs_curl_share = curl_share_init()) != NULL) {
+        curl_share_setopt(_xs_curl_share, CURLSHOPT_LOCKFUNC,   _xs_curl_lock);
+        curl_share_setopt(_xs_curl_share, CURLSHOPT_UNLOCKFUNC, _xs_curl_unlock);
+        curl_share_setopt(_xs_curl_share, CURLSHOPT_SHARE,      CURL_LOCK_DATA_DNS);
+        curl_share_setopt(_xs_curl_share, CURLSHOPT_SHARE,      CURL_LOCK_DATA_SSL_SESSION);
+    }
+}
+
+
+static CURL *_xs_curl_handle(void)
+/* returns this thread's handle, ready to be used */
+{
+    CURL *curl;
+
+    pthread_once(&_xs_curl_once, _xs_curl_init);
+
+    if ((curl = pthread_getspecific(_xs_curl_key)) != NULL) {
+        /* this keeps the open connections and the shares */
+        curl_easy_reset(curl);
+    }
+    else
+    if ((curl = curl_easy_init()) != NULL) {
+        if (_xs_curl_share != NULL)
+            curl_easy_setopt(curl, CURLOPT_SHARE, _xs_curl_share);
+
+        pthread_setspecific(_xs_curl_key, curl);
+    }
+
+    if (curl != NULL)
+        curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, (long) XS_CURL_MAXCONNECTS);
+
+    return curl;
+}
 
 static size_t _header_callback(char *buffer, size_t size,
                                size_t nitems, xs_dict **userdata)
@@ -100,7 +185,12 @@ xs_dict *xs_http_request(const char *method, const char *url,
 
     response = xs_dict_new();
 
-    curl = curl_easy_init();
+    if ((curl = _xs_curl_handle()) == NULL) {
+        if (status != NULL)
+            *status = -CURLE_FAILED_INIT;
+
+        return response;
+    }
 
     curl_easy_setopt(curl, CURLOPT_URL, url);
 
@@ -163,7 +253,7 @@ xs_dict *xs_http_request(const char *method, const char *url,
 
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lstatus);
 
-    curl_easy_cleanup(curl);
+    /* the handle is kept for the next request from this thread */
 
     curl_slist_free_all(list);
 
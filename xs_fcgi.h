@@ -2,8 +2,10 @@
 
 /*
     This is an intentionally-dead-simple FastCGI implementation;
-    only FCGI_RESPONDER type with *no* FCGI_KEEP_CON flag is supported.
-    This means only one simultaneous connection and no multiplexing.
+    only FCGI_RESPONDER type is supported. The FCGI_KEEP_CONN flag is
+    accepted (the request dict gets a "fcgi_keep_conn" field, so the
+    caller can reuse the connection for the next request), but requests
+    in the same connection must come one after the other: no multiplexing.
     It seems it's enough for nginx and OpenBSD's httpd, so here it goes.
     Almost fully compatible with xs_httpd.h
 */
@@ -88,6 +90,7 @@ xs_dict *xs_fcgi_request(FILE *f, xs_str **payload, int *p_size, int *fcgi_id)
     unsigned char p_status = FCGI_REQUEST_COMPLETE;
     xs *q_vars = NULL;
     xs *p_vars = NULL;
+    int keep_conn = 0;
 
     *fcgi_id = -1;
 
@@ -116,11 +119,8 @@ xs_dict *xs_fcgi_request(FILE *f, xs_str **payload, int *p_size, int *fcgi_id)
                 goto end;
             }
 
-            /* fail on unsupported flags */
-            if (breq->flags & FCGI_KEEP_CONN) {
-                p_status = FCGI_CANT_MPX_CONN;
-                goto end;
-            }
+            /* the web server wants to reuse the connection */
+            keep_conn = !!(breq->flags & FCGI_KEEP_CONN);
 
             /* store the id for later */
             *fcgi_id = (int) hdr.id;
@@ -249,6 +249,9 @@ xs_dict *xs_fcgi_request(FILE *f, xs_str **payload, int *p_size, int *fcgi_id)
                 req = xs_dict_append(req, "q_vars", q_vars);
                 req = xs_dict_append(req, "p_vars", p_vars);
 
+                if (keep_conn)
+                    req = xs_dict_append(req, "fcgi_keep_conn", xs_stock(XSTYPE_TRUE));
+
                 /* disconnect the payload from the buf variable */
                 buf = NULL;
 
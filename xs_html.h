@@ -50,41 +50,29 @@ struct xs_html {
 xs_str *xs_html_encode(const char *str)
 /* encodes str using HTML entities */
 {
-    xs_str *s = xs_str_new(NULL);
-    int o = 0;
-    const char *e = str + strlen(str);
+    xs_str_bld b = { NULL, 0, 0 };
 
     for (;;) {
-        char *ec = "<>\"'&";   /* characters to escape */
-        const char *q = e;
-        int z;
-
-        /* find the nearest happening of a char */
-        while (*ec) {
-            char *m = memchr(str, *ec++, q - str);
-            if (m)
-                q = m;
-        }
+        /* find the nearest happening of a char to escape */
+        int z = strcspn(str, "<>\"'&");
 
         /* copy string to here */
-        z = q - str;
-        s = xs_insert_m(s, o, str, z);
-        o += z;
+        xs_str_bld_cat_m(&b, str, z);
+        str += z;
 
-        /* if q points to the end, nothing more to do */
-        if (q == e)
+        /* at the end? nothing more to do */
+        if (*str == '\0')
             break;
 
-        /* insert the escaped char */
+        /* add the escaped char */
         char tmp[8];
-        z = snprintf(tmp, sizeof(tmp), "&#%d;", *q);
-        s = xs_insert_m(s, o, tmp, z);
-        o += z;
+        z = snprintf(tmp, sizeof(tmp), "&#%d;", *str);
+        xs_str_bld_cat_m(&b, tmp, z);
 
-        str = q + 1;
+        str++;
     }
 
-    return s;
+    return xs_str_bld_done(&b);
 }
 
 
@@ -187,50 +175,54 @@ xs_html *_xs_html_container(xs_html *var[])
 }
 
 
-void xs_html_render_f(xs_html *h, FILE *f)
-/* renders the tag and its subtags into a file */
+static void _xs_html_render_b(xs_html *h, xs_str_bld *b)
+/* renders the tag and its subtags into a string builder */
 {
     if (h == NULL)
         return;
 
     /* follow the chain */
-    xs_html_render_f(h->next, f);
+    _xs_html_render_b(h->next, b);
 
     switch (h->type) {
     case XS_HTML_TAG:
-        fprintf(f, "<%s", h->content);
+        xs_str_bld_chr(b, '<');
+        xs_str_bld_cat(b, h->content);
 
         /* attributes */
-        xs_html_render_f(h->attrs, f);
+        _xs_html_render_b(h->attrs, b);
 
-        fprintf(f, ">");
+        xs_str_bld_chr(b, '>');
 
         /* sub-tags */
-        xs_html_render_f(h->tags, f);
+        _xs_html_render_b(h->tags, b);
 
-        fprintf(f, "</%s>", h->content);
+        xs_str_bld_cat_m(b, "</", 2);
+        xs_str_bld_cat(b, h->content);
+        xs_str_bld_chr(b, '>');
         break;
 
     case XS_HTML_SCTAG:
-        fprintf(f, "<%s", h->content);
+        xs_str_bld_chr(b, '<');
+        xs_str_bld_cat(b, h->content);
 
         /* attributes */
-        xs_html_render_f(h->attrs, f);
+        _xs_html_render_b(h->attrs, b);
 
-        fprintf(f, "/>");
+        xs_str_bld_cat_m(b, "/>", 2);
         break;
 
     case XS_HTML_CONTAINER:
         /* sub-tags */
-        xs_html_render_f(h->tags, f);
+        _xs_html_render_b(h->tags, b);
         break;
 
     case XS_HTML_ATTR:
-        fprintf(f, " ");
+        xs_str_bld_chr(b, ' ');
         /* fallthrough */
 
     case XS_HTML_TEXT:
-        fprintf(f, "%s", h->content);
+        xs_str_bld_cat(b, h->content);
         break;
     }
 
@@ -239,22 +231,31 @@ void xs_html_render_f(xs_html *h, FILE *f)
 }
 
 
+void xs_html_render_f(xs_html *h, FILE *f)
+/* renders the tag and its subtags into a file */
+{
+    xs_str_bld b = { NULL, 0, 0 };
+
+    _xs_html_render_b(h, &b);
+
+    if (b.len)
+        fwrite(b.s, b.len, 1, f);
+
+    xs_free(b.s);
+}
+
+
 xs_str *xs_html_render_s(xs_html *tag, const char *prefix)
 /* renders to a string */
 {
-    xs_str *s = NULL;
-    size_t sz;
-    FILE *f;
+    xs_str_bld b = { NULL, 0, 0 };
 
-    if ((f = open_memstream(&s, &sz)) != NULL) {
-        if (prefix)
-            fprintf(f, "%s", prefix);
+    if (prefix)
+        xs_str_bld_cat(&b, prefix);
 
-        xs_html_render_f(tag, f);
-        fclose(f);
-    }
+    _xs_html_render_b(tag, &b);
 
-    return s;
+    return xs_str_bld_done(&b);
 }
 
 
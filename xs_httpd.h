@@ -110,12 +110,16 @@ void xs_httpd_response(FILE *f, int status, xs_dict *headers, xs_str *body, int
         fprintf(f, "%s: %s\r\n", k, v);
     }
 
-    if (b_size != 0)
+    /* these statuses can't have a body */
+    int no_body = status / 100 == 1 || status == 204 || status == 304;
+
+    /* always sent otherwise, so that the client can reuse the connection */
+    if (!no_body)
         fprintf(f, "content-length: %d\r\n", b_size);
 
     fprintf(f, "\r\n");
 
-    if (body != NULL && b_size != 0)
+    if (!no_body && body != NULL && b_size != 0)
         fwrite(body, b_size, 1, f);
 }
 
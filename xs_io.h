@@ -20,18 +20,17 @@ xs_str *xs_readline(FILE *f)
 
     /* don't even try on eof */
     if (!feof(f)) {
+        xs_str_bld b = { NULL, 0, 0 };
         int c;
 
-        s = xs_str_new(NULL);
-
         while ((c = fgetc(f)) != EOF) {
-            unsigned char rc = c;
-
-            s = xs_append_m(s, (char *)&rc, 1);
+            xs_str_bld_chr(&b, c);
 
             if (c == '\n')
                 break;
         }
+
+        s = xs_str_bld_done(&b);
     }
 
     return s;
@@ -9,6 +9,12 @@ xs_str *xs_json_dumps(const xs_val *data, int indent);
 
 xs_val *xs_json_load(FILE *f);
 xs_val *xs_json_loads(const xs_str *json);
+xs_val *xs_json_loads_m(const char *json, int size);
+
+xs_dict *_xs_json_peek_m(const char *json, int size, const char *keys[]);
+#define xs_json_peek_m(json, size, ...) _xs_json_peek_m(json, size, (const char *[]){ __VA_ARGS__, NULL })
+xs_dict *_xs_json_peek(FILE *f, const char *keys[]);
+#define xs_json_peek(f, ...) _xs_json_peek(f, (const char *[]){ __VA_ARGS__, NULL })
 
 xstype xs_json_load_type(FILE *f);
 int xs_json_load_array_iter(FILE *f, xs_val **value, xstype *pt, int *c);
@@ -23,55 +29,71 @@ xs_dict *xs_json_load_object(FILE *f);
 
 /** JSON dumps **/
 
-static void _xs_json_dump_str(const char *data, FILE *f)
+static void _xs_json_dump_str(const char *data, xs_str_bld *b)
 /* dumps a string in JSON format */
 {
-    unsigned char c;
-    fputs("\"", f);
+    xs_str_bld_chr(b, '"');
+
+    for (;;) {
+        const char *p = data;
+
+        /* find the run of chars that don't need escaping */
+        while ((unsigned char)*p >= 32 && *p != '"' && *p != '\\')
+            p++;
+
+        xs_str_bld_cat_m(b, data, p - data);
+
+        unsigned char c = *p;
+
+        if (c == '\0')
+            break;
 
-    while ((c = *data)) {
         if (c == '\n')
-            fputs("\\n", f);
+            xs_str_bld_cat_m(b, "\\n", 2);
         else
         if (c == '\r')
-            fputs("\\r", f);
+            xs_str_bld_cat_m(b, "\\r", 2);
         else
         if (c == '\t')
-            fputs("\\t", f);
+            xs_str_bld_cat_m(b, "\\t", 2);
         else
         if (c == '\\')
-            fputs("\\\\", f);
+            xs_str_bld_cat_m(b, "\\\\", 2);
         else
         if (c == '"')
-            fputs("\\\"", f);
-        else
-        if (c < 32)
-            fprintf(f, "\\u%04x", (unsigned int) c);
-        else
-            fputc(c, f);
+            xs_str_bld_cat_m(b, "\\\"", 2);
+        else {
+            char tmp[8];
+            xs_str_bld_cat_m(b, tmp, snprintf(tmp, sizeof(tmp), "\\u%04x", (unsigned int) c));
+        }
 
-        data++;
+        data = p + 1;
     }
 
-    fputs("\"", f);
+    xs_str_bld_chr(b, '"');
 }
 
 
-static void _xs_json_indent(int level, int indent, FILE *f)
+static void _xs_json_indent(int level, int indent, xs_str_bld *b)
 /* adds indentation */
 {
     if (indent) {
-        int n;
+        static const char spaces[] = "                                ";
+        int n = level * indent;
+
+        xs_str_bld_chr(b, '\n');
 
-        fputc('\n', f);
+        while (n > 0) {
+            int z = n < (int)sizeof(spaces) - 1 ? n : (int)sizeof(spaces) - 1;
 
-        for (n = 0; n < level * indent; n++)
-            fputc(' ', f);
+            xs_str_bld_cat_m(b, spaces, z);
+            n -= z;
+        }
     }
 }
 
 
-static void _xs_json_dump(const xs_val *data, int level, int indent, FILE *f)
+static void _xs_json_dump(const xs_val *data, int level, int indent, xs_str_bld *b)
 /* dumps partial data as JSON */
 {
     int c = 0;
@@ -80,67 +102,67 @@ static void _xs_json_dump(const xs_val *data, int level, int indent, FILE *f)
 
     switch (xs_type(data)) {
     case XSTYPE_NULL:
-        fputs("null", f);
+        xs_str_bld_cat_m(b, "null", 4);
         break;
 
     case XSTYPE_TRUE:
-        fputs("true", f);
+        xs_str_bld_cat_m(b, "true", 4);
         break;
 
     case XSTYPE_FALSE:
-        fputs("false", f);
+        xs_str_bld_cat_m(b, "false", 5);
         break;
 
     case XSTYPE_NUMBER:
-        fputs(xs_number_str(data), f);
+        xs_str_bld_cat(b, xs_number_str(data));
         break;
 
     case XSTYPE_LIST:
-        fputc('[', f);
+        xs_str_bld_chr(b, '[');
 
         while (xs_list_next(data, &v, &ct)) {
             if (c != 0)
-                fputc(',', f);
+                xs_str_bld_chr(b, ',');
 
-            _xs_json_indent(level + 1, indent, f);
-            _xs_json_dump(v, level + 1, indent, f);
+            _xs_json_indent(level + 1, indent, b);
+            _xs_json_dump(v, level + 1, indent, b);
 
             c++;
         }
 
-        _xs_json_indent(level, indent, f);
-        fputc(']', f);
+        _xs_json_indent(level, indent, b);
+        xs_str_bld_chr(b, ']');
 
         break;
 
     case XSTYPE_DICT:
-        fputc('{', f);
+        xs_str_bld_chr(b, '{');
 
         const xs_str *k;
 
         while (xs_dict_next(data, &k, &v, &ct)) {
             if (c != 0)
-                fputc(',', f);
+                xs_str_bld_chr(b, ',');
 
-            _xs_json_indent(level + 1, indent, f);
+            _xs_json_indent(level + 1, indent, b);
 
-            _xs_json_dump_str(k, f);
-            fputc(':', f);
+            _xs_json_dump_str(k, b);
+            xs_str_bld_chr(b, ':');
 
             if (indent)
-                fputc(' ', f);
+                xs_str_bld_chr(b, ' ');
 
-            _xs_json_dump(v, level + 1, indent, f);
+            _xs_json_dump(v, level + 1, indent, b);
 
             c++;
         }
 
-        _xs_json_indent(level, indent, f);
-        fputc('}', f);
+        _xs_json_indent(level, indent, b);
+        xs_str_bld_chr(b, '}');
         break;
 
     case XSTYPE_STRING:
-        _xs_json_dump_str(data, f);
+        _xs_json_dump_str(data, b);
         break;
 
     default:
@@ -152,29 +174,27 @@ static void _xs_json_dump(const xs_val *data, int level, int indent, FILE *f)
 xs_str *xs_json_dumps(const xs_val *data, int indent)
 /* dumps data as a JSON string */
 {
-    xs_str *s = NULL;
-    size_t sz;
-    FILE *f;
+    xstype t = xs_type(data);
+
+    if (t == XSTYPE_LIST || t == XSTYPE_DICT) {
+        xs_str_bld b = { NULL, 0, 0 };
 
-    if ((f = open_memstream(&s, &sz)) != NULL) {
-        int r = xs_json_dump(data, indent, f);
-        fclose(f);
+        _xs_json_dump(data, 0, indent, &b);
 
-        if (!r)
-            s = xs_free(s);
+        return xs_str_bld_done(&b);
     }
 
-    return s;
+    return NULL;
 }
 
 
 int xs_json_dump(const xs_val *data, int indent, FILE *f)
 /* dumps data into a file as JSON */
 {
-    xstype t = xs_type(data);
+    xs *s = xs_json_dumps(data, indent);
 
-    if (t == XSTYPE_LIST || t == XSTYPE_DICT) {
-        _xs_json_dump(data, 0, indent, f);
+    if (s != NULL) {
+        fwrite(s, strlen(s), 1, f);
         return 1;
     }
 
@@ -233,9 +253,9 @@ static xs_val *_xs_json_load_lexer(FILE *f, js_type *t)
         *t = JS_COLON;
     else
     if (c == '"') {
-        *t = JS_STRING;
+        xs_str_bld b = { NULL, 0, 0 };
 
-        v = xs_str_new(NULL);
+        *t = JS_STRING;
 
         while ((c = fgetc(f)) != '"' && c != EOF && *t != JS_ERROR) {
             if (c == '\\') {
@@ -274,14 +294,15 @@ static xs_val *_xs_json_load_lexer(FILE *f, js_type *t)
                     break;
                 }
 
-                v = xs_utf8_enc(v, cp);
-            }
-            else {
-                char cc = c;
-                v = xs_append_m(v, &cc, 1);
+                char tmp[4];
+                xs_str_bld_cat_m(&b, tmp, _xs_utf8_enc(tmp, cp));
             }
+            else
+                xs_str_bld_chr(&b, c);
         }
 
+        v = xs_str_bld_done(&b);
+
         if (c == EOF)
             *t = JS_ERROR;
     }
@@ -492,21 +513,492 @@ xs_dict *xs_json_load_object(FILE *f)
 }
 
 
-xs_val *xs_json_loads(const xs_str *json)
-/* loads a string in JSON format and converts to a multiple data */
+/** JSON buffer parser **/
+
+/* The functions above parse a FILE stream char by char, so they can
+   be used to iterate huge files. The ones below parse a full buffer,
+   which is much faster, and are used by xs_json_load() and xs_json_loads(). */
+
+#ifndef XS_JSON_MAX_DEPTH
+#define XS_JSON_MAX_DEPTH 512
+#endif
+
+typedef struct {
+    const char *p;      /* current position */
+    const char *e;      /* end of the buffer */
+    int depth;          /* nesting level */
+} _xs_json_buf;
+
+
+static int _xs_json_skip(_xs_json_buf *b)
+/* skips blanks and returns the next char (or -1 at the end) */
+{
+    while (b->p < b->e && (*b->p == ' ' || *b->p == '\n' || *b->p == '\r' || *b->p == '\t'))
+        b->p++;
+
+    return b->p < b->e ? (unsigned char)*b->p : -1;
+}
+
+
+static const char *_xs_json_str_scan(const char *p, const char *e)
+/* returns the address of the next quote or backslash (or e) */
+{
+    const unsigned long long ones  = 0x0101010101010101ULL;
+    const unsigned long long highs = 0x8080808080808080ULL;
+
+    /* test 8 bytes at a time for any of the two chars */
+    while (e - p >= 8) {
+        unsigned long long w, q, s;
+
+        memcpy(&w, p, 8);
+
+        q = w ^ (ones * '"');
+        s = w ^ (ones * '\\');
+
+        if (((q - ones) & ~q & highs) || ((s - ones) & ~s & highs))
+            break;
+
+        p += 8;
+    }
+
+    while (p < e && *p != '"' && *p != '\\')
+        p++;
+
+    return p;
+}
+
+
+static int _xs_json_hex4(_xs_json_buf *b, unsigned int *cp)
+/* parses 4 hex digits */
+{
+    int n;
+
+    *cp = 0;
+
+    /* like scanf("%04x"), accept less than 4 digits */
+    for (n = 0; n < 4 && b->p < b->e; n++) {
+        int c = (unsigned char)*b->p;
+
+        if (c >= '0' && c <= '9')
+            c -= '0';
+        else
+        if (c >= 'a' && c <= 'f')
+            c -= 'a' - 10;
+        else
+        if (c >= 'A' && c <= 'F')
+            c -= 'A' - 10;
+        else
+            break;
+
+        *cp = (*cp << 4) | c;
+        b->p++;
+    }
+
+    return n > 0;
+}
+
+
+static xs_str *_xs_json_parse_str(_xs_json_buf *b)
+/* parses a string (after the opening quote) */
+{
+    xs_str_bld sb = { NULL, 0, 0 };
+
+    for (;;) {
+        const char *q = _xs_json_str_scan(b->p, b->e);
+
+        /* copy the run of plain chars */
+        xs_str_bld_cat_m(&sb, b->p, q - b->p);
+        b->p = q;
+
+        if (b->p == b->e)
+            break;
+
+        if (*b->p++ == '"')
+            return xs_str_bld_done(&sb);
+
+        /* an escape sequence */
+        if (b->p == b->e)
+            break;
+
+        unsigned int cp = (unsigned char)*b->p++;
+
+        switch (cp) {
+        case 'n': cp = '\n'; break;
+        case 'r': cp = '\r'; break;
+        case 't': cp = '\t'; break;
+        case 'u': /* Unicode codepoint as an hex char */
+            if (!_xs_json_hex4(b, &cp))
+                goto error;
+
+            if (xs_is_surrogate(cp)) {
+                unsigned int p2;
+
+                /* \u must follow */
+                if (b->e - b->p < 2 || b->p[0] != '\\' || b->p[1] != 'u')
+                    goto error;
+
+                b->p += 2;
+
+                if (!_xs_json_hex4(b, &p2))
+                    goto error;
+
+                cp = xs_surrogate_dec(cp, p2);
+            }
+
+            /* replace dangerous control codes with their visual representations */
+            if (cp < ' ' && !strchr("\r\n\t", cp))
+                cp += 0x2400;
+
+            break;
+        }
+
+        char tmp[4];
+        xs_str_bld_cat_m(&sb, tmp, _xs_utf8_enc(tmp, cp));
+    }
+
+error:
+    xs_free(sb.s);
+    return NULL;
+}
+
+
+static xs_val *_xs_json_parse_num(_xs_json_buf *b)
+/* parses a number */
+{
+    char tmp[512];
+    const char *p = b->p;
+    int n = 0;
+
+    /* copy what can be part of a number, as the buffer may not be NUL-terminated */
+    while (p < b->e && n < (int)sizeof(tmp) - 1 && *p && strchr("0123456789+-.eExXaAbBcCdDfFpPinftyINFTY", *p))
+        tmp[n++] = *p++;
+
+    tmp[n] = '\0';
+
+    char *end;
+    double d = strtod(tmp, &end);
+
+    if (end == tmp)
+        return NULL;
+
+    /* like scanf("%lf"), swallow a dangling exponent */
+    if ((*end == 'e' || *end == 'E') && strpbrk(tmp, "eExX") == end) {
+        end++;
+
+        if (*end == '+' || *end == '-')
+            end++;
+    }
+
+    b->p += end - tmp;
+
+    return xs_number_new(d);
+}
+
+
+static xs_val *_xs_json_parse_value(_xs_json_buf *b);
+
+static xs_list *_xs_json_parse_array(_xs_json_buf *b)
+/* parses an array (after the opening bracket) */
+{
+    xs_list *l = xs_list_new();
+
+    if (_xs_json_skip(b) == ']') {
+        b->p++;
+        return l;
+    }
+
+    for (;;) {
+        xs *v = _xs_json_parse_value(b);
+
+        if (v == NULL)
+            break;
+
+        l = xs_list_append(l, v);
+
+        int c = _xs_json_skip(b);
+
+        if (c == -1)
+            break;
+
+        b->p++;
+
+        if (c == ']')
+            return l;
+
+        if (c != ',')
+            break;
+    }
+
+    return xs_free(l);
+}
+
+
+static xs_dict *_xs_json_parse_object(_xs_json_buf *b)
+/* parses an object (after the opening curly brace) */
+{
+    xs_dict *d = xs_dict_new();
+
+    if (_xs_json_skip(b) == '}') {
+        b->p++;
+        return d;
+    }
+
+    for (;;) {
+        if (_xs_json_skip(b) != '"')
+            break;
+
+        b->p++;
+
+        xs *k = _xs_json_parse_str(b);
+
+        if (k == NULL || _xs_json_skip(b) != ':')
+            break;
+
+        b->p++;
+
+        xs *v = _xs_json_parse_value(b);
+
+        if (v == NULL)
+            break;
+
+        d = xs_dict_append(d, k, v);
+
+        int c = _xs_json_skip(b);
+
+        if (c == -1)
+            break;
+
+        b->p++;
+
+        if (c == '}')
+            return d;
+
+        if (c != ',')
+            break;
+    }
+
+    return xs_free(d);
+}
+
+
+static int _xs_json_parse_word(_xs_json_buf *b, const char *w)
+/* checks if a word is next */
+{
+    int n = strlen(w);
+
+    if (b->e - b->p < n || memcmp(b->p, w, n) != 0)
+        return 0;
+
+    b->p += n;
+    return 1;
+}
+
+
+static xs_val *_xs_json_parse_value(_xs_json_buf *b)
+/* parses any value */
 {
-    FILE *f;
     xs_val *v = NULL;
+    int c = _xs_json_skip(b);
+
+    if (c == '{' || c == '[') {
+        if (b->depth >= XS_JSON_MAX_DEPTH)
+            return NULL;
 
-    if ((f = fmemopen((char *)json, strlen(json), "r")) != NULL) {
-        v = xs_json_load(f);
-        fclose(f);
+        b->p++;
+        b->depth++;
+
+        v = c == '{' ? _xs_json_parse_object(b) : _xs_json_parse_array(b);
+
+        b->depth--;
+    }
+    else
+    if (c == '"') {
+        b->p++;
+        v = _xs_json_parse_str(b);
+    }
+    else
+    if (c == '-' || (c >= '0' && c <= '9') || c == '.')
+        v = _xs_json_parse_num(b);
+    else
+    if (c == 't') {
+        if (_xs_json_parse_word(b, "true"))
+            v = xs_val_new(XSTYPE_TRUE);
+    }
+    else
+    if (c == 'f') {
+        if (_xs_json_parse_word(b, "false"))
+            v = xs_val_new(XSTYPE_FALSE);
+    }
+    else
+    if (c == 'n') {
+        if (_xs_json_parse_word(b, "null"))
+            v = xs_val_new(XSTYPE_NULL);
     }
 
     return v;
 }
 
 
+xs_val *xs_json_loads_m(const char *json, int size)
+/* loads a JSON list or dict from a memory buffer */
+{
+    _xs_json_buf b = { json, json + size, 0 };
+    int c = _xs_json_skip(&b);
+
+    /* only compound types are accepted */
+    if (c != '{' && c != '[')
+        return NULL;
+
+    return _xs_json_parse_value(&b);
+}
+
+
+xs_val *xs_json_loads(const xs_str *json)
+/* loads a string in JSON format and converts to a multiple data */
+{
+    return xs_json_loads_m(json, strlen(json));
+}
+
+
+static int _xs_json_skip_value(_xs_json_buf *b)
+/* skips a value without converting it; returns 0 on error */
+{
+    int c, depth = 0;
+
+    _xs_json_skip(b);
+
+    do {
+        if (b->p == b->e)
+            return 0;
+
+        c = (unsigned char)*b->p++;
+
+        if (c == '"') {
+            /* skip the string */
+            for (;;) {
+                b->p = _xs_json_str_scan(b->p, b->e);
+
+                if (b->p == b->e)
+                    return 0;
+
+                if (*b->p++ == '"')
+                    break;
+
+                /* skip the escaped char */
+                if (b->p++ == b->e)
+                    return 0;
+            }
+        }
+        else
+        if (c == '{' || c == '[')
+            depth++;
+        else
+        if (c == '}' || c == ']')
+            depth--;
+        else
+        if (depth == 0) {
+            /* a scalar: skip until a separator */
+            while (b->p < b->e && !strchr(",}] \t\r\n", *b->p))
+                b->p++;
+        }
+    } while (depth > 0);
+
+    return depth == 0;
+}
+
+
+xs_dict *_xs_json_peek_m(const char *json, int size, const char *keys[])
+/* gets some top level keys of a JSON object from a memory buffer,
+   without converting the rest of it */
+{
+    _xs_json_buf b = { json, json + size, 0 };
+    unsigned int found = 0, all;
+    int n_keys;
+
+    for (n_keys = 0; keys[n_keys]; n_keys++);
+
+    if (n_keys > 32 || _xs_json_skip(&b) != '{')
+        return NULL;
+
+    all = n_keys == 32 ? 0xffffffff : (1U << n_keys) - 1;
+
+    b.p++;
+
+    xs_dict *d = xs_dict_new();
+
+    if (_xs_json_skip(&b) == '}')
+        return d;
+
+    while (found != all) {
+        if (_xs_json_skip(&b) != '"')
+            break;
+
+        b.p++;
+
+        xs *k = _xs_json_parse_str(&b);
+
+        if (k == NULL || _xs_json_skip(&b) != ':')
+            break;
+
+        b.p++;
+
+        int n;
+
+        /* is this one of the wanted keys (not yet seen)? */
+        for (n = 0; n < n_keys; n++) {
+            if (!(found & (1U << n)) && strcmp(k, keys[n]) == 0)
+                break;
+        }
+
+        if (n < n_keys) {
+            xs *v = _xs_json_parse_value(&b);
+
+            if (v == NULL)
+                break;
+
+            d = xs_dict_append(d, k, v);
+            found |= 1U << n;
+        }
+        else
+        if (!_xs_json_skip_value(&b))
+            break;
+
+        int c = _xs_json_skip(&b);
+
+        if (c == '}')
+            return d;
+
+        if (c != ',')
+            break;
+
+        b.p++;
+    }
+
+    if (found != all)
+        d = xs_free(d);
+
+    return d;
+}
+
+
+xs_dict *_xs_json_peek(FILE *f, const char *keys[])
+/* gets some top level keys of a JSON object from a file */
+{
+    xs_str_bld b = { NULL, 0, 0 };
+    char tmp[8192];
+    int n;
+
+    while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0)
+        xs_str_bld_cat_m(&b, tmp, n);
+
+    xs_dict *d = _xs_json_peek_m(b.s, b.len, keys);
+
+    xs_free(b.s);
+
+    return d;
+}
+
+
 xstype xs_json_load_type(FILE *f)
 /* identifies the type of a JSON stream */
 {
@@ -526,16 +1018,18 @@ xstype xs_json_load_type(FILE *f)
 
 
 xs_val *xs_json_load(FILE *f)
-/* loads a JSON file */
+/* loads a JSON file (reading it until the end) */
 {
-    xs_val *v = NULL;
-    xstype t = xs_json_load_type(f);
+    xs_str_bld b = { NULL, 0, 0 };
+    char tmp[8192];
+    int n;
 
-    if (t == XSTYPE_LIST)
-        v = xs_json_load_array(f);
-    else
-    if (t == XSTYPE_DICT)
-        v = xs_json_load_object(f);
+    while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0)
+        xs_str_bld_cat_m(&b, tmp, n);
+
+    xs_val *v = xs_json_loads_m(b.s, b.len);
+
+    xs_free(b.s);
 
     return v;
 }
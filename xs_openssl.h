@@ -23,6 +23,12 @@ xs_dict *xs_evp_genkey(int bits);
 xs_str *xs_evp_sign(const char *secret, const char *mem, int size);
 int xs_evp_verify(const char *pubkey, const char *mem, int size, const char *b64sig);
 
+struct evp_pkey_st *xs_evp_pkey_new(const char *pem, int priv);
+struct evp_pkey_st *xs_evp_pkey_ref(struct evp_pkey_st *pkey);
+void xs_evp_pkey_free(struct evp_pkey_st *pkey);
+xs_str *xs_evp_sign_pkey(struct evp_pkey_st *pkey, const char *mem, int size);
+int xs_evp_verify_pkey(struct evp_pkey_st *pkey, const char *mem, int size, const char *b64sig);
+
 
 #ifdef XS_IMPLEMENTATION
 
@@ -153,20 +159,51 @@ end:
 }
 
 
-xs_str *xs_evp_sign(const char *secret, const char *mem, int size)
-/* signs a memory block (secret is in PEM format) */
+EVP_PKEY *xs_evp_pkey_new(const char *pem, int priv)
+/* parses a private or public key in PEM format */
+{
+    BIO *b = BIO_new_mem_buf(pem, strlen(pem));
+    EVP_PKEY *pkey;
+
+    if (priv)
+        pkey = PEM_read_bio_PrivateKey(b, NULL, NULL, NULL);
+    else
+        pkey = PEM_read_bio_PUBKEY(b, NULL, NULL, NULL);
+
+    BIO_free(b);
+
+    return pkey;
+}
+
+
+EVP_PKEY *xs_evp_pkey_ref(EVP_PKEY *pkey)
+/* adds a reference to a key */
+{
+    if (pkey != NULL)
+        EVP_PKEY_up_ref(pkey);
+
+    return pkey;
+}
+
+
+void xs_evp_pkey_free(EVP_PKEY *pkey)
+/* releases a reference to a key */
+{
+    EVP_PKEY_free(pkey);
+}
+
+
+xs_str *xs_evp_sign_pkey(EVP_PKEY *pkey, const char *mem, int size)
+/* signs a memory block with an already parsed key */
 {
     xs_str *signature = NULL;
-    BIO *b;
     unsigned char *sig;
     unsigned int sig_len;
-    EVP_PKEY *pkey;
     EVP_MD_CTX *mdctx;
     const EVP_MD *md;
 
-    /* un-PEM the key */
-    b = BIO_new_mem_buf(secret, strlen(secret));
-    pkey = PEM_read_bio_PrivateKey(b, NULL, NULL, NULL);
+    if (pkey == NULL)
+        return NULL;
 
     /* I've learnt all these magical incantations by watching
        the Python module code and the OpenSSL manual pages */
@@ -186,48 +223,63 @@ xs_str *xs_evp_sign(const char *secret, const char *mem, int size)
         signature = xs_base64_enc((char *)sig, sig_len);
 
     EVP_MD_CTX_free(mdctx);
-    EVP_PKEY_free(pkey);
-    BIO_free(b);
     xs_free(sig);
 
     return signature;
 }
 
 
-int xs_evp_verify(const char *pubkey, const char *mem, int size, const char *b64sig)
-/* verifies a base64 block, returns non-zero on ok */
+int xs_evp_verify_pkey(EVP_PKEY *pkey, const char *mem, int size, const char *b64sig)
+/* verifies a base64 block with an already parsed key, returns non-zero on ok */
 {
     int r = 0;
-    BIO *b;
-    EVP_PKEY *pkey;
     EVP_MD_CTX *mdctx;
     const EVP_MD *md;
 
-    /* un-PEM the key */
-    b = BIO_new_mem_buf(pubkey, strlen(pubkey));
-    pkey = PEM_read_bio_PUBKEY(b, NULL, NULL, NULL);
+    if (pkey == NULL)
+        return 0;
 
     md = EVP_get_digestbyname("sha256");
     mdctx = EVP_MD_CTX_new();
 
-    if (pkey != NULL) {
-        xs *sig = NULL;
-        int s_size;
+    xs *sig = NULL;
+    int s_size;
 
-        /* de-base64 */
-        sig = xs_base64_dec(b64sig,  &s_size);
+    /* de-base64 */
+    sig = xs_base64_dec(b64sig,  &s_size);
 
-        if (sig != NULL) {
-            EVP_VerifyInit(mdctx, md);
-            EVP_VerifyUpdate(mdctx, mem, size);
+    if (sig != NULL) {
+        EVP_VerifyInit(mdctx, md);
+        EVP_VerifyUpdate(mdctx, mem, size);
 
-            r = EVP_VerifyFinal(mdctx, (unsigned char *)sig, s_size, pkey);
-        }
+        r = EVP_VerifyFinal(mdctx, (unsigned char *)sig, s_size, pkey);
     }
 
     EVP_MD_CTX_free(mdctx);
+
+    return r;
+}
+
+
+xs_str *xs_evp_sign(const char *secret, const char *mem, int size)
+/* signs a memory block (secret is in PEM format) */
+{
+    EVP_PKEY *pkey = xs_evp_pkey_new(secret, 1);
+    xs_str *signature = xs_evp_sign_pkey(pkey, mem, size);
+
+    EVP_PKEY_free(pkey);
+
+    return signature;
+}
+
+
+int xs_evp_verify(const char *pubkey, const char *mem, int size, const char *b64sig)
+/* verifies a base64 block, returns non-zero on ok */
+{
+    EVP_PKEY *pkey = xs_evp_pkey_new(pubkey, 0);
+    int r = xs_evp_verify_pkey(pkey, mem, size, b64sig);
+
     EVP_PKEY_free(pkey);
-    BIO_free(b);
 
     return r;
 }
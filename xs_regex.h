@@ -5,6 +5,7 @@
 #define _XS_REGEX_H
 
 int xs_regex_match(const char *str, const char *rx);
+int xs_regex_valid(const char *rx);
 xs_list *xs_regex_split_n(const char *str, const char *rx, int count);
 #define xs_regex_split(str, rx) xs_regex_split_n(str, rx, XS_ALL)
 xs_list *xs_regex_select_n(const char *str, const char *rx, int count);
@@ -23,6 +24,103 @@ xs_list *xs_regex_replace_in(xs_str *str, const char *rx, const char *rep, int c
 
 #include <regex.h>
 
+/** compiled regex cache **/
+
+/* Each thread keeps its most recently used regexes already compiled,
+   so that the same patterns are not compiled again and again. The
+   cache entries are allocated from the heap (not from arenas). */
+
+#ifndef XS_REGEX_CACHE_SIZE
+#define XS_REGEX_CACHE_SIZE 32
+#endif
+
+typedef struct {
+    char *rx;                   /* the pattern (NULL if the slot is free) */
+    unsigned int hash;          /* hash of the pattern */
+    unsigned int used;          /* time of last use */
+    regex_t re;                 /* the compiled regex */
+} _xs_regex_slot;
+
+typedef struct {
+    unsigned int clock;
+    _xs_regex_slot slot[XS_REGEX_CACHE_SIZE];
+} _xs_regex_cache;
+
+static pthread_once_t _xs_regex_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _xs_regex_key;
+
+
+static void _xs_regex_cache_free(void *cache)
+{
+    _xs_regex_cache *c = cache;
+    int n;
+
+    for (n = 0; n < XS_REGEX_CACHE_SIZE; n++) {
+        if (c->slot[n].rx != NULL) {
+            regfree(&c->slot[n].re);
+            free(c->slot[n].rx);
+        }
+    }
+
+    free(c);
+}
+
+
+static void _xs_regex_init(void)
+{
+    pthread_key_create(&_xs_regex_key, _xs_regex_cache_free);
+}
+
+
+static const regex_t *_xs_regex_get(const char *rx)
+/* returns the compiled regex from this thread's cache (NULL on error) */
+{
+    _xs_regex_cache *c;
+    _xs_regex_slot *s = NULL;
+    regex_t re;
+    int n;
+
+    pthread_once(&_xs_regex_once, _xs_regex_init);
+
+    if ((c = pthread_getspecific(_xs_regex_key)) == NULL) {
+        if ((c = calloc(1, sizeof(_xs_regex_cache))) == NULL)
+            return NULL;
+
+        pthread_setspecific(_xs_regex_key, c);
+    }
+
+    unsigned int hash = xs_hash_func(rx, strlen(rx));
+
+    for (n = 0; n < XS_REGEX_CACHE_SIZE; n++) {
+        _xs_regex_slot *t = &c->slot[n];
+
+        if (t->rx != NULL && t->hash == hash && strcmp(t->rx, rx) == 0) {
+            t->used = ++c->clock;
+            return &t->re;
+        }
+
+        /* keep the free or least recently used slot, just in case */
+        if (s == NULL || (s->rx != NULL && (t->rx == NULL || t->used < s->used)))
+            s = t;
+    }
+
+    if (regcomp(&re, rx, REG_EXTENDED))
+        return NULL;
+
+    if (s->rx != NULL) {
+        regfree(&s->re);
+        free(s->rx);
+    }
+
+    s->rx   = strdup(rx);
+    s->hash = hash;
+    s->used = ++c->clock;
+    s->re   = re;
+
+    return &s->re;
+}
+
+
 xs_list *xs_regex_split_n(const char *str, const char *rx, int count)
 /* splits str using regex as a separator, at most count times.
     Always returns a list:
@@ -31,16 +129,16 @@ xs_list *xs_regex_split_n(const char *str, const char *rx, int count)
     len == odd: first part [ separator / next part ]...
 */
 {
-    regex_t re;
+    const regex_t *re;
     regmatch_t rm;
     int offset = 0;
     xs_list *list = xs_list_new();
     const char *p;
 
-    if (regcomp(&re, rx, REG_EXTENDED))
+    if ((re = _xs_regex_get(rx)) == NULL)
         return list;
 
-    while (count > 0 && !regexec(&re, (p = str + offset), 1, &rm, offset > 0 ? REG_NOTBOL : 0)) {
+    while (count > 0 && !regexec(re, (p = str + offset), 1, &rm, offset > 0 ? REG_NOTBOL : 0)) {
         /* add first the leading part of the string */
         xs *s1 = xs_str_new_sz(p, rm.rm_so);
         list = xs_list_append(list, s1);
@@ -58,8 +156,6 @@ xs_list *xs_regex_split_n(const char *str, const char *rx, int count)
     /* add the rest of the string */
     list = xs_list_append(list, p);
 
-    regfree(&re);
-
     return list;
 }
 
@@ -139,9 +235,23 @@ xs_list *xs_regex_replace_in(xs_str *str, const char *rx, const char *rep, int c
 int xs_regex_match(const char *str, const char *rx)
 /* returns if str matches the regex at least once */
 {
-    xs *l = xs_regex_select_n(str, rx, 1);
+    const regex_t *re = _xs_regex_get(rx);
+
+    return re != NULL && regexec(re, str, 0, NULL, 0) == 0;
+}
+
+
+int xs_regex_valid(const char *rx)
+/* returns if rx is a valid regex (without caching it) */
+{
+    regex_t re;
+
+    if (regcomp(&re, rx, REG_EXTENDED))
+        return 0;
+
+    regfree(&re);
 
-    return xs_list_len(l) == 1;
+    return 1;
 }
 
 
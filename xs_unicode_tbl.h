@@ -0,0 +1,3035 @@
+/* copyright (c) 2022 - 2024 grunfink et al. / MIT license */
+
+#ifndef _XS_UNICODE_TBL_H
+
+#define _XS_UNICODE_TBL_H
+
+/* generated from the Unicode Character Database, version 14.0.0 */
+
+/* uppercase to lowercase codepoint pairs, sorted by the first one */
+
+static unsigned int xs_unicode_case_fold_table[] = {
+    0x00041, 0x00061,
+    0x00042, 0x00062,
+    0x00043, 0x00063,
+    0x00044, 0x00064,
+    0x00045, 0x00065,
+    0x00046, 0x00066,
+    0x00047, 0x00067,
+    0x00048, 0x00068,
+    0x00049, 0x00069,
+    0x0004A, 0x0006A,
+    0x0004B, 0x0006B,
+    0x0004C, 0x0006C,
+    0x0004D, 0x0006D,
+    0x0004E, 0x0006E,
+    0x0004F, 0x0006F,
+    0x00050, 0x00070,
+    0x00051, 0x00071,
+    0x00052, 0x00072,
+    0x00053, 0x00073,
+    0x00054, 0x00074,
+    0x00055, 0x00075,
+    0x00056, 0x00076,
+    0x00057, 0x00077,
+    0x00058, 0x00078,
+    0x00059, 0x00079,
+    0x0005A, 0x0007A,
+    0x000C0, 0x000E0,
+    0x000C1, 0x000E1,
+    0x000C2, 0x000E2,
+    0x000C3, 0x000E3,
+    0x000C4, 0x000E4,
+    0x000C5, 0x000E5,
+    0x000C6, 0x000E6,
+    0x000C7, 0x000E7,
+    0x000C8, 0x000E8,
+    0x000C9, 0x000E9,
+    0x000CA, 0x000EA,
+    0x000CB, 0x000EB,
+    0x000CC, 0x000EC,
+    0x000CD, 0x000ED,
+    0x000CE, 0x000EE,
+    0x000CF, 0x000EF,
+    0x000D0, 0x000F0,
+    0x000D1, 0x000F1,
+    0x000D2, 0x000F2,
+    0x000D3, 0x000F3,
+    0x000D4, 0x000F4,
+    0x000D5, 0x000F5,
+    0x000D6, 0x000F6,
+    0x000D8, 0x000F8,
+    0x000D9, 0x000F9,
+    0x000DA, 0x000FA,
+    0x000DB, 0x000FB,
+    0x000DC, 0x000FC,
+    0x000DD, 0x000FD,
+    0x000DE, 0x000FE,
+    0x00100, 0x00101,
+    0x00102, 0x00103,
+    0x00104, 0x00105,
+    0x00106, 0x00107,
+    0x00108, 0x00109,
+    0x0010A, 0x0010B,
+    0x0010C, 0x0010D,
+    0x0010E, 0x0010F,
+    0x00110, 0x00111,
+    0x00112, 0x00113,
+    0x00114, 0x00115,
+    0x00116, 0x00117,
+    0x00118, 0x00119,
+    0x0011A, 0x0011B,
+    0x0011C, 0x0011D,
+    0x0011E, 0x0011F,
+    0x00120, 0x00121,
+    0x00122, 0x00123,
+    0x00124, 0x00125,
+    0x00126, 0x00127,
+    0x00128, 0x00129,
+    0x0012A, 0x0012B,
+    0x0012C, 0x0012D,
+    0x0012E, 0x0012F,
+    0x00132, 0x00133,
+    0x00134, 0x00135,
+    0x00136, 0x00137,
+    0x00139, 0x0013A,
+    0x0013B, 0x0013C,
+    0x0013D, 0x0013E,
+    0x0013F, 0x00140,
+    0x00141, 0x00142,
+    0x00143, 0x00144,
+    0x00145, 0x00146,
+    0x00147, 0x00148,
+    0x0014A, 0x0014B,
+    0x0014C, 0x0014D,
+    0x0014E, 0x0014F,
+    0x00150, 0x00151,
+    0x00152, 0x00153,
+    0x00154, 0x00155,
+    0x00156, 0x00157,
+    0x00158, 0x00159,
+    0x0015A, 0x0015B,
+    0x0015C, 0x0015D,
+    0x0015E, 0x0015F,
+    0x00160, 0x00161,
+    0x00162, 0x00163,
+    0x00164, 0x00165,
+    0x00166, 0x00167,
+    0x00168, 0x00169,
+    0x0016A, 0x0016B,
+    0x0016C, 0x0016D,
+    0x0016E, 0x0016F,
+    0x00170, 0x00171,
+    0x00172, 0x00173,
+    0x00174, 0x00175,
+    0x00176, 0x00177,
+    0x00178, 0x000FF,
+    0x00179, 0x0017A,
+    0x0017B, 0x0017C,
+    0x0017D, 0x0017E,
+    0x00181, 0x00253,
+    0x00182, 0x00183,
+    0x00184, 0x00185,
+    0x00186, 0x00254,
+    0x00187, 0x00188,
+    0x00189, 0x00256,
+    0x0018A, 0x00257,
+    0x0018B, 0x0018C,
+    0x0018E, 0x001DD,
+    0x0018F, 0x00259,
+    0x00190, 0x0025B,
+    0x00191, 0x00192,
+    0x00193, 0x00260,
+    0x00194, 0x00263,
+    0x00196, 0x00269,
+    0x00197, 0x00268,
+    0x00198, 0x00199,
+    0x0019C, 0x0026F,
+    0x0019D, 0x00272,
+    0x0019F, 0x00275,
+    0x001A0, 0x001A1,
+    0x001A2, 0x001A3,
+    0x001A4, 0x001A5,
+    0x001A6, 0x00280,
+    0x001A7, 0x001A8,
+    0x001A9, 0x00283,
+    0x001AC, 0x001AD,
+    0x001AE, 0x00288,
+    0x001AF, 0x001B0,
+    0x001B1, 0x0028A,
+    0x001B2, 0x0028B,
+    0x001B3, 0x001B4,
+    0x001B5, 0x001B6,
+    0x001B7, 0x00292,
+    0x001B8, 0x001B9,
+    0x001BC, 0x001BD,
+    0x001C4, 0x001C6,
+    0x001C5, 0x001C6,
+    0x001C7, 0x001C9,
+    0x001C8, 0x001C9,
+    0x001CA, 0x001CC,
+    0x001CB, 0x001CC,
+    0x001CD, 0x001CE,
+    0x001CF, 0x001D0,
+    0x001D1, 0x001D2,
+    0x001D3, 0x001D4,
+    0x001D5, 0x001D6,
+    0x001D7, 0x001D8,
+    0x001D9, 0x001DA,
+    0x001DB, 0x001DC,
+    0x001DE, 0x001DF,
+    0x001E0, 0x001E1,
+    0x001E2, 0x001E3,
+    0x001E4, 0x001E5,
+    0x001E6, 0x001E7,
+    0x001E8, 0x001E9,
+    0x001EA, 0x001EB,
+    0x001EC, 0x001ED,
+    0x001EE, 0x001EF,
+    0x001F1, 0x001F3,
+    0x001F2, 0x001F3,
+    0x001F4, 0x001F5,
+    0x001F6, 0x00195,
+    0x001F7, 0x001BF,
+    0x001F8, 0x001F9,
+    0x001FA, 0x001FB,
+    0x001FC, 0x001FD,
+    0x001FE, 0x001FF,
+    0x00200, 0x00201,
+    0x00202, 0x00203,
+    0x00204, 0x00205,
+    0x00206, 0x00207,
+    0x00208, 0x00209,
+    0x0020A, 0x0020B,
+    0x0020C, 0x0020D,
+    0x0020E, 0x0020F,
+    0x00210, 0x00211,
+    0x00212, 0x00213,
+    0x00214, 0x00215,
+    0x00216, 0x00217,
+    0x00218, 0x00219,
+    0x0021A, 0x0021B,
+    0x0021C, 0x0021D,
+    0x0021E, 0x0021F,
+    0x00220, 0x0019E,
+    0x00222, 0x00223,
+    0x00224, 0x00225,
+    0x00226, 0x00227,
+    0x00228, 0x00229,
+    0x0022A, 0x0022B,
+    0x0022C, 0x0022D,
+    0x0022E, 0x0022F,
+    0x00230, 0x00231,
+    0x00232, 0x00233,
+    0x0023A, 0x02C65,
+    0x0023B, 0x0023C,
+    0x0023D, 0x0019A,
+    0x0023E, 0x02C66,
+    0x00241, 0x00242,
+    0x00243, 0x00180,
+    0x00244, 0x00289,
+    0x00245, 0x0028C,
+    0x00246, 0x00247,
+    0x00248, 0x00249,
+    0x0024A, 0x0024B,
+    0x0024C, 0x0024D,
+    0x0024E, 0x0024F,
+    0x00370, 0x00371,
+    0x00372, 0x00373,
+    0x00376, 0x00377,
+    0x0037F, 0x003F3,
+    0x00386, 0x003AC,
+    0x00388, 0x003AD,
+    0x00389, 0x003AE,
+    0x0038A, 0x003AF,
+    0x0038C, 0x003CC,
+    0x0038E, 0x003CD,
+    0x0038F, 0x003CE,
+    0x00391, 0x003B1,
+    0x00392, 0x003B2,
+    0x00393, 0x003B3,
+    0x00394, 0x003B4,
+    0x00395, 0x003B5,
+    0x00396, 0x003B6,
+    0x00397, 0x003B7,
+    0x00398, 0x003B8,
+    0x00399, 0x003B9,
+    0x0039A, 0x003BA,
+    0x0039B, 0x003BB,
+    0x0039C, 0x003BC,
+    0x0039D, 0x003BD,
+    0x0039E, 0x003BE,
+    0x0039F, 0x003BF,
+    0x003A0, 0x003C0,
+    0x003A1, 0x003C1,
+    0x003A3, 0x003C3,
+    0x003A4, 0x003C4,
+    0x003A5, 0x003C5,
+    0x003A6, 0x003C6,
+    0x003A7, 0x003C7,
+    0x003A8, 0x003C8,
+    0x003A9, 0x003C9,
+    0x003AA, 0x003CA,
+    0x003AB, 0x003CB,
+    0x003CF, 0x003D7,
+    0x003D8, 0x003D9,
+    0x003DA, 0x003DB,
+    0x003DC, 0x003DD,
+    0x003DE, 0x003DF,
+    0x003E0, 0x003E1,
+    0x003E2, 0x003E3,
+    0x003E4, 0x003E5,
+    0x003E6, 0x003E7,
+    0x003E8, 0x003E9,
+    0x003EA, 0x003EB,
+    0x003EC, 0x003ED,
+    0x003EE, 0x003EF,
+    0x003F4, 0x003B8,
+    0x003F7, 0x003F8,
+    0x003F9, 0x003F2,
+    0x003FA, 0x003FB,
+    0x003FD, 0x0037B,
+    0x003FE, 0x0037C,
+    0x003FF, 0x0037D,
+    0x00400, 0x00450,
+    0x00401, 0x00451,
+    0x00402, 0x00452,
+    0x00403, 0x00453,
+    0x00404, 0x00454,
+    0x00405, 0x00455,
+    0x00406, 0x00456,
+    0x00407, 0x00457,
+    0x00408, 0x00458,
+    0x00409, 0x00459,
+    0x0040A, 0x0045A,
+    0x0040B, 0x0045B,
+    0x0040C, 0x0045C,
+    0x0040D, 0x0045D,
+    0x0040E, 0x0045E,
+    0x0040F, 0x0045F,
+    0x00410, 0x00430,
+    0x00411, 0x00431,
+    0x00412, 0x00432,
+    0x00413, 0x00433,
+    0x00414, 0x00434,
+    0x00415, 0x00435,
+    0x00416, 0x00436,
+    0x00417, 0x00437,
+    0x00418, 0x00438,
+    0x00419, 0x00439,
+    0x0041A, 0x0043A,
+    0x0041B, 0x0043B,
+    0x0041C, 0x0043C,
+    0x0041D, 0x0043D,
+    0x0041E, 0x0043E,
+    0x0041F, 0x0043F,
+    0x00420, 0x00440,
+    0x00421, 0x00441,
+    0x00422, 0x00442,
+    0x00423, 0x00443,
+    0x00424, 0x00444,
+    0x00425, 0x00445,
+    0x00426, 0x00446,
+    0x00427, 0x00447,
+    0x00428, 0x00448,
+    0x00429, 0x00449,
+    0x0042A, 0x0044A,
+    0x0042B, 0x0044B,
+    0x0042C, 0x0044C,
+    0x0042D, 0x0044D,
+    0x0042E, 0x0044E,
+    0x0042F, 0x0044F,
+    0x00460, 0x00461,
+    0x00462, 0x00463,
+    0x00464, 0x00465,
+    0x00466, 0x00467,
+    0x00468, 0x00469,
+    0x0046A, 0x0046B,
+    0x0046C, 0x0046D,
+    0x0046E, 0x0046F,
+    0x00470, 0x00471,
+    0x00472, 0x00473,
+    0x00474, 0x00475,
+    0x00476, 0x00477,
+    0x00478, 0x00479,
+    0x0047A, 0x0047B,
+    0x0047C, 0x0047D,
+    0x0047E, 0x0047F,
+    0x00480, 0x00481,
+    0x0048A, 0x0048B,
+    0x0048C, 0x0048D,
+    0x0048E, 0x0048F,
+    0x00490, 0x00491,
+    0x00492, 0x00493,
+    0x00494, 0x00495,
+    0x00496, 0x00497,
+    0x00498, 0x00499,
+    0x0049A, 0x0049B,
+    0x0049C, 0x0049D,
+    0x0049E, 0x0049F,
+    0x004A0, 0x004A1,
+    0x004A2, 0x004A3,
+    0x004A4, 0x004A5,
+    0x004A6, 0x004A7,
+    0x004A8, 0x004A9,
+    0x004AA, 0x004AB,
+    0x004AC, 0x004AD,
+    0x004AE, 0x004AF,
+    0x004B0, 0x004B1,
+    0x004B2, 0x004B3,
+    0x004B4, 0x004B5,
+    0x004B6, 0x004B7,
+    0x004B8, 0x004B9,
+    0x004BA, 0x004BB,
+    0x004BC, 0x004BD,
+    0x004BE, 0x004BF,
+    0x004C0, 0x004CF,
+    0x004C1, 0x004C2,
+    0x004C3, 0x004C4,
+    0x004C5, 0x004C6,
+    0x004C7, 0x004C8,
+    0x004C9, 0x004CA,
+    0x004CB, 0x004CC,
+    0x004CD, 0x004CE,
+    0x004D0, 0x004D1,
+    0x004D2, 0x004D3,
+    0x004D4, 0x004D5,
+    0x004D6, 0x004D7,
+    0x004D8, 0x004D9,
+    0x004DA, 0x004DB,
+    0x004DC, 0x004DD,
+    0x004DE, 0x004DF,
+    0x004E0, 0x004E1,
+    0x004E2, 0x004E3,
+    0x004E4, 0x004E5,
+    0x004E6, 0x004E7,
+    0x004E8, 0x004E9,
+    0x004EA, 0x004EB,
+    0x004EC, 0x004ED,
+    0x004EE, 0x004EF,
+    0x004F0, 0x004F1,
+    0x004F2, 0x004F3,
+    0x004F4, 0x004F5,
+    0x004F6, 0x004F7,
+    0x004F8, 0x004F9,
+    0x004FA, 0x004FB,
+    0x004FC, 0x004FD,
+    0x004FE, 0x004FF,
+    0x00500, 0x00501,
+    0x00502, 0x00503,
+    0x00504, 0x00505,
+    0x00506, 0x00507,
+    0x00508, 0x00509,
+    0x0050A, 0x0050B,
+    0x0050C, 0x0050D,
+    0x0050E, 0x0050F,
+    0x00510, 0x00511,
+    0x00512, 0x00513,
+    0x00514, 0x00515,
+    0x00516, 0x00517,
+    0x00518, 0x00519,
+    0x0051A, 0x0051B,
+    0x0051C, 0x0051D,
+    0x0051E, 0x0051F,
+    0x00520, 0x00521,
+    0x00522, 0x00523,
+    0x00524, 0x00525,
+    0x00526, 0x00527,
+    0x00528, 0x00529,
+    0x0052A, 0x0052B,
+    0x0052C, 0x0052D,
+    0x0052E, 0x0052F,
+    0x00531, 0x00561,
+    0x00532, 0x00562,
+    0x00533, 0x00563,
+    0x00534, 0x00564,
+    0x00535, 0x00565,
+    0x00536, 0x00566,
+    0x00537, 0x00567,
+    0x00538, 0x00568,
+    0x00539, 0x00569,
+    0x0053A, 0x0056A,
+    0x0053B, 0x0056B,
+    0x0053C, 0x0056C,
+    0x0053D, 0x0056D,
+    0x0053E, 0x0056E,
+    0x0053F, 0x0056F,
+    0x00540, 0x00570,
+    0x00541, 0x00571,
+    0x00542, 0x00572,
+    0x00543, 0x00573,
+    0x00544, 0x00574,
+    0x00545, 0x00575,
+    0x00546, 0x00576,
+    0x00547, 0x00577,
+    0x00548, 0x00578,
+    0x00549, 0x00579,
+    0x0054A, 0x0057A,
+    0x0054B, 0x0057B,
+    0x0054C, 0x0057C,
+    0x0054D, 0x0057D,
+    0x0054E, 0x0057E,
+    0x0054F, 0x0057F,
+    0x00550, 0x00580,
+    0x00551, 0x00581,
+    0x00552, 0x00582,
+    0x00553, 0x00583,
+    0x00554, 0x00584,
+    0x00555, 0x00585,
+    0x00556, 0x00586,
+    0x010A0, 0x02D00,
+    0x010A1, 0x02D01,
+    0x010A2, 0x02D02,
+    0x010A3, 0x02D03,
+    0x010A4, 0x02D04,
+    0x010A5, 0x02D05,
+    0x010A6, 0x02D06,
+    0x010A7, 0x02D07,
+    0x010A8, 0x02D08,
+    0x010A9, 0x02D09,
+    0x010AA, 0x02D0A,
+    0x010AB, 0x02D0B,
+    0x010AC, 0x02D0C,
+    0x010AD, 0x02D0D,
+    0x010AE, 0x02D0E,
+    0x010AF, 0x02D0F,
+    0x010B0, 0x02D10,
+    0x010B1, 0x02D11,
+    0x010B2, 0x02D12,
+    0x010B3, 0x02D13,
+    0x010B4, 0x02D14,
+    0x010B5, 0x02D15,
+    0x010B6, 0x02D16,
+    0x010B7, 0x02D17,
+    0x010B8, 0x02D18,
+    0x010B9, 0x02D19,
+    0x010BA, 0x02D1A,
+    0x010BB, 0x02D1B,
+    0x010BC, 0x02D1C,
+    0x010BD, 0x02D1D,
+    0x010BE, 0x02D1E,
+    0x010BF, 0x02D1F,
+    0x010C0, 0x02D20,
+    0x010C1, 0x02D21,
+    0x010C2, 0x02D22,
+    0x010C3, 0x02D23,
+    0x010C4, 0x02D24,
+    0x010C5, 0x02D25,
+    0x010C7, 0x02D27,
+    0x010CD, 0x02D2D,
+    0x013A0, 0x0AB70,
+    0x013A1, 0x0AB71,
+    0x013A2, 0x0AB72,
+    0x013A3, 0x0AB73,
+    0x013A4, 0x0AB74,
+    0x013A5, 0x0AB75,
+    0x013A6, 0x0AB76,
+    0x013A7, 0x0AB77,
+    0x013A8, 0x0AB78,
+    0x013A9, 0x0AB79,
+    0x013AA, 0x0AB7A,
+    0x013AB, 0x0AB7B,
+    0x013AC, 0x0AB7C,
+    0x013AD, 0x0AB7D,
+    0x013AE, 0x0AB7E,
+    0x013AF, 0x0AB7F,
+    0x013B0, 0x0AB80,
+    0x013B1, 0x0AB81,
+    0x013B2, 0x0AB82,
+    0x013B3, 0x0AB83,
+    0x013B4, 0x0AB84,
+    0x013B5, 0x0AB85,
+    0x013B6, 0x0AB86,
+    0x013B7, 0x0AB87,
+    0x013B8, 0x0AB88,
+    0x013B9, 0x0AB89,
+    0x013BA, 0x0AB8A,
+    0x013BB, 0x0AB8B,
+    0x013BC, 0x0AB8C,
+    0x013BD, 0x0AB8D,
+    0x013BE, 0x0AB8E,
+    0x013BF, 0x0AB8F,
+    0x013C0, 0x0AB90,
+    0x013C1, 0x0AB91,
+    0x013C2, 0x0AB92,
+    0x013C3, 0x0AB93,
+    0x013C4, 0x0AB94,
+    0x013C5, 0x0AB95,
+    0x013C6, 0x0AB96,
+    0x013C7, 0x0AB97,
+    0x013C8, 0x0AB98,
+    0x013C9, 0x0AB99,
+    0x013CA, 0x0AB9A,
+    0x013CB, 0x0AB9B,
+    0x013CC, 0x0AB9C,
+    0x013CD, 0x0AB9D,
+    0x013CE, 0x0AB9E,
+    0x013CF, 0x0AB9F,
+    0x013D0, 0x0ABA0,
+    0x013D1, 0x0ABA1,
+    0x013D2, 0x0ABA2,
+    0x013D3, 0x0ABA3,
+    0x013D4, 0x0ABA4,
+    0x013D5, 0x0ABA5,
+    0x013D6, 0x0ABA6,
+    0x013D7, 0x0ABA7,
+    0x013D8, 0x0ABA8,
+    0x013D9, 0x0ABA9,
+    0x013DA, 0x0ABAA,
+    0x013DB, 0x0ABAB,
+    0x013DC, 0x0ABAC,
+    0x013DD, 0x0ABAD,
+    0x013DE, 0x0ABAE,
+    0x013DF, 0x0ABAF,
+    0x013E0, 0x0ABB0,
+    0x013E1, 0x0ABB1,
+    0x013E2, 0x0ABB2,
+    0x013E3, 0x0ABB3,
+    0x013E4, 0x0ABB4,
+    0x013E5, 0x0ABB5,
+    0x013E6, 0x0ABB6,
+    0x013E7, 0x0ABB7,
+    0x013E8, 0x0ABB8,
+    0x013E9, 0x0ABB9,
+    0x013EA, 0x0ABBA,
+    0x013EB, 0x0ABBB,
+    0x013EC, 0x0ABBC,
+    0x013ED, 0x0ABBD,
+    0x013EE, 0x0ABBE,
+    0x013EF, 0x0ABBF,
+    0x013F0, 0x013F8,
+    0x013F1, 0x013F9,
+    0x013F2, 0x013FA,
+    0x013F3, 0x013FB,
+    0x013F4, 0x013FC,
+    0x013F5, 0x013FD,
+    0x01C90, 0x010D0,
+    0x01C91, 0x010D1,
+    0x01C92, 0x010D2,
+    0x01C93, 0x010D3,
+    0x01C94, 0x010D4,
+    0x01C95, 0x010D5,
+    0x01C96, 0x010D6,
+    0x01C97, 0x010D7,
+    0x01C98, 0x010D8,
+    0x01C99, 0x010D9,
+    0x01C9A, 0x010DA,
+    0x01C9B, 0x010DB,
+    0x01C9C, 0x010DC,
+    0x01C9D, 0x010DD,
+    0x01C9E, 0x010DE,
+    0x01C9F, 0x010DF,
+    0x01CA0, 0x010E0,
+    0x01CA1, 0x010E1,
+    0x01CA2, 0x010E2,
+    0x01CA3, 0x010E3,
+    0x01CA4, 0x010E4,
+    0x01CA5, 0x010E5,
+    0x01CA6, 0x010E6,
+    0x01CA7, 0x010E7,
+    0x01CA8, 0x010E8,
+    0x01CA9, 0x010E9,
+    0x01CAA, 0x010EA,
+    0x01CAB, 0x010EB,
+    0x01CAC, 0x010EC,
+    0x01CAD, 0x010ED,
+    0x01CAE, 0x010EE,
+    0x01CAF, 0x010EF,
+    0x01CB0, 0x010F0,
+    0x01CB1, 0x010F1,
+    0x01CB2, 0x010F2,
+    0x01CB3, 0x010F3,
+    0x01CB4, 0x010F4,
+    0x01CB5, 0x010F5,
+    0x01CB6, 0x010F6,
+    0x01CB7, 0x010F7,
+    0x01CB8, 0x010F8,
+    0x01CB9, 0x010F9,
+    0x01CBA, 0x010FA,
+    0x01CBD, 0x010FD,
+    0x01CBE, 0x010FE,
+    0x01CBF, 0x010FF,
+    0x01E00, 0x01E01,
+    0x01E02, 0x01E03,
+    0x01E04, 0x01E05,
+    0x01E06, 0x01E07,
+    0x01E08, 0x01E09,
+    0x01E0A, 0x01E0B,
+    0x01E0C, 0x01E0D,
+    0x01E0E, 0x01E0F,
+    0x01E10, 0x01E11,
+    0x01E12, 0x01E13,
+    0x01E14, 0x01E15,
+    0x01E16, 0x01E17,
+    0x01E18, 0x01E19,
+    0x01E1A, 0x01E1B,
+    0x01E1C, 0x01E1D,
+    0x01E1E, 0x01E1F,
+    0x01E20, 0x01E21,
+    0x01E22, 0x01E23,
+    0x01E24, 0x01E25,
+    0x01E26, 0x01E27,
+    0x01E28, 0x01E29,
+    0x01E2A, 0x01E2B,
+    0x01E2C, 0x01E2D,
+    0x01E2E, 0x01E2F,
+    0x01E30, 0x01E31,
+    0x01E32, 0x01E33,
+    0x01E34, 0x01E35,
+    0x01E36, 0x01E37,
+    0x01E38, 0x01E39,
+    0x01E3A, 0x01E3B,
+    0x01E3C, 0x01E3D,
+    0x01E3E, 0x01E3F,
+    0x01E40, 0x01E41,
+    0x01E42, 0x01E43,
+    0x01E44, 0x01E45,
+    0x01E46, 0x01E47,
+    0x01E48, 0x01E49,
+    0x01E4A, 0x01E4B,
+    0x01E4C, 0x01E4D,
+    0x01E4E, 0x01E4F,
+    0x01E50, 0x01E51,
+    0x01E52, 0x01E53,
+    0x01E54, 0x01E55,
+    0x01E56, 0x01E57,
+    0x01E58, 0x01E59,
+    0x01E5A, 0x01E5B,
+    0x01E5C, 0x01E5D,
+    0x01E5E, 0x01E5F,
+    0x01E60, 0x01E61,
+    0x01E62, 0x01E63,
+    0x01E64, 0x01E65,
+    0x01E66, 0x01E67,
+    0x01E68, 0x01E69,
+    0x01E6A, 0x01E6B,
+    0x01E6C, 0x01E6D,
+    0x01E6E, 0x01E6F,
+    0x01E70, 0x01E71,
+    0x01E72, 0x01E73,
+    0x01E74, 0x01E75,
+    0x01E76, 0x01E77,
+    0x01E78, 0x01E79,
+    0x01E7A, 0x01E7B,
+    0x01E7C, 0x01E7D,
+    0x01E7E, 0x01E7F,
+    0x01E80, 0x01E81,
+    0x01E82, 0x01E83,
+    0x01E84, 0x01E85,
+    0x01E86, 0x01E87,
+    0x01E88, 0x01E89,
+    0x01E8A, 0x01E8B,
+    0x01E8C, 0x01E8D,
+    0x01E8E, 0x01E8F,
+    0x01E90, 0x01E91,
+    0x01E92, 0x01E93,
+    0x01E94, 0x01E95,
+    0x01E9E, 0x000DF,
+    0x01EA0, 0x01EA1,
+    0x01EA2, 0x01EA3,
+    0x01EA4, 0x01EA5,
+    0x01EA6, 0x01EA7,
+    0x01EA8, 0x01EA9,
+    0x01EAA, 0x01EAB,
+    0x01EAC, 0x01EAD,
+    0x01EAE, 0x01EAF,
+    0x01EB0, 0x01EB1,
+    0x01EB2, 0x01EB3,
+    0x01EB4, 0x01EB5,
+    0x01EB6, 0x01EB7,
+    0x01EB8, 0x01EB9,
+    0x01EBA, 0x01EBB,
+    0x01EBC, 0x01EBD,
+    0x01EBE, 0x01EBF,
+    0x01EC0, 0x01EC1,
+    0x01EC2, 0x01EC3,
+    0x01EC4, 0x01EC5,
+    0x01EC6, 0x01EC7,
+    0x01EC8, 0x01EC9,
+    0x01ECA, 0x01ECB,
+    0x01ECC, 0x01ECD,
+    0x01ECE, 0x01ECF,
+    0x01ED0, 0x01ED1,
+    0x01ED2, 0x01ED3,
+    0x01ED4, 0x01ED5,
+    0x01ED6, 0x01ED7,
+    0x01ED8, 0x01ED9,
+    0x01EDA, 0x01EDB,
+    0x01EDC, 0x01EDD,
+    0x01EDE, 0x01EDF,
+    0x01EE0, 0x01EE1,
+    0x01EE2, 0x01EE3,
+    0x01EE4, 0x01EE5,
+    0x01EE6, 0x01EE7,
+    0x01EE8, 0x01EE9,
+    0x01EEA, 0x01EEB,
+    0x01EEC, 0x01EED,
+    0x01EEE, 0x01EEF,
+    0x01EF0, 0x01EF1,
+    0x01EF2, 0x01EF3,
+    0x01EF4, 0x01EF5,
+    0x01EF6, 0x01EF7,
+    0x01EF8, 0x01EF9,
+    0x01EFA, 0x01EFB,
+    0x01EFC, 0x01EFD,
+    0x01EFE, 0x01EFF,
+    0x01F08, 0x01F00,
+    0x01F09, 0x01F01,
+    0x01F0A, 0x01F02,
+    0x01F0B, 0x01F03,
+    0x01F0C, 0x01F04,
+    0x01F0D, 0x01F05,
+    0x01F0E, 0x01F06,
+    0x01F0F, 0x01F07,
+    0x01F18, 0x01F10,
+    0x01F19, 0x01F11,
+    0x01F1A, 0x01F12,
+    0x01F1B, 0x01F13,
+    0x01F1C, 0x01F14,
+    0x01F1D, 0x01F15,
+    0x01F28, 0x01F20,
+    0x01F29, 0x01F21,
+    0x01F2A, 0x01F22,
+    0x01F2B, 0x01F23,
+    0x01F2C, 0x01F24,
+    0x01F2D, 0x01F25,
+    0x01F2E, 0x01F26,
+    0x01F2F, 0x01F27,
+    0x01F38, 0x01F30,
+    0x01F39, 0x01F31,
+    0x01F3A, 0x01F32,
+    0x01F3B, 0x01F33,
+    0x01F3C, 0x01F34,
+    0x01F3D, 0x01F35,
+    0x01F3E, 0x01F36,
+    0x01F3F, 0x01F37,
+    0x01F48, 0x01F40,
+    0x01F49, 0x01F41,
+    0x01F4A, 0x01F42,
+    0x01F4B, 0x01F43,
+    0x01F4C, 0x01F44,
+    0x01F4D, 0x01F45,
+    0x01F59, 0x01F51,
+    0x01F5B, 0x01F53,
+    0x01F5D, 0x01F55,
+    0x01F5F, 0x01F57,
+    0x01F68, 0x01F60,
+    0x01F69, 0x01F61,
+    0x01F6A, 0x01F62,
+    0x01F6B, 0x01F63,
+    0x01F6C, 0x01F64,
+    0x01F6D, 0x01F65,
+    0x01F6E, 0x01F66,
+    0x01F6F, 0x01F67,
+    0x01F88, 0x01F80,
+    0x01F89, 0x01F81,
+    0x01F8A, 0x01F82,
+    0x01F8B, 0x01F83,
+    0x01F8C, 0x01F84,
+    0x01F8D, 0x01F85,
+    0x01F8E, 0x01F86,
+    0x01F8F, 0x01F87,
+    0x01F98, 0x01F90,
+    0x01F99, 0x01F91,
+    0x01F9A, 0x01F92,
+    0x01F9B, 0x01F93,
+    0x01F9C, 0x01F94,
+    0x01F9D, 0x01F95,
+    0x01F9E, 0x01F96,
+    0x01F9F, 0x01F97,
+    0x01FA8, 0x01FA0,
+    0x01FA9, 0x01FA1,
+    0x01FAA, 0x01FA2,
+    0x01FAB, 0x01FA3,
+    0x01FAC, 0x01FA4,
+    0x01FAD, 0x01FA5,
+    0x01FAE, 0x01FA6,
+    0x01FAF, 0x01FA7,
+    0x01FB8, 0x01FB0,
+    0x01FB9, 0x01FB1,
+    0x01FBA, 0x01F70,
+    0x01FBB, 0x01F71,
+    0x01FBC, 0x01FB3,
+    0x01FC8, 0x01F72,
+    0x01FC9, 0x01F73,
+    0x01FCA, 0x01F74,
+    0x01FCB, 0x01F75,
+    0x01FCC, 0x01FC3,
+    0x01FD8, 0x01FD0,
+    0x01FD9, 0x01FD1,
+    0x01FDA, 0x01F76,
+    0x01FDB, 0x01F77,
+    0x01FE8, 0x01FE0,
+    0x01FE9, 0x01FE1,
+    0x01FEA, 0x01F7A,
+    0x01FEB, 0x01F7B,
+    0x01FEC, 0x01FE5,
+    0x01FF8, 0x01F78,
+    0x01FF9, 0x01F79,
+    0x01FFA, 0x01F7C,
+    0x01FFB, 0x01F7D,
+    0x01FFC, 0x01FF3,
+    0x02126, 0x003C9,
+    0x0212A, 0x0006B,
+    0x0212B, 0x000E5,
+    0x02132, 0x0214E,
+    0x02183, 0x02184,
+    0x02C00, 0x02C30,
+    0x02C01, 0x02C31,
+    0x02C02, 0x02C32,
+    0x02C03, 0x02C33,
+    0x02C04, 0x02C34,
+    0x02C05, 0x02C35,
+    0x02C06, 0x02C36,
+    0x02C07, 0x02C37,
+    0x02C08, 0x02C38,
+    0x02C09, 0x02C39,
+    0x02C0A, 0x02C3A,
+    0x02C0B, 0x02C3B,
+    0x02C0C, 0x02C3C,
+    0x02C0D, 0x02C3D,
+    0x02C0E, 0x02C3E,
+    0x02C0F, 0x02C3F,
+    0x02C10, 0x02C40,
+    0x02C11, 0x02C41,
+    0x02C12, 0x02C42,
+    0x02C13, 0x02C43,
+    0x02C14, 0x02C44,
+    0x02C15, 0x02C45,
+    0x02C16, 0x02C46,
+    0x02C17, 0x02C47,
+    0x02C18, 0x02C48,
+    0x02C19, 0x02C49,
+    0x02C1A, 0x02C4A,
+    0x02C1B, 0x02C4B,
+    0x02C1C, 0x02C4C,
+    0x02C1D, 0x02C4D,
+    0x02C1E, 0x02C4E,
+    0x02C1F, 0x02C4F,
+    0x02C20, 0x02C50,
+    0x02C21, 0x02C51,
+    0x02C22, 0x02C52,
+    0x02C23, 0x02C53,
+    0x02C24, 0x02C54,
+    0x02C25, 0x02C55,
+    0x02C26, 0x02C56,
+    0x02C27, 0x02C57,
+    0x02C28, 0x02C58,
+    0x02C29, 0x02C59,
+    0x02C2A, 0x02C5A,
+    0x02C2B, 0x02C5B,
+    0x02C2C, 0x02C5C,
+    0x02C2D, 0x02C5D,
+    0x02C2E, 0x02C5E,
+    0x02C2F, 0x02C5F,
+    0x02C60, 0x02C61,
+    0x02C62, 0x0026B,
+    0x02C63, 0x01D7D,
+    0x02C64, 0x0027D,
+    0x02C67, 0x02C68,
+    0x02C69, 0x02C6A,
+    0x02C6B, 0x02C6C,
+    0x02C6D, 0x00251,
+    0x02C6E, 0x00271,
+    0x02C6F, 0x00250,
+    0x02C70, 0x00252,
+    0x02C72, 0x02C73,
+    0x02C75, 0x02C76,
+    0x02C7E, 0x0023F,
+    0x02C7F, 0x00240,
+    0x02C80, 0x02C81,
+    0x02C82, 0x02C83,
+    0x02C84, 0x02C85,
+    0x02C86, 0x02C87,
+    0x02C88, 0x02C89,
+    0x02C8A, 0x02C8B,
+    0x02C8C, 0x02C8D,
+    0x02C8E, 0x02C8F,
+    0x02C90, 0x02C91,
+    0x02C92, 0x02C93,
+    0x02C94, 0x02C95,
+    0x02C96, 0x02C97,
+    0x02C98, 0x02C99,
+    0x02C9A, 0x02C9B,
+    0x02C9C, 0x02C9D,
+    0x02C9E, 0x02C9F,
+    0x02CA0, 0x02CA1,
+    0x02CA2, 0x02CA3,
+    0x02CA4, 0x02CA5,
+    0x02CA6, 0x02CA7,
+    0x02CA8, 0x02CA9,
+    0x02CAA, 0x02CAB,
+    0x02CAC, 0x02CAD,
+    0x02CAE, 0x02CAF,
+    0x02CB0, 0x02CB1,
+    0x02CB2, 0x02CB3,
+    0x02CB4, 0x02CB5,
+    0x02CB6, 0x02CB7,
+    0x02CB8, 0x02CB9,
+    0x02CBA, 0x02CBB,
+    0x02CBC, 0x02CBD,
+    0x02CBE, 0x02CBF,
+    0x02CC0, 0x02CC1,
+    0x02CC2, 0x02CC3,
+    0x02CC4, 0x02CC5,
+    0x02CC6, 0x02CC7,
+    0x02CC8, 0x02CC9,
+    0x02CCA, 0x02CCB,
+    0x02CCC, 0x02CCD,
+    0x02CCE, 0x02CCF,
+    0x02CD0, 0x02CD1,
+    0x02CD2, 0x02CD3,
+    0x02CD4, 0x02CD5,
+    0x02CD6, 0x02CD7,
+    0x02CD8, 0x02CD9,
+    0x02CDA, 0x02CDB,
+    0x02CDC, 0x02CDD,
+    0x02CDE, 0x02CDF,
+    0x02CE0, 0x02CE1,
+    0x02CE2, 0x02CE3,
+    0x02CEB, 0x02CEC,
+    0x02CED, 0x02CEE,
+    0x02CF2, 0x02CF3,
+    0x0A640, 0x0A641,
+    0x0A642, 0x0A643,
+    0x0A644, 0x0A645,
+    0x0A646, 0x0A647,
+    0x0A648, 0x0A649,
+    0x0A64A, 0x0A64B,
+    0x0A64C, 0x0A64D,
+    0x0A64E, 0x0A64F,
+    0x0A650, 0x0A651,
+    0x0A652, 0x0A653,
+    0x0A654, 0x0A655,
+    0x0A656, 0x0A657,
+    0x0A658, 0x0A659,
+    0x0A65A, 0x0A65B,
+    0x0A65C, 0x0A65D,
+    0x0A65E, 0x0A65F,
+    0x0A660, 0x0A661,
+    0x0A662, 0x0A663,
+    0x0A664, 0x0A665,
+    0x0A666, 0x0A667,
+    0x0A668, 0x0A669,
+    0x0A66A, 0x0A66B,
+    0x0A66C, 0x0A66D,
+    0x0A680, 0x0A681,
+    0x0A682, 0x0A683,
+    0x0A684, 0x0A685,
+    0x0A686, 0x0A687,
+    0x0A688, 0x0A689,
+    0x0A68A, 0x0A68B,
+    0x0A68C, 0x0A68D,
+    0x0A68E, 0x0A68F,
+    0x0A690, 0x0A691,
+    0x0A692, 0x0A693,
+    0x0A694, 0x0A695,
+    0x0A696, 0x0A697,
+    0x0A698, 0x0A699,
+    0x0A69A, 0x0A69B,
+    0x0A722, 0x0A723,
+    0x0A724, 0x0A725,
+    0x0A726, 0x0A727,
+    0x0A728, 0x0A729,
+    0x0A72A, 0x0A72B,
+    0x0A72C, 0x0A72D,
+    0x0A72E, 0x0A72F,
+    0x0A732, 0x0A733,
+    0x0A734, 0x0A735,
+    0x0A736, 0x0A737,
+    0x0A738, 0x0A739,
+    0x0A73A, 0x0A73B,
+    0x0A73C, 0x0A73D,
+    0x0A73E, 0x0A73F,
+    0x0A740, 0x0A741,
+    0x0A742, 0x0A743,
+    0x0A744, 0x0A745,
+    0x0A746, 0x0A747,
+    0x0A748, 0x0A749,
+    0x0A74A, 0x0A74B,
+    0x0A74C, 0x0A74D,
+    0x0A74E, 0x0A74F,
+    0x0A750, 0x0A751,
+    0x0A752, 0x0A753,
+    0x0A754, 0x0A755,
+    0x0A756, 0x0A757,
+    0x0A758, 0x0A759,
+    0x0A75A, 0x0A75B,
+    0x0A75C, 0x0A75D,
+    0x0A75E, 0x0A75F,
+    0x0A760, 0x0A761,
+    0x0A762, 0x0A763,
+    0x0A764, 0x0A765,
+    0x0A766, 0x0A767,
+    0x0A768, 0x0A769,
+    0x0A76A, 0x0A76B,
+    0x0A76C, 0x0A76D,
+    0x0A76E, 0x0A76F,
+    0x0A779, 0x0A77A,
+    0x0A77B, 0x0A77C,
+    0x0A77D, 0x01D79,
+    0x0A77E, 0x0A77F,
+    0x0A780, 0x0A781,
+    0x0A782, 0x0A783,
+    0x0A784, 0x0A785,
+    0x0A786, 0x0A787,
+    0x0A78B, 0x0A78C,
+    0x0A78D, 0x00265,
+    0x0A790, 0x0A791,
+    0x0A792, 0x0A793,
+    0x0A796, 0x0A797,
+    0x0A798, 0x0A799,
+    0x0A79A, 0x0A79B,
+    0x0A79C, 0x0A79D,
+    0x0A79E, 0x0A79F,
+    0x0A7A0, 0x0A7A1,
+    0x0A7A2, 0x0A7A3,
+    0x0A7A4, 0x0A7A5,
+    0x0A7A6, 0x0A7A7,
+    0x0A7A8, 0x0A7A9,
+    0x0A7AA, 0x00266,
+    0x0A7AB, 0x0025C,
+    0x0A7AC, 0x00261,
+    0x0A7AD, 0x0026C,
+    0x0A7AE, 0x0026A,
+    0x0A7B0, 0x0029E,
+    0x0A7B1, 0x00287,
+    0x0A7B2, 0x0029D,
+    0x0A7B3, 0x0AB53,
+    0x0A7B4, 0x0A7B5,
+    0x0A7B6, 0x0A7B7,
+    0x0A7B8, 0x0A7B9,
+    0x0A7BA, 0x0A7BB,
+    0x0A7BC, 0x0A7BD,
+    0x0A7BE, 0x0A7BF,
+    0x0A7C0, 0x0A7C1,
+    0x0A7C2, 0x0A7C3,
+    0x0A7C4, 0x0A794,
+    0x0A7C5, 0x00282,
+    0x0A7C6, 0x01D8E,
+    0x0A7C7, 0x0A7C8,
+    0x0A7C9, 0x0A7CA,
+    0x0A7D0, 0x0A7D1,
+    0x0A7D6, 0x0A7D7,
+    0x0A7D8, 0x0A7D9,
+    0x0A7F5, 0x0A7F6,
+    0x0FF21, 0x0FF41,
+    0x0FF22, 0x0FF42,
+    0x0FF23, 0x0FF43,
+    0x0FF24, 0x0FF44,
+    0x0FF25, 0x0FF45,
+    0x0FF26, 0x0FF46,
+    0x0FF27, 0x0FF47,
+    0x0FF28, 0x0FF48,
+    0x0FF29, 0x0FF49,
+    0x0FF2A, 0x0FF4A,
+    0x0FF2B, 0x0FF4B,
+    0x0FF2C, 0x0FF4C,
+    0x0FF2D, 0x0FF4D,
+    0x0FF2E, 0x0FF4E,
+    0x0FF2F, 0x0FF4F,
+    0x0FF30, 0x0FF50,
+    0x0FF31, 0x0FF51,
+    0x0FF32, 0x0FF52,
+    0x0FF33, 0x0FF53,
+    0x0FF34, 0x0FF54,
+    0x0FF35, 0x0FF55,
+    0x0FF36, 0x0FF56,
+    0x0FF37, 0x0FF57,
+    0x0FF38, 0x0FF58,
+    0x0FF39, 0x0FF59,
+    0x0FF3A, 0x0FF5A,
+    0x10400, 0x10428,
+    0x10401, 0x10429,
+    0x10402, 0x1042A,
+    0x10403, 0x1042B,
+    0x10404, 0x1042C,
+    0x10405, 0x1042D,
+    0x10406, 0x1042E,
+    0x10407, 0x1042F,
+    0x10408, 0x10430,
+    0x10409, 0x10431,
+    0x1040A, 0x10432,
+    0x1040B, 0x10433,
+    0x1040C, 0x10434,
+    0x1040D, 0x10435,
+    0x1040E, 0x10436,
+    0x1040F, 0x10437,
+    0x10410, 0x10438,
+    0x10411, 0x10439,
+    0x10412, 0x1043A,
+    0x10413, 0x1043B,
+    0x10414, 0x1043C,
+    0x10415, 0x1043D,
+    0x10416, 0x1043E,
+    0x10417, 0x1043F,
+    0x10418, 0x10440,
+    0x10419, 0x10441,
+    0x1041A, 0x10442,
+    0x1041B, 0x10443,
+    0x1041C, 0x10444,
+    0x1041D, 0x10445,
+    0x1041E, 0x10446,
+    0x1041F, 0x10447,
+    0x10420, 0x10448,
+    0x10421, 0x10449,
+    0x10422, 0x1044A,
+    0x10423, 0x1044B,
+    0x10424, 0x1044C,
+    0x10425, 0x1044D,
+    0x10426, 0x1044E,
+    0x10427, 0x1044F,
+    0x104B0, 0x104D8,
+    0x104B1, 0x104D9,
+    0x104B2, 0x104DA,
+    0x104B3, 0x104DB,
+    0x104B4, 0x104DC,
+    0x104B5, 0x104DD,
+    0x104B6, 0x104DE,
+    0x104B7, 0x104DF,
+    0x104B8, 0x104E0,
+    0x104B9, 0x104E1,
+    0x104BA, 0x104E2,
+    0x104BB, 0x104E3,
+    0x104BC, 0x104E4,
+    0x104BD, 0x104E5,
+    0x104BE, 0x104E6,
+    0x104BF, 0x104E7,
+    0x104C0, 0x104E8,
+    0x104C1, 0x104E9,
+    0x104C2, 0x104EA,
+    0x104C3, 0x104EB,
+    0x104C4, 0x104EC,
+    0x104C5, 0x104ED,
+    0x104C6, 0x104EE,
+    0x104C7, 0x104EF,
+    0x104C8, 0x104F0,
+    0x104C9, 0x104F1,
+    0x104CA, 0x104F2,
+    0x104CB, 0x104F3,
+    0x104CC, 0x104F4,
+    0x104CD, 0x104F5,
+    0x104CE, 0x104F6,
+    0x104CF, 0x104F7,
+    0x104D0, 0x104F8,
+    0x104D1, 0x104F9,
+    0x104D2, 0x104FA,
+    0x104D3, 0x104FB,
+    0x10570, 0x10597,
+    0x10571, 0x10598,
+    0x10572, 0x10599,
+    0x10573, 0x1059A,
+    0x10574, 0x1059B,
+    0x10575, 0x1059C,
+    0x10576, 0x1059D,
+    0x10577, 0x1059E,
+    0x10578, 0x1059F,
+    0x10579, 0x105A0,
+    0x1057A, 0x105A1,
+    0x1057C, 0x105A3,
+    0x1057D, 0x105A4,
+    0x1057E, 0x105A5,
+    0x1057F, 0x105A6,
+    0x10580, 0x105A7,
+    0x10581, 0x105A8,
+    0x10582, 0x105A9,
+    0x10583, 0x105AA,
+    0x10584, 0x105AB,
+    0x10585, 0x105AC,
+    0x10586, 0x105AD,
+    0x10587, 0x105AE,
+    0x10588, 0x105AF,
+    0x10589, 0x105B0,
+    0x1058A, 0x105B1,
+    0x1058C, 0x105B3,
+    0x1058D, 0x105B4,
+    0x1058E, 0x105B5,
+    0x1058F, 0x105B6,
+    0x10590, 0x105B7,
+    0x10591, 0x105B8,
+    0x10592, 0x105B9,
+    0x10594, 0x105BB,
+    0x10595, 0x105BC,
+    0x10C80, 0x10CC0,
+    0x10C81, 0x10CC1,
+    0x10C82, 0x10CC2,
+    0x10C83, 0x10CC3,
+    0x10C84, 0x10CC4,
+    0x10C85, 0x10CC5,
+    0x10C86, 0x10CC6,
+    0x10C87, 0x10CC7,
+    0x10C88, 0x10CC8,
+    0x10C89, 0x10CC9,
+    0x10C8A, 0x10CCA,
+    0x10C8B, 0x10CCB,
+    0x10C8C, 0x10CCC,
+    0x10C8D, 0x10CCD,
+    0x10C8E, 0x10CCE,
+    0x10C8F, 0x10CCF,
+    0x10C90, 0x10CD0,
+    0x10C91, 0x10CD1,
+    0x10C92, 0x10CD2,
+    0x10C93, 0x10CD3,
+    0x10C94, 0x10CD4,
+    0x10C95, 0x10CD5,
+    0x10C96, 0x10CD6,
+    0x10C97, 0x10CD7,
+    0x10C98, 0x10CD8,
+    0x10C99, 0x10CD9,
+    0x10C9A, 0x10CDA,
+    0x10C9B, 0x10CDB,
+    0x10C9C, 0x10CDC,
+    0x10C9D, 0x10CDD,
+    0x10C9E, 0x10CDE,
+    0x10C9F, 0x10CDF,
+    0x10CA0, 0x10CE0,
+    0x10CA1, 0x10CE1,
+    0x10CA2, 0x10CE2,
+    0x10CA3, 0x10CE3,
+    0x10CA4, 0x10CE4,
+    0x10CA5, 0x10CE5,
+    0x10CA6, 0x10CE6,
+    0x10CA7, 0x10CE7,
+    0x10CA8, 0x10CE8,
+    0x10CA9, 0x10CE9,
+    0x10CAA, 0x10CEA,
+    0x10CAB, 0x10CEB,
+    0x10CAC, 0x10CEC,
+    0x10CAD, 0x10CED,
+    0x10CAE, 0x10CEE,
+    0x10CAF, 0x10CEF,
+    0x10CB0, 0x10CF0,
+    0x10CB1, 0x10CF1,
+    0x10CB2, 0x10CF2,
+    0x118A0, 0x118C0,
+    0x118A1, 0x118C1,
+    0x118A2, 0x118C2,
+    0x118A3, 0x118C3,
+    0x118A4, 0x118C4,
+    0x118A5, 0x118C5,
+    0x118A6, 0x118C6,
+    0x118A7, 0x118C7,
+    0x118A8, 0x118C8,
+    0x118A9, 0x118C9,
+    0x118AA, 0x118CA,
+    0x118AB, 0x118CB,
+    0x118AC, 0x118CC,
+    0x118AD, 0x118CD,
+    0x118AE, 0x118CE,
+    0x118AF, 0x118CF,
+    0x118B0, 0x118D0,
+    0x118B1, 0x118D1,
+    0x118B2, 0x118D2,
+    0x118B3, 0x118D3,
+    0x118B4, 0x118D4,
+    0x118B5, 0x118D5,
+    0x118B6, 0x118D6,
+    0x118B7, 0x118D7,
+    0x118B8, 0x118D8,
+    0x118B9, 0x118D9,
+    0x118BA, 0x118DA,
+    0x118BB, 0x118DB,
+    0x118BC, 0x118DC,
+    0x118BD, 0x118DD,
+    0x118BE, 0x118DE,
+    0x118BF, 0x118DF,
+    0x16E40, 0x16E60,
+    0x16E41, 0x16E61,
+    0x16E42, 0x16E62,
+    0x16E43, 0x16E63,
+    0x16E44, 0x16E64,
+    0x16E45, 0x16E65,
+    0x16E46, 0x16E66,
+    0x16E47, 0x16E67,
+    0x16E48, 0x16E68,
+    0x16E49, 0x16E69,
+    0x16E4A, 0x16E6A,
+    0x16E4B, 0x16E6B,
+    0x16E4C, 0x16E6C,
+    0x16E4D, 0x16E6D,
+    0x16E4E, 0x16E6E,
+    0x16E4F, 0x16E6F,
+    0x16E50, 0x16E70,
+    0x16E51, 0x16E71,
+    0x16E52, 0x16E72,
+    0x16E53, 0x16E73,
+    0x16E54, 0x16E74,
+    0x16E55, 0x16E75,
+    0x16E56, 0x16E76,
+    0x16E57, 0x16E77,
+    0x16E58, 0x16E78,
+    0x16E59, 0x16E79,
+    0x16E5A, 0x16E7A,
+    0x16E5B, 0x16E7B,
+    0x16E5C, 0x16E7C,
+    0x16E5D, 0x16E7D,
+    0x16E5E, 0x16E7E,
+    0x16E5F, 0x16E7F,
+    0x1E900, 0x1E922,
+    0x1E901, 0x1E923,
+    0x1E902, 0x1E924,
+    0x1E903, 0x1E925,
+    0x1E904, 0x1E926,
+    0x1E905, 0x1E927,
+    0x1E906, 0x1E928,
+    0x1E907, 0x1E929,
+    0x1E908, 0x1E92A,
+    0x1E909, 0x1E92B,
+    0x1E90A, 0x1E92C,
+    0x1E90B, 0x1E92D,
+    0x1E90C, 0x1E92E,
+    0x1E90D, 0x1E92F,
+    0x1E90E, 0x1E930,
+    0x1E90F, 0x1E931,
+    0x1E910, 0x1E932,
+    0x1E911, 0x1E933,
+    0x1E912, 0x1E934,
+    0x1E913, 0x1E935,
+    0x1E914, 0x1E936,
+    0x1E915, 0x1E937,
+    0x1E916, 0x1E938,
+    0x1E917, 0x1E939,
+    0x1E918, 0x1E93A,
+    0x1E919, 0x1E93B,
+    0x1E91A, 0x1E93C,
+    0x1E91B, 0x1E93D,
+    0x1E91C, 0x1E93E,
+    0x1E91D, 0x1E93F,
+    0x1E91E, 0x1E940,
+    0x1E91F, 0x1E941,
+    0x1E920, 0x1E942,
+    0x1E921, 0x1E943,
+};
+
+/* codepoint, base and diacritic triplets (canonical decompositions), sorted by codepoint */
+
+static unsigned int xs_unicode_nfd_table[] = {
+    0x000C0, 0x00041, 0x00300,
+    0x000C1, 0x00041, 0x00301,
+    0x000C2, 0x00041, 0x00302,
+    0x000C3, 0x00041, 0x00303,
+    0x000C4, 0x00041, 0x00308,
+    0x000C5, 0x00041, 0x0030A,
+    0x000C7, 0x00043, 0x00327,
+    0x000C8, 0x00045, 0x00300,
+    0x000C9, 0x00045, 0x00301,
+    0x000CA, 0x00045, 0x00302,
+    0x000CB, 0x00045, 0x00308,
+    0x000CC, 0x00049, 0x00300,
+    0x000CD, 0x00049, 0x00301,
+    0x000CE, 0x00049, 0x00302,
+    0x000CF, 0x00049, 0x00308,
+    0x000D1, 0x0004E, 0x00303,
+    0x000D2, 0x0004F, 0x00300,
+    0x000D3, 0x0004F, 0x00301,
+    0x000D4, 0x0004F, 0x00302,
+    0x000D5, 0x0004F, 0x00303,
+    0x000D6, 0x0004F, 0x00308,
+    0x000D9, 0x00055, 0x00300,
+    0x000DA, 0x00055, 0x00301,
+    0x000DB, 0x00055, 0x00302,
+    0x000DC, 0x00055, 0x00308,
+    0x000DD, 0x00059, 0x00301,
+    0x000E0, 0x00061, 0x00300,
+    0x000E1, 0x00061, 0x00301,
+    0x000E2, 0x00061, 0x00302,
+    0x000E3, 0x00061, 0x00303,
+    0x000E4, 0x00061, 0x00308,
+    0x000E5, 0x00061, 0x0030A,
+    0x000E7, 0x00063, 0x00327,
+    0x000E8, 0x00065, 0x00300,
+    0x000E9, 0x00065, 0x00301,
+    0x000EA, 0x00065, 0x00302,
+    0x000EB, 0x00065, 0x00308,
+    0x000EC, 0x00069, 0x00300,
+    0x000ED, 0x00069, 0x00301,
+    0x000EE, 0x00069, 0x00302,
+    0x000EF, 0x00069, 0x00308,
+    0x000F1, 0x0006E, 0x00303,
+    0x000F2, 0x0006F, 0x00300,
+    0x000F3, 0x0006F, 0x00301,
+    0x000F4, 0x0006F, 0x00302,
+    0x000F5, 0x0006F, 0x00303,
+    0x000F6, 0x0006F, 0x00308,
+    0x000F9, 0x00075, 0x00300,
+    0x000FA, 0x00075, 0x00301,
+    0x000FB, 0x00075, 0x00302,
+    0x000FC, 0x00075, 0x00308,
+    0x000FD, 0x00079, 0x00301,
+    0x000FF, 0x00079, 0x00308,
+    0x00100, 0x00041, 0x00304,
+    0x00101, 0x00061, 0x00304,
+    0x00102, 0x00041, 0x00306,
+    0x00103, 0x00061, 0x00306,
+    0x00104, 0x00041, 0x00328,
+    0x00105, 0x00061, 0x00328,
+    0x00106, 0x00043, 0x00301,
+    0x00107, 0x00063, 0x00301,
+    0x00108, 0x00043, 0x00302,
+    0x00109, 0x00063, 0x00302,
+    0x0010A, 0x00043, 0x00307,
+    0x0010B, 0x00063, 0x00307,
+    0x0010C, 0x00043, 0x0030C,
+    0x0010D, 0x00063, 0x0030C,
+    0x0010E, 0x00044, 0x0030C,
+    0x0010F, 0x00064, 0x0030C,
+    0x00112, 0x00045, 0x00304,
+    0x00113, 0x00065, 0x00304,
+    0x00114, 0x00045, 0x00306,
+    0x00115, 0x00065, 0x00306,
+    0x00116, 0x00045, 0x00307,
+    0x00117, 0x00065, 0x00307,
+    0x00118, 0x00045, 0x00328,
+    0x00119, 0x00065, 0x00328,
+    0x0011A, 0x00045, 0x0030C,
+    0x0011B, 0x00065, 0x0030C,
+    0x0011C, 0x00047, 0x00302,
+    0x0011D, 0x00067, 0x00302,
+    0x0011E, 0x00047, 0x00306,
+    0x0011F, 0x00067, 0x00306,
+    0x00120, 0x00047, 0x00307,
+    0x00121, 0x00067, 0x00307,
+    0x00122, 0x00047, 0x00327,
+    0x00123, 0x00067, 0x00327,
+    0x00124, 0x00048, 0x00302,
+    0x00125, 0x00068, 0x00302,
+    0x00128, 0x00049, 0x00303,
+    0x00129, 0x00069, 0x00303,
+    0x0012A, 0x00049, 0x00304,
+    0x0012B, 0x00069, 0x00304,
+    0x0012C, 0x00049, 0x00306,
+    0x0012D, 0x00069, 0x00306,
+    0x0012E, 0x00049, 0x00328,
+    0x0012F, 0x00069, 0x00328,
+    0x00130, 0x00049, 0x00307,
+    0x00134, 0x0004A, 0x00302,
+    0x00135, 0x0006A, 0x00302,
+    0x00136, 0x0004B, 0x00327,
+    0x00137, 0x0006B, 0x00327,
+    0x00139, 0x0004C, 0x00301,
+    0x0013A, 0x0006C, 0x00301,
+    0x0013B, 0x0004C, 0x00327,
+    0x0013C, 0x0006C, 0x00327,
+    0x0013D, 0x0004C, 0x0030C,
+    0x0013E, 0x0006C, 0x0030C,
+    0x00143, 0x0004E, 0x00301,
+    0x00144, 0x0006E, 0x00301,
+    0x00145, 0x0004E, 0x00327,
+    0x00146, 0x0006E, 0x00327,
+    0x00147, 0x0004E, 0x0030C,
+    0x00148, 0x0006E, 0x0030C,
+    0x0014C, 0x0004F, 0x00304,
+    0x0014D, 0x0006F, 0x00304,
+    0x0014E, 0x0004F, 0x00306,
+    0x0014F, 0x0006F, 0x00306,
+    0x00150, 0x0004F, 0x0030B,
+    0x00151, 0x0006F, 0x0030B,
+    0x00154, 0x00052, 0x00301,
+    0x00155, 0x00072, 0x00301,
+    0x00156, 0x00052, 0x00327,
+    0x00157, 0x00072, 0x00327,
+    0x00158, 0x00052, 0x0030C,
+    0x00159, 0x00072, 0x0030C,
+    0x0015A, 0x00053, 0x00301,
+    0x0015B, 0x00073, 0x00301,
+    0x0015C, 0x00053, 0x00302,
+    0x0015D, 0x00073, 0x00302,
+    0x0015E, 0x00053, 0x00327,
+    0x0015F, 0x00073, 0x00327,
+    0x00160, 0x00053, 0x0030C,
+    0x00161, 0x00073, 0x0030C,
+    0x00162, 0x00054, 0x00327,
+    0x00163, 0x00074, 0x00327,
+    0x00164, 0x00054, 0x0030C,
+    0x00165, 0x00074, 0x0030C,
+    0x00168, 0x00055, 0x00303,
+    0x00169, 0x00075, 0x00303,
+    0x0016A, 0x00055, 0x00304,
+    0x0016B, 0x00075, 0x00304,
+    0x0016C, 0x00055, 0x00306,
+    0x0016D, 0x00075, 0x00306,
+    0x0016E, 0x00055, 0x0030A,
+    0x0016F, 0x00075, 0x0030A,
+    0x00170, 0x00055, 0x0030B,
+    0x00171, 0x00075, 0x0030B,
+    0x00172, 0x00055, 0x00328,
+    0x00173, 0x00075, 0x00328,
+    0x00174, 0x00057, 0x00302,
+    0x00175, 0x00077, 0x00302,
+    0x00176, 0x00059, 0x00302,
+    0x00177, 0x00079, 0x00302,
+    0x00178, 0x00059, 0x00308,
+    0x00179, 0x0005A, 0x00301,
+    0x0017A, 0x0007A, 0x00301,
+    0x0017B, 0x0005A, 0x00307,
+    0x0017C, 0x0007A, 0x00307,
+    0x0017D, 0x0005A, 0x0030C,
+    0x0017E, 0x0007A, 0x0030C,
+    0x001A0, 0x0004F, 0x0031B,
+    0x001A1, 0x0006F, 0x0031B,
+    0x001AF, 0x00055, 0x0031B,
+    0x001B0, 0x00075, 0x0031B,
+    0x001CD, 0x00041, 0x0030C,
+    0x001CE, 0x00061, 0x0030C,
+    0x001CF, 0x00049, 0x0030C,
+    0x001D0, 0x00069, 0x0030C,
+    0x001D1, 0x0004F, 0x0030C,
+    0x001D2, 0x0006F, 0x0030C,
+    0x001D3, 0x00055, 0x0030C,
+    0x001D4, 0x00075, 0x0030C,
+    0x001D5, 0x000DC, 0x00304,
+    0x001D6, 0x000FC, 0x00304,
+    0x001D7, 0x000DC, 0x00301,
+    0x001D8, 0x000FC, 0x00301,
+    0x001D9, 0x000DC, 0x0030C,
+    0x001DA, 0x000FC, 0x0030C,
+    0x001DB, 0x000DC, 0x00300,
+    0x001DC, 0x000FC, 0x00300,
+    0x001DE, 0x000C4, 0x00304,
+    0x001DF, 0x000E4, 0x00304,
+    0x001E0, 0x00226, 0x00304,
+    0x001E1, 0x00227, 0x00304,
+    0x001E2, 0x000C6, 0x00304,
+    0x001E3, 0x000E6, 0x00304,
+    0x001E6, 0x00047, 0x0030C,
+    0x001E7, 0x00067, 0x0030C,
+    0x001E8, 0x0004B, 0x0030C,
+    0x001E9, 0x0006B, 0x0030C,
+    0x001EA, 0x0004F, 0x00328,
+    0x001EB, 0x0006F, 0x00328,
+    0x001EC, 0x001EA, 0x00304,
+    0x001ED, 0x001EB, 0x00304,
+    0x001EE, 0x001B7, 0x0030C,
+    0x001EF, 0x00292, 0x0030C,
+    0x001F0, 0x0006A, 0x0030C,
+    0x001F4, 0x00047, 0x00301,
+    0x001F5, 0x00067, 0x00301,
+    0x001F8, 0x0004E, 0x00300,
+    0x001F9, 0x0006E, 0x00300,
+    0x001FA, 0x000C5, 0x00301,
+    0x001FB, 0x000E5, 0x00301,
+    0x001FC, 0x000C6, 0x00301,
+    0x001FD, 0x000E6, 0x00301,
+    0x001FE, 0x000D8, 0x00301,
+    0x001FF, 0x000F8, 0x00301,
+    0x00200, 0x00041, 0x0030F,
+    0x00201, 0x00061, 0x0030F,
+    0x00202, 0x00041, 0x00311,
+    0x00203, 0x00061, 0x00311,
+    0x00204, 0x00045, 0x0030F,
+    0x00205, 0x00065, 0x0030F,
+    0x00206, 0x00045, 0x00311,
+    0x00207, 0x00065, 0x00311,
+    0x00208, 0x00049, 0x0030F,
+    0x00209, 0x00069, 0x0030F,
+    0x0020A, 0x00049, 0x00311,
+    0x0020B, 0x00069, 0x00311,
+    0x0020C, 0x0004F, 0x0030F,
+    0x0020D, 0x0006F, 0x0030F,
+    0x0020E, 0x0004F, 0x00311,
+    0x0020F, 0x0006F, 0x00311,
+    0x00210, 0x00052, 0x0030F,
+    0x00211, 0x00072, 0x0030F,
+    0x00212, 0x00052, 0x00311,
+    0x00213, 0x00072, 0x00311,
+    0x00214, 0x00055, 0x0030F,
+    0x00215, 0x00075, 0x0030F,
+    0x00216, 0x00055, 0x00311,
+    0x00217, 0x00075, 0x00311,
+    0x00218, 0x00053, 0x00326,
+    0x00219, 0x00073, 0x00326,
+    0x0021A, 0x00054, 0x00326,
+    0x0021B, 0x00074, 0x00326,
+    0x0021E, 0x00048, 0x0030C,
+    0x0021F, 0x00068, 0x0030C,
+    0x00226, 0x00041, 0x00307,
+    0x00227, 0x00061, 0x00307,
+    0x00228, 0x00045, 0x00327,
+    0x00229, 0x00065, 0x00327,
+    0x0022A, 0x000D6, 0x00304,
+    0x0022B, 0x000F6, 0x00304,
+    0x0022C, 0x000D5, 0x00304,
+    0x0022D, 0x000F5, 0x00304,
+    0x0022E, 0x0004F, 0x00307,
+    0x0022F, 0x0006F, 0x00307,
+    0x00230, 0x0022E, 0x00304,
+    0x00231, 0x0022F, 0x00304,
+    0x00232, 0x00059, 0x00304,
+    0x00233, 0x00079, 0x00304,
+    0x00344, 0x00308, 0x00301,
+    0x00385, 0x000A8, 0x00301,
+    0x00386, 0x00391, 0x00301,
+    0x00388, 0x00395, 0x00301,
+    0x00389, 0x00397, 0x00301,
+    0x0038A, 0x00399, 0x00301,
+    0x0038C, 0x0039F, 0x00301,
+    0x0038E, 0x003A5, 0x00301,
+    0x0038F, 0x003A9, 0x00301,
+    0x00390, 0x003CA, 0x00301,
+    0x003AA, 0x00399, 0x00308,
+    0x003AB, 0x003A5, 0x00308,
+    0x003AC, 0x003B1, 0x00301,
+    0x003AD, 0x003B5, 0x00301,
+    0x003AE, 0x003B7, 0x00301,
+    0x003AF, 0x003B9, 0x00301,
+    0x003B0, 0x003CB, 0x00301,
+    0x003CA, 0x003B9, 0x00308,
+    0x003CB, 0x003C5, 0x00308,
+    0x003CC, 0x003BF, 0x00301,
+    0x003CD, 0x003C5, 0x00301,
+    0x003CE, 0x003C9, 0x00301,
+    0x003D3, 0x003D2, 0x00301,
+    0x003D4, 0x003D2, 0x00308,
+    0x00400, 0x00415, 0x00300,
+    0x00401, 0x00415, 0x00308,
+    0x00403, 0x00413, 0x00301,
+    0x00407, 0x00406, 0x00308,
+    0x0040C, 0x0041A, 0x00301,
+    0x0040D, 0x00418, 0x00300,
+    0x0040E, 0x00423, 0x00306,
+    0x00419, 0x00418, 0x00306,
+    0x00439, 0x00438, 0x00306,
+    0x00450, 0x00435, 0x00300,
+    0x00451, 0x00435, 0x00308,
+    0x00453, 0x00433, 0x00301,
+    0x00457, 0x00456, 0x00308,
+    0x0045C, 0x0043A, 0x00301,
+    0x0045D, 0x00438, 0x00300,
+    0x0045E, 0x00443, 0x00306,
+    0x00476, 0x00474, 0x0030F,
+    0x00477, 0x00475, 0x0030F,
+    0x004C1, 0x00416, 0x00306,
+    0x004C2, 0x00436, 0x00306,
+    0x004D0, 0x00410, 0x00306,
+    0x004D1, 0x00430, 0x00306,
+    0x004D2, 0x00410, 0x00308,
+    0x004D3, 0x00430, 0x00308,
+    0x004D6, 0x00415, 0x00306,
+    0x004D7, 0x00435, 0x00306,
+    0x004DA, 0x004D8, 0x00308,
+    0x004DB, 0x004D9, 0x00308,
+    0x004DC, 0x00416, 0x00308,
+    0x004DD, 0x00436, 0x00308,
+    0x004DE, 0x00417, 0x00308,
+    0x004DF, 0x00437, 0x00308,
+    0x004E2, 0x00418, 0x00304,
+    0x004E3, 0x00438, 0x00304,
+    0x004E4, 0x00418, 0x00308,
+    0x004E5, 0x00438, 0x00308,
+    0x004E6, 0x0041E, 0x00308,
+    0x004E7, 0x0043E, 0x00308,
+    0x004EA, 0x004E8, 0x00308,
+    0x004EB, 0x004E9, 0x00308,
+    0x004EC, 0x0042D, 0x00308,
+    0x004ED, 0x0044D, 0x00308,
+    0x004EE, 0x00423, 0x00304,
+    0x004EF, 0x00443, 0x00304,
+    0x004F0, 0x00423, 0x00308,
+    0x004F1, 0x00443, 0x00308,
+    0x004F2, 0x00423, 0x0030B,
+    0x004F3, 0x00443, 0x0030B,
+    0x004F4, 0x00427, 0x00308,
+    0x004F5, 0x00447, 0x00308,
+    0x004F8, 0x0042B, 0x00308,
+    0x004F9, 0x0044B, 0x00308,
+    0x00622, 0x00627, 0x00653,
+    0x00623, 0x00627, 0x00654,
+    0x00624, 0x00648, 0x00654,
+    0x00625, 0x00627, 0x00655,
+    0x00626, 0x0064A, 0x00654,
+    0x006C0, 0x006D5, 0x00654,
+    0x006C2, 0x006C1, 0x00654,
+    0x006D3, 0x006D2, 0x00654,
+    0x00929, 0x00928, 0x0093C,
+    0x00931, 0x00930, 0x0093C,
+    0x00934, 0x00933, 0x0093C,
+    0x00958, 0x00915, 0x0093C,
+    0x00959, 0x00916, 0x0093C,
+    0x0095A, 0x00917, 0x0093C,
+    0x0095B, 0x0091C, 0x0093C,
+    0x0095C, 0x00921, 0x0093C,
+    0x0095D, 0x00922, 0x0093C,
+    0x0095E, 0x0092B, 0x0093C,
+    0x0095F, 0x0092F, 0x0093C,
+    0x009DC, 0x009A1, 0x009BC,
+    0x009DD, 0x009A2, 0x009BC,
+    0x009DF, 0x009AF, 0x009BC,
+    0x00A33, 0x00A32, 0x00A3C,
+    0x00A36, 0x00A38, 0x00A3C,
+    0x00A59, 0x00A16, 0x00A3C,
+    0x00A5A, 0x00A17, 0x00A3C,
+    0x00A5B, 0x00A1C, 0x00A3C,
+    0x00A5E, 0x00A2B, 0x00A3C,
+    0x00B5C, 0x00B21, 0x00B3C,
+    0x00B5D, 0x00B22, 0x00B3C,
+    0x00C48, 0x00C46, 0x00C56,
+    0x00DDA, 0x00DD9, 0x00DCA,
+    0x00DDD, 0x00DDC, 0x00DCA,
+    0x00F73, 0x00F71, 0x00F72,
+    0x00F75, 0x00F71, 0x00F74,
+    0x00F76, 0x00FB2, 0x00F80,
+    0x00F78, 0x00FB3, 0x00F80,
+    0x00F81, 0x00F71, 0x00F80,
+    0x01E00, 0x00041, 0x00325,
+    0x01E01, 0x00061, 0x00325,
+    0x01E02, 0x00042, 0x00307,
+    0x01E03, 0x00062, 0x00307,
+    0x01E04, 0x00042, 0x00323,
+    0x01E05, 0x00062, 0x00323,
+    0x01E06, 0x00042, 0x00331,
+    0x01E07, 0x00062, 0x00331,
+    0x01E08, 0x000C7, 0x00301,
+    0x01E09, 0x000E7, 0x00301,
+    0x01E0A, 0x00044, 0x00307,
+    0x01E0B, 0x00064, 0x00307,
+    0x01E0C, 0x00044, 0x00323,
+    0x01E0D, 0x00064, 0x00323,
+    0x01E0E, 0x00044, 0x00331,
+    0x01E0F, 0x00064, 0x00331,
+    0x01E10, 0x00044, 0x00327,
+    0x01E11, 0x00064, 0x00327,
+    0x01E12, 0x00044, 0x0032D,
+    0x01E13, 0x00064, 0x0032D,
+    0x01E14, 0x00112, 0x00300,
+    0x01E15, 0x00113, 0x00300,
+    0x01E16, 0x00112, 0x00301,
+    0x01E17, 0x00113, 0x00301,
+    0x01E18, 0x00045, 0x0032D,
+    0x01E19, 0x00065, 0x0032D,
+    0x01E1A, 0x00045, 0x00330,
+    0x01E1B, 0x00065, 0x00330,
+    0x01E1C, 0x00228, 0x00306,
+    0x01E1D, 0x00229, 0x00306,
+    0x01E1E, 0x00046, 0x00307,
+    0x01E1F, 0x00066, 0x00307,
+    0x01E20, 0x00047, 0x00304,
+    0x01E21, 0x00067, 0x00304,
+    0x01E22, 0x00048, 0x00307,
+    0x01E23, 0x00068, 0x00307,
+    0x01E24, 0x00048, 0x00323,
+    0x01E25, 0x00068, 0x00323,
+    0x01E26, 0x00048, 0x00308,
+    0x01E27, 0x00068, 0x00308,
+    0x01E28, 0x00048, 0x00327,
+    0x01E29, 0x00068, 0x00327,
+    0x01E2A, 0x00048, 0x0032E,
+    0x01E2B, 0x00068, 0x0032E,
+    0x01E2C, 0x00049, 0x00330,
+    0x01E2D, 0x00069, 0x00330,
+    0x01E2E, 0x000CF, 0x00301,
+    0x01E2F, 0x000EF, 0x00301,
+    0x01E30, 0x0004B, 0x00301,
+    0x01E31, 0x0006B, 0x00301,
+    0x01E32, 0x0004B, 0x00323,
+    0x01E33, 0x0006B, 0x00323,
+    0x01E34, 0x0004B, 0x00331,
+    0x01E35, 0x0006B, 0x00331,
+    0x01E36, 0x0004C, 0x00323,
+    0x01E37, 0x0006C, 0x00323,
+    0x01E38, 0x01E36, 0x00304,
+    0x01E39, 0x01E37, 0x00304,
+    0x01E3A, 0x0004C, 0x00331,
+    0x01E3B, 0x0006C, 0x00331,
+    0x01E3C, 0x0004C, 0x0032D,
+    0x01E3D, 0x0006C, 0x0032D,
+    0x01E3E, 0x0004D, 0x00301,
+    0x01E3F, 0x0006D, 0x00301,
+    0x01E40, 0x0004D, 0x00307,
+    0x01E41, 0x0006D, 0x00307,
+    0x01E42, 0x0004D, 0x00323,
+    0x01E43, 0x0006D, 0x00323,
+    0x01E44, 0x0004E, 0x00307,
+    0x01E45, 0x0006E, 0x00307,
+    0x01E46, 0x0004E, 0x00323,
+    0x01E47, 0x0006E, 0x00323,
+    0x01E48, 0x0004E, 0x00331,
+    0x01E49, 0x0006E, 0x00331,
+    0x01E4A, 0x0004E, 0x0032D,
+    0x01E4B, 0x0006E, 0x0032D,
+    0x01E4C, 0x000D5, 0x00301,
+    0x01E4D, 0x000F5, 0x00301,
+    0x01E4E, 0x000D5, 0x00308,
+    0x01E4F, 0x000F5, 0x00308,
+    0x01E50, 0x0014C, 0x00300,
+    0x01E51, 0x0014D, 0x00300,
+    0x01E52, 0x0014C, 0x00301,
+    0x01E53, 0x0014D, 0x00301,
+    0x01E54, 0x00050, 0x00301,
+    0x01E55, 0x00070, 0x00301,
+    0x01E56, 0x00050, 0x00307,
+    0x01E57, 0x00070, 0x00307,
+    0x01E58, 0x00052, 0x00307,
+    0x01E59, 0x00072, 0x00307,
+    0x01E5A, 0x00052, 0x00323,
+    0x01E5B, 0x00072, 0x00323,
+    0x01E5C, 0x01E5A, 0x00304,
+    0x01E5D, 0x01E5B, 0x00304,
+    0x01E5E, 0x00052, 0x00331,
+    0x01E5F, 0x00072, 0x00331,
+    0x01E60, 0x00053, 0x00307,
+    0x01E61, 0x00073, 0x00307,
+    0x01E62, 0x00053, 0x00323,
+    0x01E63, 0x00073, 0x00323,
+    0x01E64, 0x0015A, 0x00307,
+    0x01E65, 0x0015B, 0x00307,
+    0x01E66, 0x00160, 0x00307,
+    0x01E67, 0x00161, 0x00307,
+    0x01E68, 0x01E62, 0x00307,
+    0x01E69, 0x01E63, 0x00307,
+    0x01E6A, 0x00054, 0x00307,
+    0x01E6B, 0x00074, 0x00307,
+    0x01E6C, 0x00054, 0x00323,
+    0x01E6D, 0x00074, 0x00323,
+    0x01E6E, 0x00054, 0x00331,
+    0x01E6F, 0x00074, 0x00331,
+    0x01E70, 0x00054, 0x0032D,
+    0x01E71, 0x00074, 0x0032D,
+    0x01E72, 0x00055, 0x00324,
+    0x01E73, 0x00075, 0x00324,
+    0x01E74, 0x00055, 0x00330,
+    0x01E75, 0x00075, 0x00330,
+    0x01E76, 0x00055, 0x0032D,
+    0x01E77, 0x00075, 0x0032D,
+    0x01E78, 0x00168, 0x00301,
+    0x01E79, 0x00169, 0x00301,
+    0x01E7A, 0x0016A, 0x00308,
+    0x01E7B, 0x0016B, 0x00308,
+    0x01E7C, 0x00056, 0x00303,
+    0x01E7D, 0x00076, 0x00303,
+    0x01E7E, 0x00056, 0x00323,
+    0x01E7F, 0x00076, 0x00323,
+    0x01E80, 0x00057, 0x00300,
+    0x01E81, 0x00077, 0x00300,
+    0x01E82, 0x00057, 0x00301,
+    0x01E83, 0x00077, 0x00301,
+    0x01E84, 0x00057, 0x00308,
+    0x01E85, 0x00077, 0x00308,
+    0x01E86, 0x00057, 0x00307,
+    0x01E87, 0x00077, 0x00307,
+    0x01E88, 0x00057, 0x00323,
+    0x01E89, 0x00077, 0x00323,
+    0x01E8A, 0x00058, 0x00307,
+    0x01E8B, 0x00078, 0x00307,
+    0x01E8C, 0x00058, 0x00308,
+    0x01E8D, 0x00078, 0x00308,
+    0x01E8E, 0x00059, 0x00307,
+    0x01E8F, 0x00079, 0x00307,
+    0x01E90, 0x0005A, 0x00302,
+    0x01E91, 0x0007A, 0x00302,
+    0x01E92, 0x0005A, 0x00323,
+    0x01E93, 0x0007A, 0x00323,
+    0x01E94, 0x0005A, 0x00331,
+    0x01E95, 0x0007A, 0x00331,
+    0x01E96, 0x00068, 0x00331,
+    0x01E97, 0x00074, 0x00308,
+    0x01E98, 0x00077, 0x0030A,
+    0x01E99, 0x00079, 0x0030A,
+    0x01E9B, 0x0017F, 0x00307,
+    0x01EA0, 0x00041, 0x00323,
+    0x01EA1, 0x00061, 0x00323,
+    0x01EA2, 0x00041, 0x00309,
+    0x01EA3, 0x00061, 0x00309,
+    0x01EA4, 0x000C2, 0x00301,
+    0x01EA5, 0x000E2, 0x00301,
+    0x01EA6, 0x000C2, 0x00300,
+    0x01EA7, 0x000E2, 0x00300,
+    0x01EA8, 0x000C2, 0x00309,
+    0x01EA9, 0x000E2, 0x00309,
+    0x01EAA, 0x000C2, 0x00303,
+    0x01EAB, 0x000E2, 0x00303,
+    0x01EAC, 0x01EA0, 0x00302,
+    0x01EAD, 0x01EA1, 0x00302,
+    0x01EAE, 0x00102, 0x00301,
+    0x01EAF, 0x00103, 0x00301,
+    0x01EB0, 0x00102, 0x00300,
+    0x01EB1, 0x00103, 0x00300,
+    0x01EB2, 0x00102, 0x00309,
+    0x01EB3, 0x00103, 0x00309,
+    0x01EB4, 0x00102, 0x00303,
+    0x01EB5, 0x00103, 0x00303,
+    0x01EB6, 0x01EA0, 0x00306,
+    0x01EB7, 0x01EA1, 0x00306,
+    0x01EB8, 0x00045, 0x00323,
+    0x01EB9, 0x00065, 0x00323,
+    0x01EBA, 0x00045, 0x00309,
+    0x01EBB, 0x00065, 0x00309,
+    0x01EBC, 0x00045, 0x00303,
+    0x01EBD, 0x00065, 0x00303,
+    0x01EBE, 0x000CA, 0x00301,
+    0x01EBF, 0x000EA, 0x00301,
+    0x01EC0, 0x000CA, 0x00300,
+    0x01EC1, 0x000EA, 0x00300,
+    0x01EC2, 0x000CA, 0x00309,
+    0x01EC3, 0x000EA, 0x00309,
+    0x01EC4, 0x000CA, 0x00303,
+    0x01EC5, 0x000EA, 0x00303,
+    0x01EC6, 0x01EB8, 0x00302,
+    0x01EC7, 0x01EB9, 0x00302,
+    0x01EC8, 0x00049, 0x00309,
+    0x01EC9, 0x00069, 0x00309,
+    0x01ECA, 0x00049, 0x00323,
+    0x01ECB, 0x00069, 0x00323,
+    0x01ECC, 0x0004F, 0x00323,
+    0x01ECD, 0x0006F, 0x00323,
+    0x01ECE, 0x0004F, 0x00309,
+    0x01ECF, 0x0006F, 0x00309,
+    0x01ED0, 0x000D4, 0x00301,
+    0x01ED1, 0x000F4, 0x00301,
+    0x01ED2, 0x000D4, 0x00300,
+    0x01ED3, 0x000F4, 0x00300,
+    0x01ED4, 0x000D4, 0x00309,
+    0x01ED5, 0x000F4, 0x00309,
+    0x01ED6, 0x000D4, 0x00303,
+    0x01ED7, 0x000F4, 0x00303,
+    0x01ED8, 0x01ECC, 0x00302,
+    0x01ED9, 0x01ECD, 0x00302,
+    0x01EDA, 0x001A0, 0x00301,
+    0x01EDB, 0x001A1, 0x00301,
+    0x01EDC, 0x001A0, 0x00300,
+    0x01EDD, 0x001A1, 0x00300,
+    0x01EDE, 0x001A0, 0x00309,
+    0x01EDF, 0x001A1, 0x00309,
+    0x01EE0, 0x001A0, 0x00303,
+    0x01EE1, 0x001A1, 0x00303,
+    0x01EE2, 0x001A0, 0x00323,
+    0x01EE3, 0x001A1, 0x00323,
+    0x01EE4, 0x00055, 0x00323,
+    0x01EE5, 0x00075, 0x00323,
+    0x01EE6, 0x00055, 0x00309,
+    0x01EE7, 0x00075, 0x00309,
+    0x01EE8, 0x001AF, 0x00301,
+    0x01EE9, 0x001B0, 0x00301,
+    0x01EEA, 0x001AF, 0x00300,
+    0x01EEB, 0x001B0, 0x00300,
+    0x01EEC, 0x001AF, 0x00309,
+    0x01EED, 0x001B0, 0x00309,
+    0x01EEE, 0x001AF, 0x00303,
+    0x01EEF, 0x001B0, 0x00303,
+    0x01EF0, 0x001AF, 0x00323,
+    0x01EF1, 0x001B0, 0x00323,
+    0x01EF2, 0x00059, 0x00300,
+    0x01EF3, 0x00079, 0x00300,
+    0x01EF4, 0x00059, 0x00323,
+    0x01EF5, 0x00079, 0x00323,
+    0x01EF6, 0x00059, 0x00309,
+    0x01EF7, 0x00079, 0x00309,
+    0x01EF8, 0x00059, 0x00303,
+    0x01EF9, 0x00079, 0x00303,
+    0x01F00, 0x003B1, 0x00313,
+    0x01F01, 0x003B1, 0x00314,
+    0x01F02, 0x01F00, 0x00300,
+    0x01F03, 0x01F01, 0x00300,
+    0x01F04, 0x01F00, 0x00301,
+    0x01F05, 0x01F01, 0x00301,
+    0x01F06, 0x01F00, 0x00342,
+    0x01F07, 0x01F01, 0x00342,
+    0x01F08, 0x00391, 0x00313,
+    0x01F09, 0x00391, 0x00314,
+    0x01F0A, 0x01F08, 0x00300,
+    0x01F0B, 0x01F09, 0x00300,
+    0x01F0C, 0x01F08, 0x00301,
+    0x01F0D, 0x01F09, 0x00301,
+    0x01F0E, 0x01F08, 0x00342,
+    0x01F0F, 0x01F09, 0x00342,
+    0x01F10, 0x003B5, 0x00313,
+    0x01F11, 0x003B5, 0x00314,
+    0x01F12, 0x01F10, 0x00300,
+    0x01F13, 0x01F11, 0x00300,
+    0x01F14, 0x01F10, 0x00301,
+    0x01F15, 0x01F11, 0x00301,
+    0x01F18, 0x00395, 0x00313,
+    0x01F19, 0x00395, 0x00314,
+    0x01F1A, 0x01F18, 0x00300,
+    0x01F1B, 0x01F19, 0x00300,
+    0x01F1C, 0x01F18, 0x00301,
+    0x01F1D, 0x01F19, 0x00301,
+    0x01F20, 0x003B7, 0x00313,
+    0x01F21, 0x003B7, 0x00314,
+    0x01F22, 0x01F20, 0x00300,
+    0x01F23, 0x01F21, 0x00300,
+    0x01F24, 0x01F20, 0x00301,
+    0x01F25, 0x01F21, 0x00301,
+    0x01F26, 0x01F20, 0x00342,
+    0x01F27, 0x01F21, 0x00342,
+    0x01F28, 0x00397, 0x00313,
+    0x01F29, 0x00397, 0x00314,
+    0x01F2A, 0x01F28, 0x00300,
+    0x01F2B, 0x01F29, 0x00300,
+    0x01F2C, 0x01F28, 0x00301,
+    0x01F2D, 0x01F29, 0x00301,
+    0x01F2E, 0x01F28, 0x00342,
+    0x01F2F, 0x01F29, 0x00342,
+    0x01F30, 0x003B9, 0x00313,
+    0x01F31, 0x003B9, 0x00314,
+    0x01F32, 0x01F30, 0x00300,
+    0x01F33, 0x01F31, 0x00300,
+    0x01F34, 0x01F30, 0x00301,
+    0x01F35, 0x01F31, 0x00301,
+    0x01F36, 0x01F30, 0x00342,
+    0x01F37, 0x01F31, 0x00342,
+    0x01F38, 0x00399, 0x00313,
+    0x01F39, 0x00399, 0x00314,
+    0x01F3A, 0x01F38, 0x00300,
+    0x01F3B, 0x01F39, 0x00300,
+    0x01F3C, 0x01F38, 0x00301,
+    0x01F3D, 0x01F39, 0x00301,
+    0x01F3E, 0x01F38, 0x00342,
+    0x01F3F, 0x01F39, 0x00342,
+    0x01F40, 0x003BF, 0x00313,
+    0x01F41, 0x003BF, 0x00314,
+    0x01F42, 0x01F40, 0x00300,
+    0x01F43, 0x01F41, 0x00300,
+    0x01F44, 0x01F40, 0x00301,
+    0x01F45, 0x01F41, 0x00301,
+    0x01F48, 0x0039F, 0x00313,
+    0x01F49, 0x0039F, 0x00314,
+    0x01F4A, 0x01F48, 0x00300,
+    0x01F4B, 0x01F49, 0x00300,
+    0x01F4C, 0x01F48, 0x00301,
+    0x01F4D, 0x01F49, 0x00301,
+    0x01F50, 0x003C5, 0x00313,
+    0x01F51, 0x003C5, 0x00314,
+    0x01F52, 0x01F50, 0x00300,
+    0x01F53, 0x01F51, 0x00300,
+    0x01F54, 0x01F50, 0x00301,
+    0x01F55, 0x01F51, 0x00301,
+    0x01F56, 0x01F50, 0x00342,
+    0x01F57, 0x01F51, 0x00342,
+    0x01F59, 0x003A5, 0x00314,
+    0x01F5B, 0x01F59, 0x00300,
+    0x01F5D, 0x01F59, 0x00301,
+    0x01F5F, 0x01F59, 0x00342,
+    0x01F60, 0x003C9, 0x00313,
+    0x01F61, 0x003C9, 0x00314,
+    0x01F62, 0x01F60, 0x00300,
+    0x01F63, 0x01F61, 0x00300,
+    0x01F64, 0x01F60, 0x00301,
+    0x01F65, 0x01F61, 0x00301,
+    0x01F66, 0x01F60, 0x00342,
+    0x01F67, 0x01F61, 0x00342,
+    0x01F68, 0x003A9, 0x00313,
+    0x01F69, 0x003A9, 0x00314,
+    0x01F6A, 0x01F68, 0x00300,
+    0x01F6B, 0x01F69, 0x00300,
+    0x01F6C, 0x01F68, 0x00301,
+    0x01F6D, 0x01F69, 0x00301,
+    0x01F6E, 0x01F68, 0x00342,
+    0x01F6F, 0x01F69, 0x00342,
+    0x01F70, 0x003B1, 0x00300,
+    0x01F72, 0x003B5, 0x00300,
+    0x01F74, 0x003B7, 0x00300,
+    0x01F76, 0x003B9, 0x00300,
+    0x01F78, 0x003BF, 0x00300,
+    0x01F7A, 0x003C5, 0x00300,
+    0x01F7C, 0x003C9, 0x00300,
+    0x01F80, 0x01F00, 0x00345,
+    0x01F81, 0x01F01, 0x00345,
+    0x01F82, 0x01F02, 0x00345,
+    0x01F83, 0x01F03, 0x00345,
+    0x01F84, 0x01F04, 0x00345,
+    0x01F85, 0x01F05, 0x00345,
+    0x01F86, 0x01F06, 0x00345,
+    0x01F87, 0x01F07, 0x00345,
+    0x01F88, 0x01F08, 0x00345,
+    0x01F89, 0x01F09, 0x00345,
+    0x01F8A, 0x01F0A, 0x00345,
+    0x01F8B, 0x01F0B, 0x00345,
+    0x01F8C, 0x01F0C, 0x00345,
+    0x01F8D, 0x01F0D, 0x00345,
+    0x01F8E, 0x01F0E, 0x00345,
+    0x01F8F, 0x01F0F, 0x00345,
+    0x01F90, 0x01F20, 0x00345,
+    0x01F91, 0x01F21, 0x00345,
+    0x01F92, 0x01F22, 0x00345,
+    0x01F93, 0x01F23, 0x00345,
+    0x01F94, 0x01F24, 0x00345,
+    0x01F95, 0x01F25, 0x00345,
+    0x01F96, 0x01F26, 0x00345,
+    0x01F97, 0x01F27, 0x00345,
+    0x01F98, 0x01F28, 0x00345,
+    0x01F99, 0x01F29, 0x00345,
+    0x01F9A, 0x01F2A, 0x00345,
+    0x01F9B, 0x01F2B, 0x00345,
+    0x01F9C, 0x01F2C, 0x00345,
+    0x01F9D, 0x01F2D, 0x00345,
+    0x01F9E, 0x01F2E, 0x00345,
+    0x01F9F, 0x01F2F, 0x00345,
+    0x01FA0, 0x01F60, 0x00345,
+    0x01FA1, 0x01F61, 0x00345,
+    0x01FA2, 0x01F62, 0x00345,
+    0x01FA3, 0x01F63, 0x00345,
+    0x01FA4, 0x01F64, 0x00345,
+    0x01FA5, 0x01F65, 0x00345,
+    0x01FA6, 0x01F66, 0x00345,
+    0x01FA7, 0x01F67, 0x00345,
+    0x01FA8, 0x01F68, 0x00345,
+    0x01FA9, 0x01F69, 0x00345,
+    0x01FAA, 0x01F6A, 0x00345,
+    0x01FAB, 0x01F6B, 0x00345,
+    0x01FAC, 0x01F6C, 0x00345,
+    0x01FAD, 0x01F6D, 0x00345,
+    0x01FAE, 0x01F6E, 0x00345,
+    0x01FAF, 0x01F6F, 0x00345,
+    0x01FB0, 0x003B1, 0x00306,
+    0x01FB1, 0x003B1, 0x00304,
+    0x01FB2, 0x01F70, 0x00345,
+    0x01FB3, 0x003B1, 0x00345,
+    0x01FB4, 0x003AC, 0x00345,
+    0x01FB6, 0x003B1, 0x00342,
+    0x01FB7, 0x01FB6, 0x00345,
+    0x01FB8, 0x00391, 0x00306,
+    0x01FB9, 0x00391, 0x00304,
+    0x01FBA, 0x00391, 0x00300,
+    0x01FBC, 0x00391, 0x00345,
+    0x01FC1, 0x000A8, 0x00342,
+    0x01FC2, 0x01F74, 0x00345,
+    0x01FC3, 0x003B7, 0x00345,
+    0x01FC4, 0x003AE, 0x00345,
+    0x01FC6, 0x003B7, 0x00342,
+    0x01FC7, 0x01FC6, 0x00345,
+    0x01FC8, 0x00395, 0x00300,
+    0x01FCA, 0x00397, 0x00300,
+    0x01FCC, 0x00397, 0x00345,
+    0x01FCD, 0x01FBF, 0x00300,
+    0x01FCE, 0x01FBF, 0x00301,
+    0x01FCF, 0x01FBF, 0x00342,
+    0x01FD0, 0x003B9, 0x00306,
+    0x01FD1, 0x003B9, 0x00304,
+    0x01FD2, 0x003CA, 0x00300,
+    0x01FD6, 0x003B9, 0x00342,
+    0x01FD7, 0x003CA, 0x00342,
+    0x01FD8, 0x00399, 0x00306,
+    0x01FD9, 0x00399, 0x00304,
+    0x01FDA, 0x00399, 0x00300,
+    0x01FDD, 0x01FFE, 0x00300,
+    0x01FDE, 0x01FFE, 0x00301,
+    0x01FDF, 0x01FFE, 0x00342,
+    0x01FE0, 0x003C5, 0x00306,
+    0x01FE1, 0x003C5, 0x00304,
+    0x01FE2, 0x003CB, 0x00300,
+    0x01FE4, 0x003C1, 0x00313,
+    0x01FE5, 0x003C1, 0x00314,
+    0x01FE6, 0x003C5, 0x00342,
+    0x01FE7, 0x003CB, 0x00342,
+    0x01FE8, 0x003A5, 0x00306,
+    0x01FE9, 0x003A5, 0x00304,
+    0x01FEA, 0x003A5, 0x00300,
+    0x01FEC, 0x003A1, 0x00314,
+    0x01FED, 0x000A8, 0x00300,
+    0x01FF2, 0x01F7C, 0x00345,
+    0x01FF3, 0x003C9, 0x00345,
+    0x01FF4, 0x003CE, 0x00345,
+    0x01FF6, 0x003C9, 0x00342,
+    0x01FF7, 0x01FF6, 0x00345,
+    0x01FF8, 0x0039F, 0x00300,
+    0x01FFA, 0x003A9, 0x00300,
+    0x01FFC, 0x003A9, 0x00345,
+    0x0219A, 0x02190, 0x00338,
+    0x0219B, 0x02192, 0x00338,
+    0x021AE, 0x02194, 0x00338,
+    0x021CD, 0x021D0, 0x00338,
+    0x021CE, 0x021D4, 0x00338,
+    0x021CF, 0x021D2, 0x00338,
+    0x02204, 0x02203, 0x00338,
+    0x02209, 0x02208, 0x00338,
+    0x0220C, 0x0220B, 0x00338,
+    0x02224, 0x02223, 0x00338,
+    0x02226, 0x02225, 0x00338,
+    0x02241, 0x0223C, 0x00338,
+    0x02244, 0x02243, 0x00338,
+    0x02247, 0x02245, 0x00338,
+    0x02249, 0x02248, 0x00338,
+    0x02260, 0x0003D, 0x00338,
+    0x02262, 0x02261, 0x00338,
+    0x0226D, 0x0224D, 0x00338,
+    0x0226E, 0x0003C, 0x00338,
+    0x0226F, 0x0003E, 0x00338,
+    0x02270, 0x02264, 0x00338,
+    0x02271, 0x02265, 0x00338,
+    0x02274, 0x02272, 0x00338,
+    0x02275, 0x02273, 0x00338,
+    0x02278, 0x02276, 0x00338,
+    0x02279, 0x02277, 0x00338,
+    0x02280, 0x0227A, 0x00338,
+    0x02281, 0x0227B, 0x00338,
+    0x02284, 0x02282, 0x00338,
+    0x02285, 0x02283, 0x00338,
+    0x02288, 0x02286, 0x00338,
+    0x02289, 0x02287, 0x00338,
+    0x022AC, 0x022A2, 0x00338,
+    0x022AD, 0x022A8, 0x00338,
+    0x022AE, 0x022A9, 0x00338,
+    0x022AF, 0x022AB, 0x00338,
+    0x022E0, 0x0227C, 0x00338,
+    0x022E1, 0x0227D, 0x00338,
+    0x022E2, 0x02291, 0x00338,
+    0x022E3, 0x02292, 0x00338,
+    0x022EA, 0x022B2, 0x00338,
+    0x022EB, 0x022B3, 0x00338,
+    0x022EC, 0x022B4, 0x00338,
+    0x022ED, 0x022B5, 0x00338,
+    0x02ADC, 0x02ADD, 0x00338,
+    0x0304C, 0x0304B, 0x03099,
+    0x0304E, 0x0304D, 0x03099,
+    0x03050, 0x0304F, 0x03099,
+    0x03052, 0x03051, 0x03099,
+    0x03054, 0x03053, 0x03099,
+    0x03056, 0x03055, 0x03099,
+    0x03058, 0x03057, 0x03099,
+    0x0305A, 0x03059, 0x03099,
+    0x0305C, 0x0305B, 0x03099,
+    0x0305E, 0x0305D, 0x03099,
+    0x03060, 0x0305F, 0x03099,
+    0x03062, 0x03061, 0x03099,
+    0x03065, 0x03064, 0x03099,
+    0x03067, 0x03066, 0x03099,
+    0x03069, 0x03068, 0x03099,
+    0x03070, 0x0306F, 0x03099,
+    0x03071, 0x0306F, 0x0309A,
+    0x03073, 0x03072, 0x03099,
+    0x03074, 0x03072, 0x0309A,
+    0x03076, 0x03075, 0x03099,
+    0x03077, 0x03075, 0x0309A,
+    0x03079, 0x03078, 0x03099,
+    0x0307A, 0x03078, 0x0309A,
+    0x0307C, 0x0307B, 0x03099,
+    0x0307D, 0x0307B, 0x0309A,
+    0x03094, 0x03046, 0x03099,
+    0x0309E, 0x0309D, 0x03099,
+    0x030AC, 0x030AB, 0x03099,
+    0x030AE, 0x030AD, 0x03099,
+    0x030B0, 0x030AF, 0x03099,
+    0x030B2, 0x030B1, 0x03099,
+    0x030B4, 0x030B3, 0x03099,
+    0x030B6, 0x030B5, 0x03099,
+    0x030B8, 0x030B7, 0x03099,
+    0x030BA, 0x030B9, 0x03099,
+    0x030BC, 0x030BB, 0x03099,
+    0x030BE, 0x030BD, 0x03099,
+    0x030C0, 0x030BF, 0x03099,
+    0x030C2, 0x030C1, 0x03099,
+    0x030C5, 0x030C4, 0x03099,
+    0x030C7, 0x030C6, 0x03099,
+    0x030C9, 0x030C8, 0x03099,
+    0x030D0, 0x030CF, 0x03099,
+    0x030D1, 0x030CF, 0x0309A,
+    0x030D3, 0x030D2, 0x03099,
+    0x030D4, 0x030D2, 0x0309A,
+    0x030D6, 0x030D5, 0x03099,
+    0x030D7, 0x030D5, 0x0309A,
+    0x030D9, 0x030D8, 0x03099,
+    0x030DA, 0x030D8, 0x0309A,
+    0x030DC, 0x030DB, 0x03099,
+    0x030DD, 0x030DB, 0x0309A,
+    0x030F4, 0x030A6, 0x03099,
+    0x030F7, 0x030EF, 0x03099,
+    0x030F8, 0x030F0, 0x03099,
+    0x030F9, 0x030F1, 0x03099,
+    0x030FA, 0x030F2, 0x03099,
+    0x030FE, 0x030FD, 0x03099,
+    0x0FB1D, 0x005D9, 0x005B4,
+    0x0FB1F, 0x005F2, 0x005B7,
+    0x0FB2A, 0x005E9, 0x005C1,
+    0x0FB2B, 0x005E9, 0x005C2,
+    0x0FB2C, 0x0FB49, 0x005C1,
+    0x0FB2D, 0x0FB49, 0x005C2,
+    0x0FB2E, 0x005D0, 0x005B7,
+    0x0FB2F, 0x005D0, 0x005B8,
+    0x0FB30, 0x005D0, 0x005BC,
+    0x0FB31, 0x005D1, 0x005BC,
+    0x0FB32, 0x005D2, 0x005BC,
+    0x0FB33, 0x005D3, 0x005BC,
+    0x0FB34, 0x005D4, 0x005BC,
+    0x0FB35, 0x005D5, 0x005BC,
+    0x0FB36, 0x005D6, 0x005BC,
+    0x0FB38, 0x005D8, 0x005BC,
+    0x0FB39, 0x005D9, 0x005BC,
+    0x0FB3A, 0x005DA, 0x005BC,
+    0x0FB3B, 0x005DB, 0x005BC,
+    0x0FB3C, 0x005DC, 0x005BC,
+    0x0FB3E, 0x005DE, 0x005BC,
+    0x0FB40, 0x005E0, 0x005BC,
+    0x0FB41, 0x005E1, 0x005BC,
+    0x0FB43, 0x005E3, 0x005BC,
+    0x0FB44, 0x005E4, 0x005BC,
+    0x0FB46, 0x005E6, 0x005BC,
+    0x0FB47, 0x005E7, 0x005BC,
+    0x0FB48, 0x005E8, 0x005BC,
+    0x0FB49, 0x005E9, 0x005BC,
+    0x0FB4A, 0x005EA, 0x005BC,
+    0x0FB4B, 0x005D5, 0x005B9,
+    0x0FB4C, 0x005D1, 0x005BF,
+    0x0FB4D, 0x005DB, 0x005BF,
+    0x0FB4E, 0x005E4, 0x005BF,
+    0x1109A, 0x11099, 0x110BA,
+    0x1109C, 0x1109B, 0x110BA,
+    0x110AB, 0x110A5, 0x110BA,
+    0x1D15E, 0x1D157, 0x1D165,
+    0x1D15F, 0x1D158, 0x1D165,
+    0x1D160, 0x1D15F, 0x1D16E,
+    0x1D161, 0x1D15F, 0x1D16F,
+    0x1D162, 0x1D15F, 0x1D170,
+    0x1D163, 0x1D15F, 0x1D171,
+    0x1D164, 0x1D15F, 0x1D172,
+    0x1D1BB, 0x1D1B9, 0x1D165,
+    0x1D1BC, 0x1D1BA, 0x1D165,
+    0x1D1BD, 0x1D1BB, 0x1D16E,
+    0x1D1BE, 0x1D1BC, 0x1D16E,
+    0x1D1BF, 0x1D1BB, 0x1D16F,
+    0x1D1C0, 0x1D1BC, 0x1D16F,
+};
+
+/* ranges of codepoints that are letters */
+
+static unsigned int xs_unicode_alpha_table[] = {
+    0x00041, 0x0005A,
+    0x00061, 0x0007A,
+    0x000AA, 0x000AA,
+    0x000B5, 0x000B5,
+    0x000BA, 0x000BA,
+    0x000C0, 0x000D6,
+    0x000D8, 0x000F6,
+    0x000F8, 0x002C1,
+    0x002C6, 0x002D1,
+    0x002E0, 0x002E4,
+    0x002EC, 0x002EC,
+    0x002EE, 0x002EE,
+    0x00370, 0x00374,
+    0x00376, 0x00377,
+    0x0037A, 0x0037D,
+    0x0037F, 0x0037F,
+    0x00386, 0x00386,
+    0x00388, 0x0038A,
+    0x0038C, 0x0038C,
+    0x0038E, 0x003A1,
+    0x003A3, 0x003F5,
+    0x003F7, 0x00481,
+    0x0048A, 0x0052F,
+    0x00531, 0x00556,
+    0x00559, 0x00559,
+    0x00560, 0x00588,
+    0x005D0, 0x005EA,
+    0x005EF, 0x005F2,
+    0x00620, 0x0064A,
+    0x0066E, 0x0066F,
+    0x00671, 0x006D3,
+    0x006D5, 0x006D5,
+    0x006E5, 0x006E6,
+    0x006EE, 0x006EF,
+    0x006FA, 0x006FC,
+    0x006FF, 0x006FF,
+    0x00710, 0x00710,
+    0x00712, 0x0072F,
+    0x0074D, 0x007A5,
+    0x007B1, 0x007B1,
+    0x007CA, 0x007EA,
+    0x007F4, 0x007F5,
+    0x007FA, 0x007FA,
+    0x00800, 0x00815,
+    0x0081A, 0x0081A,
+    0x00824, 0x00824,
+    0x00828, 0x00828,
+    0x00840, 0x00858,
+    0x00860, 0x0086A,
+    0x00870, 0x00887,
+    0x00889, 0x0088E,
+    0x008A0, 0x008C9,
+    0x00904, 0x00939,
+    0x0093D, 0x0093D,
+    0x00950, 0x00950,
+    0x00958, 0x00961,
+    0x00971, 0x00980,
+    0x00985, 0x0098C,
+    0x0098F, 0x00990,
+    0x00993, 0x009A8,
+    0x009AA, 0x009B0,
+    0x009B2, 0x009B2,
+    0x009B6, 0x009B9,
+    0x009BD, 0x009BD,
+    0x009CE, 0x009CE,
+    0x009DC, 0x009DD,
+    0x009DF, 0x009E1,
+    0x009F0, 0x009F1,
+    0x009FC, 0x009FC,
+    0x00A05, 0x00A0A,
+    0x00A0F, 0x00A10,
+    0x00A13, 0x00A28,
+    0x00A2A, 0x00A30,
+    0x00A32, 0x00A33,
+    0x00A35, 0x00A36,
+    0x00A38, 0x00A39,
+    0x00A59, 0x00A5C,
+    0x00A5E, 0x00A5E,
+    0x00A72, 0x00A74,
+    0x00A85, 0x00A8D,
+    0x00A8F, 0x00A91,
+    0x00A93, 0x00AA8,
+    0x00AAA, 0x00AB0,
+    0x00AB2, 0x00AB3,
+    0x00AB5, 0x00AB9,
+    0x00ABD, 0x00ABD,
+    0x00AD0, 0x00AD0,
+    0x00AE0, 0x00AE1,
+    0x00AF9, 0x00AF9,
+    0x00B05, 0x00B0C,
+    0x00B0F, 0x00B10,
+    0x00B13, 0x00B28,
+    0x00B2A, 0x00B30,
+    0x00B32, 0x00B33,
+    0x00B35, 0x00B39,
+    0x00B3D, 0x00B3D,
+    0x00B5C, 0x00B5D,
+    0x00B5F, 0x00B61,
+    0x00B71, 0x00B71,
+    0x00B83, 0x00B83,
+    0x00B85, 0x00B8A,
+    0x00B8E, 0x00B90,
+    0x00B92, 0x00B95,
+    0x00B99, 0x00B9A,
+    0x00B9C, 0x00B9C,
+    0x00B9E, 0x00B9F,
+    0x00BA3, 0x00BA4,
+    0x00BA8, 0x00BAA,
+    0x00BAE, 0x00BB9,
+    0x00BD0, 0x00BD0,
+    0x00C05, 0x00C0C,
+    0x00C0E, 0x00C10,
+    0x00C12, 0x00C28,
+    0x00C2A, 0x00C39,
+    0x00C3D, 0x00C3D,
+    0x00C58, 0x00C5A,
+    0x00C5D, 0x00C5D,
+    0x00C60, 0x00C61,
+    0x00C80, 0x00C80,
+    0x00C85, 0x00C8C,
+    0x00C8E, 0x00C90,
+    0x00C92, 0x00CA8,
+    0x00CAA, 0x00CB3,
+    0x00CB5, 0x00CB9,
+    0x00CBD, 0x00CBD,
+    0x00CDD, 0x00CDE,
+    0x00CE0, 0x00CE1,
+    0x00CF1, 0x00CF2,
+    0x00D04, 0x00D0C,
+    0x00D0E, 0x00D10,
+    0x00D12, 0x00D3A,
+    0x00D3D, 0x00D3D,
+    0x00D4E, 0x00D4E,
+    0x00D54, 0x00D56,
+    0x00D5F, 0x00D61,
+    0x00D7A, 0x00D7F,
+    0x00D85, 0x00D96,
+    0x00D9A, 0x00DB1,
+    0x00DB3, 0x00DBB,
+    0x00DBD, 0x00DBD,
+    0x00DC0, 0x00DC6,
+    0x00E01, 0x00E30,
+    0x00E32, 0x00E33,
+    0x00E40, 0x00E46,
+    0x00E81, 0x00E82,
+    0x00E84, 0x00E84,
+    0x00E86, 0x00E8A,
+    0x00E8C, 0x00EA3,
+    0x00EA5, 0x00EA5,
+    0x00EA7, 0x00EB0,
+    0x00EB2, 0x00EB3,
+    0x00EBD, 0x00EBD,
+    0x00EC0, 0x00EC4,
+    0x00EC6, 0x00EC6,
+    0x00EDC, 0x00EDF,
+    0x00F00, 0x00F00,
+    0x00F40, 0x00F47,
+    0x00F49, 0x00F6C,
+    0x00F88, 0x00F8C,
+    0x01000, 0x0102A,
+    0x0103F, 0x0103F,
+    0x01050, 0x01055,
+    0x0105A, 0x0105D,
+    0x01061, 0x01061,
+    0x01065, 0x01066,
+    0x0106E, 0x01070,
+    0x01075, 0x01081,
+    0x0108E, 0x0108E,
+    0x010A0, 0x010C5,
+    0x010C7, 0x010C7,
+    0x010CD, 0x010CD,
+    0x010D0, 0x010FA,
+    0x010FC, 0x01248,
+    0x0124A, 0x0124D,
+    0x01250, 0x01256,
+    0x01258, 0x01258,
+    0x0125A, 0x0125D,
+    0x01260, 0x01288,
+    0x0128A, 0x0128D,
+    0x01290, 0x012B0,
+    0x012B2, 0x012B5,
+    0x012B8, 0x012BE,
+    0x012C0, 0x012C0,
+    0x012C2, 0x012C5,
+    0x012C8, 0x012D6,
+    0x012D8, 0x01310,
+    0x01312, 0x01315,
+    0x01318, 0x0135A,
+    0x01380, 0x0138F,
+    0x013A0, 0x013F5,
+    0x013F8, 0x013FD,
+    0x01401, 0x0166C,
+    0x0166F, 0x0167F,
+    0x01681, 0x0169A,
+    0x016A0, 0x016EA,
+    0x016F1, 0x016F8,
+    0x01700, 0x01711,
+    0x0171F, 0x01731,
+    0x01740, 0x01751,
+    0x01760, 0x0176C,
+    0x0176E, 0x01770,
+    0x01780, 0x017B3,
+    0x017D7, 0x017D7,
+    0x017DC, 0x017DC,
+    0x01820, 0x01878,
+    0x01880, 0x01884,
+    0x01887, 0x018A8,
+    0x018AA, 0x018AA,
+    0x018B0, 0x018F5,
+    0x01900, 0x0191E,
+    0x01950, 0x0196D,
+    0x01970, 0x01974,
+    0x01980, 0x019AB,
+    0x019B0, 0x019C9,
+    0x01A00, 0x01A16,
+    0x01A20, 0x01A54,
+    0x01AA7, 0x01AA7,
+    0x01B05, 0x01B33,
+    0x01B45, 0x01B4C,
+    0x01B83, 0x01BA0,
+    0x01BAE, 0x01BAF,
+    0x01BBA, 0x01BE5,
+    0x01C00, 0x01C23,
+    0x01C4D, 0x01C4F,
+    0x01C5A, 0x01C7D,
+    0x01C80, 0x01C88,
+    0x01C90, 0x01CBA,
+    0x01CBD, 0x01CBF,
+    0x01CE9, 0x01CEC,
+    0x01CEE, 0x01CF3,
+    0x01CF5, 0x01CF6,
+    0x01CFA, 0x01CFA,
+    0x01D00, 0x01DBF,
+    0x01E00, 0x01F15,
+    0x01F18, 0x01F1D,
+    0x01F20, 0x01F45,
+    0x01F48, 0x01F4D,
+    0x01F50, 0x01F57,
+    0x01F59, 0x01F59,
+    0x01F5B, 0x01F5B,
+    0x01F5D, 0x01F5D,
+    0x01F5F, 0x01F7D,
+    0x01F80, 0x01FB4,
+    0x01FB6, 0x01FBC,
+    0x01FBE, 0x01FBE,
+    0x01FC2, 0x01FC4,
+    0x01FC6, 0x01FCC,
+    0x01FD0, 0x01FD3,
+    0x01FD6, 0x01FDB,
+    0x01FE0, 0x01FEC,
+    0x01FF2, 0x01FF4,
+    0x01FF6, 0x01FFC,
+    0x02071, 0x02071,
+    0x0207F, 0x0207F,
+    0x02090, 0x0209C,
+    0x02102, 0x02102,
+    0x02107, 0x02107,
+    0x0210A, 0x02113,
+    0x02115, 0x02115,
+    0x02119, 0x0211D,
+    0x02124, 0x02124,
+    0x02126, 0x02126,
+    0x02128, 0x02128,
+    0x0212A, 0x0212D,
+    0x0212F, 0x02139,
+    0x0213C, 0x0213F,
+    0x02145, 0x02149,
+    0x0214E, 0x0214E,
+    0x02183, 0x02184,
+    0x02C00, 0x02CE4,
+    0x02CEB, 0x02CEE,
+    0x02CF2, 0x02CF3,
+    0x02D00, 0x02D25,
+    0x02D27, 0x02D27,
+    0x02D2D, 0x02D2D,
+    0x02D30, 0x02D67,
+    0x02D6F, 0x02D6F,
+    0x02D80, 0x02D96,
+    0x02DA0, 0x02DA6,
+    0x02DA8, 0x02DAE,
+    0x02DB0, 0x02DB6,
+    0x02DB8, 0x02DBE,
+    0x02DC0, 0x02DC6,
+    0x02DC8, 0x02DCE,
+    0x02DD0, 0x02DD6,
+    0x02DD8, 0x02DDE,
+    0x02E2F, 0x02E2F,
+    0x03005, 0x03006,
+    0x03031, 0x03035,
+    0x0303B, 0x0303C,
+    0x03041, 0x03096,
+    0x0309D, 0x0309F,
+    0x030A1, 0x030FA,
+    0x030FC, 0x030FF,
+    0x03105, 0x0312F,
+    0x03131, 0x0318E,
+    0x031A0, 0x031BF,
+    0x031F0, 0x031FF,
+    0x03400, 0x04DBF,
+    0x04E00, 0x0A48C,
+    0x0A4D0, 0x0A4FD,
+    0x0A500, 0x0A60C,
+    0x0A610, 0x0A61F,
+    0x0A62A, 0x0A62B,
+    0x0A640, 0x0A66E,
+    0x0A67F, 0x0A69D,
+    0x0A6A0, 0x0A6E5,
+    0x0A717, 0x0A71F,
+    0x0A722, 0x0A788,
+    0x0A78B, 0x0A7CA,
+    0x0A7D0, 0x0A7D1,
+    0x0A7D3, 0x0A7D3,
+    0x0A7D5, 0x0A7D9,
+    0x0A7F2, 0x0A801,
+    0x0A803, 0x0A805,
+    0x0A807, 0x0A80A,
+    0x0A80C, 0x0A822,
+    0x0A840, 0x0A873,
+    0x0A882, 0x0A8B3,
+    0x0A8F2, 0x0A8F7,
+    0x0A8FB, 0x0A8FB,
+    0x0A8FD, 0x0A8FE,
+    0x0A90A, 0x0A925,
+    0x0A930, 0x0A946,
+    0x0A960, 0x0A97C,
+    0x0A984, 0x0A9B2,
+    0x0A9CF, 0x0A9CF,
+    0x0A9E0, 0x0A9E4,
+    0x0A9E6, 0x0A9EF,
+    0x0A9FA, 0x0A9FE,
+    0x0AA00, 0x0AA28,
+    0x0AA40, 0x0AA42,
+    0x0AA44, 0x0AA4B,
+    0x0AA60, 0x0AA76,
+    0x0AA7A, 0x0AA7A,
+    0x0AA7E, 0x0AAAF,
+    0x0AAB1, 0x0AAB1,
+    0x0AAB5, 0x0AAB6,
+    0x0AAB9, 0x0AABD,
+    0x0AAC0, 0x0AAC0,
+    0x0AAC2, 0x0AAC2,
+    0x0AADB, 0x0AADD,
+    0x0AAE0, 0x0AAEA,
+    0x0AAF2, 0x0AAF4,
+    0x0AB01, 0x0AB06,
+    0x0AB09, 0x0AB0E,
+    0x0AB11, 0x0AB16,
+    0x0AB20, 0x0AB26,
+    0x0AB28, 0x0AB2E,
+    0x0AB30, 0x0AB5A,
+    0x0AB5C, 0x0AB69,
+    0x0AB70, 0x0ABE2,
+    0x0AC00, 0x0D7A3,
+    0x0D7B0, 0x0D7C6,
+    0x0D7CB, 0x0D7FB,
+    0x0F900, 0x0FA6D,
+    0x0FA70, 0x0FAD9,
+    0x0FB00, 0x0FB06,
+    0x0FB13, 0x0FB17,
+    0x0FB1D, 0x0FB1D,
+    0x0FB1F, 0x0FB28,
+    0x0FB2A, 0x0FB36,
+    0x0FB38, 0x0FB3C,
+    0x0FB3E, 0x0FB3E,
+    0x0FB40, 0x0FB41,
+    0x0FB43, 0x0FB44,
+    0x0FB46, 0x0FBB1,
+    0x0FBD3, 0x0FD3D,
+    0x0FD50, 0x0FD8F,
+    0x0FD92, 0x0FDC7,
+    0x0FDF0, 0x0FDFB,
+    0x0FE70, 0x0FE74,
+    0x0FE76, 0x0FEFC,
+    0x0FF21, 0x0FF3A,
+    0x0FF41, 0x0FF5A,
+    0x0FF66, 0x0FFBE,
+    0x0FFC2, 0x0FFC7,
+    0x0FFCA, 0x0FFCF,
+    0x0FFD2, 0x0FFD7,
+    0x0FFDA, 0x0FFDC,
+    0x10000, 0x1000B,
+    0x1000D, 0x10026,
+    0x10028, 0x1003A,
+    0x1003C, 0x1003D,
+    0x1003F, 0x1004D,
+    0x10050, 0x1005D,
+    0x10080, 0x100FA,
+    0x10280, 0x1029C,
+    0x102A0, 0x102D0,
+    0x10300, 0x1031F,
+    0x1032D, 0x10340,
+    0x10342, 0x10349,
+    0x10350, 0x10375,
+    0x10380, 0x1039D,
+    0x103A0, 0x103C3,
+    0x103C8, 0x103CF,
+    0x10400, 0x1049D,
+    0x104B0, 0x104D3,
+    0x104D8, 0x104FB,
+    0x10500, 0x10527,
+    0x10530, 0x10563,
+    0x10570, 0x1057A,
+    0x1057C, 0x1058A,
+    0x1058C, 0x10592,
+    0x10594, 0x10595,
+    0x10597, 0x105A1,
+    0x105A3, 0x105B1,
+    0x105B3, 0x105B9,
+    0x105BB, 0x105BC,
+    0x10600, 0x10736,
+    0x10740, 0x10755,
+    0x10760, 0x10767,
+    0x10780, 0x10785,
+    0x10787, 0x107B0,
+    0x107B2, 0x107BA,
+    0x10800, 0x10805,
+    0x10808, 0x10808,
+    0x1080A, 0x10835,
+    0x10837, 0x10838,
+    0x1083C, 0x1083C,
+    0x1083F, 0x10855,
+    0x10860, 0x10876,
+    0x10880, 0x1089E,
+    0x108E0, 0x108F2,
+    0x108F4, 0x108F5,
+    0x10900, 0x10915,
+    0x10920, 0x10939,
+    0x10980, 0x109B7,
+    0x109BE, 0x109BF,
+    0x10A00, 0x10A00,
+    0x10A10, 0x10A13,
+    0x10A15, 0x10A17,
+    0x10A19, 0x10A35,
+    0x10A60, 0x10A7C,
+    0x10A80, 0x10A9C,
+    0x10AC0, 0x10AC7,
+    0x10AC9, 0x10AE4,
+    0x10B00, 0x10B35,
+    0x10B40, 0x10B55,
+    0x10B60, 0x10B72,
+    0x10B80, 0x10B91,
+    0x10C00, 0x10C48,
+    0x10C80, 0x10CB2,
+    0x10CC0, 0x10CF2,
+    0x10D00, 0x10D23,
+    0x10E80, 0x10EA9,
+    0x10EB0, 0x10EB1,
+    0x10F00, 0x10F1C,
+    0x10F27, 0x10F27,
+    0x10F30, 0x10F45,
+    0x10F70, 0x10F81,
+    0x10FB0, 0x10FC4,
+    0x10FE0, 0x10FF6,
+    0x11003, 0x11037,
+    0x11071, 0x11072,
+    0x11075, 0x11075,
+    0x11083, 0x110AF,
+    0x110D0, 0x110E8,
+    0x11103, 0x11126,
+    0x11144, 0x11144,
+    0x11147, 0x11147,
+    0x11150, 0x11172,
+    0x11176, 0x11176,
+    0x11183, 0x111B2,
+    0x111C1, 0x111C4,
+    0x111DA, 0x111DA,
+    0x111DC, 0x111DC,
+    0x11200, 0x11211,
+    0x11213, 0x1122B,
+    0x11280, 0x11286,
+    0x11288, 0x11288,
+    0x1128A, 0x1128D,
+    0x1128F, 0x1129D,
+    0x1129F, 0x112A8,
+    0x112B0, 0x112DE,
+    0x11305, 0x1130C,
+    0x1130F, 0x11310,
+    0x11313, 0x11328,
+    0x1132A, 0x11330,
+    0x11332, 0x11333,
+    0x11335, 0x11339,
+    0x1133D, 0x1133D,
+    0x11350, 0x11350,
+    0x1135D, 0x11361,
+    0x11400, 0x11434,
+    0x11447, 0x1144A,
+    0x1145F, 0x11461,
+    0x11480, 0x114AF,
+    0x114C4, 0x114C5,
+    0x114C7, 0x114C7,
+    0x11580, 0x115AE,
+    0x115D8, 0x115DB,
+    0x11600, 0x1162F,
+    0x11644, 0x11644,
+    0x11680, 0x116AA,
+    0x116B8, 0x116B8,
+    0x11700, 0x1171A,
+    0x11740, 0x11746,
+    0x11800, 0x1182B,
+    0x118A0, 0x118DF,
+    0x118FF, 0x11906,
+    0x11909, 0x11909,
+    0x1190C, 0x11913,
+    0x11915, 0x11916,
+    0x11918, 0x1192F,
+    0x1193F, 0x1193F,
+    0x11941, 0x11941,
+    0x119A0, 0x119A7,
+    0x119AA, 0x119D0,
+    0x119E1, 0x119E1,
+    0x119E3, 0x119E3,
+    0x11A00, 0x11A00,
+    0x11A0B, 0x11A32,
+    0x11A3A, 0x11A3A,
+    0x11A50, 0x11A50,
+    0x11A5C, 0x11A89,
+    0x11A9D, 0x11A9D,
+    0x11AB0, 0x11AF8,
+    0x11C00, 0x11C08,
+    0x11C0A, 0x11C2E,
+    0x11C40, 0x11C40,
+    0x11C72, 0x11C8F,
+    0x11D00, 0x11D06,
+    0x11D08, 0x11D09,
+    0x11D0B, 0x11D30,
+    0x11D46, 0x11D46,
+    0x11D60, 0x11D65,
+    0x11D67, 0x11D68,
+    0x11D6A, 0x11D89,
+    0x11D98, 0x11D98,
+    0x11EE0, 0x11EF2,
+    0x11FB0, 0x11FB0,
+    0x12000, 0x12399,
+    0x12480, 0x12543,
+    0x12F90, 0x12FF0,
+    0x13000, 0x1342E,
+    0x14400, 0x14646,
+    0x16800, 0x16A38,
+    0x16A40, 0x16A5E,
+    0x16A70, 0x16ABE,
+    0x16AD0, 0x16AED,
+    0x16B00, 0x16B2F,
+    0x16B40, 0x16B43,
+    0x16B63, 0x16B77,
+    0x16B7D, 0x16B8F,
+    0x16E40, 0x16E7F,
+    0x16F00, 0x16F4A,
+    0x16F50, 0x16F50,
+    0x16F93, 0x16F9F,
+    0x16FE0, 0x16FE1,
+    0x16FE3, 0x16FE3,
+    0x17000, 0x187F7,
+    0x18800, 0x18CD5,
+    0x18D00, 0x18D08,
+    0x1AFF0, 0x1AFF3,
+    0x1AFF5, 0x1AFFB,
+    0x1AFFD, 0x1AFFE,
+    0x1B000, 0x1B122,
+    0x1B150, 0x1B152,
+    0x1B164, 0x1B167,
+    0x1B170, 0x1B2FB,
+    0x1BC00, 0x1BC6A,
+    0x1BC70, 0x1BC7C,
+    0x1BC80, 0x1BC88,
+    0x1BC90, 0x1BC99,
+    0x1D400, 0x1D454,
+    0x1D456, 0x1D49C,
+    0x1D49E, 0x1D49F,
+    0x1D4A2, 0x1D4A2,
+    0x1D4A5, 0x1D4A6,
+    0x1D4A9, 0x1D4AC,
+    0x1D4AE, 0x1D4B9,
+    0x1D4BB, 0x1D4BB,
+    0x1D4BD, 0x1D4C3,
+    0x1D4C5, 0x1D505,
+    0x1D507, 0x1D50A,
+    0x1D50D, 0x1D514,
+    0x1D516, 0x1D51C,
+    0x1D51E, 0x1D539,
+    0x1D53B, 0x1D53E,
+    0x1D540, 0x1D544,
+    0x1D546, 0x1D546,
+    0x1D54A, 0x1D550,
+    0x1D552, 0x1D6A5,
+    0x1D6A8, 0x1D6C0,
+    0x1D6C2, 0x1D6DA,
+    0x1D6DC, 0x1D6FA,
+    0x1D6FC, 0x1D714,
+    0x1D716, 0x1D734,
+    0x1D736, 0x1D74E,
+    0x1D750, 0x1D76E,
+    0x1D770, 0x1D788,
+    0x1D78A, 0x1D7A8,
+    0x1D7AA, 0x1D7C2,
+    0x1D7C4, 0x1D7CB,
+    0x1DF00, 0x1DF1E,
+    0x1E100, 0x1E12C,
+    0x1E137, 0x1E13D,
+    0x1E14E, 0x1E14E,
+    0x1E290, 0x1E2AD,
+    0x1E2C0, 0x1E2EB,
+    0x1E7E0, 0x1E7E6,
+    0x1E7E8, 0x1E7EB,
+    0x1E7ED, 0x1E7EE,
+    0x1E7F0, 0x1E7FE,
+    0x1E800, 0x1E8C4,
+    0x1E900, 0x1E943,
+    0x1E94B, 0x1E94B,
+    0x1EE00, 0x1EE03,
+    0x1EE05, 0x1EE1F,
+    0x1EE21, 0x1EE22,
+    0x1EE24, 0x1EE24,
+    0x1EE27, 0x1EE27,
+    0x1EE29, 0x1EE32,
+    0x1EE34, 0x1EE37,
+    0x1EE39, 0x1EE39,
+    0x1EE3B, 0x1EE3B,
+    0x1EE42, 0x1EE42,
+    0x1EE47, 0x1EE47,
+    0x1EE49, 0x1EE49,
+    0x1EE4B, 0x1EE4B,
+    0x1EE4D, 0x1EE4F,
+    0x1EE51, 0x1EE52,
+    0x1EE54, 0x1EE54,
+    0x1EE57, 0x1EE57,
+    0x1EE59, 0x1EE59,
+    0x1EE5B, 0x1EE5B,
+    0x1EE5D, 0x1EE5D,
+    0x1EE5F, 0x1EE5F,
+    0x1EE61, 0x1EE62,
+    0x1EE64, 0x1EE64,
+    0x1EE67, 0x1EE6A,
+    0x1EE6C, 0x1EE72,
+    0x1EE74, 0x1EE77,
+    0x1EE79, 0x1EE7C,
+    0x1EE7E, 0x1EE7E,
+    0x1EE80, 0x1EE89,
+    0x1EE8B, 0x1EE9B,
+    0x1EEA1, 0x1EEA3,
+    0x1EEA5, 0x1EEA9,
+    0x1EEAB, 0x1EEBB,
+    0x20000, 0x2A6DF,
+    0x2A700, 0x2B738,
+    0x2B740, 0x2B81D,
+    0x2B820, 0x2CEA1,
+    0x2CEB0, 0x2EBE0,
+    0x2F800, 0x2FA1D,
+    0x30000, 0x3134A,
+};
+
+#endif /* _XS_UNICODE_TBL_H */